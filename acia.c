@@ -0,0 +1,128 @@
+/********************************************************************
+ * acia.c
+ *
+ *  Module that implements the MC6551 ACIA serial port
+ *  of the Dragon 64, at 0xFF04 to 0xFF07.
+ *  Transmitted bytes go to the emulator console output, and there is no
+ *  serial input, so the receive data register is always empty and the modem
+ *  lines read as connected. The baud rate, word format and parity of the
+ *  control and command registers are kept but not emulated, and the ACIA
+ *  interrupt is not used by the Dragon 64 ROM, so it is not connected.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "mem.h"
+#include    "printf.h"
+
+#include    "acia.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     ACIA_BASE           0xff04
+#define     ACIA_END            0xff07
+
+#define     ACIA_REG_MASK       0x03
+#define     ACIA_REG_DATA       0       // Transmit and receive data
+#define     ACIA_REG_STATUS     1       // Status, and programmed reset on write
+#define     ACIA_REG_COMMAND    2
+#define     ACIA_REG_CONTROL    3
+
+#define     ACIA_STAT_TDRE      0x10    // Transmit data register empty
+#define     ACIA_STAT_RDRF      0x08    // Receive data register full
+#define     ACIA_STAT_OVERRUN   0x04
+
+#define     ACIA_CMD_RESET_MASK 0xe0    // Command bits kept by a programmed reset
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static uint8_t io_handler_acia(uint16_t address, uint8_t data, mem_operation_t op);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static struct acia_reg_t
+{
+    uint8_t status;
+    uint8_t command;
+    uint8_t control;
+} acia_registers;
+
+/*------------------------------------------------
+ * acia_init()
+ *
+ *  Initialize the ACIA to its hardware reset state and
+ *  link its IO call-back over the PIA0 register mirror it replaces.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void acia_init(void)
+{
+    acia_registers.status = ACIA_STAT_TDRE;
+    acia_registers.command = 0x02;          // Receiver interrupt disabled
+    acia_registers.control = 0;
+
+    mem_define_io(ACIA_BASE, ACIA_END, io_handler_acia);
+}
+
+/*------------------------------------------------
+ * io_handler_acia()
+ *
+ *  IO call-back handler to emulate the ACIA registers.
+ *  The transmitter is always ready, a byte written to the data register
+ *  is sent to the console right away.
+ *
+ *  param:  Call address, data byte for write operation, and operation type
+ *  return: Status or data byte
+ */
+static uint8_t io_handler_acia(uint16_t address, uint8_t data, mem_operation_t op)
+{
+    switch ( address & ACIA_REG_MASK )
+    {
+        case ACIA_REG_DATA:
+            if ( op == MEM_WRITE )
+            {
+                _putchar((char) data);
+            }
+            else
+            {
+                acia_registers.status &= ~(ACIA_STAT_RDRF | ACIA_STAT_OVERRUN);
+                data = 0;
+            }
+            break;
+
+        case ACIA_REG_STATUS:
+            if ( op == MEM_WRITE )
+            {
+                acia_registers.status &= ~ACIA_STAT_OVERRUN;
+                acia_registers.command &= ACIA_CMD_RESET_MASK;
+            }
+            else
+            {
+                data = acia_registers.status;
+            }
+            break;
+
+        case ACIA_REG_COMMAND:
+            if ( op == MEM_WRITE )
+                acia_registers.command = data;
+            else
+                data = acia_registers.command;
+            break;
+
+        case ACIA_REG_CONTROL:
+            if ( op == MEM_WRITE )
+                acia_registers.control = data;
+            else
+                data = acia_registers.control;
+            break;
+    }
+
+    return data;
+}
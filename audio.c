@@ -0,0 +1,198 @@
+/********************************************************************
+ * audio.c
+ *
+ *  Buffered DAC audio stream.
+ *  DAC writes are time stamped in emulated CPU cycles and queued
+ *  in a ring buffer by the emulation. The platform's sample timer
+ *  (a thread on Linux, a timer interrupt on bare metal) takes one sample
+ *  per period at AUDIO_SAMPLE_RATE and writes it to the GPIO DAC,
+ *  so that sound timing does not depend on emulation loop jitter.
+ *  The ring buffer has one writer and one reader, the emulation only
+ *  moves the head and the sample timer only moves the tail.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+
+#include    "sched.h"
+#include    "audio.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     AUDIO_RING_SIZE         2048        // DAC writes, must be a power of 2
+#define     AUDIO_RING_MASK         (AUDIO_RING_SIZE-1)
+#define     AUDIO_LATENCY           ((int32_t)(SCHED_CPU_CLOCK_HZ/50))  // Play-out delay, one video field in CPU cycles
+#define     AUDIO_LATENCY_MAX       (3*AUDIO_LATENCY)                   // Re-synchronize play-out past this delay
+#define     AUDIO_CYCLES_PER_SAMPLE (SCHED_CPU_CLOCK_HZ/AUDIO_SAMPLE_RATE)
+#define     AUDIO_CYCLES_REMAINDER  (SCHED_CPU_CLOCK_HZ%AUDIO_SAMPLE_RATE)
+
+/* Order ring buffer entry and index accesses between the emulation
+ * and the sample timer. Bare metal takes samples in an interrupt on one core.
+ */
+#if (RPI_BARE_METAL==0)
+    #define     audio_barrier()     __sync_synchronize()
+#else
+    #define     audio_barrier()     __asm__ __volatile__ ("" ::: "memory")
+#endif
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static struct audio_entry_t
+{
+    uint32_t    cycles;
+    int         dac_value;
+} audio_ring[AUDIO_RING_SIZE];
+
+static volatile uint32_t    ring_head = 0;      // Next entry to write, emulation
+static volatile uint32_t    ring_tail = 0;      // Next entry to play, sample timer
+static volatile int         stream_on = 0;
+static volatile uint32_t    dropped_writes = 0;
+
+static int          play_sync = 1;              // Align the play-out position to the next entry
+static uint32_t     play_cycles = 0;            // Play-out position in emulated CPU cycles
+static uint32_t     play_remainder = 0;
+static int          play_value = 0;
+
+/*------------------------------------------------
+ * audio_init()
+ *
+ *  Initialize the audio stream, empty the ring buffer
+ *  and stop the stream.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void audio_init(void)
+{
+    stream_on = 0;
+    ring_head = 0;
+    ring_tail = 0;
+    dropped_writes = 0;
+    play_sync = 1;
+}
+
+/*------------------------------------------------
+ * audio_stream()
+ *
+ *  Start or stop the audio stream. The stream runs while the audio
+ *  multiplexer routes the DAC to the audio output. When stopped,
+ *  the sample timer discards queued writes and leaves the DAC to direct
+ *  writes, such as the joystick comparator conversion.
+ *
+ *  param:  1- start, 0- stop
+ *  return: Nothing
+ */
+void audio_stream(int on)
+{
+    if ( on == stream_on )
+        return;
+
+    if ( !on && dropped_writes )
+    {
+        dbg_printf(1, "audio_stream()[%d]: Ring buffer full, %u DAC writes dropped.\n", __LINE__, dropped_writes);
+        dropped_writes = 0;
+    }
+
+    audio_barrier();
+    stream_on = on;
+}
+
+/*------------------------------------------------
+ * audio_dac_write()
+ *
+ *  Queue a DAC write with its emulated time.
+ *  A write is dropped if the ring buffer is full.
+ *
+ *  param:  Emulated time in CPU cycles, DAC value 0x00 to 0x3f
+ *  return: Nothing
+ */
+void audio_dac_write(uint32_t cycles, int dac_value)
+{
+    uint32_t    head;
+
+    head = ring_head;
+
+    if ( (head - ring_tail) == AUDIO_RING_SIZE )
+    {
+        dropped_writes++;
+        return;
+    }
+
+    audio_ring[head & AUDIO_RING_MASK].cycles = cycles;
+    audio_ring[head & AUDIO_RING_MASK].dac_value = dac_value;
+
+    audio_barrier();
+    ring_head = head + 1;
+}
+
+/*------------------------------------------------
+ * audio_sample()
+ *
+ *  Called by the platform sample timer at AUDIO_SAMPLE_RATE.
+ *  Advance the play-out position by one sample period and return
+ *  the DAC value of the last write due by then.
+ *  Play-out runs AUDIO_LATENCY behind the emulation, and is re-aligned
+ *  when the emulation runs ahead (turbo mode) or falls behind real time.
+ *
+ *  param:  Nothing
+ *  return: DAC value 0x00 to 0x3f, or -1 when the stream is stopped
+ */
+int audio_sample(void)
+{
+    struct audio_entry_t   *entry;
+    uint32_t    tail;
+    int32_t     lead;
+
+    tail = ring_tail;
+
+    if ( !stream_on )
+    {
+        ring_tail = ring_head;
+        play_sync = 1;
+        return -1;
+    }
+
+    play_cycles += AUDIO_CYCLES_PER_SAMPLE;
+    play_remainder += AUDIO_CYCLES_REMAINDER;
+    if ( play_remainder >= AUDIO_SAMPLE_RATE )
+    {
+        play_remainder -= AUDIO_SAMPLE_RATE;
+        play_cycles++;
+    }
+
+    while ( tail != ring_head )
+    {
+        audio_barrier();
+        entry = &audio_ring[tail & AUDIO_RING_MASK];
+
+        lead = (int32_t)(entry->cycles - play_cycles);
+        if ( play_sync || lead > AUDIO_LATENCY_MAX || lead < -AUDIO_LATENCY )
+        {
+            play_cycles = entry->cycles - AUDIO_LATENCY;
+            play_sync = 0;
+            break;
+        }
+
+        if ( lead > 0 )
+            break;
+
+        play_value = entry->dac_value;
+        tail++;
+    }
+
+    audio_barrier();
+    ring_tail = tail;
+
+    return play_value;
+}
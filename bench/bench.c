@@ -0,0 +1,279 @@
+/********************************************************************
+ * bench.c
+ *
+ *  Headless emulator benchmark.
+ *  Builds the CPU, memory, SAM, PIA, VDG and disk emulation with the
+ *  RPi functions replaced by host stand-ins, so it runs on any Linux host.
+ *  Each workload cold starts the headless machine of machine.c, types
+ *  a BASIC script, and then runs for a fixed number of emulated frames.
+ *  The report shows the emulated CPU clock and the host time per frame
+ *  that the emulation reached, and a hash of the last frame to check that an optimization
+ *  did not change the emulation's output.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdlib.h>
+#include    <string.h>
+
+#include    "dbgmsg.h"
+#include    "printf.h"
+
+#include    "bench.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     BENCH_FRAMES            1000    // Default measured frames per workload, 20 emulated seconds
+
+#define     DISK_TRACKS             40
+#define     DISK_SEC_PER_TRACK      18
+#define     DISK_SECTOR_SIZE        256
+#define     DISK_HEADER_SIZE        12      // VDK header
+#define     DISK_IMAGE_SIZE         (DISK_HEADER_SIZE + DISK_TRACKS * DISK_SEC_PER_TRACK * DISK_SECTOR_SIZE)
+#define     DISK_DIR_TRACK          20      // Dragon DOS directory track
+#define     DISK_DIR_ENTRY          25      // Directory entry bytes
+#define     DISK_DIR_PER_SECTOR     10      // Directory entries per sector
+#define     DISK_DIR_FIRST          3       // First directory sector, sectors 1 and 2 are the bitmap
+#define     DISK_DIR_FILES          24      // Files in the directory
+#define     DISK_FILE_SECTORS       4       // Sectors per file
+#define     DIR_END                 0x08    // Directory entry flags, end of directory
+
+/* -----------------------------------------
+   Module types
+----------------------------------------- */
+typedef struct
+{
+    const char     *name;
+    const char     *keys;           // BASIC input typed after the boot frames
+    const uint8_t  *code;           // Machine code loaded after the boot frames, or 0
+    int             code_length;
+    int             disk;           // Dragon DOS with the in-memory disk image in drive 1
+} bench_workload_t;
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static int  bench_run(const bench_workload_t *workload, int frames);
+static void bench_disk_build(void);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint8_t      disk_image[DISK_IMAGE_SIZE];
+
+/* Prefix op-code stress loop, 10h and 11h page op-codes and
+ * indexed addressing modes, that never exits:
+ *
+ *          LDY     #0
+ *          LDU     #0
+ *  LOOP    CMPY    #$1234
+ *          CMPU    #$0010
+ *          CMPD    #$0020
+ *          LEAY    1,Y
+ *          LEAU    1,U
+ *          STY     $4100
+ *          LDY     $4100
+ *          CMPS    #0
+ *          LBNE    LOOP
+ */
+static const uint8_t prefix_loop[] =
+{
+    0x10, 0x8e, 0x00, 0x00,
+    0xce, 0x00, 0x00,
+    0x10, 0x8c, 0x12, 0x34,
+    0x11, 0x83, 0x00, 0x10,
+    0x10, 0x83, 0x00, 0x20,
+    0x31, 0x21,
+    0x33, 0x41,
+    0x10, 0xbf, 0x41, 0x00,
+    0x10, 0xbe, 0x41, 0x00,
+    0x11, 0x8c, 0x00, 0x00,
+    0x10, 0x26, 0xff, 0xe0,
+};
+
+static const bench_workload_t workloads[] =
+{
+    { "boot",   "", 0L, 0, 0 },
+    { "pmode4", "10 PMODE4,1:PCLS:SCREEN1,1\n"
+                "20 FOR I=0 TO 255 STEP 4:LINE(I,0)-(255-I,191),PSET:NEXT\n"
+                "30 PCLS:GOTO 20\n"
+                "RUN\n", 0L, 0, 0 },
+    { "prefix", "EXEC&H4000\n", prefix_loop, sizeof(prefix_loop), 0 },
+    { "dosdir", "10 DIR\n"
+                "20 GOTO 10\n"
+                "RUN\n", 0L, 0, 1 },
+};
+
+#define     BENCH_WORKLOADS         ((int)(sizeof(workloads) / sizeof(bench_workload_t)))
+
+/*------------------------------------------------
+ * main()
+ *
+ */
+int main(int argc, char *argv[])
+{
+    const char *workload_name = 0L;
+    int         frames = BENCH_FRAMES;
+    int         i, result;
+
+    /* Command line options
+     */
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strcmp(argv[i], "-n") == 0 && (i + 1) < argc && atoi(argv[i + 1]) > 0 )
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if ( strcmp(argv[i], "-w") == 0 && (i + 1) < argc )
+        {
+            workload_name = argv[++i];
+        }
+        else
+        {
+            dbg_printf(0, "Usage: %s [-n <frames>] [-w <workload>]\n", argv[0]);
+            dbg_printf(0, "  -n  emulated frames to measure per workload, default %d\n", BENCH_FRAMES);
+            dbg_printf(0, "  -w  run one workload:");
+            for ( i = 0; i < BENCH_WORKLOADS; i++ )
+                dbg_printf(0, " %s", workloads[i].name);
+            dbg_printf(0, "\n");
+            return 1;
+        }
+    }
+
+    printf("%-8s %7s %11s %10s %8s %7s %8s\n",
+           "workload", "frames", "cycles", "host-ms", "us/frame", "MHz", "fb-hash");
+
+    result = 1;
+    for ( i = 0; i < BENCH_WORKLOADS; i++ )
+    {
+        if ( workload_name && strcmp(workload_name, workloads[i].name) != 0 )
+            continue;
+
+        if ( bench_run(&workloads[i], frames) != 0 )
+            return 1;
+
+        result = 0;
+    }
+
+    if ( result )
+        dbg_printf(0, "Unknown workload '%s'\n", workload_name);
+
+    return result;
+}
+
+/*------------------------------------------------
+ * bench_run()
+ *
+ *  Cold start the Dragon and run a workload: boot to the BASIC prompt,
+ *  load the workload's machine code, type its script, and then measure
+ *  the host time of a fixed number of emulated frames.
+ *  Disk workloads start with Dragon DOS and the in-memory disk image.
+ *
+ *  param:  Workload, frames to measure
+ *  return: 0- workload ran, -1- workload stopped
+ */
+static int bench_run(const bench_workload_t *workload, int frames)
+{
+    bench_result_t  result;
+
+    if ( workload->disk )
+    {
+        bench_disk_build();
+        bench_disk_mount(disk_image, sizeof(disk_image), FILE_VDK);
+    }
+    else
+    {
+        bench_disk_mount(0L, 0, FILE_NONE);
+    }
+
+    bench_cas_mount(0L, 0);
+    bench_machine_init(workload->disk);
+
+    if ( bench_machine_run(workload->keys, workload->code, workload->code_length, frames, &result) != 0 )
+    {
+        dbg_printf(0, "%s: Workload stopped\n", workload->name);
+        return -1;
+    }
+
+    printf("%-8s %7d %11u %10u %8u %3u.%03u %08x\n",
+           workload->name, frames, result.cycles, result.host_usec / 1000, result.host_usec / frames,
+           result.cycles / result.host_usec, (uint32_t)(((uint64_t) result.cycles * 1000 / result.host_usec) % 1000),
+           result.fb_hash);
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * bench_disk_build()
+ *
+ *  Build a single sided 40 track Dragon DOS VDK disk image
+ *  with a directory of DISK_DIR_FILES files.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void bench_disk_build(void)
+{
+    uint8_t    *bitmap, *entry;
+    int         file, lsn, dir_lsn, i;
+
+    memset(disk_image, 0, sizeof(disk_image));
+
+    /* VDK header
+     */
+    disk_image[0] = 'd';
+    disk_image[1] = 'k';
+    disk_image[2] = DISK_HEADER_SIZE;
+    disk_image[4] = 0x10;
+    disk_image[5] = 0x10;
+    disk_image[8] = DISK_TRACKS;
+    disk_image[9] = 1;
+
+    /* Sector allocation bitmap in the first directory sector, a set bit is a free sector,
+     * with the disk geometry and its complement at the end of the sector
+     */
+    dir_lsn = DISK_DIR_TRACK * DISK_SEC_PER_TRACK;
+    bitmap = &disk_image[DISK_HEADER_SIZE + dir_lsn * DISK_SECTOR_SIZE];
+
+    for ( lsn = 0; lsn < (DISK_TRACKS * DISK_SEC_PER_TRACK); lsn++ )
+    {
+        if ( (lsn >= dir_lsn && lsn < (dir_lsn + DISK_SEC_PER_TRACK)) ||
+             lsn < (DISK_DIR_FILES * DISK_FILE_SECTORS) )
+            continue;
+        bitmap[lsn / 8] |= (1 << (lsn % 8));
+    }
+
+    bitmap[0xfc] = DISK_TRACKS;
+    bitmap[0xfd] = DISK_SEC_PER_TRACK;
+    bitmap[0xfe] = ~DISK_TRACKS;
+    bitmap[0xff] = ~DISK_SEC_PER_TRACK;
+
+    /* Directory entries, each file is one block of sectors,
+     * and the unused entries are marked as the end of the directory
+     */
+    for ( i = 0; i < ((DISK_SEC_PER_TRACK - DISK_DIR_FIRST + 1) * DISK_DIR_PER_SECTOR); i++ )
+    {
+        entry = &disk_image[DISK_HEADER_SIZE +
+                            (dir_lsn + DISK_DIR_FIRST - 1 + i / DISK_DIR_PER_SECTOR) * DISK_SECTOR_SIZE +
+                            (i % DISK_DIR_PER_SECTOR) * DISK_DIR_ENTRY];
+
+        file = i;
+        if ( file >= DISK_DIR_FILES )
+        {
+            entry[0] = DIR_END;
+            continue;
+        }
+
+        lsn = file * DISK_FILE_SECTORS;
+
+        memcpy(&entry[1], "BENCH   BAS", 11);
+        entry[6] = '0' + (file / 10);
+        entry[7] = '0' + (file % 10);
+        entry[12] = (uint8_t)(lsn >> 8);
+        entry[13] = (uint8_t) lsn;
+        entry[14] = DISK_FILE_SECTORS;
+        entry[24] = 0;
+    }
+}
@@ -0,0 +1,45 @@
+/********************************************************************
+ * bench.h
+ *
+ *  Header file for the benchmark host functions that are added
+ *  to the RPi machine-dependent functions of rpi.h, and for the
+ *  headless machine of the benchmark and the instance farm.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include    <stdint.h>
+
+#include    "loader.h"
+
+/* -----------------------------------------
+   Types
+----------------------------------------- */
+typedef struct
+{
+    uint32_t    cycles;             // Emulated CPU cycles of the measured frames
+    uint32_t    host_usec;          // Host time of the measured frames
+    uint32_t    fb_hash;            // Hash of the last frame
+} bench_result_t;
+
+/********************************************************************
+ *  Benchmark host API
+ */
+void     rpi_keyboard_script(const char *keys);
+int      rpi_keyboard_idle(void);
+
+uint32_t rpi_fb_hash(void);
+
+/********************************************************************
+ *  Headless machine API
+ */
+void     bench_disk_mount(uint8_t *image, uint32_t length, loader_file_type_t type);
+void     bench_cas_mount(const uint8_t *image, uint32_t length);
+void     bench_machine_init(int dos);
+int      bench_machine_run(const char *keys, const uint8_t *program, int program_length, int frames, bench_result_t *result);
+
+#endif  /* __BENCH_H__ */
@@ -0,0 +1,417 @@
+/********************************************************************
+ * farm.c
+ *
+ *  Headless emulator instance farm for batch regression runs.
+ *  Runs one headless Dragon of machine.c for each disk or cassette
+ *  image on the command line. The emulation modules keep their state
+ *  in module globals, so every instance is a forked worker process
+ *  with its own machine and its own copy of the image in memory,
+ *  and a pool of worker processes runs the instances in parallel.
+ *  Each instance boots to the BASIC prompt, types a key script and runs
+ *  a fixed number of emulated frames. The results are reported back to
+ *  the farm through a pipe, and printed in command line order with the
+ *  hash of the instance's last frame, so that the report of two
+ *  emulator builds or two versions of the software on the images
+ *  can be compared.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <strings.h>
+#include    <unistd.h>
+#include    <sys/types.h>
+#include    <sys/wait.h>
+
+#include    "dbgmsg.h"
+
+#include    "bench.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     FARM_FRAMES             500     // Default measured frames per instance, 10 emulated seconds
+#define     FARM_MAX_IMAGE          (2 * 1024 * 1024)   // Largest disk or cassette image in bytes
+#define     FARM_MAX_KEYS           256
+
+#define     FARM_CAS_KEYS           "CLOAD\nRUN\n"
+#define     FARM_DISK_KEYS          "DIR\n"
+
+/* -----------------------------------------
+   Module types
+----------------------------------------- */
+typedef struct
+{
+    int             status;         // 0- instance ran, -1- image or emulation error
+    bench_result_t  result;
+} farm_report_t;
+
+typedef struct
+{
+    const char     *image;          // Image file name
+    pid_t           pid;            // Worker process, 0 when not started or done
+    int             pipe_fd;        // Read end of the worker's report pipe
+    farm_report_t   report;
+} farm_instance_t;
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static int      farm_start(farm_instance_t *instance, const char *keys, int frames);
+static void     farm_done(farm_instance_t *instances, int count, pid_t pid, int exit_status);
+static int      farm_instance_run(const char *image, const char *keys, int frames, bench_result_t *result);
+static uint8_t *farm_image_read(const char *image, uint32_t *length);
+static void     farm_keys_unescape(char *keys, const char *text);
+
+/*------------------------------------------------
+ * main()
+ *
+ */
+int main(int argc, char *argv[])
+{
+    farm_instance_t    *instances;
+    char                keys[FARM_MAX_KEYS];
+    int                 workers, frames, count, next, running, failed;
+    int                 i, exit_status;
+    pid_t               pid;
+
+    workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if ( workers < 1 )
+        workers = 1;
+
+    frames = FARM_FRAMES;
+    keys[0] = 0;
+
+    /* Command line options, followed by the images
+     */
+    for ( i = 1; i < argc && argv[i][0] == '-'; i++ )
+    {
+        if ( strcmp(argv[i], "-j") == 0 && (i + 1) < argc && atoi(argv[i + 1]) > 0 )
+        {
+            workers = atoi(argv[++i]);
+        }
+        else if ( strcmp(argv[i], "-n") == 0 && (i + 1) < argc && atoi(argv[i + 1]) > 0 )
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if ( strcmp(argv[i], "-k") == 0 && (i + 1) < argc && strlen(argv[i + 1]) < FARM_MAX_KEYS )
+        {
+            farm_keys_unescape(keys, argv[++i]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    count = argc - i;
+
+    if ( count <= 0 || argv[i][0] == '-' )
+    {
+        dbg_printf(0, "Usage: %s [-j <workers>] [-n <frames>] [-k <keys>] <image> ...\n", argv[0]);
+        dbg_printf(0, "  -j  instances to run in parallel, default is the host CPU count\n");
+        dbg_printf(0, "  -n  emulated frames to measure per instance, default %d\n", FARM_FRAMES);
+        dbg_printf(0, "  -k  keys to type at the BASIC prompt, \\n types ENTER,\n");
+        dbg_printf(0, "      default \"CLOAD\\nRUN\\n\" for CAS images and \"DIR\\n\" for disk images\n");
+        dbg_printf(0, "  Images are CAS cassette files, or VDK or DSK disk files in drive 1 with Dragon DOS\n");
+        return 1;
+    }
+
+    if ( (instances = calloc(count, sizeof(farm_instance_t))) == 0L )
+    {
+        dbg_printf(0, "main()[%d]: Cannot allocate %d instances\n", __LINE__, count);
+        return 1;
+    }
+
+    for ( next = 0; next < count; next++ )
+        instances[next].image = argv[i + next];
+
+    /* Keep the pool of workers busy until all instances ran
+     */
+    next = 0;
+    running = 0;
+
+    while ( next < count || running > 0 )
+    {
+        while ( next < count && running < workers )
+        {
+            if ( farm_start(&instances[next], keys, frames) == 0 )
+                running++;
+            next++;
+        }
+
+        if ( running == 0 )
+            continue;
+
+        if ( (pid = wait(&exit_status)) < 0 )
+        {
+            dbg_printf(0, "main()[%d]: Lost the worker processes\n", __LINE__);
+            return 1;
+        }
+
+        farm_done(instances, count, pid, exit_status);
+        running--;
+    }
+
+    /* Report in command line order
+     */
+    printf("%-4s %7s %11s %8s %8s  %s\n",
+           "inst", "frames", "cycles", "us/frame", "fb-hash", "image");
+
+    failed = 0;
+    for ( i = 0; i < count; i++ )
+    {
+        if ( instances[i].report.status != 0 )
+        {
+            printf("%-4d %7s %11s %8s %8s  %s\n", i, "-", "-", "-", "failed", instances[i].image);
+            failed++;
+            continue;
+        }
+
+        printf("%-4d %7d %11u %8u %08x  %s\n", i, frames,
+               instances[i].report.result.cycles,
+               instances[i].report.result.host_usec / frames,
+               instances[i].report.result.fb_hash,
+               instances[i].image);
+    }
+
+    free(instances);
+
+    return (failed ? 1 : 0);
+}
+
+/*------------------------------------------------
+ * farm_start()
+ *
+ *  Start the worker process of an instance, that runs the
+ *  instance and writes its report to a pipe.
+ *
+ *  param:  Instance, key script or empty for the image type's default, frames to measure
+ *  return: 0- worker started, -1- instance failed to start
+ */
+static int farm_start(farm_instance_t *instance, const char *keys, int frames)
+{
+    farm_report_t   report;
+    int             fd[2];
+    ssize_t         written;
+
+    instance->report.status = -1;
+
+    if ( pipe(fd) < 0 )
+    {
+        dbg_printf(0, "farm_start()[%d]: Cannot create a pipe for %s\n", __LINE__, instance->image);
+        return -1;
+    }
+
+    /* Nothing buffered is duplicated in the worker
+     */
+    fflush(stdout);
+
+    instance->pid = fork();
+
+    if ( instance->pid < 0 )
+    {
+        dbg_printf(0, "farm_start()[%d]: Cannot start a worker for %s\n", __LINE__, instance->image);
+        instance->pid = 0;
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+
+    if ( instance->pid == 0 )
+    {
+        close(fd[0]);
+
+        memset(&report, 0, sizeof(report));
+        report.status = farm_instance_run(instance->image, keys, frames, &report.result);
+
+        written = write(fd[1], &report, sizeof(report));
+
+        fflush(stdout);
+        _exit(written == sizeof(report) ? 0 : 1);
+    }
+
+    close(fd[1]);
+    instance->pipe_fd = fd[0];
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * farm_done()
+ *
+ *  Collect the report of an instance whose worker process exited.
+ *  A worker that exited without writing its report, or with
+ *  an exit status, leaves the instance as failed.
+ *
+ *  param:  Instances, instance count, worker process and its exit status
+ *  return: None
+ */
+static void farm_done(farm_instance_t *instances, int count, pid_t pid, int exit_status)
+{
+    farm_report_t   report;
+    int             i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        if ( instances[i].pid != pid )
+            continue;
+
+        if ( read(instances[i].pipe_fd, &report, sizeof(report)) == sizeof(report) &&
+             WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0 )
+        {
+            instances[i].report = report;
+        }
+        else
+        {
+            dbg_printf(0, "farm_done()[%d]: Worker of %s stopped without a report\n", __LINE__, instances[i].image);
+        }
+
+        close(instances[i].pipe_fd);
+        instances[i].pid = 0;
+        return;
+    }
+}
+
+/*------------------------------------------------
+ * farm_instance_run()
+ *
+ *  Run one instance in the worker process: read the image into memory,
+ *  mount it, cold start the machine and run the key script.
+ *
+ *  param:  Image file name, key script or empty string, frames to measure,
+ *          pointer to the run's result
+ *  return: 0- instance ran, -1- image or emulation error
+ */
+static int farm_instance_run(const char *image, const char *keys, int frames, bench_result_t *result)
+{
+    const char *extension;
+    uint8_t    *data;
+    uint32_t    length;
+    int         dos;
+
+    if ( (extension = strrchr(image, '.')) == 0L )
+        extension = "";
+
+    if ( (data = farm_image_read(image, &length)) == 0L )
+        return -1;
+
+    if ( strcasecmp(extension, ".cas") == 0 )
+    {
+        bench_disk_mount(0L, 0, FILE_NONE);
+        bench_cas_mount(data, length);
+        dos = 0;
+        if ( keys[0] == 0 )
+            keys = FARM_CAS_KEYS;
+    }
+    else if ( strcasecmp(extension, ".vdk") == 0 || strcasecmp(extension, ".dsk") == 0 )
+    {
+        bench_disk_mount(data, length, (strcasecmp(extension, ".vdk") == 0) ? FILE_VDK : FILE_DSK);
+        bench_cas_mount(0L, 0);
+        dos = 1;
+        if ( keys[0] == 0 )
+            keys = FARM_DISK_KEYS;
+    }
+    else
+    {
+        dbg_printf(0, "farm_instance_run()[%d]: %s is not a CAS, VDK or DSK image\n", __LINE__, image);
+        free(data);
+        return -1;
+    }
+
+    bench_machine_init(dos);
+
+    if ( bench_machine_run(keys, 0L, 0, frames, result) != 0 )
+    {
+        dbg_printf(0, "%s: Instance stopped\n", image);
+        free(data);
+        return -1;
+    }
+
+    free(data);
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * farm_image_read()
+ *
+ *  Read an image file into an allocated buffer.
+ *
+ *  param:  Image file name, pointer to the image length output
+ *  return: Image buffer to free, or 0 if error
+ */
+static uint8_t *farm_image_read(const char *image, uint32_t *length)
+{
+    FILE       *file;
+    uint8_t    *data;
+    long        size;
+
+    if ( (file = fopen(image, "rb")) == 0L )
+    {
+        dbg_printf(0, "farm_image_read()[%d]: Cannot open %s\n", __LINE__, image);
+        return 0L;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+
+    if ( size <= 0 || size > FARM_MAX_IMAGE )
+    {
+        dbg_printf(0, "farm_image_read()[%d]: Bad size of %s, %ld bytes\n", __LINE__, image, size);
+        fclose(file);
+        return 0L;
+    }
+
+    if ( (data = malloc(size)) == 0L )
+    {
+        dbg_printf(0, "farm_image_read()[%d]: Cannot allocate %ld bytes for %s\n", __LINE__, size, image);
+        fclose(file);
+        return 0L;
+    }
+
+    if ( fread(data, 1, size, file) != (size_t) size )
+    {
+        dbg_printf(0, "farm_image_read()[%d]: Cannot read %s\n", __LINE__, image);
+        free(data);
+        fclose(file);
+        return 0L;
+    }
+
+    fclose(file);
+
+    *length = (uint32_t) size;
+
+    return data;
+}
+
+/*------------------------------------------------
+ * farm_keys_unescape()
+ *
+ *  Copy a key script from the command line,
+ *  with the two characters \n replaced by a new line.
+ *
+ *  param:  Key script output of at least the text's length, command line text
+ *  return: None
+ */
+static void farm_keys_unescape(char *keys, const char *text)
+{
+    while ( *text )
+    {
+        if ( text[0] == '\\' && text[1] == 'n' )
+        {
+            *keys++ = '\n';
+            text += 2;
+        }
+        else
+        {
+            *keys++ = *text++;
+        }
+    }
+
+    *keys = 0;
+}
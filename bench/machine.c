@@ -0,0 +1,422 @@
+/********************************************************************
+ * machine.c
+ *
+ *  Headless Dragon machine of the benchmark and the instance farm.
+ *  Cold starts the emulation with the RPi functions replaced by the host
+ *  stand-ins of rpi.c, types a key script at the BASIC prompt and runs
+ *  a fixed number of emulated frames through the same VSYNC and band
+ *  rendering events as the emulator's main loop.
+ *  The SD card is replaced by disk and cassette images in memory.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdlib.h>
+#include    <string.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+#include    "printf.h"
+#include    "errors.h"
+
+#include    "mem.h"
+#include    "cpu.h"
+#include    "rpi.h"
+#include    "sched.h"
+#include    "sam.h"
+#include    "vdg.h"
+#include    "intr.h"
+#include    "pia.h"
+#include    "disk.h"
+#include    "audio.h"
+#include    "joystk.h"
+#include    "kbd.h"
+#include    "loader.h"
+#include    "stats.h"
+
+#include    "bench.h"
+
+/* -----------------------------------------
+   Dragon 32 ROM image
+----------------------------------------- */
+#include    "dragon/dragon.h"
+#include    "dragon/ddos10p.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     DRAGON_ROM_START        0x8000
+#define     DRAGON_ROM_END          0xfeff
+#define     DRAGON_ROM_CSRDON       0xbde7  // Cassette motor on and leader sync
+#define     DRAGON_ROM_BLKIN        0xb93e  // Cassette block input
+#define     VDG_REFRESH_INTERVAL    ((uint32_t)(SCHED_CPU_CLOCK_HZ/50))     // In CPU cycles
+#define     VDG_LINE_INTERVAL       (VDG_REFRESH_INTERVAL/VDG_FIELD_LINES)  // Scan line time in CPU cycles
+#define     VDG_BAND_INTERVAL       (VDG_LINE_INTERVAL*VDG_BAND_LINES)      // Band of scan lines in CPU cycles
+#define     CPU_BATCH_CYCLES        500     // CPU cycles to run between peripheral service calls
+
+#define     BENCH_BOOT_FRAMES       200     // Frames to the BASIC prompt before typing the script
+#define     BENCH_TYPING_FRAMES     3000    // Frames to type the script before giving up on it
+#define     BENCH_CODE_ADDRESS      0x4000  // Machine code load address
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static void vsync_event(void);
+static void band_event(void);
+static void hsync_event(void);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static volatile int frame_count = 0;
+static int          band = 0;
+
+static uint8_t             *disk_image = 0L;    // Drive 1 image, or 0
+static uint32_t             disk_length = 0;
+static uint32_t             disk_position = 0;
+static loader_file_type_t   disk_type = FILE_NONE;
+
+static const uint8_t       *cas_image = 0L;     // Cassette image, or 0
+static uint32_t             cas_length = 0;
+static uint32_t             cas_position = 0;
+
+/*------------------------------------------------
+ * bench_disk_mount()
+ *
+ *  Insert a disk image in drive 1 before the machine is initialized.
+ *  Disk writes change the image in memory.
+ *
+ *  param:  Image, its length in bytes, FILE_VDK or FILE_DSK, or 0 to remove the disk
+ *  return: None
+ */
+void bench_disk_mount(uint8_t *image, uint32_t length, loader_file_type_t type)
+{
+    disk_image = image;
+    disk_length = image ? length : 0;
+    disk_position = 0;
+    disk_type = image ? type : FILE_NONE;
+}
+
+/*------------------------------------------------
+ * bench_cas_mount()
+ *
+ *  Insert a CAS cassette image before the machine is initialized.
+ *  The machine reads it with the cassette fast load traps.
+ *
+ *  param:  Image and its length in bytes, or 0 to remove the cassette
+ *  return: None
+ */
+void bench_cas_mount(const uint8_t *image, uint32_t length)
+{
+    cas_image = image;
+    cas_length = image ? length : 0;
+    cas_position = 0;
+}
+
+/*------------------------------------------------
+ * bench_machine_init()
+ *
+ *  Initialize the emulation for a cold start, with Dragon DOS if
+ *  requested, and the cassette traps if a cassette is mounted.
+ *
+ *  param:  1- Dragon DOS, 0- no DOS cartridge
+ *  return: None
+ */
+void bench_machine_init(int dos)
+{
+    mem_init();
+    sam_init();
+    audio_init();
+    joystk_init();
+    kbd_init();
+    intr_init();
+    pia_init();
+    vdg_init();
+    stats_init();
+
+    mem_load(LOAD_ADDRESS, code, sizeof(code));
+
+    if ( dos )
+    {
+        disk_init();
+        mem_load(DDOS_LOAD_ADDRESS, ddos10p_code, sizeof(ddos10p_code));
+    }
+
+    mem_define_rom(DRAGON_ROM_START, DRAGON_ROM_END);
+
+    cpu_init(RUN_ADDRESS);
+
+    if ( cas_image )
+    {
+        cpu_trap(DRAGON_ROM_CSRDON, pia_cas_csrdon);
+        cpu_trap(DRAGON_ROM_BLKIN, pia_cas_blkin);
+    }
+
+    cpu_reset(1);
+
+    rpi_keyboard_script(0L);
+
+    frame_count = 0;
+    band = 0;
+
+    sched_init();
+    sched_add(VDG_REFRESH_INTERVAL, vsync_event);
+}
+
+/*------------------------------------------------
+ * bench_machine_run()
+ *
+ *  Run the initialized machine: boot to the BASIC prompt,
+ *  load the machine code, type the key script, and then measure
+ *  the host time of a fixed number of emulated frames.
+ *
+ *  param:  Key script, machine code and its length or 0, frames to measure,
+ *          pointer to the run's result
+ *  return: 0- frames ran, -1- CPU exception or the key script was not typed
+ */
+int bench_machine_run(const char *keys, const uint8_t *program, int program_length, int frames, bench_result_t *result)
+{
+    cpu_state_t cpu_state;
+    uint32_t    budget, start_time, host_usec, start_cycles;
+    int         cycles, typing, measure_frame;
+
+    typing = 0;
+    measure_frame = -1;
+    start_time = 0;
+    start_cycles = 0;
+
+    for (;;)
+    {
+        budget = sched_cycles_to_next();
+        if ( budget > CPU_BATCH_CYCLES )
+            budget = CPU_BATCH_CYCLES;
+
+        if ( cpu_run_cycles(budget, &cycles) == CPU_EXCEPTION )
+        {
+            cpu_get_state(&cpu_state);
+            dbg_printf(0, "Op-code Exception at pc=0x%04x last_pc=0x%04x\n",
+                       cpu_state.pc, cpu_state.last_pc);
+            return -1;
+        }
+
+        sched_advance(cycles);
+        cpu_reset(0);
+        disk_io_interrupt();
+
+        /* Type the script at the BASIC prompt, and start
+         * measuring when it was typed
+         */
+        if ( measure_frame >= 0 )
+        {
+            if ( (frame_count - measure_frame) >= frames )
+                break;
+        }
+        else if ( !typing && frame_count >= BENCH_BOOT_FRAMES )
+        {
+            if ( program )
+                mem_load(BENCH_CODE_ADDRESS, program, program_length);
+            rpi_keyboard_script(keys);
+            typing = 1;
+        }
+        else if ( typing && rpi_keyboard_idle() )
+        {
+            measure_frame = frame_count;
+            start_cycles = sched_get_cycles();
+            start_time = rpi_system_timer();
+        }
+        else if ( typing && frame_count >= (BENCH_BOOT_FRAMES + BENCH_TYPING_FRAMES) )
+        {
+            dbg_printf(0, "Key script not typed in %d frames, the keyboard is not read\n", BENCH_TYPING_FRAMES);
+            return -1;
+        }
+    }
+
+    /* Include the frames still queued to the render thread
+     */
+    vdg_render_sync();
+
+    host_usec = rpi_system_timer() - start_time;
+    if ( host_usec == 0 )
+        host_usec = 1;
+
+    result->cycles = sched_get_cycles() - start_cycles;
+    result->host_usec = host_usec;
+    result->fb_hash = rpi_fb_hash();
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * vsync_event()
+ *
+ * Scheduler event at the VDG field rate that starts a field.
+ * The benchmark renders every frame.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void vsync_event(void)
+{
+    frame_count++;
+
+    band = 0;
+    sched_add(VDG_BAND_INTERVAL, band_event);
+
+    sched_add(VDG_REFRESH_INTERVAL, vsync_event);
+}
+
+/*------------------------------------------------
+ * band_event()
+ *
+ * Scheduler event at the end of each band of VDG_BAND_LINES active scan lines,
+ * that renders the band, and after the last band generates the VSYNC IRQ.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void band_event(void)
+{
+    vdg_render_band(band);
+
+    if ( !sched_is_pending(hsync_event) )
+    {
+        pia_hsync_irq();
+        if ( pia_hsync_active() )
+            sched_add(VDG_LINE_INTERVAL, hsync_event);
+    }
+
+    band++;
+    if ( band < VDG_BANDS )
+        sched_add(VDG_BAND_INTERVAL, band_event);
+    else
+        pia_vsync_irq();
+}
+
+/*------------------------------------------------
+ * hsync_event()
+ *
+ * Scheduler event at the scan line rate that generates the HSYNC,
+ * while line sync timing is in use.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void hsync_event(void)
+{
+    pia_hsync_irq();
+
+    if ( pia_hsync_active() )
+        sched_add(VDG_LINE_INTERVAL, hsync_event);
+}
+
+/********************************************************************
+ *  Loader stand-ins, there is no SD card on the benchmark host.
+ *  Drive 1 and the cassette are the images in memory of
+ *  bench_disk_mount() and bench_cas_mount(), cassette saves and
+ *  saved machine state are not supported.
+ */
+
+int loader_cas_fread(uint8_t *buffer, uint16_t bytes)
+{
+    if ( cas_image == 0L || cas_position >= cas_length )
+        return FAT_EOF;
+
+    if ( cas_position + bytes > cas_length )
+        bytes = cas_length - cas_position;
+
+    memcpy(buffer, &cas_image[cas_position], bytes);
+    cas_position += bytes;
+
+    return bytes;
+}
+
+int loader_cas_fwrite(uint8_t *buffer, uint16_t bytes)
+{
+    return FAT_WRITE_FAIL;
+}
+
+void loader_cas_fclose(void)
+{
+}
+
+uint32_t loader_cas_ftell(uint32_t *cluster)
+{
+    *cluster = cas_image ? 1 : 0;
+    return cas_position;
+}
+
+int loader_cas_fseek(uint32_t cluster, uint32_t position)
+{
+    if ( cas_image == 0L )
+        return FAT_FILE_NOT_OPEN;
+
+    if ( position > cas_length )
+        return FAT_FILE_SEEK_RANGE;
+
+    cas_position = position;
+
+    return NO_ERROR;
+}
+
+int loader_disk_fread(int drive, uint8_t *buffer, uint16_t bytes)
+{
+    if ( disk_position + bytes > disk_length )
+        return FAT_EOF;
+
+    memcpy(buffer, &disk_image[disk_position], bytes);
+    disk_position += bytes;
+
+    return bytes;
+}
+
+int loader_disk_fwrite(int drive, uint8_t *buffer, uint16_t bytes)
+{
+    if ( disk_position + bytes > disk_length )
+        return FAT_WRITE_FAIL;
+
+    memcpy(&disk_image[disk_position], buffer, bytes);
+    disk_position += bytes;
+
+    return bytes;
+}
+
+int loader_disk_fseek(int drive, uint32_t position)
+{
+    if ( position > disk_length )
+        return FAT_FILE_SEEK_RANGE;
+
+    disk_position = position;
+
+    return NO_ERROR;
+}
+
+void loader_disk_flush(void)
+{
+}
+
+loader_file_type_t loader_disk_img_type(int drive)
+{
+    if ( drive == 0 )
+        return disk_type;
+
+    return FILE_NONE;
+}
+
+uint32_t loader_disk_img_cluster(int drive)
+{
+    return 0;
+}
+
+int loader_state_fwrite(char *file_name, uint8_t *buffer, uint32_t length)
+{
+    return FAT_WRITE_FAIL;
+}
+
+int loader_state_fread(char *file_name, uint8_t *buffer, uint32_t length)
+{
+    return -1;
+}
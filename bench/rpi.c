@@ -0,0 +1,526 @@
+/********************************************************************
+ * rpi.c
+ *
+ *  Functions and definitions for RPi machine-dependent functionality.
+ *  This is the host implementation for the headless benchmark,
+ *  that builds and runs on any Linux host without RPi GPIO, SPI or
+ *  frame buffer. Video is rendered to a memory buffer, the keyboard
+ *  AVR is replaced by a script of key strokes, and all other inputs
+ *  read as idle.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <time.h>
+
+#include    "dbgmsg.h"
+#include    "rpi.h"
+
+#include    "bench.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     KEY_HOLD_READS      20          // Keyboard reads between key make and break codes
+#define     SCAN_SHIFT          42          // Left shift make code
+#define     SCAN_BREAK          0x80        // Break code flag
+
+/* -----------------------------------------
+   Module types
+----------------------------------------- */
+typedef enum
+{
+    KEY_SHIFT_MAKE = 0,
+    KEY_MAKE,
+    KEY_BREAK,
+    KEY_SHIFT_BREAK,
+} key_phase_t;
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static int  key_scan_code(char key, int *shift);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint8_t     *fb_base = 0L;               // Headless frame buffer
+static int          fb_size = 0;
+
+static const char  *key_script = 0L;            // Key strokes to type
+static key_phase_t  key_phase = KEY_SHIFT_MAKE;
+static int          key_hold = 0;
+
+/* Dragon keyboard characters by their PC keyboard scan code,
+ * the Dragon layout is mapped to the PC key positions
+ */
+static const char   scan_code_keys[] = "\0\0" "1234567890-:" "\0\0" "QWERTYUIOP@\0" "\n\0" "ASDFGHJKL;\0\0" "\0\0" "ZXCVBNM,./";
+static const char   shift_keys[] = "!\"#$%&'()\0=*+";
+static const char   shift_key_base[] = "1234567890-:;";
+
+/*------------------------------------------------
+ * rpi_gpio_init()
+ *
+ *  There is no GPIO on the benchmark host.
+ *
+ *  param:  None
+ *  return: 0
+ */
+int rpi_gpio_init(void)
+{
+    return 0;
+}
+
+/********************************************************************
+ * rpi_fb_init()
+ *
+ *  Initialize a memory buffer for headless video output.
+ *
+ *  param:  None
+ *  return: Pointer to frame buffer, or 0 if error,
+ */
+uint8_t *rpi_fb_init(int x_pix, int y_pix)
+{
+    if ( fb_base == 0L && (fb_base = malloc(x_pix * y_pix)) == 0L )
+    {
+        dbg_printf(0, "rpi_fb_init()[%d]: Cannot allocate headless frame buffer\n", __LINE__);
+        return 0;
+    }
+
+    fb_size = x_pix * y_pix;
+    memset(fb_base, 0, fb_size);
+
+    return fb_base;
+}
+
+/********************************************************************
+ * rpi_fb_flip()
+ *
+ *  Copy a complete frame from the off-screen buffer to the headless
+ *  frame buffer.
+ *
+ *  param:  Off-screen frame buffer
+ *  return: None
+ */
+void rpi_fb_flip(const uint8_t *buffer)
+{
+    if ( fb_base )
+        memcpy(fb_base, buffer, fb_size);
+}
+
+/*------------------------------------------------
+ * rpi_fb_output()
+ *
+ *  The benchmark output is always headless.
+ *
+ *  param:  Headless output, print frame hashes, frames between snapshots or 0
+ *  return: None
+ */
+void rpi_fb_output(int headless, int frame_hash, int snapshot_interval)
+{
+}
+
+/*------------------------------------------------
+ * rpi_system_timer()
+ *
+ *  Return running system timer time stamp, the host's
+ *  monotonic clock in micro-seconds.
+ *
+ *  param:  None
+ *  return: System timer value
+ */
+uint32_t rpi_system_timer(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)((uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+/*------------------------------------------------
+ * rpi_keyboard_read()
+ *
+ *  Replace the AVR (PS2 keyboard controller) with the key
+ *  script of rpi_keyboard_script(). Every key is held down for
+ *  KEY_HOLD_READS reads, so the Dragon ROM keyboard scan sees it.
+ *
+ *  param:  None
+ *  return: Key code, 0 if no key
+ */
+int rpi_keyboard_read(void)
+{
+    int     scan_code, shift;
+
+    if ( key_script == 0L || *key_script == 0 )
+        return 0;
+
+    if ( key_hold > 0 )
+    {
+        key_hold--;
+        return 0;
+    }
+
+    key_hold = KEY_HOLD_READS;
+    scan_code = key_scan_code(*key_script, &shift);
+
+    switch ( key_phase )
+    {
+        case KEY_SHIFT_MAKE:
+            key_phase = KEY_MAKE;
+            if ( shift )
+                return SCAN_SHIFT;
+            /* no break */
+
+        case KEY_MAKE:
+            key_phase = KEY_BREAK;
+            return scan_code;
+
+        case KEY_BREAK:
+            key_phase = KEY_SHIFT_BREAK;
+            if ( !shift )
+            {
+                key_phase = KEY_SHIFT_MAKE;
+                key_script++;
+            }
+            return (scan_code | SCAN_BREAK);
+
+        case KEY_SHIFT_BREAK:
+            key_phase = KEY_SHIFT_MAKE;
+            key_script++;
+            return (SCAN_SHIFT | SCAN_BREAK);
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * rpi_keyboard_script()
+ *
+ *  Start typing a script of key strokes.
+ *
+ *  param:  Characters to type, new line types an ENTER
+ *  return: None
+ */
+void rpi_keyboard_script(const char *keys)
+{
+    key_script = keys;
+    key_phase = KEY_SHIFT_MAKE;
+    key_hold = 0;
+}
+
+/*------------------------------------------------
+ * rpi_keyboard_idle()
+ *
+ *  Check if the key script was typed. The script is typed when the
+ *  last key is pressed, because a program started by that key may
+ *  never read the keyboard for its break code.
+ *
+ *  param:  None
+ *  return: 1- no more key strokes, 0- still typing
+ */
+int rpi_keyboard_idle(void)
+{
+    if ( key_script == 0L || key_script[0] == 0 )
+        return 1;
+
+    return (key_script[1] == 0 && key_phase >= KEY_BREAK);
+}
+
+/*------------------------------------------------
+ * rpi_keyboard_reset()
+ *
+ *  Reset keyboard AVR interface
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_keyboard_reset(void)
+{
+}
+
+/*------------------------------------------------
+ * rpi_keyboard_start()
+ *
+ *  The benchmark reads the keyboard from the emulation loop,
+ *  see KBD_READER in config.h
+ *
+ *  param:  Reader step function
+ *  return: None
+ */
+void rpi_keyboard_start(uint32_t (*poll_step)(void))
+{
+}
+
+/*------------------------------------------------
+ * rpi_joystk_comp()
+ *
+ *  Joystick comparator input level, there is no joystick.
+ *
+ *  param:  None
+ *  return: GPIO joystick comparator input level
+ */
+int rpi_joystk_comp(void)
+{
+    return 0;
+}
+
+/*------------------------------------------------
+ * rpi_joystk_comp_settled()
+ *
+ *  Joystick comparator input level, there is no joystick.
+ *
+ *  param:  None
+ *  return: GPIO joystick comparator input level
+ */
+int rpi_joystk_comp_settled(void)
+{
+    return 0;
+}
+
+/*------------------------------------------------
+ * rpi_joystk_start()
+ *
+ *  The benchmark reads the joystick from the emulation loop,
+ *  see JOYSTK_SAMPLER in config.h
+ *
+ *  param:  Sampler step function
+ *  return: None
+ */
+void rpi_joystk_start(uint32_t (*sample_step)(void))
+{
+}
+
+/*------------------------------------------------
+ * rpi_rjoystk_button()
+ *
+ *  Right joystick button, not pressed.
+ *
+ *  param:  None
+ *  return: GPIO joystick button input level
+ */
+int rpi_rjoystk_button(void)
+{
+    return 1;
+}
+
+/*------------------------------------------------
+ * rpi_reset_button()
+ *
+ *  Emulator reset button, not pressed.
+ *
+ *  param:  None
+ *  return: GPIO reset button input level
+ */
+int rpi_reset_button(void)
+{
+    return 1;
+}
+
+/*------------------------------------------------
+ * rpi_audio_mux_set()
+ *
+ *  Analog multiplexer output, not used.
+ *
+ *  param:  Multiplexer select bit field: b.1=PIA1-CB2, b.0=PIA0-CA2
+ *  return: None
+ */
+void rpi_audio_mux_set(int select)
+{
+}
+
+/*------------------------------------------------
+ * rpi_write_dac()
+ *
+ *  DAC output, not used.
+ *
+ *  param:  DAC value 0x00 to 0x3f
+ *  return: None
+ */
+void rpi_write_dac(int dac_value)
+{
+}
+
+/*------------------------------------------------
+ * rpi_audio_start()
+ *
+ *  The benchmark has no audio output,
+ *  see AUDIO_STREAM in config.h
+ *
+ *  param:  Sample rate in Hz, sample source function
+ *  return: None
+ */
+void rpi_audio_start(int sample_rate, int (*sample_source)(void))
+{
+}
+
+/*------------------------------------------------
+ * rpi_disable()
+ *
+ *  Disable interrupts
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_disable(void)
+{
+}
+
+/*------------------------------------------------
+ * rpi_enable()
+ *
+ *  Enable interrupts
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_enable(void)
+{
+}
+
+/*------------------------------------------------
+ * rpi_motor_led_on()
+ *
+ *  Motor LED indicator, not used.
+ *
+ *  param:  Source of request disk=1 or tape=2
+ *  return: None
+ */
+void rpi_motor_led_on(uint8_t source)
+{
+}
+
+/*------------------------------------------------
+ * rpi_motor_led_off()
+ *
+ *  Motor LED indicator, not used.
+ *
+ *  param:  Source of request disk=1 or tape=2
+ *  return: None
+ */
+void rpi_motor_led_off(uint8_t source)
+{
+}
+
+/*------------------------------------------------
+ * rpi_testpoint_on()
+ *
+ *  Test point, not used.
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_testpoint_on(void)
+{
+}
+
+/*------------------------------------------------
+ * rpi_testpoint_off()
+ *
+ *  Test point, not used.
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_testpoint_off(void)
+{
+}
+
+/*------------------------------------------------
+ * rpi_cpu_pin()
+ *
+ *  Benchmark threads are left on any core of the host.
+ *
+ *  param:  Core number
+ *  return: None
+ */
+void rpi_cpu_pin(int core)
+{
+}
+
+/********************************************************************
+ * rpi_halt()
+ *
+ *  Output message and exit the benchmark
+ *
+ *  param:  Message
+ *  return: None
+ */
+void rpi_halt(void)
+{
+    dbg_printf(0, "HALT\n");
+    exit(1);
+}
+
+/*------------------------------------------------
+ * _putchar()
+ *
+ *  Low level character output/stream for printf()
+ *
+ *  param:  character
+ *  return: none
+ */
+void _putchar(char character)
+{
+    putchar(character);
+}
+
+/*------------------------------------------------
+ * rpi_fb_hash()
+ *
+ *  Return an FNV-1a hash of the last frame in the headless frame buffer,
+ *  to check that a change to the emulation does not change its output.
+ *
+ *  param:  None
+ *  return: Frame hash
+ */
+uint32_t rpi_fb_hash(void)
+{
+    uint32_t    hash = 2166136261u;
+    int         i;
+
+    for ( i = 0; i < fb_size; i++ )
+    {
+        hash ^= fb_base[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*------------------------------------------------
+ * key_scan_code()
+ *
+ *  Convert a character to the PC keyboard scan code
+ *  of the Dragon key that types it.
+ *
+ *  param:  Character, pointer to shift key flag output
+ *  return: Scan code, 0 if the character has no key
+ */
+static int key_scan_code(char key, int *shift)
+{
+    const char *position;
+
+    *shift = 0;
+
+    if ( key == ' ' )
+        return 57;
+
+    if ( key == '^' )
+        return 72;                  // Up arrow
+
+    if ( (position = memchr(shift_keys, key, sizeof(shift_keys) - 1)) != 0L )
+    {
+        *shift = 1;
+        key = shift_key_base[position - shift_keys];
+    }
+
+    if ( (position = memchr(scan_code_keys, key, sizeof(scan_code_keys) - 1)) != 0L )
+        return (int)(position - scan_code_keys);
+
+    return 0;
+}
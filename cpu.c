@@ -17,9 +17,11 @@
 
 #include    <string.h>
 
+#include    "config.h"
 #include    "mc6809e.h"
 #include    "mem.h"
 #include    "cpu.h"
+#include    "state.h"
 
 /* -----------------------------------------
    Local definitions
@@ -35,7 +37,7 @@
 #define     VEC_FIRQ                0xfff6
 #define     VEC_SWI2                0xfff4
 #define     VEC_SWI3                0xfff2
-#define     VEC_RESERVED            0xfff0
+#define     VEC_RESERVED            0xfff0      // HD6309 illegal op-code and division by zero trap
 
 /* Interrupt sources
  */
@@ -50,17 +52,125 @@
 #define     INDX_POST_INDIRECT      0x10
 #define     INDX_POST_MODE          0x0f
 
+/* HD6309 ,W ,W++ ,--W and n16,W modes use the post-bytes of the
+ * non-indirect mode 15 and of the indirect ,R+ mode
+ */
+#define     INDX_POST_W_MODE(p)     (((p) & 0x9f) == 0x8f || ((p) & 0x9f) == 0x90)
+
+/* Push and pull post-byte register list
+ */
+#define     PUSH_PULL_CC            0x01
+#define     PUSH_PULL_A             0x02
+#define     PUSH_PULL_B             0x04
+#define     PUSH_PULL_DP            0x08
+#define     PUSH_PULL_X             0x10
+#define     PUSH_PULL_Y             0x20
+#define     PUSH_PULL_SU            0x40        // S or U, the other stack register
+#define     PUSH_PULL_PC            0x80
+#define     PUSH_PULL_ALL           0xff
+
+#if (CPU_6309==1)
+#define     PUSH_PULL_W             0x100       // E and F, only in HD6309 native mode interrupt frames
+#define     PUSH_PULL_STATE         (PUSH_PULL_ALL | (NATIVE_MODE ? PUSH_PULL_W : 0))
+#define     PUSH_PULL_MAX_BYTES     14
+#else
+#define     PUSH_PULL_STATE         PUSH_PULL_ALL
+#define     PUSH_PULL_MAX_BYTES     12
+#endif
+
+/* HD6309 mode and error register bits
+ */
+#define     MD_NATIVE               0x01        // Native mode
+#define     MD_FIRQ_STATE           0x02        // FIRQ stacks the entire machine state
+#define     MD_ILLEGAL              0x40        // Illegal op-code trap
+#define     MD_DIV_ZERO             0x80        // Division by zero trap
+
+#if (CPU_6309==1)
+#define     NATIVE_MODE             (cpu.md & MD_NATIVE)
+#else
+#define     NATIVE_MODE             0
+#endif
+
+#define     TFM_BYTE_CYCLES         3           // Cycles per byte of an HD6309 TFM block move
+
+/* Pre-decoded instruction cache for code executing from ROM.
+ * The cache is direct mapped and indexed by PC.
+ */
+#define     DECODE_CACHE_SIZE       4096        // Entries, must be a power of 2
+#define     DECODE_CACHE_MASK       (DECODE_CACHE_SIZE-1)
+
+/* ROM routine traps
+ */
+#define     CPU_TRAPS               4
+#define     TRAP_CYCLES             5           // Cycles of the RTS back to the caller
+
 /* Condition-code register bit
  */
 #define     CC_FLAG_CLR             0
 #define     CC_FLAG_SET             1
 
+/* Lazy condition-code flags.
+ * C, V, Z, N and H are not evaluated when an instruction executes.
+ * Instead each flag keeps the raw value it is derived from, and the
+ * flag is extracted only when a branch, PSH/TFR/EXG of CC or an interrupt
+ * reads it. A 16-bit source value is stored shifted right by eight so
+ * that one extraction works for both operand sizes.
+ */
+#define     CC_C                    ((cc.c_src >> 8) & 1)       // Carry out of bit 7
+#define     CC_V                    ((cc.v_src >> 7) & 1)       // Overflow in bit 7
+#define     CC_Z                    (cc.z_src == 0)             // Zero when the result is zero
+#define     CC_N                    ((cc.n_src >> 7) & 1)       // Sign bit 7
+#define     CC_H                    ((cc.h_src >> 4) & 1)       // Half carry out of bit 3
+
+#define     CC_C_SET                0x0100      // Source values that force a flag state
+#define     CC_V_SET                0x0080
+#define     CC_Z_SET                0
+#define     CC_Z_CLR                1
+#define     CC_N_SET                0x0080
+#define     CC_H_SET                0x0010
+
 /* Word and Byte operations
  */
 #define     GET_REG_HIGH(r)         ((uint8_t)(r >> 8))
 #define     GET_REG_LOW(r)          ((uint8_t)r)
 #define     SIG_EXTEND(b)           ((((uint8_t)b) & 0x80) ? (((uint16_t)b) | 0xff00):((uint16_t)b))
 
+/* Index into machine_code[] used for double byte op-codes
+ * that do not exist in the 0x10 or 0x11 pages.
+ * Entry 0x01 is an illegal op-code with mode 'ILLEGAL_OP'.
+ */
+#define     OP_CODE_ILLEGAL_INDEX   0x01
+
+/* Index into machine_code[] of a single byte op-code, the HD6309
+ * build overlays its op-codes on the MC6809E illegal op-codes
+ */
+#if (CPU_6309==1)
+#define     PAGE0_INDEX(op_code)    (op_code_page0[(op_code)])
+#else
+#define     PAGE0_INDEX(op_code)    (op_code)
+#endif
+
+/* A decoded instruction.
+ * Holds everything about an instruction that does not depend on
+ * CPU register content, so that instructions in ROM are decoded once.
+ */
+typedef struct
+{
+    uint16_t    pc;             // Instruction address, the cache tag
+    uint16_t    next_pc;        // Address of the next instruction
+    uint16_t    operand;        // Effective address, direct page offset, or index offset
+    uint8_t     prefix;         // 0x10 or 0x11 double byte op-code prefix, or 0
+    uint8_t     op_code;
+    uint8_t     mode;           // Addressing mode ADDR_*
+    uint8_t     post_byte;      // Indexed addressing post-byte
+    uint8_t     cycles;         // Cycle count including indexed addressing cycles
+    uint8_t     bytes;
+    uint8_t     valid;
+#if (CPU_6309==1)
+    uint8_t     data;           // HD6309 immediate byte or bit manipulation post-byte
+#endif
+} decoded_op_t;
+
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
@@ -106,11 +216,37 @@ static void    swi(int swi_id);
 static void    tfr(uint8_t regs);
 static void    tst(uint8_t byte);
 
+#if (CPU_6309==1)
+/* HD6309 op-code processing
+ */
+static uint16_t add16(uint16_t acc, uint16_t word, int carry);
+static void    alu_register(uint8_t op_code, uint8_t regs);
+static void    bit_op(uint8_t op_code, uint8_t post_byte, uint16_t address, int *cycles);
+static void    divd(uint8_t byte);
+static void    divq(uint16_t word);
+static uint16_t inherent16(uint8_t op_code, uint16_t word);
+static void    ldq(uint32_t quad);
+static void    muld(uint16_t word);
+static uint16_t sub16(uint16_t acc, uint16_t word, int carry);
+static void    tfm(const decoded_op_t *op, int *cycles);
+static void    tst16(uint16_t word);
+
+static void    error_trap(uint8_t md_bit, int *cycles);
+static void    set_md(uint8_t value);
+#endif
+
 /* CPU op-code support functions
  */
 static void     branch(int instruction, int long_short, uint16_t effective_address, int *cycles);
 static void     do_branch(int long_short, uint16_t effective_address, int *cycles);
-static int      get_eff_addr(int op_code, int *cycles, int *bytes);
+static decoded_op_t *get_decoded_op(decoded_op_t *op_buffer);
+static void     decode_op(uint16_t address, decoded_op_t *op);
+static int      get_eff_addr(const decoded_op_t *op);
+#if (CPU_6309==1)
+static uint16_t get_eff_addr_w(const decoded_op_t *op);
+#endif
+static int      push_registers(uint16_t *stack, uint16_t other_stack, int push_list, uint8_t cc_value);
+static int      pull_registers(uint16_t *stack, uint16_t *other_stack, int pull_list);
 static uint16_t read_register(int reg);
 static void     write_register(int reg, uint16_t data);
 
@@ -129,6 +265,31 @@ static void    eval_cc_h(uint8_t val1, uint8_t val2, uint8_t result);
 static uint8_t get_cc(void);
 static void    set_cc(uint8_t value);
 
+/* Op-code decode tables
+ */
+static void    build_op_code_pages(void);
+
+/* ROM routine traps
+ */
+static int     run_trap(void);
+
+/* Breakpoints and watchpoints
+ */
+static int     debug_break(void);
+
+/* Instruction history
+ */
+#if (CPU_HISTORY > 0)
+static void    history_record(const decoded_op_t *op, int cycles);
+#endif
+static const char *op_code_mnemonic(uint8_t op_code, uint8_t page_op_code);
+
+#if (CPU_PROFILE==1)
+/* Execution profile
+ */
+static void    profile_count(const decoded_op_t *op);
+#endif
+
 
 /* -----------------------------------------
    Module globals
@@ -139,17 +300,82 @@ static void    set_cc(uint8_t value);
 static cpu_state_t cpu;
 static struct cc_t
 {
-    int c;
-    int v;
-    int z;
-    int n;
-    int i;
-    int h;
-    int f;
-    int e;
+    uint32_t c_src;
+    uint32_t v_src;
+    uint32_t z_src;
+    uint32_t n_src;
+    int      i;
+    uint32_t h_src;
+    int      f;
+    int      e;
 } cc;
 
 #define     d       ((uint16_t)(((uint16_t)cpu.a << 8) + cpu.b))    // Accumulator D
+#if (CPU_6309==1)
+#define     w       ((uint16_t)(((uint16_t)cpu.e << 8) + cpu.f))    // HD6309 accumulator W
+#define     q       ((uint32_t)(((uint32_t)d << 16) + w))           // HD6309 accumulator Q
+#endif
+
+/* Direct-indexed decode tables for double byte op-codes.
+ * Each entry holds the machine_code[] index of the 0x10 or 0x11
+ * prefixed op-code, built once by cpu_init().
+ */
+static int  op_code_page10[256];
+static int  op_code_page11[256];
+#if (CPU_6309==1)
+static int  op_code_page0[256];
+#endif
+
+/* Pre-decoded ROM instructions, discarded when
+ * the memory module reports that memory was loaded.
+ */
+static decoded_op_t decode_cache[DECODE_CACHE_SIZE];
+static uint32_t     decode_cache_version = 0;
+
+/* Trapped ROM routine addresses and their handlers
+ */
+static struct
+{
+    uint16_t            address;
+    cpu_trap_handler_t  handler;
+} trap_list[CPU_TRAPS];
+static int  trap_count = 0;
+
+/* CPU cycles used so far by the running cpu_run_cycles() batch
+ */
+static int  batch_cycles = 0;
+
+/* Breakpoint bitmap, one bit per address
+ */
+static uint8_t  breakpoint_map[MEMORY / 8];
+static int      breakpoint_count = 0;
+static int      break_hit = 0;
+
+/* Instructions executed since power-up, for the performance counters
+ */
+static uint32_t instruction_count = 0;
+
+#if (CPU_HISTORY > 0)
+/* Instruction history ring buffer, and CPU cycles since power-up
+ */
+static cpu_history_t history[CPU_HISTORY];
+static uint32_t history_next = 0;
+static uint32_t history_cycles = 0;
+#endif
+
+#if (CPU_PROFILE==1)
+/* Execution profile, counts of instructions executed per PC bucket
+ * and per machine_code[] entry
+ */
+static uint32_t profile_pc[CPU_PROFILE_BUCKETS];
+static uint16_t profile_first_pc[CPU_PROFILE_BUCKETS];
+static uint32_t profile_op[sizeof(machine_code)/sizeof(machine_code_t)];
+#endif
+
+/* The machine state is on the stack after CWAI, and the interrupt
+ * that ends the wait does not push it again
+ */
+static int  cwai_stacked = 0;
 
 /*------------------------------------------------
  * cpu_init()
@@ -174,6 +400,12 @@ int cpu_init(int address)
 
     cpu.dp = 0;
     set_cc(0);
+#if (CPU_6309==1)
+    cpu.e  = 0;
+    cpu.f  = 0;
+    cpu.v  = 0;
+    cpu.md = 0;
+#endif
 
     /* CPU state
      */
@@ -184,9 +416,22 @@ int cpu_init(int address)
     cpu.irq_asserted = 0;
     cpu.firq_asserted = 0;
     cpu.int_latch = 0;
+    cwai_stacked = 0;
     cpu.cpu_state = CPU_HALTED;
     cpu.exception_line_num = -1;
 
+    trap_count = 0;
+
+    memset(breakpoint_map, 0, sizeof(breakpoint_map));
+    breakpoint_count = 0;
+    break_hit = 0;
+
+    build_op_code_pages();
+
+#if (CPU_PROFILE==1)
+    cpu_profile_reset();
+#endif
+
     /* Check start address and update PC
      */
     if ( address < 0 || address > (MEMORY-1) )
@@ -234,12 +479,14 @@ void cpu_reset(int state)
 void cpu_nmi_trigger(void)
 {
     cpu.nmi_latched = 1;
+    cpu.int_latch |= INT_NMI;
 }
 
 /*------------------------------------------------
  * cpu_firq()
  *
- *  Assert Fast IRQ (FIRQ) state
+ *  Assert Fast IRQ (FIRQ) state.
+ *  Called by the interrupt controller when the FIRQ line changes.
  *
  *  param:  0- clear, 1- asserted
  *  return: Nothing
@@ -247,12 +494,18 @@ void cpu_nmi_trigger(void)
 void cpu_firq(int state)
 {
     cpu.firq_asserted = state;
+
+    if ( state )
+        cpu.int_latch |= INT_FIRQ;
+    else
+        cpu.int_latch &= ~INT_FIRQ;
 }
 
 /*------------------------------------------------
  * cpu_irq()
  *
- *  Assert IRQ state
+ *  Assert IRQ state.
+ *  Called by the interrupt controller when the IRQ line changes.
  *
  *  param:  0- clear, 1- asserted
  *  return: Nothing
@@ -260,12 +513,18 @@ void cpu_firq(int state)
 void cpu_irq(int state)
 {
     cpu.irq_asserted = state;
+
+    if ( state )
+        cpu.int_latch |= INT_IRQ;
+    else
+        cpu.int_latch &= ~INT_IRQ;
 }
 
 /*------------------------------------------------
  * cpu_run()
  *
  *  Start CPU.
+ *  Executes one instruction per call, see cpu_run_cycles() for batch execution.
  *  Function should be called periodically
  *  after an initialization by cpu_run_init().
  *
@@ -274,21 +533,21 @@ void cpu_irq(int state)
  */
 cpu_run_state_t cpu_run(void)
 {
-    int         op_code_index;
+    decoded_op_t   *op = 0L;
+    decoded_op_t    op_buffer;
     int         cycles;
     int         bytes;
     int         eff_addr;
     uint8_t     operand8;
     uint16_t    operand16;
 
-    int  intr_latch = 0;
+    int  intr_latch;
     int  op_code = -1;
 
-    /* Latch interrupt requests
+    /* Latch interrupt requests, a bit mask of the interrupt lines
+     * kept up to date as the lines change
      */
-    intr_latch |= cpu.nmi_latched ? INT_NMI : 0;
-    intr_latch |= cpu.irq_asserted ? INT_IRQ : 0;
-    intr_latch |= cpu.firq_asserted ? INT_FIRQ : 0;
+    intr_latch = cpu.int_latch;
 
     /* Check RESET at every cycle
      * this will emulate an asynchronous RESET response.
@@ -298,12 +557,17 @@ cpu_run_state_t cpu_run(void)
         cc.f = CC_FLAG_SET;
         cc.i = CC_FLAG_SET;
         cpu.dp = 0;
+#if (CPU_6309==1)
+        set_md(0);
+#endif
         cpu.nmi_armed = 0;
         cpu.nmi_latched = 0;
+        cpu.int_latch &= ~INT_NMI;
+        cwai_stacked = 0;
         bytes = 0;
         cycles = 0;
         cpu.cpu_state = CPU_RESET;
-        cpu.pc = (mem_read(VEC_RESET) << 8) + mem_read(VEC_RESET+1);
+        cpu.pc = mem_fetch16(VEC_RESET);
         cpu.last_pc = cpu.pc;
     }
     else
@@ -328,10 +592,18 @@ cpu_run_state_t cpu_run(void)
          * then this point will force the emulation to exit execution
          * and stay in wait mode, or if an interrupt was latched
          * then execution will proceed with op-code fetch.
+         * SYNC resumes on any interrupt line, CWAI waits for an unmasked interrupt.
          */
         if ( cpu.cpu_state == CPU_SYNC )
         {
-            if ( intr_latch & (INT_NMI | INT_FIRQ | INT_IRQ) )
+            if ( cwai_stacked )
+            {
+                intr_latch &= (cpu.nmi_armed ? INT_NMI : 0) |
+                              (cc.f ? 0 : INT_FIRQ) |
+                              (cc.i ? 0 : INT_IRQ);
+            }
+
+            if ( intr_latch )
             {
                 cpu.cpu_state = CPU_EXEC;
             }
@@ -354,94 +626,79 @@ cpu_run_state_t cpu_run(void)
          * but if the IRQ/FIRQ signal was removed before sapling
          * then it will not be serviced.
          * The IRQ and FIRQ signal is level driven.
+         * With no interrupt line asserted, the common case, this is one test.
+         * After CWAI the entire machine state is already stacked with E set,
+         * and the interrupt, FIRQ too, only loads its vector.
          */
-        if ( cpu.nmi_armed && (intr_latch & INT_NMI) )
+        if ( intr_latch )
         {
-            cpu.cpu_state = CPU_EXEC;
-            cc.e = CC_FLAG_SET;
-
-            cpu.s--;
-            mem_write(cpu.s, cpu.pc & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.u & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.u >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.y & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.y >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.x & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.x >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.dp);
-            cpu.s--;
-            mem_write(cpu.s, cpu.b);
-            cpu.s--;
-            mem_write(cpu.s, cpu.a);
-            cpu.s--;
-            mem_write(cpu.s, get_cc());
-
-            cpu.nmi_latched = 0;
+            if ( cpu.nmi_armed && (intr_latch & INT_NMI) )
+            {
+                cpu.cpu_state = CPU_EXEC;
+                cc.e = CC_FLAG_SET;
 
-            cc.f = CC_FLAG_SET;
-            cc.i = CC_FLAG_SET;
+                if ( !cwai_stacked )
+                    push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, get_cc());
+                cwai_stacked = 0;
 
-            cpu.pc = (mem_read(VEC_NMI) << 8) + mem_read(VEC_NMI+1);
-        }
-        else if ( !(cc.f) && (intr_latch & INT_FIRQ) )
-        {
-            cpu.cpu_state = CPU_EXEC;
-            cc.e = CC_FLAG_CLR;
+                cpu.nmi_latched = 0;
+                cpu.int_latch &= ~INT_NMI;
 
-            cpu.s--;
-            mem_write(cpu.s, cpu.pc & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, get_cc());
+                cc.f = CC_FLAG_SET;
+                cc.i = CC_FLAG_SET;
 
-            cc.f = CC_FLAG_SET;
-            cc.i = CC_FLAG_SET;
+                cpu.pc = mem_fetch16(VEC_NMI);
+            }
+            else if ( !(cc.f) && (intr_latch & INT_FIRQ) )
+            {
+                cpu.cpu_state = CPU_EXEC;
+
+                if ( !cwai_stacked )
+                {
+#if (CPU_6309==1)
+                    if ( cpu.md & MD_FIRQ_STATE )
+                    {
+                        cc.e = CC_FLAG_SET;
+                        push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, get_cc());
+                    }
+                    else
+#endif
+                    {
+                        cc.e = CC_FLAG_CLR;
+                        push_registers(&cpu.s, cpu.u, (PUSH_PULL_PC | PUSH_PULL_CC), get_cc());
+                    }
+                }
+                cwai_stacked = 0;
+
+                cc.f = CC_FLAG_SET;
+                cc.i = CC_FLAG_SET;
 
-            cpu.pc = (mem_read(VEC_FIRQ) << 8) + mem_read(VEC_FIRQ+1);
+                cpu.pc = mem_fetch16(VEC_FIRQ);
+            }
+            else if ( !(cc.i) && (intr_latch & INT_IRQ) )
+            {
+                cpu.cpu_state = CPU_EXEC;
+                cc.e = CC_FLAG_SET;
+
+                if ( !cwai_stacked )
+                    push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, get_cc());
+                cwai_stacked = 0;
+
+                cc.i = CC_FLAG_SET;
+
+                cpu.pc = mem_fetch16(VEC_IRQ);
+            }
         }
-        else if ( !(cc.i) && (intr_latch & INT_IRQ) )
+
+        /* A trapped ROM routine is replaced by its handler,
+         * and execution continues at the routine's caller.
+         */
+        if ( trap_count && run_trap() )
         {
             cpu.cpu_state = CPU_EXEC;
-            cc.e = CC_FLAG_SET;
-
-            cpu.s--;
-            mem_write(cpu.s, cpu.pc & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.u & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.u >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.y & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.y >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.x & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, (cpu.x >> 8) & 0xff);
-            cpu.s--;
-            mem_write(cpu.s, cpu.dp);
-            cpu.s--;
-            mem_write(cpu.s, cpu.b);
-            cpu.s--;
-            mem_write(cpu.s, cpu.a);
-            cpu.s--;
-            mem_write(cpu.s, get_cc());
-
-            cc.i = CC_FLAG_SET;
-
-            cpu.pc = (mem_read(VEC_IRQ) << 8) + mem_read(VEC_IRQ+1);
+            cpu.last_opcode_bytes = 0;
+            cpu.last_opcode_cycles = TRAP_CYCLES;
+            return cpu.cpu_state;
         }
 
         /* CPU now running so fetch instruction.
@@ -450,32 +707,27 @@ cpu_run_state_t cpu_run(void)
          */
         cpu.cpu_state = CPU_EXEC;
 
-        op_code = mem_read(cpu.pc);
-        cpu.pc++;
-
-        /* Double-byte 0x10 prefix
+        /* Decode the instruction, or use the pre-decoded
+         * instruction if executing from ROM.
+         * An illegal op-code is caught in the switch-case below.
          */
-        if ( op_code == 0x10 )
-        {
-            op_code = mem_read(cpu.pc);
-            cpu.pc++;
+        op = get_decoded_op(&op_buffer);
 
-            /* Search for 0x10 double byte op-code. If not found
-             * then fall through the loop and catch the issue in the
-             * switch-case below.
-             */
-            for ( op_code_index = OP_CODE10; op_code_index < OP_CODE11; op_code_index++ )
-            {
-                if ( machine_code[op_code_index].op == op_code )
-                    {
-                        cycles = machine_code[op_code_index].cycles;
-                        bytes = machine_code[op_code_index].bytes;
-                        break;
-                    }
-            }
+#if (CPU_PROFILE==1)
+        profile_count(op);
+#endif
 
-            eff_addr = get_eff_addr(op_code_index, &cycles, &bytes);
+        cpu.pc = op->next_pc;
+        op_code = op->op_code;
+        cycles = op->cycles;
+        bytes = op->bytes;
 
+        eff_addr = get_eff_addr(op);
+
+        /* Double-byte 0x10 prefix
+         */
+        if ( op->prefix == 0x10 )
+        {
             switch ( op_code )
             {
                 /* CMPD
@@ -484,9 +736,7 @@ cpu_run_state_t cpu_run(void)
                 case 0x93:
                 case 0xa3:
                 case 0xb3:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
+                    operand16 = mem_fetch16(eff_addr);
                     cmp16(d, operand16);
                     break;
 
@@ -496,9 +746,7 @@ cpu_run_state_t cpu_run(void)
                 case 0x9c:
                 case 0xac:
                 case 0xbc:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
+                    operand16 = mem_fetch16(eff_addr);
                     cmp16(cpu.y, operand16);
                     break;
 
@@ -508,12 +756,10 @@ cpu_run_state_t cpu_run(void)
                 case 0xde:
                 case 0xee:
                 case 0xfe:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    cpu.s = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
+                    cpu.s = mem_fetch16(eff_addr);
                     eval_cc_z16(cpu.s);
                     eval_cc_n16(cpu.s);
-                    cc.v = CC_FLAG_CLR;
+                    cc.v_src = 0;
                     cpu.nmi_armed = 1;
                     break;
 
@@ -523,12 +769,10 @@ cpu_run_state_t cpu_run(void)
                 case 0x9e:
                 case 0xae:
                 case 0xbe:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    cpu.y = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
+                    cpu.y = mem_fetch16(eff_addr);
                     eval_cc_z16(cpu.y);
                     eval_cc_n16(cpu.y);
-                    cc.v = CC_FLAG_CLR;
+                    cc.v_src = 0;
                     break;
 
                 /* STS
@@ -536,11 +780,10 @@ cpu_run_state_t cpu_run(void)
                 case 0xdf:
                 case 0xef:
                 case 0xff:
-                    mem_write(eff_addr, (uint8_t) (cpu.s >> 8));
-                    mem_write(eff_addr + 1, (uint8_t) (cpu.s));
+                    mem_store16(eff_addr, cpu.s);
                     eval_cc_z16(cpu.s);
                     eval_cc_n16(cpu.s);
-                    cc.v = CC_FLAG_CLR;
+                    cc.v_src = 0;
                     break;
 
                 /* STY
@@ -548,11 +791,10 @@ cpu_run_state_t cpu_run(void)
                 case 0x9f:
                 case 0xaf:
                 case 0xbf:
-                    mem_write(eff_addr, (uint8_t) (cpu.y >> 8));
-                    mem_write(eff_addr + 1, (uint8_t) (cpu.y));
+                    mem_store16(eff_addr, cpu.y);
                     eval_cc_z16(cpu.y);
                     eval_cc_n16(cpu.y);
-                    cc.v = CC_FLAG_CLR;
+                    cc.v_src = 0;
                     break;
 
                 /* LBRN
@@ -573,1045 +815,2048 @@ cpu_run_state_t cpu_run(void)
                     swi(2);
                     break;
 
-                default:
-                    /* Exception: Illegal 0x10 op-code cpu_run()
-                     */
-                    cpu.cpu_state = CPU_EXCEPTION;
-                    cpu.exception_line_num = __LINE__;
-            }
-        }
-        /* Double-byte 0x11 prefix
-         */
-        else if ( op_code == 0x11 )
-        {
-            op_code = mem_read(cpu.pc);
-            cpu.pc++;
-            /* Search for 0x11 double byte op-code. If not found
-             * then fall through the loop and catch the issue in the
-             * switch-case below.
-             */
-            for ( op_code_index = OP_CODE11; op_code_index < sizeof(machine_code)/sizeof(machine_code_t); op_code_index++ )
-            {
-                if ( machine_code[op_code_index].op == op_code )
-                    {
-                        cycles = machine_code[op_code_index].cycles;
-                        bytes = machine_code[op_code_index].bytes;
-                        break;
-                    }
-            }
-
-            eff_addr = get_eff_addr(op_code_index, &cycles, &bytes);
-
-            switch ( op_code )
-            {
-                /* CMPU
+#if (CPU_6309==1)
+                /* ADDR, ADCR, SUBR, SBCR, ANDR, ORR, EORR, CMPR
                  */
-                case 0x83:
-                case 0x93:
-                case 0xa3:
-                case 0xb3:
+                case 0x30 ... 0x37:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    cmp16(cpu.u, operand16);
+                    alu_register(op_code, operand8);
                     break;
 
-                /* CMPS
+                /* PSHSW, PULSW, PSHUW, PULUW
                  */
-                case 0x8c:
-                case 0x9c:
-                case 0xac:
-                case 0xbc:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    cmp16(cpu.s, operand16);
+                case 0x38:
+                    push_registers(&cpu.s, cpu.u, PUSH_PULL_W, 0);
                     break;
 
-                /* SWI3
-                 */
-                case 0x3f:
-                    swi(3);
+                case 0x39:
+                    pull_registers(&cpu.s, &cpu.u, PUSH_PULL_W);
                     break;
 
-                default:
-                    /* Exception: Illegal 0x11 op-code cpu_run()
-                     */
-                    cpu.cpu_state = CPU_EXCEPTION;
-                    cpu.exception_line_num = __LINE__;
-            }
-        }
-        /* Common op-code processing
-         */
-        else
-        {
-            /* 'operand8' will be operand byte, and for a 16-bit operand 'operand8'
-             * will be the high order byte and low order byte should be read separately
-             * and combined into 16-bit value.
-             */
-            cycles = machine_code[op_code].cycles;
-            bytes = machine_code[op_code].bytes;
-
-            eff_addr = get_eff_addr(op_code, &cycles, &bytes);
-
-            switch ( op_code )
-            {
-                /* ABX
-                 */
                 case 0x3a:
-                    cpu.x += cpu.b;
+                    push_registers(&cpu.u, cpu.s, PUSH_PULL_W, 0);
                     break;
 
-                /* ADCA
+                case 0x3b:
+                    pull_registers(&cpu.u, &cpu.s, PUSH_PULL_W);
+                    break;
+
+                /* NEGD, COMD, LSRD, RORD, ASRD, ASLD, ROLD, DECD, INCD, TSTD, CLRD
                  */
-                case 0x89:
-                case 0x99:
-                case 0xa9:
-                case 0xb9:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = adc(cpu.a, operand8);
+                case 0x40:
+                case 0x43:
+                case 0x44:
+                case 0x46:
+                case 0x47:
+                case 0x48:
+                case 0x49:
+                case 0x4a:
+                case 0x4c:
+                case 0x4d:
+                case 0x4f:
+                    operand16 = inherent16(op_code, d);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
                     break;
 
-                /* ADCB
+                /* COMW, LSRW, RORW, ROLW, DECW, INCW, TSTW, CLRW
                  */
-                case 0xc9:
-                case 0xd9:
-                case 0xe9:
-                case 0xf9:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = adc(cpu.b, operand8);
+                case 0x53:
+                case 0x54:
+                case 0x56:
+                case 0x59:
+                case 0x5a:
+                case 0x5c:
+                case 0x5d:
+                case 0x5f:
+                    operand16 = inherent16(op_code, w);
+                    cpu.e = GET_REG_HIGH(operand16);
+                    cpu.f = GET_REG_LOW(operand16);
                     break;
 
-                /* ADDA
+                /* SUBW
                  */
-                case 0x8b:
-                case 0x9b:
-                case 0xab:
-                case 0xbb:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = add(cpu.a, operand8);
+                case 0x80:
+                case 0x90:
+                case 0xa0:
+                case 0xb0:
+                    operand16 = sub16(w, mem_fetch16(eff_addr), 0);
+                    cpu.e = GET_REG_HIGH(operand16);
+                    cpu.f = GET_REG_LOW(operand16);
                     break;
 
-                /* ADDB
+                /* CMPW
                  */
-                case 0xcb:
-                case 0xdb:
-                case 0xeb:
-                case 0xfb:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = add(cpu.b, operand8);
+                case 0x81:
+                case 0x91:
+                case 0xa1:
+                case 0xb1:
+                    operand16 = mem_fetch16(eff_addr);
+                    cmp16(w, operand16);
                     break;
 
-                /* ADDD
+                /* SBCD
                  */
-                case 0xc3:
-                case 0xd3:
-                case 0xe3:
-                case 0xf3:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    addd(operand16);
+                case 0x82:
+                case 0x92:
+                case 0xa2:
+                case 0xb2:
+                    operand16 = sub16(d, mem_fetch16(eff_addr), CC_C);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
                     break;
 
-                /* ANDA
+                /* ANDD
                  */
                 case 0x84:
                 case 0x94:
                 case 0xa4:
                 case 0xb4:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = and(cpu.a, operand8);
+                    operand16 = d & mem_fetch16(eff_addr);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
+                    tst16(operand16);
                     break;
 
-                /* ADDB
+                /* BITD
                  */
-                case 0xc4:
-                case 0xd4:
-                case 0xe4:
-                case 0xf4:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = and(cpu.b, operand8);
-                    break;
-
-                /* ANDCC
-                 */
-                case 0x1c:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    andcc(operand8);
+                case 0x85:
+                case 0x95:
+                case 0xa5:
+                case 0xb5:
+                    tst16(d & mem_fetch16(eff_addr));
                     break;
 
-                /* ASL, ASLA, ASLB
-                 * LSL, LSLA, LSLB
+                /* LDW
                  */
-                case 0x08:
-                case 0x68:
-                case 0x78:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = asl(operand8);
-                    mem_write(eff_addr, operand8);
-                    break;
-
-                case 0x48:
-                    cpu.a = asl(cpu.a);
-                    break;
-
-                case 0x58:
-                    cpu.b = asl(cpu.b);
+                case 0x86:
+                case 0x96:
+                case 0xa6:
+                case 0xb6:
+                    operand16 = mem_fetch16(eff_addr);
+                    cpu.e = GET_REG_HIGH(operand16);
+                    cpu.f = GET_REG_LOW(operand16);
+                    tst16(operand16);
                     break;
 
-                /* ASR, ASRA, ASRB
+                /* STW
                  */
-                case 0x07:
-                case 0x67:
-                case 0x77:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = asr(operand8);
-                    mem_write(eff_addr, operand8);
-                    break;
-
-                case 0x47:
-                    cpu.a = asr(cpu.a);
-                    break;
-
-                case 0x57:
-                    cpu.b = asr(cpu.b);
+                case 0x97:
+                case 0xa7:
+                case 0xb7:
+                    mem_store16(eff_addr, w);
+                    tst16(w);
                     break;
 
-                /* BITA
+                /* EORD
                  */
-                case 0x85:
-                case 0x95:
-                case 0xa5:
-                case 0xb5:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    bit(cpu.a, operand8);
+                case 0x88:
+                case 0x98:
+                case 0xa8:
+                case 0xb8:
+                    operand16 = d ^ mem_fetch16(eff_addr);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
+                    tst16(operand16);
                     break;
 
-                /* BITB
+                /* ADCD
                  */
-                case 0xc5:
-                case 0xd5:
-                case 0xe5:
-                case 0xf5:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    bit(cpu.b, operand8);
+                case 0x89:
+                case 0x99:
+                case 0xa9:
+                case 0xb9:
+                    operand16 = add16(d, mem_fetch16(eff_addr), CC_C);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
                     break;
 
-                /* CLR, CLRA, CLRB
+                /* ORD
                  */
-                case 0x0f:
-                case 0x6f:
-                case 0x7f:
-                    operand8 = clr();
-                    mem_write(eff_addr, operand8);
+                case 0x8a:
+                case 0x9a:
+                case 0xaa:
+                case 0xba:
+                    operand16 = d | mem_fetch16(eff_addr);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
+                    tst16(operand16);
                     break;
 
-                case 0x4f:
-                    cpu.a = clr();
+                /* ADDW
+                 */
+                case 0x8b:
+                case 0x9b:
+                case 0xab:
+                case 0xbb:
+                    operand16 = add16(w, mem_fetch16(eff_addr), 0);
+                    cpu.e = GET_REG_HIGH(operand16);
+                    cpu.f = GET_REG_LOW(operand16);
                     break;
 
-                case 0x5f:
-                    cpu.b = clr();
+                /* LDQ
+                 */
+                case 0xdc:
+                case 0xec:
+                case 0xfc:
+                    ldq(((uint32_t) mem_fetch16(eff_addr) << 16) + mem_fetch16(eff_addr + 2));
                     break;
 
-                /* CMPA
+                /* STQ
                  */
-                case 0x81:
-                case 0x91:
-                case 0xa1:
-                case 0xb1:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cmp(cpu.a, operand8);
+                case 0xdd:
+                case 0xed:
+                case 0xfd:
+                    mem_store16(eff_addr, d);
+                    mem_store16(eff_addr + 2, w);
+                    ldq(q);
                     break;
+#endif
 
-                /* CMPB
+                default:
+#if (CPU_6309==1)
+                    error_trap(MD_ILLEGAL, &cycles);
+#else
+                    /* Exception: Illegal 0x10 op-code cpu_run()
+                     */
+                    cpu.cpu_state = CPU_EXCEPTION;
+                    cpu.exception_line_num = __LINE__;
+#endif
+            }
+        }
+        /* Double-byte 0x11 prefix
+         */
+        else if ( op->prefix == 0x11 )
+        {
+            switch ( op_code )
+            {
+                /* CMPU
                  */
-                case 0xc1:
-                case 0xd1:
-                case 0xe1:
-                case 0xf1:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cmp(cpu.b, operand8);
+                case 0x83:
+                case 0x93:
+                case 0xa3:
+                case 0xb3:
+                    operand16 = mem_fetch16(eff_addr);
+                    cmp16(cpu.u, operand16);
                     break;
 
-                /* CMPX
+                /* CMPS
                  */
                 case 0x8c:
                 case 0x9c:
                 case 0xac:
                 case 0xbc:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    cmp16(cpu.x, operand16);
+                    operand16 = mem_fetch16(eff_addr);
+                    cmp16(cpu.s, operand16);
                     break;
 
-                /* COM, COMA, COMB
+                /* SWI3
                  */
-                case 0x03:
-                case 0x63:
-                case 0x73:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = com(operand8);
-                    mem_write(eff_addr, operand8);
+                case 0x3f:
+                    swi(3);
                     break;
 
-                case 0x43:
-                    cpu.a = com(cpu.a);
+#if (CPU_6309==1)
+                /* BAND, BIAND, BOR, BIOR, BEOR, BIEOR, LDBT, STBT
+                 */
+                case 0x30 ... 0x37:
+                    bit_op(op_code, op->data, eff_addr, &cycles);
                     break;
 
-                case 0x53:
-                    cpu.b = com(cpu.b);
+                /* TFM
+                 */
+                case 0x38 ... 0x3b:
+                    tfm(op, &cycles);
                     break;
 
-                /* CWAI
+                /* BITMD
                  */
                 case 0x3c:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cwai(operand8);
+                    operand8 = (uint8_t) mem_read(eff_addr) & (MD_ILLEGAL | MD_DIV_ZERO);
+                    cc.z_src = (cpu.md & operand8) ? CC_Z_CLR : CC_Z_SET;
+                    cpu.md &= ~operand8;
                     break;
 
-                /* DAA
+                /* LDMD
                  */
-                case 0x19:
-                    daa();
+                case 0x3d:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    set_md((cpu.md & ~(MD_NATIVE | MD_FIRQ_STATE)) | (operand8 & (MD_NATIVE | MD_FIRQ_STATE)));
                     break;
 
-                /* DEC, DECA, DECB
+                /* COME, DECE, INCE, TSTE, CLRE
                  */
-                case 0x0a:
-                case 0x6a:
-                case 0x7a:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = dec(operand8);
-                    mem_write(eff_addr, operand8);
+                case 0x43:
+                    cpu.e = com(cpu.e);
                     break;
 
                 case 0x4a:
-                    cpu.a = dec(cpu.a);
+                    cpu.e = dec(cpu.e);
                     break;
 
-                case 0x5a:
-                    cpu.b = dec(cpu.b);
+                case 0x4c:
+                    cpu.e = inc(cpu.e);
                     break;
 
-                /* EORA
-                 */
-                case 0x88:
-                case 0x98:
-                case 0xa8:
-                case 0xb8:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = eor(cpu.a, operand8);
+                case 0x4d:
+                    tst(cpu.e);
                     break;
 
-                /* EORB
-                 */
-                case 0xc8:
-                case 0xd8:
-                case 0xe8:
-                case 0xf8:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = eor(cpu.b, operand8);
+                case 0x4f:
+                    cpu.e = clr();
                     break;
 
-                /* EXG
+                /* COMF, DECF, INCF, TSTF, CLRF
                  */
-                case 0x1e:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    exg(operand8);
+                case 0x53:
+                    cpu.f = com(cpu.f);
                     break;
 
-                /* INC, INCA, INCB
-                 */
-                case 0x0c:
-                case 0x6c:
-                case 0x7c:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = inc(operand8);
-                    mem_write(eff_addr, operand8);
+                case 0x5a:
+                    cpu.f = dec(cpu.f);
                     break;
 
-                case 0x4c:
-                    cpu.a = inc(cpu.a);
+                case 0x5c:
+                    cpu.f = inc(cpu.f);
                     break;
 
-                case 0x5c:
-                    cpu.b = inc(cpu.b);
+                case 0x5d:
+                    tst(cpu.f);
                     break;
 
-                /* JMP
+                case 0x5f:
+                    cpu.f = clr();
+                    break;
+
+                /* SUBE, SUBF
                  */
-                case 0x0e:
-                case 0x6e:
-                case 0x7e:
-                    cpu.pc = eff_addr;
+                case 0x80:
+                case 0x90:
+                case 0xa0:
+                case 0xb0:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.e = sub(cpu.e, operand8);
                     break;
 
-                /* JSR
+                case 0xc0:
+                case 0xd0:
+                case 0xe0:
+                case 0xf0:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.f = sub(cpu.f, operand8);
+                    break;
+
+                /* CMPE, CMPF
                  */
-                case 0x9d:
-                case 0xad:
-                case 0xbd:
-                    cpu.s--;
-                    mem_write(cpu.s, GET_REG_LOW(cpu.pc));
-                    cpu.s--;
-                    mem_write(cpu.s, GET_REG_HIGH(cpu.pc));
-                    cpu.pc = eff_addr;
+                case 0x81:
+                case 0x91:
+                case 0xa1:
+                case 0xb1:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cmp(cpu.e, operand8);
                     break;
 
-                /* LDA
+                case 0xc1:
+                case 0xd1:
+                case 0xe1:
+                case 0xf1:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cmp(cpu.f, operand8);
+                    break;
+
+                /* LDE, LDF
                  */
                 case 0x86:
                 case 0x96:
                 case 0xa6:
                 case 0xb6:
-                    cpu.a = (uint8_t) mem_read(eff_addr);;
-                    eval_cc_z((uint16_t) cpu.a);
-                    eval_cc_n((uint16_t) cpu.a);
-                    cc.v = CC_FLAG_CLR;
+                    cpu.e = (uint8_t) mem_read(eff_addr);
+                    tst(cpu.e);
                     break;
 
-                /* LDB
-                 */
                 case 0xc6:
                 case 0xd6:
                 case 0xe6:
                 case 0xf6:
-                    cpu.b = (uint8_t) mem_read(eff_addr);;
-                    eval_cc_z((uint16_t) cpu.b);
-                    eval_cc_n((uint16_t) cpu.b);
-                    cc.v = CC_FLAG_CLR;
+                    cpu.f = (uint8_t) mem_read(eff_addr);
+                    tst(cpu.f);
                     break;
 
-                /* LDD
+                /* STE, STF
                  */
-                case 0xcc:
-                case 0xdc:
-                case 0xec:
-                case 0xfc:
-                    cpu.a = (uint8_t) mem_read(eff_addr);;
-                    eff_addr++;
-                    cpu.b = (uint8_t) mem_read(eff_addr);
-                    eval_cc_z16(d);
-                    eval_cc_n16(d);
-                    cc.v = CC_FLAG_CLR;
+                case 0x97:
+                case 0xa7:
+                case 0xb7:
+                    mem_write(eff_addr, cpu.e);
+                    tst(cpu.e);
                     break;
 
-                /* LDU
-                 */
-                case 0xce:
-                case 0xde:
-                case 0xee:
-                case 0xfe:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    cpu.u = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    eval_cc_z16(cpu.u);
-                    eval_cc_n16(cpu.u);
-                    cc.v = CC_FLAG_CLR;
+                case 0xd7:
+                case 0xe7:
+                case 0xf7:
+                    mem_write(eff_addr, cpu.f);
+                    tst(cpu.f);
                     break;
 
-                /* LDX
+                /* ADDE, ADDF
                  */
-                case 0x8e:
-                case 0x9e:
-                case 0xae:
-                case 0xbe:
+                case 0x8b:
+                case 0x9b:
+                case 0xab:
+                case 0xbb:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    cpu.x = ((uint16_t) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    eval_cc_z16(cpu.x);
-                    eval_cc_n16(cpu.x);
-                    cc.v = CC_FLAG_CLR;
-                    break;
-
-                /* LEA
-                 */
-                case 0x30:
-                    cpu.x = eff_addr;
-                    eval_cc_z16(cpu.x);
-                    break;
-
-                case 0x31:
-                    cpu.y = eff_addr;
-                    eval_cc_z16(cpu.y);
-                    break;
-
-                case 0x32:
-                    cpu.s = eff_addr;
-                    cpu.nmi_armed = 1;
+                    cpu.e = add(cpu.e, operand8);
                     break;
 
-                case 0x33:
-                    cpu.u = eff_addr;
+                case 0xcb:
+                case 0xdb:
+                case 0xeb:
+                case 0xfb:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.f = add(cpu.f, operand8);
                     break;
 
-                /* LSR, LSRA, LSRB
+                /* DIVD
                  */
-                case 0x04:
-                case 0x64:
-                case 0x74:
+                case 0x8d:
+                case 0x9d:
+                case 0xad:
+                case 0xbd:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = lsr(operand8);
-                    mem_write(eff_addr, operand8);
-                    break;
-
-                case 0x44:
-                    cpu.a = lsr(cpu.a);
-                    break;
-
-                case 0x54:
-                    cpu.b = lsr(cpu.b);
+                    if ( operand8 == 0 )
+                        error_trap(MD_DIV_ZERO, &cycles);
+                    else
+                        divd(operand8);
                     break;
 
-                /* MUL
+                /* DIVQ
                  */
-                case 0x3d:
-                    operand16 = cpu.a * cpu.b;
-                    cpu.a = GET_REG_HIGH(operand16);
-                    cpu.b = GET_REG_LOW(operand16);
-                    eval_cc_z16(operand16);
-                    eval_cc_c(operand16);;
+                case 0x8e:
+                case 0x9e:
+                case 0xae:
+                case 0xbe:
+                    operand16 = mem_fetch16(eff_addr);
+                    if ( operand16 == 0 )
+                        error_trap(MD_DIV_ZERO, &cycles);
+                    else
+                        divq(operand16);
                     break;
 
-                /* NEG, NEGA, NEGB
+                /* MULD
                  */
-                case 0x00:
-                case 0x60:
-                case 0x70:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = neg(operand8);
-                    mem_write(eff_addr, operand8);
-                    break;
-
-                case 0x40:
-                    cpu.a = neg(cpu.a);
+                case 0x8f:
+                case 0x9f:
+                case 0xaf:
+                case 0xbf:
+                    operand16 = mem_fetch16(eff_addr);
+                    muld(operand16);
                     break;
+#endif
 
-                case 0x50:
-                    cpu.b = neg(cpu.b);
+                default:
+#if (CPU_6309==1)
+                    error_trap(MD_ILLEGAL, &cycles);
+#else
+                    /* Exception: Illegal 0x11 op-code cpu_run()
+                     */
+                    cpu.cpu_state = CPU_EXCEPTION;
+                    cpu.exception_line_num = __LINE__;
+#endif
+            }
+        }
+        /* Common op-code processing
+         */
+        else
+        {
+            /* 'operand8' will be operand byte, and for a 16-bit operand 'operand8'
+             * will be the high order byte and low order byte should be read separately
+             * and combined into 16-bit value.
+             */
+            switch ( op_code )
+            {
+                /* ABX
+                 */
+                case 0x3a:
+                    cpu.x += cpu.b;
                     break;
 
-                /* NOP
+                /* ADCA
                  */
-                case 0x12:
+                case 0x89:
+                case 0x99:
+                case 0xa9:
+                case 0xb9:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.a = adc(cpu.a, operand8);
                     break;
 
-                /* ORA, ORB
+                /* ADCB
                  */
-                case 0x8a:
-                case 0x9a:
-                case 0xaa:
-                case 0xba:
+                case 0xc9:
+                case 0xd9:
+                case 0xe9:
+                case 0xf9:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = or(cpu.a, operand8);
+                    cpu.b = adc(cpu.b, operand8);
                     break;
 
-                case 0xca:
-                case 0xda:
-                case 0xea:
-                case 0xfa:
+                /* ADDA
+                 */
+                case 0x8b:
+                case 0x9b:
+                case 0xab:
+                case 0xbb:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = or(cpu.b, operand8);
+                    cpu.a = add(cpu.a, operand8);
                     break;
 
-                /* ORCC
+                /* ADDB
                  */
-                case 0x1a:
+                case 0xcb:
+                case 0xdb:
+                case 0xeb:
+                case 0xfb:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    orcc(operand8);
+                    cpu.b = add(cpu.b, operand8);
                     break;
 
-                /* PSHS, PSHU
+                /* ADDD
                  */
-                case 0x34:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    pshs(operand8, &cycles);
+                case 0xc3:
+                case 0xd3:
+                case 0xe3:
+                case 0xf3:
+                    operand16 = mem_fetch16(eff_addr);
+                    addd(operand16);
                     break;
 
-                case 0x36:
+                /* ANDA
+                 */
+                case 0x84:
+                case 0x94:
+                case 0xa4:
+                case 0xb4:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    pshu(operand8, &cycles);
+                    cpu.a = and(cpu.a, operand8);
                     break;
 
-                /* PULS, PULU
+                /* ADDB
                  */
-                case 0x35:
+                case 0xc4:
+                case 0xd4:
+                case 0xe4:
+                case 0xf4:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    puls(operand8, &cycles);
+                    cpu.b = and(cpu.b, operand8);
                     break;
 
-                case 0x37:
+                /* ANDCC
+                 */
+                case 0x1c:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    pulu(operand8, &cycles);
+                    andcc(operand8);
                     break;
 
-                /* ROL, ROLA, ROLB
+                /* ASL, ASLA, ASLB
+                 * LSL, LSLA, LSLB
                  */
-                case 0x09:
-                case 0x69:
-                case 0x79:
+                case 0x08:
+                case 0x68:
+                case 0x78:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = rol(operand8);
+                    operand8 = asl(operand8);
                     mem_write(eff_addr, operand8);
                     break;
 
-                case 0x49:
-                    cpu.a = rol(cpu.a);
+                case 0x48:
+                    cpu.a = asl(cpu.a);
                     break;
 
-                case 0x59:
-                    cpu.b = rol(cpu.b);
+                case 0x58:
+                    cpu.b = asl(cpu.b);
                     break;
 
-                /* ROR, RORA, RORB
+                /* ASR, ASRA, ASRB
                  */
-                case 0x06:
-                case 0x66:
-                case 0x76:
+                case 0x07:
+                case 0x67:
+                case 0x77:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    operand8 = ror(operand8);
+                    operand8 = asr(operand8);
                     mem_write(eff_addr, operand8);
                     break;
 
-                case 0x46:
-                    cpu.a = ror(cpu.a);
+                case 0x47:
+                    cpu.a = asr(cpu.a);
                     break;
 
-                case 0x56:
-                    cpu.b = ror(cpu.b);
+                case 0x57:
+                    cpu.b = asr(cpu.b);
                     break;
 
-                /* RTI
+                /* BITA
                  */
-                case 0x3b:
-                    rti(&cycles);
+                case 0x85:
+                case 0x95:
+                case 0xa5:
+                case 0xb5:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    bit(cpu.a, operand8);
                     break;
 
-                /* RTS
+                /* BITB
                  */
-                case 0x39:
-                     /* Restore PC and return
-                      */
-                     operand8 = mem_read(cpu.s);
-                     cpu.s++;
-                     cpu.pc = (uint16_t) operand8 << 8;
-                     operand8 = mem_read(cpu.s);
-                     cpu.s++;
-                     cpu.pc += operand8;
-                     break;
+                case 0xc5:
+                case 0xd5:
+                case 0xe5:
+                case 0xf5:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    bit(cpu.b, operand8);
+                    break;
 
-                /* SBCA
+                /* CLR, CLRA, CLRB
                  */
-                case 0x82:
-                case 0x92:
-                case 0xa2:
-                case 0xb2:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = sbc(cpu.a, operand8);
+                case 0x0f:
+                case 0x6f:
+                case 0x7f:
+                    operand8 = clr();
+                    mem_write(eff_addr, operand8);
                     break;
 
-                /* SBCB
+                case 0x4f:
+                    cpu.a = clr();
+                    break;
+
+                case 0x5f:
+                    cpu.b = clr();
+                    break;
+
+                /* CMPA
                  */
-                case 0xc2:
-                case 0xd2:
-                case 0xe2:
-                case 0xf2:
+                case 0x81:
+                case 0x91:
+                case 0xa1:
+                case 0xb1:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = sbc(cpu.b, operand8);
+                    cmp(cpu.a, operand8);
                     break;
 
-                /* SEX
+                /* CMPB
                  */
-                case 0x1d:
-                    sex();
+                case 0xc1:
+                case 0xd1:
+                case 0xe1:
+                case 0xf1:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cmp(cpu.b, operand8);
                     break;
 
-                /* STA
+                /* CMPX
                  */
-                case 0x97:
-                case 0xa7:
-                case 0xb7:
-                    mem_write(eff_addr, cpu.a);
-                    eval_cc_z((uint16_t) cpu.a);
-                    eval_cc_n((uint16_t) cpu.a);
-                    cc.v = CC_FLAG_CLR;
+                case 0x8c:
+                case 0x9c:
+                case 0xac:
+                case 0xbc:
+                    operand16 = mem_fetch16(eff_addr);
+                    cmp16(cpu.x, operand16);
                     break;
 
-                /* STB
+                /* COM, COMA, COMB
                  */
-                case 0xd7:
-                case 0xe7:
-                case 0xf7:
-                    mem_write(eff_addr, cpu.b);
-                    eval_cc_z((uint16_t) cpu.b);
-                    eval_cc_n((uint16_t) cpu.b);
-                    cc.v = CC_FLAG_CLR;
+                case 0x03:
+                case 0x63:
+                case 0x73:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = com(operand8);
+                    mem_write(eff_addr, operand8);
                     break;
 
-                /* STD
-                 */
-                case 0xdd:
-                case 0xed:
-                case 0xfd:
-                    mem_write(eff_addr, cpu.a);
-                    mem_write(eff_addr + 1, cpu.b);
-                    eval_cc_z16(d);
-                    eval_cc_n16(d);
-                    cc.v = CC_FLAG_CLR;
+                case 0x43:
+                    cpu.a = com(cpu.a);
                     break;
 
-                /* STU
-                 */
-                case 0xdf:
-                case 0xef:
-                case 0xff:
-                    mem_write(eff_addr, (uint8_t) (cpu.u >> 8));
-                    mem_write(eff_addr + 1, (uint8_t) (cpu.u));
-                    eval_cc_z16(cpu.u);
-                    eval_cc_n16(cpu.u);
-                    cc.v = CC_FLAG_CLR;
+                case 0x53:
+                    cpu.b = com(cpu.b);
                     break;
 
-                /* STX
+                /* CWAI
                  */
-                case 0x9f:
-                case 0xaf:
-                case 0xbf:
-                    mem_write(eff_addr, (uint8_t) (cpu.x >> 8));
-                    mem_write(eff_addr + 1, (uint8_t) (cpu.x));
-                    eval_cc_z16(cpu.x);
-                    eval_cc_n16(cpu.x);
-                    cc.v = CC_FLAG_CLR;
+                case 0x3c:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cwai(operand8);
                     break;
 
-                /* SUBA
+                /* DAA
                  */
-                case 0x80:
-                case 0x90:
-                case 0xa0:
-                case 0xb0:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.a = sub(cpu.a, operand8);
+                case 0x19:
+                    daa();
                     break;
 
-                /* SUBB
+                /* DEC, DECA, DECB
                  */
-                case 0xc0:
-                case 0xd0:
-                case 0xe0:
-                case 0xf0:
+                case 0x0a:
+                case 0x6a:
+                case 0x7a:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    cpu.b = sub(cpu.b, operand8);
+                    operand8 = dec(operand8);
+                    mem_write(eff_addr, operand8);
                     break;
 
-                /* SUBD
+                case 0x4a:
+                    cpu.a = dec(cpu.a);
+                    break;
+
+                case 0x5a:
+                    cpu.b = dec(cpu.b);
+                    break;
+
+                /* EORA
                  */
-                case 0x83:
-                case 0x93:
-                case 0xa3:
-                case 0xb3:
+                case 0x88:
+                case 0x98:
+                case 0xa8:
+                case 0xb8:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    eff_addr++;
-                    operand16 = ((uint16_t ) operand8 << 8) + (uint16_t) mem_read(eff_addr);
-                    subd(operand16);
+                    cpu.a = eor(cpu.a, operand8);
                     break;
 
-                /* SWI
+                /* EORB
                  */
-                case 0x3f:
-                    swi(1);
+                case 0xc8:
+                case 0xd8:
+                case 0xe8:
+                case 0xf8:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.b = eor(cpu.b, operand8);
                     break;
 
-                /* SYNC
-                 *
-                 * The SYNC instruction allows software to synchronize with an external hardware
-                 * event (interrupt). When executed, SYNC stops executing instructions and waits
-                 * for an interrupt. None of the CC flags are directly affected.
+                /* EXG
                  */
-                case 0x13:
-                    cpu.cpu_state = CPU_SYNC;
+                case 0x1e:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    exg(operand8);
                     break;
 
-                /* TFR
+                /* INC, INCA, INCB
                  */
-                case 0x1f:
+                case 0x0c:
+                case 0x6c:
+                case 0x7c:
                     operand8 = (uint8_t) mem_read(eff_addr);
-                    tfr(operand8);
+                    operand8 = inc(operand8);
+                    mem_write(eff_addr, operand8);
                     break;
 
-                /* TSTA
-                 */
-                case 0x4d:
-                    tst(cpu.a);
+                case 0x4c:
+                    cpu.a = inc(cpu.a);
                     break;
 
-                /* TSTB
-                 */
-                case 0x5d:
-                    tst(cpu.b);
+                case 0x5c:
+                    cpu.b = inc(cpu.b);
                     break;
 
-                /* TST
+                /* JMP
                  */
-                case 0x0d:
-                case 0x6d:
-                case 0x7d:
-                    operand8 = (uint8_t) mem_read(eff_addr);
-                    tst(operand8);
+                case 0x0e:
+                case 0x6e:
+                case 0x7e:
+                    cpu.pc = eff_addr;
                     break;
 
-                /* BRA / LBRA
+                /* JSR
                  */
-                case 0x20:
-                case 0x16:
+                case 0x9d:
+                case 0xad:
+                case 0xbd:
+                    push_registers(&cpu.s, cpu.u, PUSH_PULL_PC, 0);
                     cpu.pc = eff_addr;
                     break;
 
-                /* BRN
+                /* LDA
                  */
-                case 0x21:
-                    // Branch never
+                case 0x86:
+                case 0x96:
+                case 0xa6:
+                case 0xb6:
+                    cpu.a = (uint8_t) mem_read(eff_addr);;
+                    eval_cc_z((uint16_t) cpu.a);
+                    eval_cc_n((uint16_t) cpu.a);
+                    cc.v_src = 0;
                     break;
 
-                /* BSR / LBSR
+                /* LDB
                  */
-                case 0x8d:
-                case 0x17:
-                    cpu.s--;
-                    mem_write(cpu.s, GET_REG_LOW(cpu.pc));
-                    cpu.s--;
-                    mem_write(cpu.s, GET_REG_HIGH(cpu.pc));
-                    cpu.pc = eff_addr;
+                case 0xc6:
+                case 0xd6:
+                case 0xe6:
+                case 0xf6:
+                    cpu.b = (uint8_t) mem_read(eff_addr);;
+                    eval_cc_z((uint16_t) cpu.b);
+                    eval_cc_n((uint16_t) cpu.b);
+                    cc.v_src = 0;
                     break;
 
-                /* Short conditional branches
+                /* LDD
                  */
-                case 0x22 ... 0x2f:
-                    branch(op_code, 0, eff_addr, &cycles);
+                case 0xcc:
+                case 0xdc:
+                case 0xec:
+                case 0xfc:
+                    operand16 = mem_fetch16(eff_addr);
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
+                    eval_cc_z16(d);
+                    eval_cc_n16(d);
+                    cc.v_src = 0;
+                    break;
+
+                /* LDU
+                 */
+                case 0xce:
+                case 0xde:
+                case 0xee:
+                case 0xfe:
+                    cpu.u = mem_fetch16(eff_addr);
+                    eval_cc_z16(cpu.u);
+                    eval_cc_n16(cpu.u);
+                    cc.v_src = 0;
                     break;
 
-                default:
-                    /* Exception: Illegal op-code cpu_run()
-                     */
-                    cpu.cpu_state = CPU_EXCEPTION;
-                    cpu.exception_line_num = __LINE__;
-            }
-        }
-    }
+                /* LDX
+                 */
+                case 0x8e:
+                case 0x9e:
+                case 0xae:
+                case 0xbe:
+                    cpu.x = mem_fetch16(eff_addr);
+                    eval_cc_z16(cpu.x);
+                    eval_cc_n16(cpu.x);
+                    cc.v_src = 0;
+                    break;
+
+                /* LEA
+                 */
+                case 0x30:
+                    cpu.x = eff_addr;
+                    eval_cc_z16(cpu.x);
+                    break;
+
+                case 0x31:
+                    cpu.y = eff_addr;
+                    eval_cc_z16(cpu.y);
+                    break;
+
+                case 0x32:
+                    cpu.s = eff_addr;
+                    cpu.nmi_armed = 1;
+                    break;
+
+                case 0x33:
+                    cpu.u = eff_addr;
+                    break;
+
+                /* LSR, LSRA, LSRB
+                 */
+                case 0x04:
+                case 0x64:
+                case 0x74:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = lsr(operand8);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x44:
+                    cpu.a = lsr(cpu.a);
+                    break;
+
+                case 0x54:
+                    cpu.b = lsr(cpu.b);
+                    break;
+
+                /* MUL
+                 */
+                case 0x3d:
+                    operand16 = cpu.a * cpu.b;
+                    cpu.a = GET_REG_HIGH(operand16);
+                    cpu.b = GET_REG_LOW(operand16);
+                    eval_cc_z16(operand16);
+                    eval_cc_c(operand16);;
+                    break;
+
+                /* NEG, NEGA, NEGB
+                 */
+                case 0x00:
+                case 0x60:
+                case 0x70:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = neg(operand8);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x40:
+                    cpu.a = neg(cpu.a);
+                    break;
+
+                case 0x50:
+                    cpu.b = neg(cpu.b);
+                    break;
+
+                /* NOP
+                 */
+                case 0x12:
+                    break;
+
+                /* ORA, ORB
+                 */
+                case 0x8a:
+                case 0x9a:
+                case 0xaa:
+                case 0xba:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.a = or(cpu.a, operand8);
+                    break;
+
+                case 0xca:
+                case 0xda:
+                case 0xea:
+                case 0xfa:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.b = or(cpu.b, operand8);
+                    break;
+
+                /* ORCC
+                 */
+                case 0x1a:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    orcc(operand8);
+                    break;
+
+                /* PSHS, PSHU
+                 */
+                case 0x34:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    pshs(operand8, &cycles);
+                    break;
+
+                case 0x36:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    pshu(operand8, &cycles);
+                    break;
+
+                /* PULS, PULU
+                 */
+                case 0x35:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    puls(operand8, &cycles);
+                    break;
+
+                case 0x37:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    pulu(operand8, &cycles);
+                    break;
+
+                /* ROL, ROLA, ROLB
+                 */
+                case 0x09:
+                case 0x69:
+                case 0x79:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = rol(operand8);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x49:
+                    cpu.a = rol(cpu.a);
+                    break;
+
+                case 0x59:
+                    cpu.b = rol(cpu.b);
+                    break;
+
+                /* ROR, RORA, RORB
+                 */
+                case 0x06:
+                case 0x66:
+                case 0x76:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = ror(operand8);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x46:
+                    cpu.a = ror(cpu.a);
+                    break;
+
+                case 0x56:
+                    cpu.b = ror(cpu.b);
+                    break;
+
+                /* RTI
+                 */
+                case 0x3b:
+                    rti(&cycles);
+                    break;
+
+                /* RTS
+                 */
+                case 0x39:
+                     /* Restore PC and return
+                      */
+                     pull_registers(&cpu.s, &cpu.u, PUSH_PULL_PC);
+                     break;
+
+                /* SBCA
+                 */
+                case 0x82:
+                case 0x92:
+                case 0xa2:
+                case 0xb2:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.a = sbc(cpu.a, operand8);
+                    break;
+
+                /* SBCB
+                 */
+                case 0xc2:
+                case 0xd2:
+                case 0xe2:
+                case 0xf2:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.b = sbc(cpu.b, operand8);
+                    break;
+
+                /* SEX
+                 */
+                case 0x1d:
+                    sex();
+                    break;
+
+                /* STA
+                 */
+                case 0x97:
+                case 0xa7:
+                case 0xb7:
+                    mem_write(eff_addr, cpu.a);
+                    eval_cc_z((uint16_t) cpu.a);
+                    eval_cc_n((uint16_t) cpu.a);
+                    cc.v_src = 0;
+                    break;
+
+                /* STB
+                 */
+                case 0xd7:
+                case 0xe7:
+                case 0xf7:
+                    mem_write(eff_addr, cpu.b);
+                    eval_cc_z((uint16_t) cpu.b);
+                    eval_cc_n((uint16_t) cpu.b);
+                    cc.v_src = 0;
+                    break;
+
+                /* STD
+                 */
+                case 0xdd:
+                case 0xed:
+                case 0xfd:
+                    mem_store16(eff_addr, d);
+                    eval_cc_z16(d);
+                    eval_cc_n16(d);
+                    cc.v_src = 0;
+                    break;
+
+                /* STU
+                 */
+                case 0xdf:
+                case 0xef:
+                case 0xff:
+                    mem_store16(eff_addr, cpu.u);
+                    eval_cc_z16(cpu.u);
+                    eval_cc_n16(cpu.u);
+                    cc.v_src = 0;
+                    break;
+
+                /* STX
+                 */
+                case 0x9f:
+                case 0xaf:
+                case 0xbf:
+                    mem_store16(eff_addr, cpu.x);
+                    eval_cc_z16(cpu.x);
+                    eval_cc_n16(cpu.x);
+                    cc.v_src = 0;
+                    break;
+
+                /* SUBA
+                 */
+                case 0x80:
+                case 0x90:
+                case 0xa0:
+                case 0xb0:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.a = sub(cpu.a, operand8);
+                    break;
+
+                /* SUBB
+                 */
+                case 0xc0:
+                case 0xd0:
+                case 0xe0:
+                case 0xf0:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    cpu.b = sub(cpu.b, operand8);
+                    break;
+
+                /* SUBD
+                 */
+                case 0x83:
+                case 0x93:
+                case 0xa3:
+                case 0xb3:
+                    operand16 = mem_fetch16(eff_addr);
+                    subd(operand16);
+                    break;
+
+                /* SWI
+                 */
+                case 0x3f:
+                    swi(1);
+                    break;
+
+                /* SYNC
+                 *
+                 * The SYNC instruction allows software to synchronize with an external hardware
+                 * event (interrupt). When executed, SYNC stops executing instructions and waits
+                 * for an interrupt. None of the CC flags are directly affected.
+                 */
+                case 0x13:
+                    cpu.cpu_state = CPU_SYNC;
+                    break;
+
+                /* TFR
+                 */
+                case 0x1f:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    tfr(operand8);
+                    break;
+
+                /* TSTA
+                 */
+                case 0x4d:
+                    tst(cpu.a);
+                    break;
+
+                /* TSTB
+                 */
+                case 0x5d:
+                    tst(cpu.b);
+                    break;
+
+                /* TST
+                 */
+                case 0x0d:
+                case 0x6d:
+                case 0x7d:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    tst(operand8);
+                    break;
+
+                /* BRA / LBRA
+                 */
+                case 0x20:
+                case 0x16:
+                    cpu.pc = eff_addr;
+                    break;
+
+                /* BRN
+                 */
+                case 0x21:
+                    // Branch never
+                    break;
+
+                /* BSR / LBSR
+                 */
+                case 0x8d:
+                case 0x17:
+                    push_registers(&cpu.s, cpu.u, PUSH_PULL_PC, 0);
+                    cpu.pc = eff_addr;
+                    break;
+
+                /* Short conditional branches
+                 */
+                case 0x22 ... 0x2f:
+                    branch(op_code, 0, eff_addr, &cycles);
+                    break;
+
+#if (CPU_6309==1)
+                /* OIM, AIM, EIM, TIM
+                 */
+                case 0x01:
+                case 0x61:
+                case 0x71:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = or(operand8, op->data);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x02:
+                case 0x62:
+                case 0x72:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = and(operand8, op->data);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x05:
+                case 0x65:
+                case 0x75:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    operand8 = eor(operand8, op->data);
+                    mem_write(eff_addr, operand8);
+                    break;
+
+                case 0x0b:
+                case 0x6b:
+                case 0x7b:
+                    operand8 = (uint8_t) mem_read(eff_addr);
+                    and(operand8, op->data);
+                    break;
+
+                /* SEXW
+                 */
+                case 0x14:
+                    if ( cpu.e & 0x80 )
+                        cpu.a = cpu.b = 0xff;
+                    else
+                        cpu.a = cpu.b = 0;
+                    cc.z_src = q ? CC_Z_CLR : CC_Z_SET;
+                    cc.n_src = cpu.a;
+                    break;
+
+                /* LDQ
+                 */
+                case 0xcd:
+                    ldq(((uint32_t) mem_fetch16(eff_addr) << 16) + mem_fetch16(eff_addr + 2));
+                    break;
+#endif
+
+                default:
+#if (CPU_6309==1)
+                    error_trap(MD_ILLEGAL, &cycles);
+#else
+                    /* Exception: Illegal op-code cpu_run()
+                     */
+                    cpu.cpu_state = CPU_EXCEPTION;
+                    cpu.exception_line_num = __LINE__;
+#endif
+            }
+        }
+    }
+
+    /* Preserves for other uses such as
+     * single step etc.
+     */
+    cpu.last_opcode_bytes = bytes;
+    cpu.last_opcode_cycles = cycles;
+
+#if (CPU_HISTORY > 0)
+    if ( op )
+        history_record(op, cycles);
+#endif
+
+    return cpu.cpu_state;
+}
+
+/*------------------------------------------------
+ * cpu_run_cycles()
+ *
+ *  Run a batch of CPU instructions until the cycle budget is used.
+ *  The batch ends early when the CPU leaves the CPU_EXEC state (HALT, SYNC
+ *  or CWAI, RESET, or exception), or when an interrupt line changed state
+ *  during an instruction, so that the caller can service peripherals once
+ *  per batch instead of once per instruction. It also ends when PC reaches
+ *  a breakpoint or an instruction accessed a watched address, see cpu_break_hit().
+ *  At least one instruction is always executed, so a budget of '1'
+ *  single-steps the CPU.
+ *  While HALTed, in RESET, or waiting in SYNC, the CPU clock keeps running,
+ *  so the rest of the budget is counted as consumed.
+ *
+ *  param:  Cycle budget, pointer to consumed cycles count return variable (or NULL)
+ *  return: Integer of CPU_* value (see #define CPU_*)
+ */
+cpu_run_state_t cpu_run_cycles(int cycle_budget, int *cycles_used)
+{
+    int     cycles = 0;
+    int     intr_lines;
+
+    batch_cycles = 0;
+
+    do
+    {
+        intr_lines = cpu.int_latch;
+
+        if ( cpu_run() != CPU_EXEC )
+        {
+            if ( cpu.cpu_state != CPU_EXCEPTION && cycles < cycle_budget )
+                cycles = cycle_budget;
+            break;
+        }
+
+        cycles += cpu.last_opcode_cycles;
+        batch_cycles = cycles;
+        instruction_count++;
+
+        if ( (breakpoint_count || mem_watch_hit) && debug_break() )
+            break;
+
+        if ( intr_lines != cpu.int_latch )
+            break;
+    }
+    while ( cycles < cycle_budget );
+
+    if ( cycles_used )
+        *cycles_used = cycles;
+
+    return cpu.cpu_state;
+}
+
+/*------------------------------------------------
+ * cpu_batch_cycles()
+ *
+ *  Return the CPU cycles used by the running cpu_run_cycles() batch
+ *  up to the instruction being executed. Added to the scheduler's
+ *  cycle count it time stamps IO accesses within a batch.
+ *
+ *  param:  Nothing
+ *  return: CPU cycles
+ */
+int cpu_batch_cycles(void)
+{
+    return batch_cycles;
+}
+
+/*------------------------------------------------
+ * cpu_instructions()
+ *
+ *  Return the count of instructions executed by cpu_run_cycles()
+ *  since power-up. The count wraps around.
+ *
+ *  param:  Nothing
+ *  return: Instruction count
+ */
+uint32_t cpu_instructions(void)
+{
+    return instruction_count;
+}
+
+/*------------------------------------------------
+ * cpu_breakpoint()
+ *
+ *  Set or clear a breakpoint. A batch of instructions run by cpu_run_cycles()
+ *  stops before the instruction at a breakpoint address.
+ *  With no breakpoints set, and no watched address accessed,
+ *  the check costs one test per instruction.
+ *
+ *  param:  Address, 1=set or 0=clear the breakpoint
+ *  return: Nothing
+ */
+void cpu_breakpoint(uint16_t address, int set)
+{
+    uint8_t     bit;
+
+    bit = 1 << (address & 7);
+
+    if ( set && !(breakpoint_map[address >> 3] & bit) )
+    {
+        breakpoint_map[address >> 3] |= bit;
+        breakpoint_count++;
+    }
+    else if ( !set && (breakpoint_map[address >> 3] & bit) )
+    {
+        breakpoint_map[address >> 3] &= ~bit;
+        breakpoint_count--;
+    }
+}
+
+/*------------------------------------------------
+ * cpu_is_breakpoint()
+ *
+ *  Check if an address has a breakpoint.
+ *
+ *  param:  Address
+ *  return: 1=breakpoint set, 0=no breakpoint
+ */
+int cpu_is_breakpoint(uint16_t address)
+{
+    return ( (breakpoint_map[address >> 3] & (1 << (address & 7))) != 0 );
+}
+
+/*------------------------------------------------
+ * cpu_break_hit()
+ *
+ *  Check and clear the breakpoint stop of the last cpu_run_cycles() batch.
+ *  The batch stopped with PC at a breakpoint, or after an instruction
+ *  that accessed a watched address, see mem_watch_triggered().
+ *
+ *  param:  Nothing
+ *  return: 1=batch stopped at a breakpoint or watchpoint, 0=no stop
+ */
+int cpu_break_hit(void)
+{
+    int     hit;
+
+    hit = break_hit;
+    break_hit = 0;
+
+    return hit;
+}
+
+/*------------------------------------------------
+ * cpu_trap()
+ *
+ *  Trap a ROM routine by its entry address. When PC reaches the address
+ *  the handler is called with the CPU registers instead of executing
+ *  the routine. A handler that replaced the routine returns '1' and
+ *  the CPU returns to the routine's caller as if by RTS.
+ *  Traps are cleared by cpu_init().
+ *
+ *  param:  Routine entry address, handler function
+ *  return: 0- trap set, 1- no free trap
+ */
+int cpu_trap(uint16_t address, cpu_trap_handler_t handler)
+{
+    if ( trap_count == CPU_TRAPS )
+        return 1;
+
+    trap_list[trap_count].address = address;
+    trap_list[trap_count].handler = handler;
+    trap_count++;
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * cpu_get_state()
+ *
+ *  Get the state of the CPU.
+ *
+ *  param:  Pointer to CPU state data structure
+ *  return: CPU running state
+ */
+cpu_run_state_t cpu_get_state(cpu_state_t* cpu_state)
+{
+    /* Condition codes are evaluated lazily, so pack
+     * the CC register only when the state is requested.
+     */
+    cpu.cc = get_cc();
+
+    memcpy(cpu_state, &cpu, sizeof(cpu_state_t));
+
+    return cpu.cpu_state;
+}
+
+/*------------------------------------------------
+ * cpu_save_state()
+ *
+ *  Write the CPU registers, interrupt lines and latches,
+ *  and the condition code sources to the machine state.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void cpu_save_state(void)
+{
+    cpu.cc = get_cc();
+
+    state_write(&cpu, sizeof(cpu_state_t));
+    state_write(&cc, sizeof(cc));
+    state_write(&cwai_stacked, sizeof(cwai_stacked));
+}
+
+/*------------------------------------------------
+ * cpu_restore_state()
+ *
+ *  Restore the CPU from the machine state.
+ *  Decoded ROM instructions are discarded when the machine state
+ *  loads memory, and breakpoints and traps are kept.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void cpu_restore_state(void)
+{
+    state_read(&cpu, sizeof(cpu_state_t));
+    state_read(&cc, sizeof(cc));
+    state_read(&cwai_stacked, sizeof(cwai_stacked));
+
+#if (CPU_6309==1)
+    /* Decoded cycle counts depend on the restored native mode
+     */
+    memset(decode_cache, 0, sizeof(decode_cache));
+#endif
+}
+
+/*------------------------------------------------
+ * cpu_get_menmonic()
+ *
+ *  Return a pointer to a constant string representing the
+ *  op-code's mnemonic at the input memory address.
+ *
+ *  param:  Memory address
+ *  return: Pointer to constant mnemonic string
+ */
+const char* cpu_get_menmonic(uint16_t address)
+{
+    return op_code_mnemonic((uint8_t) mem_read(address), (uint8_t) mem_read(address + 1));
+}
+
+/*------------------------------------------------
+ * cpu_get_code_menmonic()
+ *
+ *  Return a pointer to a constant string representing the
+ *  op-code's mnemonic of an instruction's bytes.
+ *
+ *  param:  Pointer to the instruction's first two bytes
+ *  return: Pointer to constant mnemonic string
+ */
+const char* cpu_get_code_menmonic(const uint8_t *code)
+{
+    return op_code_mnemonic(code[0], code[1]);
+}
+
+/*------------------------------------------------
+ * cpu_history()
+ *
+ *  Get an entry of the instruction history, the registers after
+ *  the execution of one of the last CPU_HISTORY instructions.
+ *
+ *  param:  Entry number, 0 for the last executed instruction,
+ *          pointer to entry return variable
+ *  return: 1=entry returned, 0=no such entry
+ */
+int cpu_history(int n, cpu_history_t *entry)
+{
+#if (CPU_HISTORY > 0)
+    if ( n < 0 || n >= CPU_HISTORY || (uint32_t) n >= history_next )
+        return 0;
+
+    *entry = history[(history_next - 1 - n) % CPU_HISTORY];
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#if (CPU_PROFILE==1)
+/*------------------------------------------------
+ * cpu_profile_reset()
+ *
+ *  Clear the execution profile.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void cpu_profile_reset(void)
+{
+    memset(profile_pc, 0, sizeof(profile_pc));
+    memset(profile_first_pc, 0, sizeof(profile_first_pc));
+    memset(profile_op, 0, sizeof(profile_op));
+}
+
+/*------------------------------------------------
+ * cpu_profile_pc()
+ *
+ *  Return the count of instructions executed in a PC bucket of
+ *  CPU_PROFILE_BUCKET_SIZE addresses, and the address of the first
+ *  instruction counted in the bucket.
+ *
+ *  param:  Bucket number 0 to CPU_PROFILE_BUCKETS-1,
+ *          pointer to first instruction address return variable
+ *  return: Instruction count
+ */
+uint32_t cpu_profile_pc(int bucket, uint16_t *first_pc)
+{
+    *first_pc = profile_first_pc[bucket];
+
+    return profile_pc[bucket];
+}
+
+/*------------------------------------------------
+ * cpu_profile_op()
+ *
+ *  Return the count of instructions executed for a machine_code[] entry,
+ *  with the entry's op-code and mnemonic. Op-codes of the 0x10 and 0x11
+ *  pages are returned with their prefix in the high byte.
+ *
+ *  param:  Entry index, pointers to count, op-code and mnemonic return variables
+ *  return: 1=entry returned, 0=index past the end of machine_code[]
+ */
+int cpu_profile_op(int index, uint32_t *count, uint16_t *op_code, const char **mnemonic)
+{
+    if ( index < 0 || index >= (int)(sizeof(machine_code)/sizeof(machine_code_t)) )
+        return 0;
+
+    *count = profile_op[index];
+    *mnemonic = machine_code[index].mnem;
+
+#if (CPU_6309==1)
+    if ( index >= OP_CODE6309_11 )
+        *op_code = 0x1100 | machine_code[index].op;
+    else if ( index >= OP_CODE6309_10 )
+        *op_code = 0x1000 | machine_code[index].op;
+    else if ( index >= OP_CODE6309 )
+        *op_code = machine_code[index].op;
+    else
+#endif
+    if ( index >= OP_CODE11 )
+        *op_code = 0x1100 | machine_code[index].op;
+    else if ( index >= OP_CODE10 )
+        *op_code = 0x1000 | machine_code[index].op;
+    else
+        *op_code = machine_code[index].op;
+
+    return 1;
+}
+#endif
+
+/*------------------------------------------------
+ * adc()
+ *
+ *  Add with carry.
+ *
+ *  acc+byte+carry
+ */
+static uint8_t adc(uint8_t acc, uint8_t byte)
+{
+    uint16_t result;
+
+    result = (acc + byte + CC_C);
+
+    eval_cc_c(result);
+    eval_cc_z(result);
+    eval_cc_n(result);
+    eval_cc_v(acc, byte, result);
+    eval_cc_h(acc, byte, result);
+
+    return (uint8_t) result;
+}
+
+/*------------------------------------------------
+ * add()
+ *
+ *  Add.
+ *
+ *  acc+byte
+ */
+static uint8_t add(uint8_t acc, uint8_t byte)
+{
+    uint16_t result;
+
+    result = (acc + byte);
+
+    eval_cc_c(result);
+    eval_cc_z(result);
+    eval_cc_n(result);
+    eval_cc_v(acc, byte, result);
+    eval_cc_h(acc, byte, result);
+
+    return (uint8_t) result;
+}
+
+/*------------------------------------------------
+ * addd()
+ *
+ *  Add 16-bit operand to Acc-D
+ *
+ *  acc+word
+ */
+static void addd(uint16_t word)
+{
+    uint16_t acc;
+    uint32_t result;
+
+    acc = (cpu.a << 8) + cpu.b;
+    result = acc + word;
+
+    cpu.a = result >> 8;
+    cpu.b = result & 0xff;
+
+    eval_cc_c16(result);
+    eval_cc_z16(result);
+    eval_cc_v16(acc, word, result);
+    eval_cc_n16(result);
+}
+
+/*------------------------------------------------
+ * and()
+ *
+ *  Logical AND accumulator with byte operand.
+ *
+ */
+static uint8_t and(uint8_t acc, uint8_t byte)
+{
+    uint8_t result;
+
+    result = (acc & byte);
+
+    eval_cc_z((uint16_t) result);
+    eval_cc_n((uint16_t) result);
+    cc.v_src = 0;
+
+    return result;
+}
+
+/*------------------------------------------------
+ * andcc()
+ *
+ *  Logical AND condition-code register with operand.
+ *
+ */
+static void andcc(uint8_t byte)
+{
+    uint8_t temp_cc;
+
+    temp_cc = get_cc();
+    temp_cc &= byte;
+    set_cc(temp_cc);
+}
+
+/*------------------------------------------------
+ * asl()
+ *
+ *  Arithmetic shift left.
+ *
+ *  'byte' shift left, MSB into carry flag.
+ */
+static uint8_t asl(uint8_t byte)
+{
+    uint16_t result;
+
+    result = ((uint16_t) byte) << 1;
+
+    eval_cc_c(result);
+    eval_cc_z(result);
+    eval_cc_n(result);
+    eval_cc_v(byte, byte, result);
+
+    return (uint8_t) result;
+}
+
+/*------------------------------------------------
+ * asr()
+ *
+ *  Arithmetic shift right.
+ *
+ *  'byte' shift right, MSB replicated b7, LSB into carry flag.
+ */
+static uint8_t asr(uint8_t byte)
+{
+    uint8_t result;
+
+    result = (byte >> 1) | (byte & 0x80);
+
+    cc.c_src = (byte & 0x01) << 8;
+    eval_cc_z((uint16_t) result);
+    eval_cc_n((uint16_t) result);
+
+    return result;
+}
+
+/*------------------------------------------------
+ * bit()
+ *
+ *  Bit test accumulator with operand by AND
+ *  without changing accumulator.
+ *  Change flag bit appropriately.
+ *
+ *  acc AND byte
+ */
+static void bit(uint8_t acc, uint8_t byte)
+{
+    uint8_t result;
+
+    result = acc & byte;
+
+    eval_cc_z((uint16_t) result);
+    eval_cc_n((uint16_t) result);
+    cc.v_src = 0;
+}
+
+/*------------------------------------------------
+ * clr()
+ *
+ *  Clear (zero) bits in operand.
+ *  Change flag bit appropriately.
+ *
+ */
+static uint8_t clr(void)
+{
+    cc.c_src = 0;
+    cc.v_src = 0;
+    cc.z_src = CC_Z_SET;
+    cc.n_src = 0;
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * cmp()
+ *
+ *  Compare 'arg' to 'byte' by subtracting
+ *  the byte from the argument and updating the
+ *  flags.
+ *
+ */
+static void cmp(uint8_t arg, uint8_t byte)
+{
+    uint16_t result;
+
+    result = arg - byte;
+
+    eval_cc_c(result);
+    eval_cc_z(result);
+    eval_cc_n(result);
+    eval_cc_v(arg, ~byte, result);
+}
+
+/*------------------------------------------------
+ * cmp16()
+ *
+ *  Compare 'arg' to 'word' by subtracting
+ *  the a 16-bit value from the argument and updating the
+ *  flags.
+ *
+ */
+static void cmp16(uint16_t arg, uint16_t word)
+{
+    uint32_t result;
+
+    result = arg - word;
+
+    eval_cc_c16(result);
+    eval_cc_z16(result);
+    eval_cc_v16(arg, ~word, result);
+    eval_cc_n16(result);
+}
+
+/*------------------------------------------------
+ * com()
+ *
+ *  Complement (bit-wise NOT) a byte.
+ *
+ *  ~byte
+ */
+static uint8_t com(uint8_t byte)
+{
+    uint8_t result;
+
+    result = ~byte;
 
-    /* Preserves for other uses such as
-     * single step etc.
-     */
-    cpu.last_opcode_bytes = bytes;
-    cpu.last_opcode_cycles = cycles;
-    cpu.cc = get_cc();
+    cc.c_src = CC_C_SET;
+    cc.v_src = 0;
+    eval_cc_z((uint16_t) result);
+    eval_cc_n((uint16_t) result);
 
-    return cpu.cpu_state;
+    return result;
 }
 
 /*------------------------------------------------
- * cpu_get_state()
+ * cwai()
  *
- *  Get the state of the CPU.
+ *  This instruction logically ANDs the contents of the Condition Codes register with the 8-
+ *  bit value specified by the immediate operand. The result is placed back into the
+ *  Condition Codes register. The E flag in the CC register is then set and the entire machine
+ *  state is pushed onto the hardware stack (S). The CPU then halts execution and waits for
+ *  an unmasked interrupt to occur. When such an interrupt occurs, the CPU resumes
+ *  execution at the address obtained from the corresponding interrupt vector.
  *
- *  param:  Pointer to CPU state data structure
- *  return: CPU running state
  */
-cpu_run_state_t cpu_get_state(cpu_state_t* cpu_state)
+static void cwai(uint8_t byte)
 {
-    memcpy(cpu_state, &cpu, sizeof(cpu_state_t));
+    uint8_t temp_cc;
 
-    return cpu.cpu_state;
+    temp_cc = get_cc();
+    temp_cc &= byte;
+    temp_cc |= 0x80;
+    set_cc(temp_cc);
+
+    push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, temp_cc);
+
+    cwai_stacked = 1;
+    cpu.cpu_state = CPU_SYNC;
 }
 
 /*------------------------------------------------
- * cpu_get_menmonic()
+ * daa()
  *
- *  Return a pointer to a constant string representing the
- *  op-code's mnemonic at the input memory address.
+ *  Decimal adjust accumulator A
  *
- *  param:  Memory address
- *  return: Pointer to constant mnemonic string
  */
-const char* cpu_get_menmonic(uint16_t address)
+static void daa(void)
 {
-    int     i, op_code;
-    char   *mnemonic = 0;
+    uint16_t    temp;
+    uint16_t    high_nibble;
+    uint16_t    low_nibble;
 
-    op_code = mem_read(address);
+    temp = cpu.a;
+    high_nibble = temp & 0xf0;
+    low_nibble = temp & 0x0f;
 
-    if ( op_code == 0x10 )
-    {
-        op_code = mem_read(address + 1);
-        for ( i = OP_CODE10; i < OP_CODE11; i++ )
-        {
-            if ( op_code == machine_code[i].op )
-            {
-                mnemonic = machine_code[i].mnem;
-                break;
-            }
-        }
-    }
-    else if ( op_code == 0x11 )
-    {
-        op_code = mem_read(address + 1);
-        for ( i = OP_CODE11; i < sizeof(machine_code)/sizeof(machine_code_t); i++ )
-        {
-            if ( op_code == machine_code[i].op )
-            {
-                mnemonic = machine_code[i].mnem;
-                break;
-            }
-        }
-    }
-    else
-    {
-        mnemonic = machine_code[op_code].mnem;
-    }
+    if ( low_nibble > 0x09 || CC_H )
+        temp += 0x06;
+    if ( high_nibble > 0x80 && low_nibble > 0x09 )
+        temp += 0x60;
+    if (high_nibble > 0x90 || CC_C)
+        temp += 0x60;
 
-    return mnemonic;
+    cpu.a = temp;
+
+    eval_cc_c(temp);
+    eval_cc_z(temp);
+    eval_cc_n(temp);
+    cc.v_src = 0;
 }
 
 /*------------------------------------------------
- * adc()
+ * dec()
  *
- *  Add with carry.
+ *  Decrement the operand.
  *
- *  acc+byte+carry
+ *  byte = byte - 1
  */
-static uint8_t adc(uint8_t acc, uint8_t byte)
+static uint8_t dec(uint8_t byte)
 {
     uint16_t result;
 
-    result = (acc + byte + cc.c);
+    result = byte - 1;
 
-    eval_cc_c(result);
+    eval_cc_v(byte, 0xfe, result);
     eval_cc_z(result);
     eval_cc_n(result);
-    eval_cc_v(acc, byte, result);
-    eval_cc_h(acc, byte, result);
 
     return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * add()
+ * eor()
  *
- *  Add.
+ *  Exclusive OR accumulator with operand.
  *
- *  acc+byte
+ *  acc ^ byte
  */
-static uint8_t add(uint8_t acc, uint8_t byte)
+static uint8_t eor(uint8_t acc, uint8_t byte)
 {
-    uint16_t result;
+    uint8_t result;
 
-    result = (acc + byte);
+    result = acc ^ byte;
 
-    eval_cc_c(result);
-    eval_cc_z(result);
-    eval_cc_n(result);
-    eval_cc_v(acc, byte, result);
-    eval_cc_h(acc, byte, result);
+    eval_cc_z((uint16_t) result);
+    eval_cc_n((uint16_t) result);
+    cc.v_src = 0;
 
-    return (uint8_t) result;
+    return result;
 }
 
 /*------------------------------------------------
- * addd()
+ * exg()
  *
- *  Add 16-bit operand to Acc-D
+ *  Exchange like-sized registers.
+ *
+ *  NOTE: The function relies on the assembler to not mix
+ *  8-bit registers with 16-bit register, otherwise
+ *  results are unexpected.
+ *  Check: if (((regs ^ (regs << 4)) & 0x80) == 0) {...}
  *
- *  acc+word
  */
-static void addd(uint16_t word)
+static void exg(uint8_t regs)
 {
-    uint16_t acc;
-    uint32_t result;
+    int         src, dst;
+    uint16_t    temp1, temp2;
 
-    acc = (cpu.a << 8) + cpu.b;
-    result = acc + word;
+    src = (int)((regs >> 4) & 0x0f);
+    dst = (int)(regs & 0x0f);
 
-    cpu.a = result >> 8;
-    cpu.b = result & 0xff;
+    temp1 = read_register(src);
+    temp2 = read_register(dst);
 
-    eval_cc_c16(result);
-    eval_cc_z16(result);
-    eval_cc_v16(acc, word, result);
-    eval_cc_n16(result);
+    write_register(dst, temp1);
+    write_register(src, temp2);
 }
 
 /*------------------------------------------------
- * and()
+ * inc()
  *
- *  Logical AND accumulator with byte operand.
+ *  Increment the operand.
  *
+ *  byte = byte + 1
  */
-static uint8_t and(uint8_t acc, uint8_t byte)
+static uint8_t inc(uint8_t byte)
 {
-    uint8_t result;
+    uint16_t result;
 
-    result = (acc & byte);
+    result = byte + 1;
 
-    eval_cc_z((uint16_t) result);
-    eval_cc_n((uint16_t) result);
-    cc.v = CC_FLAG_CLR;
+    eval_cc_v(byte, 1, result);
+    eval_cc_z(result);
+    eval_cc_n(result);
 
-    return result;
+    return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * andcc()
+ * lsr()
  *
- *  Logical AND condition-code register with operand.
+ *  Logic shift right.
  *
+ *  'byte' shift right, MSB replicated with zero, LSB into carry flag.
  */
-static void andcc(uint8_t byte)
+static uint8_t lsr(uint8_t byte)
 {
-    uint8_t temp_cc;
+    uint8_t result;
 
-    temp_cc = get_cc();
-    temp_cc &= byte;
-    set_cc(temp_cc);
+    result = (byte >> 1) & 0x7f;
+
+    cc.c_src = (byte & 0x01) << 8;
+    eval_cc_z((uint16_t) result);
+    cc.n_src = 0;
+
+    return result;
 }
 
 /*------------------------------------------------
- * asl()
+ * neg()
  *
- *  Arithmetic shift left.
+ *  Negate byte.
+ *  Two's complement: ~byte+1
  *
- *  'byte' shift left, MSB into carry flag.
  */
-static uint8_t asl(uint8_t byte)
+static uint8_t neg(uint8_t byte)
 {
     uint16_t result;
 
-    result = ((uint16_t) byte) << 1;
+    result =  0 - byte;
 
     eval_cc_c(result);
     eval_cc_z(result);
     eval_cc_n(result);
-    eval_cc_v(byte, byte, result);
+    eval_cc_v(0, ~byte, result);
 
     return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * asr()
+ * or()
  *
- *  Arithmetic shift right.
+ *  Bit-wise logical OR between 'acc' and 'byte'
  *
- *  'byte' shift right, MSB replicated b7, LSB into carry flag.
  */
-static uint8_t asr(uint8_t byte)
+static uint8_t or(uint8_t acc, uint8_t byte)
 {
     uint8_t result;
 
-    result = (byte >> 1) | (byte & 0x80);
+    result = acc | byte;
 
-    cc.c = byte & 0x01 ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.v_src = 0;
     eval_cc_z((uint16_t) result);
     eval_cc_n((uint16_t) result);
 
@@ -1619,948 +2864,875 @@ static uint8_t asr(uint8_t byte)
 }
 
 /*------------------------------------------------
- * bit()
+ * orcc()
  *
- *  Bit test accumulator with operand by AND
- *  without changing accumulator.
- *  Change flag bit appropriately.
+ *  Logical OR condition-code register with operand.
  *
- *  acc AND byte
  */
-static void bit(uint8_t acc, uint8_t byte)
+static void orcc(uint8_t byte)
 {
-    uint8_t result;
-
-    result = acc & byte;
+    uint8_t temp_cc;
 
-    eval_cc_z((uint16_t) result);
-    eval_cc_n((uint16_t) result);
-    cc.v = CC_FLAG_CLR;
+    temp_cc = get_cc();
+    temp_cc |= byte;
+    set_cc(temp_cc);
 }
 
 /*------------------------------------------------
- * clr()
+ * pshs()
  *
- *  Clear (zero) bits in operand.
- *  Change flag bit appropriately.
+ *  Push registers onto stack S (systems)
+ *  Modifies 's' stack register.
  *
+ *  param:  Push-list operand, and command cycles to update if needed.
+ *  return: Nothing
  */
-static uint8_t clr(void)
+static void pshs(uint8_t push_list, int *cycles)
 {
-    cc.c = CC_FLAG_CLR;
-    cc.v = CC_FLAG_CLR;
-    cc.z = CC_FLAG_SET;
-    cc.n = CC_FLAG_CLR;
-
-    return 0;
+    (*cycles) += 1 + push_registers(&cpu.s, cpu.u, push_list, get_cc());
 }
 
 /*------------------------------------------------
- * cmp()
+ * pshu()
  *
- *  Compare 'arg' to 'byte' by subtracting
- *  the byte from the argument and updating the
- *  flags.
+ *  Push registers onto stack U (user)
+ *  Modifies 'u' stack register.
  *
+ *  param:  Push-list operand, and command cycles to update if needed.
+ *  return: Nothing
  */
-static void cmp(uint8_t arg, uint8_t byte)
+static void pshu(uint8_t push_list, int *cycles)
 {
-    uint16_t result;
-
-    result = arg - byte;
-
-    eval_cc_c(result);
-    eval_cc_z(result);
-    eval_cc_n(result);
-    eval_cc_v(arg, ~byte, result);
+    (*cycles) += 1 + push_registers(&cpu.u, cpu.s, push_list, get_cc());
 }
 
 /*------------------------------------------------
- * cmp16()
+ * puls()
  *
- *  Compare 'arg' to 'word' by subtracting
- *  the a 16-bit value from the argument and updating the
- *  flags.
+ *  Pull registers from stack S (systems)
+ *  Modifies 's' stack register.
  *
+ *  param:  Pull-list operand, and command cycles to update if needed.
+ *  return: Nothing
  */
-static void cmp16(uint16_t arg, uint16_t word)
+static void puls(uint8_t pull_list, int *cycles)
 {
-    uint32_t result;
-
-    result = arg - word;
-
-    eval_cc_c16(result);
-    eval_cc_z16(result);
-    eval_cc_v16(arg, ~word, result);
-    eval_cc_n16(result);
+    (*cycles) += 1 + pull_registers(&cpu.s, &cpu.u, pull_list);
 }
 
 /*------------------------------------------------
- * com()
+ * pulu()
  *
- *  Complement (bit-wise NOT) a byte.
+ *  Pull registers from stack U (user)
+ *  Modifies 'u' stack register.
  *
- *  ~byte
+ *  param:  Pull-list operand, and command cycles to update if needed.
+ *  return: Nothing
  */
-static uint8_t com(uint8_t byte)
+static void pulu(uint8_t pull_list, int *cycles)
 {
-    uint8_t result;
-
-    result = ~byte;
-
-    cc.c = CC_FLAG_SET;
-    cc.v = CC_FLAG_CLR;
-    eval_cc_z((uint16_t) result);
-    eval_cc_n((uint16_t) result);
-
-    return result;
+    (*cycles) += 1 + pull_registers(&cpu.u, &cpu.s, pull_list);
 }
 
 /*------------------------------------------------
- * cwai()
+ * rol()
  *
- *  This instruction logically ANDs the contents of the Condition Codes register with the 8-
- *  bit value specified by the immediate operand. The result is placed back into the
- *  Condition Codes register. The E flag in the CC register is then set and the entire machine
- *  state is pushed onto the hardware stack (S). The CPU then halts execution and waits for
- *  an unmasked interrupt to occur. When such an interrupt occurs, the CPU resumes
- *  execution at the address obtained from the corresponding interrupt vector.
+ *  Rotate left through Carry
  *
  */
-static void cwai(uint8_t byte)
+static uint8_t rol(uint8_t byte)
 {
-    uint8_t temp_cc;
+    uint16_t    result;
 
-    temp_cc = get_cc();
-    temp_cc &= byte;
-    temp_cc |= 0x80;
-    set_cc(temp_cc);
+    result = (byte << 1);
+
+    if ( CC_C )
+        result |= 0x0001;
+    else
+        result &= 0xfffe;
 
-    cpu.s--;
-    mem_write(cpu.s, cpu.pc & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.u & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.u >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.y & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.y >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.x & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.x >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.dp);
-    cpu.s--;
-    mem_write(cpu.s, cpu.b);
-    cpu.s--;
-    mem_write(cpu.s, cpu.a);
-    cpu.s--;
-    mem_write(cpu.s, temp_cc);
+    eval_cc_c(result);
+    eval_cc_v(byte, byte, result);
+    eval_cc_z(result);
+    eval_cc_n(result);
 
-    cpu.cpu_state = CPU_SYNC;
+    return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * daa()
+ * ror()
  *
- *  Decimal adjust accumulator A
+ *  Rotate right through Carry
  *
  */
-static void daa(void)
+static uint8_t ror(uint8_t byte)
 {
-    uint16_t    temp;
-    uint16_t    high_nibble;
-    uint16_t    low_nibble;
+    uint16_t    result;
 
-    temp = cpu.a;
-    high_nibble = temp & 0xf0;
-    low_nibble = temp & 0x0f;
 
-    if ( low_nibble > 0x09 || cc.h )
-        temp += 0x06;
-    if ( high_nibble > 0x80 && low_nibble > 0x09 )
-        temp += 0x60;
-    if (high_nibble > 0x90 || cc.c)
-        temp += 0x60;
+    result = byte;
 
-    cpu.a = temp;
+    if ( CC_C )
+        result |= 0x0100;
+    else
+        result &= 0xfeff;
 
-    eval_cc_c(temp);
-    eval_cc_z(temp);
-    eval_cc_n(temp);
-    cc.v = CC_FLAG_CLR;
+    if ( byte & 0x01 )
+        cc.c_src = CC_C_SET;
+    else
+        cc.c_src = 0;
+
+    result = (result >> 1);
+
+    eval_cc_z(result);
+    eval_cc_n(result);
+
+    return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * dec()
+ * rti()
  *
- *  Decrement the operand.
+ *  Return from interrupt
  *
- *  byte = byte - 1
  */
-static uint8_t dec(uint8_t byte)
+static void rti(int *cycles)
 {
-    uint16_t result;
-
-    result = byte - 1;
-
-    eval_cc_v(byte, 0xfe, result);
-    eval_cc_z(result);
-    eval_cc_n(result);
+    /* Restore CCR
+     */
+    pull_registers(&cpu.s, &cpu.u, PUSH_PULL_CC);
 
-    return (uint8_t) result;
+    /* Restore registers if this is an extended
+     * interrupt frame (IRQ, NMI, SWIx), then restore PC and return
+     */
+    if ( cc.e )
+    {
+        pull_registers(&cpu.s, &cpu.u, (PUSH_PULL_STATE & ~PUSH_PULL_CC));
+        (*cycles) += NATIVE_MODE ? 11 : 9;
+    }
+    else
+    {
+        pull_registers(&cpu.s, &cpu.u, PUSH_PULL_PC);
+    }
 }
 
 /*------------------------------------------------
- * eor()
+ * sbc()
  *
- *  Exclusive OR accumulator with operand.
+ *  Subtract with carry.
  *
- *  acc ^ byte
+ *  acc-byte-carry
  */
-static uint8_t eor(uint8_t acc, uint8_t byte)
+static uint8_t sbc(uint8_t acc, uint8_t byte)
 {
-    uint8_t result;
+    uint16_t result;
 
-    result = acc ^ byte;
+    result = acc - byte - CC_C;
 
-    eval_cc_z((uint16_t) result);
-    eval_cc_n((uint16_t) result);
-    cc.v = CC_FLAG_CLR;
+    eval_cc_c(result);
+    eval_cc_z(result);
+    eval_cc_n(result);
+    eval_cc_v(acc, ~byte, result);
 
-    return result;
+    return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * exg()
- *
- *  Exchange like-sized registers.
+ * sex()
  *
- *  NOTE: The function relies on the assembler to not mix
- *  8-bit registers with 16-bit register, otherwise
- *  results are unexpected.
- *  Check: if (((regs ^ (regs << 4)) & 0x80) == 0) {...}
+ *  Sign extend Acc-B to Acc-A
  *
  */
-static void exg(uint8_t regs)
+static void sex(void)
 {
-    int         src, dst;
-    uint16_t    temp1, temp2;
-
-    src = (int)((regs >> 4) & 0x0f);
-    dst = (int)(regs & 0x0f);
-
-    temp1 = read_register(src);
-    temp2 = read_register(dst);
+    if ( cpu.b & 0x80 )
+        cpu.a = 0xff;
+    else
+        cpu.a = 0;
 
-    write_register(dst, temp1);
-    write_register(src, temp2);
+    cc.v_src = 0;
+    eval_cc_z((uint16_t) cpu.a);
+    eval_cc_n((uint16_t) cpu.a);
 }
 
 /*------------------------------------------------
- * inc()
+ * sub()
  *
- *  Increment the operand.
+ *  Subtract byte from Acc and set flags
  *
- *  byte = byte + 1
  */
-static uint8_t inc(uint8_t byte)
+static uint8_t sub(uint8_t acc, uint8_t byte)
 {
     uint16_t result;
 
-    result = byte + 1;
+    result = acc - byte;
 
-    eval_cc_v(byte, 1, result);
+    eval_cc_c(result);
     eval_cc_z(result);
     eval_cc_n(result);
+    eval_cc_v(acc, ~byte, result);
 
     return (uint8_t) result;
 }
 
 /*------------------------------------------------
- * lsr()
+ * subd()
  *
- *  Logic shift right.
+ *  Subtract word from D accumulator and set flags
+ *  Using 2's complement addition.
  *
- *  'byte' shift right, MSB replicated with zero, LSB into carry flag.
  */
-static uint8_t lsr(uint8_t byte)
+static void subd(uint16_t word)
 {
-    uint8_t result;
+    uint16_t acc;
+    uint32_t result;
 
-    result = (byte >> 1) & 0x7f;
+    acc = (cpu.a << 8) + cpu.b;
+    result = acc - word;
 
-    cc.c = byte & 0x01 ? CC_FLAG_SET : CC_FLAG_CLR;
-    eval_cc_z((uint16_t) result);
-    cc.n = CC_FLAG_CLR;
+    cpu.a = result >> 8;
+    cpu.b = result & 0xff;
 
-    return result;
+    eval_cc_c16(result);
+    eval_cc_z16(result);
+    eval_cc_v16(acc, ~word, result);
+    eval_cc_n16(result);
 }
 
 /*------------------------------------------------
- * neg()
+ * swi()
  *
- *  Negate byte.
- *  Two's complement: ~byte+1
+ *  Software interrupt.
+ *  SWI type is input to the function:
+ *  SWI=1, SWI2=2, SWI3=3
  *
  */
-static uint8_t neg(uint8_t byte)
+static void swi(int swi_id)
 {
-    uint16_t result;
+    cc.e = CC_FLAG_SET;
 
-    result =  0 - byte;
+    push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, get_cc());
 
-    eval_cc_c(result);
-    eval_cc_z(result);
-    eval_cc_n(result);
-    eval_cc_v(0, ~byte, result);
+    switch ( swi_id )
+    {
+        case 1:
+            cc.i = CC_FLAG_SET;
+            cc.f = CC_FLAG_SET;
+            cpu.pc = mem_fetch16(VEC_SWI);
+            break;
 
-    return (uint8_t) result;
+        case 2:
+            cpu.pc = mem_fetch16(VEC_SWI2);
+            break;
+
+        case 3:
+            cpu.pc = mem_fetch16(VEC_SWI3);
+            break;
+
+        default:
+            /* Exception: Illegal SWI type swi()
+             */
+            cpu.cpu_state = CPU_EXCEPTION;
+            cpu.exception_line_num = __LINE__;
+    }
 }
 
 /*------------------------------------------------
- * or()
+ * tfr()
  *
- *  Bit-wise logical OR between 'acc' and 'byte'
+ *  Transfer value from source register to destination register
+ *
+ *  NOTE: The function relies on the assembler to not mix
+ *  8-bit registers with 16-bit register, otherwise
+ *  results are unexpected.
+ *  Check: if (((regs ^ (regs << 4)) & 0x80) == 0) {...}
  *
  */
-static uint8_t or(uint8_t acc, uint8_t byte)
+static void tfr(uint8_t regs)
 {
-    uint8_t result;
-
-    result = acc | byte;
+    int         src, dst;
+    uint16_t    temp1;
 
-    cc.v = CC_FLAG_CLR;
-    eval_cc_z((uint16_t) result);
-    eval_cc_n((uint16_t) result);
+    src = (int)((regs >> 4) & 0x0f);
+    dst = (int)(regs & 0x0f);
 
-    return result;
+    temp1 = read_register(src);
+    write_register(dst, temp1);
 }
 
 /*------------------------------------------------
- * orcc()
+ * tst()
  *
- *  Logical OR condition-code register with operand.
+ *  Test 8 bit operand and set V,Z,N flags.
  *
  */
-static void orcc(uint8_t byte)
+static void tst(uint8_t byte)
 {
-    uint8_t temp_cc;
-
-    temp_cc = get_cc();
-    temp_cc |= byte;
-    set_cc(temp_cc);
+    eval_cc_z((uint16_t) byte);
+    eval_cc_n((uint16_t) byte);
+    cc.v_src = 0;
 }
 
+#if (CPU_6309==1)
 /*------------------------------------------------
- * pshs()
+ * add16()
  *
- *  Push registers onto stack S (systems)
- *  Modifies 's' stack register.
+ *  Add a 16-bit operand, and optionally the carry,
+ *  to a 16-bit accumulator and set flags.
  *
- *  param:  Push-list operand, and command cycles to update if needed.
- *  return: Nothing
+ *  acc+word+carry
  */
-static void pshs(uint8_t push_list, int *cycles)
+static uint16_t add16(uint16_t acc, uint16_t word, int carry)
 {
-    (*cycles)++;
-
-    if ( push_list & 0x80 )
-    {
-        (*cycles)++;
-        cpu.s--;
-        mem_write(cpu.s, cpu.pc & 0xff);
-        cpu.s--;
-        mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-    }
-
-    if ( push_list & 0x40 )
-    {
-        (*cycles)++;
-        cpu.s--;
-        mem_write(cpu.s, cpu.u & 0xff);
-        cpu.s--;
-        mem_write(cpu.s, (cpu.u >> 8) & 0xff);
-    }
-
-    if ( push_list & 0x20 )
-    {
-        (*cycles)++;
-        cpu.s--;
-        mem_write(cpu.s, cpu.y & 0xff);
-        cpu.s--;
-        mem_write(cpu.s, (cpu.y >> 8) & 0xff);
-    }
-
-    if ( push_list & 0x10 )
-    {
-        (*cycles)++;
-        cpu.s--;
-        mem_write(cpu.s, cpu.x & 0xff);
-        cpu.s--;
-        mem_write(cpu.s, (cpu.x >> 8) & 0xff);
-    }
-
-    if ( push_list & 0x08 )
-    {
-        cpu.s--;
-        mem_write(cpu.s, cpu.dp);
-    }
+    uint32_t result;
 
-    if ( push_list & 0x04 )
-    {
-        cpu.s--;
-        mem_write(cpu.s, cpu.b);
-    }
+    result = acc + word + carry;
 
-    if ( push_list & 0x02 )
-    {
-        cpu.s--;
-        mem_write(cpu.s, cpu.a);
-    }
+    eval_cc_c16(result);
+    eval_cc_z16(result);
+    eval_cc_v16(acc, word, result);
+    eval_cc_n16(result);
 
-    if ( push_list & 0x01 )
-    {
-        cpu.s--;
-        mem_write(cpu.s, (int) get_cc());
-    }
+    return (uint16_t) result;
 }
 
 /*------------------------------------------------
- * pshu()
+ * alu_register()
  *
- *  Push registers onto stack U (user)
- *  Modifies 'u' stack register.
+ *  HD6309 inter-register ADDR, ADCR, SUBR, SBCR, ANDR, ORR, EORR and CMPR.
+ *  The post-byte has the source register in the high nibble and the
+ *  destination in the low nibble, numbered as for EXG and TFR.
+ *  The operation is 8-bit or 16-bit by the size of the destination.
  *
- *  param:  Push-list operand, and command cycles to update if needed.
+ *  param:  Op-code, register post-byte
  *  return: Nothing
  */
-static void pshu(uint8_t push_list, int *cycles)
+static void alu_register(uint8_t op_code, uint8_t regs)
 {
-    (*cycles)++;
-
-    if ( push_list & 0x80 )
-    {
-        (*cycles)++;
-        cpu.u--;
-        mem_write(cpu.u, cpu.pc & 0xff);
-        cpu.u--;
-        mem_write(cpu.u, (cpu.pc >> 8) & 0xff);
-    }
+    int         src, dst;
+    uint16_t    operand, acc, result;
 
-    if ( push_list & 0x40 )
-    {
-        (*cycles)++;
-        cpu.u--;
-        mem_write(cpu.u, cpu.s & 0xff);
-        cpu.u--;
-        mem_write(cpu.u, (cpu.s >> 8) & 0xff);
-    }
+    src = (int)((regs >> 4) & 0x0f);
+    dst = (int)(regs & 0x0f);
 
-    if ( push_list & 0x20 )
-    {
-        (*cycles)++;
-        cpu.u--;
-        mem_write(cpu.u, cpu.y & 0xff);
-        cpu.u--;
-        mem_write(cpu.u, (cpu.y >> 8) & 0xff);
-    }
+    operand = read_register(src);
+    acc = read_register(dst);
 
-    if ( push_list & 0x10 )
+    if ( dst & 0x08 )
     {
-        (*cycles)++;
-        cpu.u--;
-        mem_write(cpu.u, cpu.x & 0xff);
-        cpu.u--;
-        mem_write(cpu.u, (cpu.x >> 8) & 0xff);
-    }
+        switch ( op_code )
+        {
+            case 0x30:
+                result = add((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    if ( push_list & 0x08 )
-    {
-        cpu.u--;
-        mem_write(cpu.u, cpu.dp);
-    }
+            case 0x31:
+                result = adc((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    if ( push_list & 0x04 )
-    {
-        cpu.u--;
-        mem_write(cpu.u, cpu.b);
-    }
+            case 0x32:
+                result = sub((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    if ( push_list & 0x02 )
-    {
-        cpu.u--;
-        mem_write(cpu.u, cpu.a);
-    }
+            case 0x33:
+                result = sbc((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    if ( push_list & 0x01 )
-    {
-        cpu.u--;
-        mem_write(cpu.u, get_cc());
-    }
-}
+            case 0x34:
+                result = and((uint8_t) acc, (uint8_t) operand);
+                break;
 
-/*------------------------------------------------
- * puls()
- *
- *  Pull registers from stack S (systems)
- *  Modifies 's' stack register.
- *
- *  param:  Pull-list operand, and command cycles to update if needed.
- *  return: Nothing
- */
-static void puls(uint8_t pull_list, int *cycles)
-{
-    uint16_t    val;
+            case 0x35:
+                result = or((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    (*cycles)++;
+            case 0x36:
+                result = eor((uint8_t) acc, (uint8_t) operand);
+                break;
 
-    if ( pull_list & 0x01 )
-    {
-        val = mem_read(cpu.s);
-        cpu.s++;
-        set_cc((uint8_t) val);
+            default:
+                cmp((uint8_t) acc, (uint8_t) operand);
+                return;
+        }
     }
-
-    if ( pull_list & 0x02 )
+    else
     {
-        val = mem_read(cpu.s);
-        cpu.s++;
-        cpu.a = val;
-    }
+        switch ( op_code )
+        {
+            case 0x30:
+                result = add16(acc, operand, 0);
+                break;
 
-    if ( pull_list & 0x04 )
-    {
-        val = mem_read(cpu.s);
-        cpu.s++;
-        cpu.b = val;
-    }
+            case 0x31:
+                result = add16(acc, operand, CC_C);
+                break;
 
-    if ( pull_list & 0x08 )
-    {
-        val = mem_read(cpu.s);
-        cpu.s++;
-        cpu.dp = val;
-    }
+            case 0x32:
+                result = sub16(acc, operand, 0);
+                break;
 
-    if ( pull_list & 0x10 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.s) << 8;
-        cpu.s++;
-        val += mem_read(cpu.s);
-        cpu.s++;
-        cpu.x = val;
-    }
+            case 0x33:
+                result = sub16(acc, operand, CC_C);
+                break;
 
-    if ( pull_list & 0x20 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.s) << 8;
-        cpu.s++;
-        val += mem_read(cpu.s);
-        cpu.s++;
-        cpu.y = val;
-    }
+            case 0x34:
+                result = acc & operand;
+                tst16(result);
+                break;
 
-    if ( pull_list & 0x40 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.s) << 8;
-        cpu.s++;
-        val += mem_read(cpu.s);
-        cpu.s++;
-        cpu.u = val;
-    }
+            case 0x35:
+                result = acc | operand;
+                tst16(result);
+                break;
 
-    if ( pull_list & 0x80 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.s) << 8;
-        cpu.s++;
-        val += mem_read(cpu.s);
-        cpu.s++;
-        cpu.pc = val;
+            case 0x36:
+                result = acc ^ operand;
+                tst16(result);
+                break;
+
+            default:
+                cmp16(acc, operand);
+                return;
+        }
     }
+
+    write_register(dst, result);
 }
 
 /*------------------------------------------------
- * pulu()
+ * bit_op()
  *
- *  Pull registers from stack U (user)
- *  Modifies 'u' stack register.
+ *  HD6309 BAND, BIAND, BOR, BIOR, BEOR, BIEOR, LDBT and STBT between a
+ *  bit of CC, A or B and a bit of a direct page memory byte.
+ *  The post-byte holds the register in bits 7-6, the source bit number
+ *  in bits 5-3 and the destination bit number in bits 2-0. The memory bit
+ *  is the source, except for STBT that stores a register bit in memory.
  *
- *  param:  Pull-list operand, and command cycles to update if needed.
+ *  param:  Op-code, bit manipulation post-byte, memory address, pointer to instruction cycles
  *  return: Nothing
  */
-static void pulu(uint8_t pull_list, int *cycles)
+static void bit_op(uint8_t op_code, uint8_t post_byte, uint16_t address, int *cycles)
 {
-    uint16_t    val;
-
-    (*cycles)++;
+    int         reg;
+    uint8_t     src_mask, dst_mask;
+    uint8_t     reg_value, mem_value;
+    int         bit_value;
 
-    if ( pull_list & 0x01 )
+    switch ( post_byte >> 6 )
     {
-        val = mem_read(cpu.u);
-        cpu.u++;
-        set_cc((uint8_t) val);
-    }
+        case 0:
+            reg = 10;
+            break;
 
-    if ( pull_list & 0x02 )
-    {
-        val = mem_read(cpu.u);
-        cpu.u++;
-        cpu.a = val;
-    }
+        case 1:
+            reg = 8;
+            break;
 
-    if ( pull_list & 0x04 )
-    {
-        val = mem_read(cpu.u);
-        cpu.u++;
-        cpu.b = val;
-    }
+        case 2:
+            reg = 9;
+            break;
 
-    if ( pull_list & 0x08 )
-    {
-        val = mem_read(cpu.u);
-        cpu.u++;
-        cpu.dp = val;
+        default:
+            error_trap(MD_ILLEGAL, cycles);
+            return;
     }
 
-    if ( pull_list & 0x10 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.u) << 8;
-        cpu.u++;
-        val += mem_read(cpu.u);
-        cpu.u++;
-        cpu.x = val;
-    }
+    src_mask = 1 << ((post_byte >> 3) & 0x07);
+    dst_mask = 1 << (post_byte & 0x07);
 
-    if ( pull_list & 0x20 )
-    {
-        (*cycles)++;
-        val = mem_read(cpu.u) << 8;
-        cpu.u++;
-        val += mem_read(cpu.u);
-        cpu.u++;
-        cpu.y = val;
-    }
+    reg_value = (uint8_t) read_register(reg);
+    mem_value = (uint8_t) mem_read(address);
 
-    if ( pull_list & 0x40 )
+    if ( op_code == 0x37 )
     {
-        (*cycles)++;
-        val = mem_read(cpu.u) << 8;
-        cpu.u++;
-        val += mem_read(cpu.u);
-        cpu.u++;
-        cpu.s = val;
+        if ( reg_value & src_mask )
+            mem_value |= dst_mask;
+        else
+            mem_value &= ~dst_mask;
+
+        mem_write(address, mem_value);
+        return;
     }
 
-    if ( pull_list & 0x80 )
+    bit_value = ((mem_value & src_mask) != 0);
+
+    switch ( op_code )
     {
-        (*cycles)++;
-        val = mem_read(cpu.u) << 8;
-        cpu.u++;
-        val += mem_read(cpu.u);
-        cpu.u++;
-        cpu.pc = val;
-    }
-}
+        case 0x30:  // BAND
+            bit_value = bit_value && (reg_value & dst_mask);
+            break;
 
-/*------------------------------------------------
- * rol()
- *
- *  Rotate left through Carry
- *
- */
-static uint8_t rol(uint8_t byte)
-{
-    uint16_t    result;
+        case 0x31:  // BIAND
+            bit_value = !bit_value && (reg_value & dst_mask);
+            break;
 
-    result = (byte << 1);
+        case 0x32:  // BOR
+            bit_value = bit_value || (reg_value & dst_mask);
+            break;
 
-    if ( cc.c )
-        result |= 0x0001;
-    else
-        result &= 0xfffe;
+        case 0x33:  // BIOR
+            bit_value = !bit_value || (reg_value & dst_mask);
+            break;
 
-    eval_cc_c(result);
-    eval_cc_v(byte, byte, result);
-    eval_cc_z(result);
-    eval_cc_n(result);
+        case 0x34:  // BEOR
+            bit_value = bit_value ^ ((reg_value & dst_mask) != 0);
+            break;
 
-    return (uint8_t) result;
+        case 0x35:  // BIEOR
+            bit_value = !bit_value ^ ((reg_value & dst_mask) != 0);
+            break;
+
+        default:    // LDBT
+            break;
+    }
+
+    if ( bit_value )
+        reg_value |= dst_mask;
+    else
+        reg_value &= ~dst_mask;
+
+    write_register(reg, reg_value);
 }
 
 /*------------------------------------------------
- * ror()
+ * divd()
  *
- *  Rotate right through Carry
+ *  HD6309 signed division of D by an 8-bit operand.
+ *  The quotient is in B and the remainder in A. A quotient that only
+ *  fits 9 bits is stored truncated with V set, and a larger
+ *  quotient aborts the division with V set and D unchanged.
  *
+ *  param:  Non-zero divisor
+ *  return: Nothing
  */
-static uint8_t ror(uint8_t byte)
+static void divd(uint8_t byte)
 {
-    uint16_t    result;
-
+    int     quotient, remainder;
 
-    result = byte;
-
-    if ( cc.c )
-        result |= 0x0100;
-    else
-        result &= 0xfeff;
-
-    if ( byte & 0x01 )
-        cc.c = CC_FLAG_SET;
-    else
-        cc.c = CC_FLAG_CLR;
+    quotient = (int16_t) d / (int8_t) byte;
+    remainder = (int16_t) d % (int8_t) byte;
 
-    result = (result >> 1);
+    if ( quotient < -256 || quotient > 255 )
+    {
+        cc.v_src = CC_V_SET;
+        cc.n_src = 0;
+        cc.z_src = CC_Z_CLR;
+        cc.c_src = 0;
+        return;
+    }
 
-    eval_cc_z(result);
-    eval_cc_n(result);
+    cpu.a = (uint8_t) remainder;
+    cpu.b = (uint8_t) quotient;
 
-    return (uint8_t) result;
+    cc.v_src = (quotient < -128 || quotient > 127) ? CC_V_SET : 0;
+    cc.c_src = (quotient & 0x01) ? CC_C_SET : 0;
+    eval_cc_z((uint16_t) cpu.b);
+    eval_cc_n((uint16_t) cpu.b);
 }
 
 /*------------------------------------------------
- * rti()
+ * divq()
  *
- *  Return from interrupt
+ *  HD6309 signed division of Q by a 16-bit operand.
+ *  The quotient is in W and the remainder in D. A quotient that only
+ *  fits 17 bits is stored truncated with V set, and a larger
+ *  quotient aborts the division with V set and Q unchanged.
  *
+ *  param:  Non-zero divisor
+ *  return: Nothing
  */
-static void rti(int *cycles)
+static void divq(uint16_t word)
 {
-    uint8_t byte;
+    int64_t     quotient, remainder;
 
-    /* Restore CCR
+    /* 64-bit, so that 0x80000000 divided by -1 is an overflow abort
+     * and not a host division overflow
      */
-    byte = mem_read(cpu.s);
-    cpu.s++;
-    set_cc(byte);
+    quotient = (int64_t)(int32_t) q / (int16_t) word;
+    remainder = (int64_t)(int32_t) q % (int16_t) word;
 
-    /* Restore registers if this is an extended
-     * interrupt frame (IRQ, NMI, SWIx)
-     */
-    if ( cc.e )
+    if ( quotient < -65536 || quotient > 65535 )
     {
-        cpu.a = mem_read(cpu.s);
-        cpu.s++;
-        cpu.b = mem_read(cpu.s);
-        cpu.s++;
-        cpu.dp = mem_read(cpu.s);
-        cpu.s++;
-        cpu.x = mem_read(cpu.s) << 8;
-        cpu.s++;
-        cpu.x += mem_read(cpu.s);
-        cpu.s++;
-        cpu.y = mem_read(cpu.s) << 8;
-        cpu.s++;
-        cpu.y += mem_read(cpu.s);
-        cpu.s++;
-        cpu.u = mem_read(cpu.s) << 8;
-        cpu.s++;
-        cpu.u += mem_read(cpu.s);
-        cpu.s++;
-
-        (*cycles) += 9;
+        cc.v_src = CC_V_SET;
+        cc.n_src = 0;
+        cc.z_src = CC_Z_CLR;
+        cc.c_src = 0;
+        return;
     }
 
-    /* Restore PC and return
-     */
-    byte = mem_read(cpu.s);
-    cpu.s++;
-    cpu.pc = (uint16_t) byte << 8;
+    cpu.a = GET_REG_HIGH((uint16_t) remainder);
+    cpu.b = GET_REG_LOW((uint16_t) remainder);
+    cpu.e = GET_REG_HIGH((uint16_t) quotient);
+    cpu.f = GET_REG_LOW((uint16_t) quotient);
 
-    byte = mem_read(cpu.s);
-    cpu.s++;
-    cpu.pc += (uint16_t) byte;
+    cc.v_src = (quotient < -32768 || quotient > 32767) ? CC_V_SET : 0;
+    cc.c_src = (quotient & 0x01) ? CC_C_SET : 0;
+    eval_cc_z16(w);
+    eval_cc_n16(w);
 }
 
 /*------------------------------------------------
- * sbc()
+ * inherent16()
  *
- *  Subtract with carry.
+ *  HD6309 16-bit inherent operations on D or W, selected by the
+ *  low nibble of the op-code as in the 8-bit A and B op-codes.
  *
- *  acc-byte-carry
+ *  param:  Op-code, accumulator value
+ *  return: Result
  */
-static uint8_t sbc(uint8_t acc, uint8_t byte)
+static uint16_t inherent16(uint8_t op_code, uint16_t word)
 {
-    uint16_t result;
+    uint32_t result;
 
-    result = acc - byte - cc.c;
+    switch ( op_code & 0x0f )
+    {
+        case 0x00:  // NEG
+            result = 0 - word;
+            eval_cc_c16(result);
+            eval_cc_v16(0, ~word, result);
+            break;
 
-    eval_cc_c(result);
-    eval_cc_z(result);
-    eval_cc_n(result);
-    eval_cc_v(acc, ~byte, result);
+        case 0x03:  // COM
+            result = (uint16_t) ~word;
+            cc.c_src = CC_C_SET;
+            cc.v_src = 0;
+            break;
 
-    return (uint8_t) result;
+        case 0x04:  // LSR
+            result = word >> 1;
+            cc.c_src = (word & 0x0001) << 8;
+            break;
+
+        case 0x06:  // ROR
+            result = (word >> 1) | (CC_C << 15);
+            cc.c_src = (word & 0x0001) << 8;
+            break;
+
+        case 0x07:  // ASR
+            result = (word >> 1) | (word & 0x8000);
+            cc.c_src = (word & 0x0001) << 8;
+            break;
+
+        case 0x08:  // ASL
+            result = word << 1;
+            eval_cc_c16(result);
+            eval_cc_v16(word, word, result);
+            break;
+
+        case 0x09:  // ROL
+            result = (word << 1) | CC_C;
+            eval_cc_c16(result);
+            eval_cc_v16(word, word, result);
+            break;
+
+        case 0x0a:  // DEC
+            result = word - 1;
+            eval_cc_v16(word, 0xfffe, result);
+            break;
+
+        case 0x0c:  // INC
+            result = word + 1;
+            eval_cc_v16(word, 1, result);
+            break;
+
+        case 0x0d:  // TST
+            result = word;
+            cc.v_src = 0;
+            break;
+
+        default:    // CLR
+            result = 0;
+            cc.c_src = 0;
+            cc.v_src = 0;
+            break;
+    }
+
+    eval_cc_z16(result);
+    eval_cc_n16(result);
+
+    return (uint16_t) result;
 }
 
 /*------------------------------------------------
- * sex()
+ * ldq()
  *
- *  Sign extend Acc-B to Acc-A
- *
- */
-static void sex(void)
-{
-    if ( cpu.b & 0x80 )
-        cpu.a = 0xff;
-    else
-        cpu.a = 0;
-
-    cc.v = CC_FLAG_CLR;
-    eval_cc_z((uint16_t) cpu.a);
-    eval_cc_n((uint16_t) cpu.a);
+ *  Load the HD6309 Q accumulator and set flags,
+ *  also sets the flags of STQ after the store.
+ *
+ *  param:  32-bit value
+ *  return: Nothing
+ */
+static void ldq(uint32_t quad)
+{
+    cpu.a = (uint8_t)(quad >> 24);
+    cpu.b = (uint8_t)(quad >> 16);
+    cpu.e = (uint8_t)(quad >> 8);
+    cpu.f = (uint8_t) quad;
+
+    cc.z_src = quad ? CC_Z_CLR : CC_Z_SET;
+    cc.n_src = quad >> 24;
+    cc.v_src = 0;
 }
 
 /*------------------------------------------------
- * sub()
+ * muld()
  *
- *  Subtract byte from Acc and set flags
+ *  HD6309 signed multiply of D by a 16-bit operand into Q.
  *
+ *  param:  Multiplier
+ *  return: Nothing
  */
-static uint8_t sub(uint8_t acc, uint8_t byte)
+static void muld(uint16_t word)
 {
-    uint16_t result;
-
-    result = acc - byte;
+    uint32_t    result;
 
-    eval_cc_c(result);
-    eval_cc_z(result);
-    eval_cc_n(result);
-    eval_cc_v(acc, ~byte, result);
+    result = (uint32_t)((int32_t)(int16_t) d * (int16_t) word);
 
-    return (uint8_t) result;
+    ldq(result);
+    cc.c_src = 0;
 }
 
 /*------------------------------------------------
- * subd()
+ * sub16()
  *
- *  Subtract word from D accumulator and set flags
- *  Using 2's complement addition.
+ *  Subtract a 16-bit operand, and optionally the carry,
+ *  from a 16-bit accumulator and set flags.
  *
+ *  acc-word-carry
  */
-static void subd(uint16_t word)
+static uint16_t sub16(uint16_t acc, uint16_t word, int carry)
 {
-    uint16_t acc;
     uint32_t result;
 
-    acc = (cpu.a << 8) + cpu.b;
-    result = acc - word;
-
-    cpu.a = result >> 8;
-    cpu.b = result & 0xff;
+    result = acc - word - carry;
 
     eval_cc_c16(result);
     eval_cc_z16(result);
     eval_cc_v16(acc, ~word, result);
     eval_cc_n16(result);
+
+    return (uint16_t) result;
 }
 
 /*------------------------------------------------
- * swi()
+ * tfm()
  *
- *  Software interrupt.
- *  SWI type is input to the function:
- *  SWI=1, SWI2=2, SWI3=3
+ *  HD6309 block move of W bytes between addresses in D, X, Y, U or S.
+ *  One byte is moved per execution, and PC is set back to the instruction
+ *  until W is zero, so that interrupts are serviced during the move
+ *  and the move resumes after the interrupt returns.
  *
+ *  param:  Decoded instruction, pointer to instruction cycles
+ *  return: Nothing
  */
-static void swi(int swi_id)
+static void tfm(const decoded_op_t *op, int *cycles)
 {
-    cc.e = CC_FLAG_SET;
+    int         src, dst;
+    uint8_t     regs;
+    uint16_t    src_addr, dst_addr;
 
-    cpu.s--;
-    mem_write(cpu.s, cpu.pc & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.pc >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.u & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.u >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.y & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.y >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.x & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, (cpu.x >> 8) & 0xff);
-    cpu.s--;
-    mem_write(cpu.s, cpu.dp);
-    cpu.s--;
-    mem_write(cpu.s, cpu.b);
-    cpu.s--;
-    mem_write(cpu.s, cpu.a);
-    cpu.s--;
-    mem_write(cpu.s, get_cc());
+    regs = (uint8_t) mem_read(op->operand);
+    src = (int)((regs >> 4) & 0x0f);
+    dst = (int)(regs & 0x0f);
 
-    switch ( swi_id )
+    if ( src > 4 || dst > 4 )
     {
-        case 1:
-            cc.i = CC_FLAG_SET;
-            cc.f = CC_FLAG_SET;
-            cpu.pc = (mem_read(VEC_SWI) << 8) + mem_read(VEC_SWI+1);
+        error_trap(MD_ILLEGAL, cycles);
+        return;
+    }
+
+    if ( w == 0 )
+        return;
+
+    src_addr = read_register(src);
+    dst_addr = read_register(dst);
+
+    mem_write(dst_addr, mem_read(src_addr));
+
+    switch ( op->op_code )
+    {
+        case 0x38:  // TFM r0+,r1+
+            write_register(src, src_addr + 1);
+            write_register(dst, dst_addr + 1);
             break;
 
-        case 2:
-            cpu.pc = (mem_read(VEC_SWI2) << 8) + mem_read(VEC_SWI2+1);
+        case 0x39:  // TFM r0-,r1-
+            write_register(src, src_addr - 1);
+            write_register(dst, dst_addr - 1);
             break;
 
-        case 3:
-            cpu.pc = (mem_read(VEC_SWI3) << 8) + mem_read(VEC_SWI3+1);
+        case 0x3a:  // TFM r0+,r1
+            write_register(src, src_addr + 1);
             break;
 
-        default:
-            /* Exception: Illegal SWI type swi()
-             */
-            cpu.cpu_state = CPU_EXCEPTION;
-            cpu.exception_line_num = __LINE__;
+        default:    // TFM r0,r1+
+            write_register(dst, dst_addr + 1);
+            break;
     }
+
+    cpu.e = GET_REG_HIGH((uint16_t)(w - 1));
+    cpu.f = GET_REG_LOW((uint16_t)(w - 1));
+
+    cpu.pc = op->pc;
+    *cycles = TFM_BYTE_CYCLES;
 }
 
 /*------------------------------------------------
- * tfr()
+ * tst16()
  *
- *  Transfer value from source register to destination register
+ *  Test a 16-bit result and set V,Z,N flags.
  *
- *  NOTE: The function relies on the assembler to not mix
- *  8-bit registers with 16-bit register, otherwise
- *  results are unexpected.
- *  Check: if (((regs ^ (regs << 4)) & 0x80) == 0) {...}
+ */
+static void tst16(uint16_t word)
+{
+    eval_cc_z16(word);
+    eval_cc_n16(word);
+    cc.v_src = 0;
+}
+
+/*------------------------------------------------
+ * error_trap()
  *
+ *  HD6309 illegal op-code and division by zero trap.
+ *  Records the error in MD, pushes the entire machine state
+ *  and continues at the trap vector.
+ *
+ *  param:  MD error bit, pointer to instruction cycles
+ *  return: Nothing
  */
-static void tfr(uint8_t regs)
+static void error_trap(uint8_t md_bit, int *cycles)
 {
-    int         src, dst;
-    uint16_t    temp1;
+    cpu.md |= md_bit;
 
-    src = (int)((regs >> 4) & 0x0f);
-    dst = (int)(regs & 0x0f);
+    cc.e = CC_FLAG_SET;
+    push_registers(&cpu.s, cpu.u, PUSH_PULL_STATE, get_cc());
 
-    temp1 = read_register(src);
-    write_register(dst, temp1);
+    cc.i = CC_FLAG_SET;
+    cc.f = CC_FLAG_SET;
+
+    cpu.pc = mem_fetch16(VEC_RESERVED);
+
+    (*cycles) += NATIVE_MODE ? 22 : 20;
 }
 
 /*------------------------------------------------
- * tst()
+ * set_md()
  *
- *  Test 8 bit operand and set V,Z,N flags.
+ *  Set the HD6309 mode register. Decoded instructions hold
+ *  the cycle counts of a mode, so they are discarded
+ *  when native mode is switched on or off.
  *
+ *  param:  MD value
+ *  return: Nothing
  */
-static void tst(uint8_t byte)
+static void set_md(uint8_t value)
 {
-    eval_cc_z((uint16_t) byte);
-    eval_cc_n((uint16_t) byte);
-    cc.v = CC_FLAG_CLR;
+    if ( (value ^ cpu.md) & MD_NATIVE )
+        memset(decode_cache, 0, sizeof(decode_cache));
+
+    cpu.md = value;
 }
+#endif
 
 /*------------------------------------------------
  * branch()
@@ -2587,170 +3759,456 @@ static void branch(int instruction, int long_short, uint16_t effective_address,
         /* BHI / LBHI
          */
         case 0x22:
-            if ( cc.c == CC_FLAG_CLR && cc.z == CC_FLAG_CLR )
+            if ( CC_C == CC_FLAG_CLR && CC_Z == CC_FLAG_CLR )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BLS / LBLS
          */
         case 0x23:
-            if ( cc.c == CC_FLAG_SET || cc.z == CC_FLAG_SET )
+            if ( CC_C == CC_FLAG_SET || CC_Z == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BHS / LBHS / BCC / LBCC
          */
         case 0x24:
-            if ( cc.c == CC_FLAG_CLR )
+            if ( CC_C == CC_FLAG_CLR )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BLO / LBLO / BCS / LBCS
          */
         case 0x25:
-            if ( cc.c == CC_FLAG_SET )
+            if ( CC_C == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BNE / LBNE
          */
         case 0x26:
-            if ( cc.z == CC_FLAG_CLR )
+            if ( CC_Z == CC_FLAG_CLR )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BEQ / LBEQ
          */
         case 0x27:
-            if ( cc.z == CC_FLAG_SET )
+            if ( CC_Z == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BVC / LBVC
          */
         case 0x28:
-            if ( cc.v == CC_FLAG_CLR )
+            if ( CC_V == CC_FLAG_CLR )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BVS / LBVS
          */
         case 0x29:
-            if ( cc.v == CC_FLAG_SET )
+            if ( CC_V == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BPL / LBPL
          */
         case 0x2a:
-            if ( cc.n == CC_FLAG_CLR )
+            if ( CC_N == CC_FLAG_CLR )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BMI / LBMI
          */
         case 0x2b:
-            if ( cc.n == CC_FLAG_SET )
+            if ( CC_N == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BGE / LBGE
          */
         case 0x2c:
-            if ( cc.n == cc.v )
+            if ( CC_N == CC_V )
                 do_branch(long_short, effective_address, cycles);
             break;
 
         /* BLT / LBLT
          */
         case 0x2d:
-            if ( cc.n != cc.v )
+            if ( CC_N != CC_V )
+                do_branch(long_short, effective_address, cycles);
+            break;
+
+        /* BGT / LBGT
+         */
+        case 0x2e:
+            if ( CC_N == CC_V && CC_Z == CC_FLAG_CLR )
+                do_branch(long_short, effective_address, cycles);
+            break;
+
+        /* BLE / LBLE
+         */
+        case 0x2f:
+            if ( CC_N != CC_V || CC_Z == CC_FLAG_SET )
                 do_branch(long_short, effective_address, cycles);
             break;
 
-        /* BGT / LBGT
-         */
-        case 0x2e:
-            if ( cc.n == cc.v && cc.z == CC_FLAG_CLR )
-                do_branch(long_short, effective_address, cycles);
+        /* Exception: Illegal branch code branch()
+         *
+         * There should be no exception here because this function is always
+         * called from within a switch/case for a valid opcode range.
+         */
+        default:
+            cpu.cpu_state = CPU_EXCEPTION;
+            cpu.exception_line_num = __LINE__;
+    }
+}
+
+/*------------------------------------------------
+ * do_branch()
+ *
+ *  Helper function to do the actual branch
+ *  by stacking the PC and changing to the target address.
+ *
+ *  param:  Long ('1') or short ('0') branch, 16-bit sign-extended offset,
+ *          pointer to opcode cycles.
+ *  return: Nothing
+ */
+static void do_branch(int long_short, uint16_t effective_address, int *cycles)
+{
+    cpu.pc = effective_address;
+    (*cycles) += long_short;
+}
+
+/*------------------------------------------------
+ * get_decoded_op()
+ *
+ *  Decode the instruction at PC.
+ *  Instructions executing from ROM are decoded once into the
+ *  decode cache. Other instructions are decoded into the buffer
+ *  provided by the caller on every execution.
+ *
+ *  param:  Pointer to a decode buffer
+ *  return: Pointer to the decoded instruction
+ */
+static decoded_op_t *get_decoded_op(decoded_op_t *op_buffer)
+{
+    decoded_op_t   *op;
+
+    if ( mem_pages[cpu.pc >> MEM_PAGE_SHIFT].page_type != MEM_TYPE_ROM )
+    {
+        decode_op(cpu.pc, op_buffer);
+        return op_buffer;
+    }
+
+    /* Discard all entries if ROM content may have changed
+     */
+    if ( decode_cache_version != mem_rom_version )
+    {
+        memset(decode_cache, 0, sizeof(decode_cache));
+        decode_cache_version = mem_rom_version;
+    }
+
+    op = &decode_cache[cpu.pc & DECODE_CACHE_MASK];
+
+    if ( !op->valid || op->pc != cpu.pc )
+    {
+        decode_op(cpu.pc, op);
+
+        /* Only keep instructions that are entirely in ROM
+         */
+        op->valid = (mem_pages[(uint16_t)(op->next_pc - 1) >> MEM_PAGE_SHIFT].page_type == MEM_TYPE_ROM);
+    }
+
+    return op;
+}
+
+/*------------------------------------------------
+ * decode_op()
+ *
+ *  Decode the op-code, addressing mode and operand bytes of the instruction
+ *  at an address, and account for the cycles and bytes of indexed addressing.
+ *  Decoding does not depend on, or change, CPU registers.
+ *
+ *  param:  Instruction address, pointer to decoded instruction
+ *  return: Nothing
+ */
+static void decode_op(uint16_t address, decoded_op_t *op)
+{
+    int         op_code_index;
+    uint16_t    pc;
+    uint16_t    operand = 0;
+    uint8_t     post_byte = 0;
+    int         cycles;
+    int         bytes;
+
+    pc = address;
+
+    op->pc = address;
+    op->prefix = 0;
+    op->op_code = mem_fetch8(pc);
+    pc++;
+
+    /* Look up 0x10 and 0x11 double byte op-codes. If not found
+     * then the index points to an illegal op-code.
+     */
+    if ( op->op_code == 0x10 || op->op_code == 0x11 )
+    {
+        op->prefix = op->op_code;
+        op->op_code = mem_fetch8(pc);
+        pc++;
+
+        if ( op->prefix == 0x10 )
+            op_code_index = op_code_page10[op->op_code];
+        else
+            op_code_index = op_code_page11[op->op_code];
+    }
+    else
+    {
+        op_code_index = PAGE0_INDEX(op->op_code);
+    }
+
+    op->mode = machine_code[op_code_index].mode;
+    cycles = NATIVE_MODE ? machine_code[op_code_index].cycles_native : machine_code[op_code_index].cycles;
+    bytes = machine_code[op_code_index].bytes;
+
+#if (CPU_6309==1)
+    /* The HD6309 immediate byte, or bit manipulation post-byte,
+     * comes before the direct, indexed or extended address bytes
+     */
+    if ( op->mode == ADDR_IMM_DIR || op->mode == ADDR_IMM_IDX || op->mode == ADDR_IMM_EXT )
+    {
+        op->data = mem_fetch8(pc);
+        pc++;
+
+        if ( op->mode == ADDR_IMM_DIR )
+            op->mode = ADDR_DIRECT;
+        else if ( op->mode == ADDR_IMM_IDX )
+            op->mode = ADDR_INDEXED;
+        else
+            op->mode = ADDR_EXTENDED;
+    }
+#endif
+
+    switch ( op->mode )
+    {
+        case ADDR_DIRECT:
+            operand = mem_fetch8(pc);
+            pc++;
+            break;
+
+        case ADDR_RELATIVE:
+            operand = SIG_EXTEND(mem_fetch8(pc));
+            pc++;
+            operand += pc;
+            break;
+
+        case ADDR_LRELATIVE:
+            operand = mem_fetch16(pc);
+            pc += 2;
+            operand += pc;
+            break;
+
+        case ADDR_INDEXED:
+            post_byte = mem_fetch8(pc);
+            pc++;
+
+#if (CPU_6309==1)
+            /* HD6309 W register indexing
+             */
+            if ( INDX_POST_W_MODE(post_byte) )
+            {
+                switch ( post_byte & INDX_POST_REG )
+                {
+                    case 0x00: // EA = ,W Zero offset
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 3 : 0;
+                        break;
+
+                    case 0x20: // EA = 16-bit,W 16-bit offset
+                        operand = mem_fetch16(pc);
+                        pc += 2;
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 5 : 2;
+                        bytes += 2;
+                        break;
+
+                    case 0x40: // EA = ,W++ Auto post-increment by 2
+                    case 0x60: // EA = ,--W Auto pre-decrement by 2
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 4 : 1;
+                        break;
+                }
+            }
+            else
+#endif
+            /* Check if 5-bit offset is in the post-byte
+             * then process more index address bytes if not.
+             */
+            if ( post_byte & INDX_POST_5BIT_OFF )
+            {
+                switch ( post_byte & INDX_POST_MODE )
+                {
+                    case 0: // EA = ,index+ Auto post-increment by 1
+                    case 2: // EA = ,-index Auto pre-decrement by 1
+                        cycles += NATIVE_MODE ? 1 : 2;
+                        break;
+
+                    case 1: // EA = ,index++ Auto post-increment by 2
+                    case 3: // EA = ,--index Auto pre-decrement by 2
+                        cycles += ((post_byte & INDX_POST_INDIRECT) ? 6 : 3) - (NATIVE_MODE ? 1 : 0);
+                        break;
+
+                    case 4: // EA = 0,index Zero offset
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 3 : 0;
+                        break;
+
+                    case 5: // EA = B,index Acc-B with index
+                    case 6: // EA = A,index Acc-A with index
+#if (CPU_6309==1)
+                    case 7: // EA = E,index Acc-E with index
+                    case 10: // EA = F,index Acc-F with index
+#endif
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 4 : 1;
+                        break;
+
+                    case 8: // EA = 8-bit,index 8-bit offset
+                        operand = SIG_EXTEND(mem_fetch8(pc));
+                        pc++;
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 4 : 1;
+                        bytes += 1;
+                        break;
+
+                    case 9: // EA = 16-bit,index 16-bit offset
+                        operand = mem_fetch16(pc);
+                        pc += 2;
+                        cycles += ((post_byte & INDX_POST_INDIRECT) ? 7 : 4) - (NATIVE_MODE ? 1 : 0);
+                        bytes += 2;
+                        break;
+
+                    case 11: // EA = D,index Acc-D with index
+                        cycles += ((post_byte & INDX_POST_INDIRECT) ? 7 : 4) - (NATIVE_MODE ? 2 : 0);
+                        break;
+
+                    case 12: // EA = 8-bit,pc PC relative
+                        operand = SIG_EXTEND(mem_fetch8(pc));
+                        pc++;
+                        operand += pc;
+                        cycles += (post_byte & INDX_POST_INDIRECT) ? 4 : 1;
+                        bytes += 1;
+                        break;
+
+                    case 13: // EA = 16-bit,pc PC relative
+                        operand = mem_fetch16(pc);
+                        pc += 2;
+                        operand += pc;
+                        cycles += ((post_byte & INDX_POST_INDIRECT) ? 8 : 5) - (NATIVE_MODE ? 2 : 0);
+                        bytes += 2;
+                        break;
+
+#if (CPU_6309==1)
+                    case 14: // EA = W,index Acc-W with index
+                        cycles += ((post_byte & INDX_POST_INDIRECT) ? 7 : 4) - (NATIVE_MODE ? 3 : 0);
+                        break;
+#endif
+
+                    case 15: // EA = [addr] Extended Indirect will always be indirect.
+                        operand = mem_fetch16(pc);
+                        pc += 2;
+                        cycles += NATIVE_MODE ? 4 : 5;
+                        bytes += 2;
+                        break;
+
+                    /* Illegal indexing modes are caught by get_eff_addr()
+                     */
+                }
+            }
+            /* 5-bit offset is in the post-bytes
+             */
+            else
+            {
+                operand = post_byte & 0x001f;
+                if ( operand & 0x0010 )
+                    operand |= 0xfff0;  // Extend the sign of the 5-bit offset into 16-bit
+                cycles++;
+            }
+            break;
+
+        case ADDR_EXTENDED:
+            operand = mem_fetch16(pc);
+            pc += 2;
+            break;
+
+        case ADDR_IMMEDIATE:
+            operand = pc;
+            pc += 1;
+            break;
+
+        case ADDR_LIMMEDIATE:
+            operand = pc;
+            pc += 2;
             break;
 
-        /* BLE / LBLE
-         */
-        case 0x2f:
-            if ( cc.n != cc.v || cc.z == CC_FLAG_SET )
-                do_branch(long_short, effective_address, cycles);
+#if (CPU_6309==1)
+        case ADDR_QIMMEDIATE:
+            operand = pc;
+            pc += 4;
             break;
+#endif
 
-        /* Exception: Illegal branch code branch()
-         *
-         * There should be no exception here because this function is always
-         * called from within a switch/case for a valid opcode range.
+        /* Inherent, and illegal address modes that
+         * are caught by get_eff_addr()
          */
         default:
-            cpu.cpu_state = CPU_EXCEPTION;
-            cpu.exception_line_num = __LINE__;
+            break;
     }
-}
 
-/*------------------------------------------------
- * do_branch()
- *
- *  Helper function to do the actual branch
- *  by stacking the PC and changing to the target address.
- *
- *  param:  Long ('1') or short ('0') branch, 16-bit sign-extended offset,
- *          pointer to opcode cycles.
- *  return: Nothing
- */
-static void do_branch(int long_short, uint16_t effective_address, int *cycles)
-{
-    cpu.pc = effective_address;
-    (*cycles) += long_short;
+    op->next_pc = pc;
+    op->operand = operand;
+    op->post_byte = post_byte;
+    op->cycles = (uint8_t) cycles;
+    op->bytes = (uint8_t) bytes;
 }
 
 /*------------------------------------------------
  * get_eff_addr()
  *
- *  Calculate and return effective address.
  *  Resolve addressing mode, calculate effective address.
- *  Modifies 'pc' and appropriate index register.
+ *  Modifies appropriate index register.
  *
- *  param:  Command op code and command cycles and bytes count to update if needed.
+ *  param:  Decoded instruction
  *  return: Effective Address, '0' if error
  */
-static int get_eff_addr(int op_code, int *cycles, int *bytes)
+static int get_eff_addr(const decoded_op_t *op)
 {
-    uint16_t    operand;
     uint16_t   *index_reg = 0;
     uint16_t    effective_addr = 0;
 
-    switch ( machine_code[op_code].mode )
+    switch ( op->mode )
     {
         case ADDR_DIRECT:
-            effective_addr = (cpu.dp << 8) + mem_read(cpu.pc);
-            cpu.pc++;
+            effective_addr = (cpu.dp << 8) + op->operand;
             break;
 
         case ADDR_RELATIVE:
-            operand = mem_read(cpu.pc);
-            cpu.pc++;
-            effective_addr = cpu.pc + SIG_EXTEND(operand);
-            break;
-
         case ADDR_LRELATIVE:
-            operand = (mem_read(cpu.pc) << 8);
-            cpu.pc++;
-            operand += mem_read(cpu.pc);
-            cpu.pc++;
-            effective_addr = cpu.pc + operand;
+        case ADDR_EXTENDED:
+        case ADDR_IMMEDIATE:
+        case ADDR_LIMMEDIATE:
+#if (CPU_6309==1)
+        case ADDR_QIMMEDIATE:
+#endif
+            effective_addr = op->operand;
             break;
 
         case ADDR_INDEXED:
-            operand = mem_read(cpu.pc);
-            cpu.pc++;
+#if (CPU_6309==1)
+            if ( INDX_POST_W_MODE(op->post_byte) )
+            {
+                effective_addr = get_eff_addr_w(op);
+                break;
+            }
+#endif
 
-            switch ( operand & INDX_POST_REG )
+            switch ( op->post_byte & INDX_POST_REG )
             {
                 case 0x00:
                     index_reg = &cpu.x;
@@ -2776,100 +4234,69 @@ static int get_eff_addr(int op_code, int *cycles, int *bytes)
                 break;
             }
 
-            /* Check if 5-bit offset is in the post-byte
-             * then process more index address bytes if not.
-             */
-            if ( operand & INDX_POST_5BIT_OFF )
+            if ( op->post_byte & INDX_POST_5BIT_OFF )
             {
-                switch ( operand & INDX_POST_MODE )
+                switch ( op->post_byte & INDX_POST_MODE )
                 {
                     case 0: // EA = ,index+ Auto post-increment by 1
                         effective_addr = *index_reg;
                         (*index_reg) += 1;
-                        (*cycles) += 2;
                         break;
 
                     case 1: // EA = ,index++ Auto post-increment by 2
                         effective_addr = *index_reg;
                         (*index_reg) += 2;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 6 : 3;
                         break;
 
                     case 2: // EA = ,-index Auto pre-decrement by 1
                         (*index_reg) -= 1;
                         effective_addr = *index_reg;
-                        (*cycles) += 2;
                         break;
 
                     case 3: // EA = ,--index Auto pre-decrement by 2
                         (*index_reg) -= 2;
                         effective_addr = *index_reg;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 6 : 3;
                         break;
 
                     case 4: // EA = 0,index Zero offset
                         effective_addr = *index_reg;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 3 : 0;
                         break;
 
                     case 5: // EA = B,index Acc-B with index
                         effective_addr = *index_reg + SIG_EXTEND(cpu.b);
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 4 : 1;
                         break;
 
                     case 6: // EA = A,index Acc-A with index
                         effective_addr = *index_reg + SIG_EXTEND(cpu.a);
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 4 : 1;
                         break;
 
-                    case 8: // EA = 8-bit,index 8-bit offset
-                        effective_addr = SIG_EXTEND(mem_read(cpu.pc));
-                        cpu.pc++;
-                        effective_addr += *index_reg;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 4 : 1;
-                        (*bytes) += 1;
+#if (CPU_6309==1)
+                    case 7: // EA = E,index Acc-E with index
+                        effective_addr = *index_reg + SIG_EXTEND(cpu.e);
+                        break;
+
+                    case 10: // EA = F,index Acc-F with index
+                        effective_addr = *index_reg + SIG_EXTEND(cpu.f);
+                        break;
+
+                    case 14: // EA = W,index Acc-W with index
+                        effective_addr = *index_reg + w;
                         break;
+#endif
 
+                    case 8: // EA = 8-bit,index 8-bit offset
                     case 9: // EA = 16-bit,index 16-bit offset
-                        effective_addr = (mem_read(cpu.pc) << 8);
-                        cpu.pc++;
-                        effective_addr += mem_read(cpu.pc);
-                        cpu.pc++;
-                        effective_addr += *index_reg;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 7 : 4;
-                        (*bytes) += 2;
+                        effective_addr = *index_reg + op->operand;
                         break;
 
                     case 11: // EA = D,index Acc-D with index
                         effective_addr = *index_reg + d;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 7 : 4;
                         break;
 
                     case 12: // EA = 8-bit,pc PC relative
-                        effective_addr = SIG_EXTEND(mem_read(cpu.pc));
-                        cpu.pc++;
-                        effective_addr += cpu.pc;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 4 : 1;
-                        (*bytes) += 1;
-                        break;
-
                     case 13: // EA = 16-bit,pc PC relative
-                        effective_addr = (mem_read(cpu.pc) << 8);
-                        cpu.pc++;
-                        effective_addr += mem_read(cpu.pc);
-                        cpu.pc++;
-                        effective_addr += cpu.pc;
-                        (*cycles) += (operand & INDX_POST_INDIRECT) ? 8 : 5;
-                        (*bytes) += 2;
-                        break;
-
                     case 15: // EA = [addr] Extended Indirect will always be indirect.
-                        effective_addr = (mem_read(cpu.pc) << 8);
-                        cpu.pc++;
-                        effective_addr += mem_read(cpu.pc);
-                        cpu.pc++;
-                        (*cycles) += 5;
-                        (*bytes) += 2;
+                        effective_addr = op->operand;
                         break;
 
                     default:
@@ -2883,42 +4310,28 @@ static int get_eff_addr(int op_code, int *cycles, int *bytes)
                  * Rely on assembler-generated code to reliably include the indirect bit
                  * i.e. not for auto inc/dec by one.
                  */
-                if ( operand & INDX_POST_INDIRECT )
+                if ( op->post_byte & INDX_POST_INDIRECT )
                 {
-                    effective_addr = (mem_read(effective_addr) << 8) + mem_read(effective_addr + 1);
+                    effective_addr = mem_fetch16(effective_addr);
                 }
             }
             /* 5-bit offset is in the post-bytes
              */
             else
             {
-                operand &= 0x001f;
-                if ( operand & 0x0010 )
-                    operand |= 0xfff0;  // Extend the sign of the 5-bit offset into 16-bit
-                effective_addr = *index_reg + operand;
-                (*cycles)++;
+                effective_addr = *index_reg + op->operand;
             }
             break;
 
-        case ADDR_EXTENDED:
-            effective_addr = (mem_read(cpu.pc) << 8);
-            cpu.pc++;
-            effective_addr += mem_read(cpu.pc);
-            cpu.pc++;
-            break;
-
-        case ADDR_IMMEDIATE:
-            effective_addr = cpu.pc;
-            cpu.pc += 1;
-            break;
-
-        case ADDR_LIMMEDIATE:
-            effective_addr = cpu.pc;
-            cpu.pc += 2;
+        case ADDR_INHERENT:
             break;
 
-        case ADDR_INHERENT:
+#if (CPU_6309==1)
+        /* Illegal op-codes trap in cpu_run()
+         */
+        case ILLEGAL_OP:
             break;
+#endif
 
         default:
             /* Exception: Illegal address mode get_eff_addr()
@@ -2930,6 +4343,53 @@ static int get_eff_addr(int op_code, int *cycles, int *bytes)
     return effective_addr;
 }
 
+#if (CPU_6309==1)
+/*------------------------------------------------
+ * get_eff_addr_w()
+ *
+ *  Calculate the effective address of the HD6309 indexed
+ *  addressing modes that use the W register as the index.
+ *  Modifies W for auto increment and decrement.
+ *
+ *  param:  Decoded instruction
+ *  return: Effective Address
+ */
+static uint16_t get_eff_addr_w(const decoded_op_t *op)
+{
+    uint16_t    effective_addr;
+
+    switch ( op->post_byte & INDX_POST_REG )
+    {
+        case 0x00: // EA = ,W Zero offset
+            effective_addr = w;
+            break;
+
+        case 0x20: // EA = 16-bit,W 16-bit offset
+            effective_addr = w + op->operand;
+            break;
+
+        case 0x40: // EA = ,W++ Auto post-increment by 2
+            effective_addr = w;
+            cpu.e = GET_REG_HIGH((uint16_t)(effective_addr + 2));
+            cpu.f = GET_REG_LOW((uint16_t)(effective_addr + 2));
+            break;
+
+        default: // EA = ,--W Auto pre-decrement by 2
+            effective_addr = w - 2;
+            cpu.e = GET_REG_HIGH(effective_addr);
+            cpu.f = GET_REG_LOW(effective_addr);
+            break;
+    }
+
+    if ( op->post_byte & INDX_POST_INDIRECT )
+    {
+        effective_addr = mem_fetch16(effective_addr);
+    }
+
+    return effective_addr;
+}
+#endif
+
 /*------------------------------------------------
  * read_register()
  *
@@ -2969,6 +4429,16 @@ static uint16_t read_register(int reg)
             temp = cpu.pc;
             break;
 
+#if (CPU_6309==1)
+        case 6:
+            temp = w;
+            break;
+
+        case 7:
+            temp = cpu.v;
+            break;
+#endif
+
         case 8:
             temp = cpu.a;
             break;
@@ -2985,6 +4455,21 @@ static uint16_t read_register(int reg)
             temp = cpu.dp;
             break;
 
+#if (CPU_6309==1)
+        case 12:
+        case 13:
+            temp = 0;               // HD6309 zero register
+            break;
+
+        case 14:
+            temp = cpu.e;
+            break;
+
+        case 15:
+            temp = cpu.f;
+            break;
+#endif
+
         default:
             temp = 0;
             /* Exception: Illegal register read_register()
@@ -3035,6 +4520,17 @@ static void write_register(int reg, uint16_t data)
             cpu.pc = data;
             break;
 
+#if (CPU_6309==1)
+        case 6:
+            cpu.e = (uint8_t)((data & 0xff00) >> 8);
+            cpu.f = (uint8_t)(data & 0x00ff);
+            break;
+
+        case 7:
+            cpu.v = data;
+            break;
+#endif
+
         case 8:
             cpu.a = (uint8_t)(data & 0x00ff);
             break;
@@ -3051,6 +4547,20 @@ static void write_register(int reg, uint16_t data)
             cpu.dp = (uint8_t)(data & 0x00ff);
             break;
 
+#if (CPU_6309==1)
+        case 12:
+        case 13:
+            break;                  // HD6309 zero register
+
+        case 14:
+            cpu.e = (uint8_t)(data & 0x00ff);
+            break;
+
+        case 15:
+            cpu.f = (uint8_t)(data & 0x00ff);
+            break;
+#endif
+
         default:
             /* Exception: Illegal register write_register()
              */
@@ -3062,85 +4572,85 @@ static void write_register(int reg, uint16_t data)
 /*------------------------------------------------
  * eval_cc_c()
  *
- *  Evaluate carry bit of 8-bit input value and set/clear CC.C flag.
+ *  Record the 8-bit input value as the source of the CC.C flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_c(uint16_t value)
 {
-    cc.c = (value & 0x100) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.c_src = value;
 }
 
 /*------------------------------------------------
  * eval_cc_c16()
  *
- *  Evaluate carry bit of 16-bit input value and set/clear CC.C flag.
+ *  Record the 16-bit input value as the source of the CC.C flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_c16(uint32_t value)
 {
-    cc.c = (value & 0x00010000) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.c_src = value >> 8;
 }
 
 /*------------------------------------------------
  * eval_cc_z()
  *
- *  Evaluate zero value of input and set/clear CC.Z flag.
+ *  Record the 8-bit input value as the source of the CC.Z flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_z(uint16_t value)
 {
-    cc.z = !(value & 0x00ff) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.z_src = value & 0x00ff;
 }
 
 /*------------------------------------------------
  * eval_cc_z16()
  *
- *  Evaluate zero value of input and set/clear CC.Z flag.
+ *  Record the 16-bit input value as the source of the CC.Z flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_z16(uint32_t value)
 {
-    cc.z = !(value & 0x0000ffff) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.z_src = value & 0x0000ffff;
 }
 
 /*------------------------------------------------
  * eval_cc_n()
  *
- *  Evaluate sign bit value of input and set/clear CC.N flag.
+ *  Record the 8-bit input value as the source of the CC.N flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_n(uint16_t value)
 {
-    cc.n = (value & 0x0080) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.n_src = value;
 }
 
 /*------------------------------------------------
  * eval_cc_n16()
  *
- *  Evaluate sign bit value of input and set/clear CC.N flag.
+ *  Record the 16-bit input value as the source of the CC.N flag.
  *
  *  param:  Input value
  *  return: Nothing
  */
 static void eval_cc_n16(uint32_t value)
 {
-    cc.n = (value & 0x00008000) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.n_src = value >> 8;
 }
 
 /*------------------------------------------------
  * eval_cc_v()
  *
- *  Evaluate overflow bit value of input and set/clear CC.V flag.
+ *  Record the overflow source of the CC.V flag.
  *  Use the C(in) != C(out) method, note the C(out) shift to align the bit location
  *  for a bit-wise XOR.
  *  source: http://teaching.idallen.com/dat2343/10f/notes/040_overflow.txt
@@ -3151,13 +4661,13 @@ static void eval_cc_n16(uint32_t value)
  */
 static void eval_cc_v(uint8_t val1, uint8_t val2, uint16_t result)
 {
-    cc.v = ((val1 ^ result) & (val2 ^ result) & 0x0080) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.v_src = (val1 ^ result) & (val2 ^ result);
 }
 
 /*------------------------------------------------
  * eval_cc_v16()
  *
- *  Evaluate overflow bit value of input and set/clear CC.V flag.
+ *  Record the overflow source of the CC.V flag.
  *  Use the C(in) != C(out) method, note the C(out) shift to align the bit location
  *  for a bit-wise XOR.
  *  source: http://teaching.idallen.com/dat2343/10f/notes/040_overflow.txt
@@ -3168,13 +4678,13 @@ static void eval_cc_v(uint8_t val1, uint8_t val2, uint16_t result)
  */
 static void eval_cc_v16(uint16_t val1, uint16_t val2, uint32_t result)
 {
-    cc.v = ((val1 ^ result) & (val2 ^ result) & 0x00008000) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.v_src = ((val1 ^ result) & (val2 ^ result)) >> 8;
 }
 
 /*------------------------------------------------
  * eval_cc_h()
  *
- *  Evaluate half carry bit and set/clear CC.H flag.
+ *  Record the half carry source of the CC.H flag.
  *  source: https://retrocomputing.stackexchange.com/questions/11262/can-someone-explain-this-algorithm-used-to-compute-the-auxiliary-carry-flag
  *
  *  param:  Input operands and result
@@ -3184,21 +4694,22 @@ static void eval_cc_h(uint8_t val1, uint8_t val2, uint8_t result)
 {
     /* Half carry in 6809 is only relevant/valid for additions ADD and ADC
      */
-    cc.h = (((val1 ^ val2) ^ result) & 0x10) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.h_src = (val1 ^ val2) ^ result;
 }
 
 /*------------------------------------------------
  * get_cc()
  *
- *  Return value of CC register as a packed 8-bit value
+ *  Return value of CC register as a packed 8-bit value,
+ *  evaluating the lazy flags from their source values.
  *
  *  param:  Nothing
  *  return: 8-bit value of CC register
  */
 static uint8_t get_cc(void)
 {
-    return (uint8_t) ((cc.e << 7) + (cc.f << 6) + (cc.h << 5) + (cc.i << 4) + \
-                      (cc.n << 3) + (cc.z << 2) + (cc.v << 1) + cc.c );
+    return (uint8_t) ((cc.e << 7) + (cc.f << 6) + (CC_H << 5) + (cc.i << 4) + \
+                      (CC_N << 3) + (CC_Z << 2) + (CC_V << 1) + CC_C );
 }
 
 /*------------------------------------------------
@@ -3211,12 +4722,386 @@ static uint8_t get_cc(void)
  */
 static void set_cc(uint8_t value)
 {
-    cc.c = (value & 0x01) ? CC_FLAG_SET : CC_FLAG_CLR;
-    cc.v = (value & 0x02) ? CC_FLAG_SET : CC_FLAG_CLR;
-    cc.z = (value & 0x04) ? CC_FLAG_SET : CC_FLAG_CLR;
-    cc.n = (value & 0x08) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.c_src = (value & 0x01) ? CC_C_SET : 0;
+    cc.v_src = (value & 0x02) ? CC_V_SET : 0;
+    cc.z_src = (value & 0x04) ? CC_Z_SET : CC_Z_CLR;
+    cc.n_src = (value & 0x08) ? CC_N_SET : 0;
     cc.i = (value & 0x10) ? CC_FLAG_SET : CC_FLAG_CLR;
-    cc.h = (value & 0x20) ? CC_FLAG_SET : CC_FLAG_CLR;
+    cc.h_src = (value & 0x20) ? CC_H_SET : 0;
     cc.f = (value & 0x40) ? CC_FLAG_SET : CC_FLAG_CLR;
     cc.e = (value & 0x80) ? CC_FLAG_SET : CC_FLAG_CLR;
 }
+
+/*------------------------------------------------
+ * push_registers()
+ *
+ *  Push a list of registers onto a stack as a single block.
+ *  The list uses the PSHS/PSHU post-byte bit order, and
+ *  PUSH_PULL_W adds the HD6309 E and F after B.
+ *
+ *  param:  Pointer to stack register, the other stack register value (U for S, S for U),
+ *          register push-list, and CC value to push
+ *  return: Count of 16-bit registers pushed
+ */
+static int push_registers(uint16_t *stack, uint16_t other_stack, int push_list, uint8_t cc_value)
+{
+    uint8_t frame[PUSH_PULL_MAX_BYTES];
+    int     length = 0;
+    int     words = 0;
+
+    /* Build the frame in ascending memory address order,
+     * which is the reverse of the push order.
+     */
+    if ( push_list & PUSH_PULL_CC )
+        frame[length++] = cc_value;
+
+    if ( push_list & PUSH_PULL_A )
+        frame[length++] = cpu.a;
+
+    if ( push_list & PUSH_PULL_B )
+        frame[length++] = cpu.b;
+
+#if (CPU_6309==1)
+    if ( push_list & PUSH_PULL_W )
+    {
+        frame[length++] = cpu.e;
+        frame[length++] = cpu.f;
+    }
+#endif
+
+    if ( push_list & PUSH_PULL_DP )
+        frame[length++] = cpu.dp;
+
+    if ( push_list & PUSH_PULL_X )
+    {
+        frame[length++] = GET_REG_HIGH(cpu.x);
+        frame[length++] = GET_REG_LOW(cpu.x);
+        words++;
+    }
+
+    if ( push_list & PUSH_PULL_Y )
+    {
+        frame[length++] = GET_REG_HIGH(cpu.y);
+        frame[length++] = GET_REG_LOW(cpu.y);
+        words++;
+    }
+
+    if ( push_list & PUSH_PULL_SU )
+    {
+        frame[length++] = GET_REG_HIGH(other_stack);
+        frame[length++] = GET_REG_LOW(other_stack);
+        words++;
+    }
+
+    if ( push_list & PUSH_PULL_PC )
+    {
+        frame[length++] = GET_REG_HIGH(cpu.pc);
+        frame[length++] = GET_REG_LOW(cpu.pc);
+        words++;
+    }
+
+    mem_push_block(stack, frame, length);
+
+    return words;
+}
+
+/*------------------------------------------------
+ * pull_registers()
+ *
+ *  Pull a list of registers from a stack as a single block.
+ *  The list uses the PULS/PULU post-byte bit order, and
+ *  PUSH_PULL_W adds the HD6309 E and F after B.
+ *
+ *  param:  Pointer to stack register, pointer to the other stack register (U for S, S for U),
+ *          and register pull-list
+ *  return: Count of 16-bit registers pulled
+ */
+static int pull_registers(uint16_t *stack, uint16_t *other_stack, int pull_list)
+{
+    uint8_t frame[PUSH_PULL_MAX_BYTES];
+    int     length = 0;
+    int     words = 0;
+    int     i = 0;
+
+    if ( pull_list & PUSH_PULL_CC )
+        length++;
+    if ( pull_list & PUSH_PULL_A )
+        length++;
+    if ( pull_list & PUSH_PULL_B )
+        length++;
+#if (CPU_6309==1)
+    if ( pull_list & PUSH_PULL_W )
+        length += 2;
+#endif
+    if ( pull_list & PUSH_PULL_DP )
+        length++;
+    if ( pull_list & PUSH_PULL_X )
+        length += 2;
+    if ( pull_list & PUSH_PULL_Y )
+        length += 2;
+    if ( pull_list & PUSH_PULL_SU )
+        length += 2;
+    if ( pull_list & PUSH_PULL_PC )
+        length += 2;
+
+    mem_pull_block(stack, frame, length);
+
+    if ( pull_list & PUSH_PULL_CC )
+        set_cc(frame[i++]);
+
+    if ( pull_list & PUSH_PULL_A )
+        cpu.a = frame[i++];
+
+    if ( pull_list & PUSH_PULL_B )
+        cpu.b = frame[i++];
+
+#if (CPU_6309==1)
+    if ( pull_list & PUSH_PULL_W )
+    {
+        cpu.e = frame[i++];
+        cpu.f = frame[i++];
+    }
+#endif
+
+    if ( pull_list & PUSH_PULL_DP )
+        cpu.dp = frame[i++];
+
+    if ( pull_list & PUSH_PULL_X )
+    {
+        cpu.x = ((uint16_t) frame[i] << 8) + frame[i+1];
+        i += 2;
+        words++;
+    }
+
+    if ( pull_list & PUSH_PULL_Y )
+    {
+        cpu.y = ((uint16_t) frame[i] << 8) + frame[i+1];
+        i += 2;
+        words++;
+    }
+
+    if ( pull_list & PUSH_PULL_SU )
+    {
+        *other_stack = ((uint16_t) frame[i] << 8) + frame[i+1];
+        i += 2;
+        words++;
+    }
+
+    if ( pull_list & PUSH_PULL_PC )
+    {
+        cpu.pc = ((uint16_t) frame[i] << 8) + frame[i+1];
+        words++;
+    }
+
+    return words;
+}
+
+/*------------------------------------------------
+ * run_trap()
+ *
+ *  Call the trap handler of the routine at PC, if it is trapped.
+ *  The handler gets the registers with a packed CC, and may change them.
+ *
+ *  param:  Nothing
+ *  return: 1- routine replaced and returned to its caller, 0- not trapped or not replaced
+ */
+static int run_trap(void)
+{
+    int     i;
+
+    for ( i = 0; i < trap_count; i++ )
+    {
+        if ( trap_list[i].address != cpu.pc )
+            continue;
+
+        cpu.cc = get_cc();
+
+        if ( !trap_list[i].handler(&cpu) )
+            return 0;
+
+        set_cc(cpu.cc);
+        pull_registers(&cpu.s, &cpu.u, PUSH_PULL_PC);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+#if (CPU_HISTORY > 0)
+/*------------------------------------------------
+ * history_record()
+ *
+ *  Record an executed instruction in the instruction history ring buffer,
+ *  with its address, bytes, the registers after execution, and the CPU cycle
+ *  count at its end. Entries are reused in a circle, so the ring always
+ *  holds the last CPU_HISTORY instructions.
+ *
+ *  param:  Pointer to decoded instruction, instruction cycles
+ *  return: Nothing
+ */
+static void history_record(const decoded_op_t *op, int cycles)
+{
+    cpu_history_t  *entry;
+    int             i, bytes;
+
+    history_cycles += cycles;
+
+    entry = &history[history_next % CPU_HISTORY];
+    history_next++;
+
+    entry->cycles = history_cycles;
+    entry->pc = op->pc;
+    entry->a = cpu.a;
+    entry->b = cpu.b;
+    entry->dp = cpu.dp;
+    entry->cc = get_cc();
+    entry->x = cpu.x;
+    entry->y = cpu.y;
+    entry->u = cpu.u;
+    entry->s = cpu.s;
+
+    bytes = (uint16_t)(op->next_pc - op->pc);
+    if ( bytes > CPU_HISTORY_CODE )
+        bytes = CPU_HISTORY_CODE;
+    entry->bytes = (uint8_t) bytes;
+
+    /* A fixed length copy is faster than one of the instruction's length
+     */
+    if ( (op->pc & MEM_BANK_MASK) <= (MEM_BANK_SIZE - CPU_HISTORY_CODE) )
+    {
+        memcpy(entry->code, &mem_byte(op->pc), CPU_HISTORY_CODE);
+    }
+    else
+    {
+        for ( i = 0; i < bytes; i++ )
+            entry->code[i] = mem_byte((uint16_t)(op->pc + i));
+    }
+}
+#endif
+
+/*------------------------------------------------
+ * op_code_mnemonic()
+ *
+ *  Return the mnemonic of an op-code, looking up the second
+ *  op-code byte in the 0x10 and 0x11 pages.
+ *
+ *  param:  First and second op-code bytes
+ *  return: Pointer to constant mnemonic string
+ */
+static const char *op_code_mnemonic(uint8_t op_code, uint8_t page_op_code)
+{
+    if ( op_code == 0x10 )
+        return machine_code[op_code_page10[page_op_code]].mnem;
+    else if ( op_code == 0x11 )
+        return machine_code[op_code_page11[page_op_code]].mnem;
+
+    return machine_code[PAGE0_INDEX(op_code)].mnem;
+}
+
+/*------------------------------------------------
+ * debug_break()
+ *
+ *  Check if the instruction batch stops at a breakpoint at the next PC,
+ *  or after an access to a watched address.
+ *
+ *  param:  Nothing
+ *  return: 1=stop, 0=continue
+ */
+static int debug_break(void)
+{
+    if ( mem_watch_hit || (breakpoint_map[cpu.pc >> 3] & (1 << (cpu.pc & 7))) )
+    {
+        break_hit = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * build_op_code_pages()
+ *
+ *  Build the direct-indexed decode tables for the 0x10 and 0x11
+ *  double byte op-code pages from machine_code[].
+ *  Op-codes that do not exist in a page point to an illegal op-code entry.
+ *  The HD6309 build adds its op-codes to the three pages.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void build_op_code_pages(void)
+{
+    int     i;
+
+    for ( i = 0; i < 256; i++ )
+    {
+        op_code_page10[i] = OP_CODE_ILLEGAL_INDEX;
+        op_code_page11[i] = OP_CODE_ILLEGAL_INDEX;
+    }
+
+    for ( i = OP_CODE10; i < OP_CODE11; i++ )
+    {
+        op_code_page10[machine_code[i].op] = i;
+    }
+
+#if (CPU_6309==1)
+    for ( i = OP_CODE11; i < OP_CODE6309; i++ )
+    {
+        op_code_page11[machine_code[i].op] = i;
+    }
+
+    for ( i = 0; i < 256; i++ )
+    {
+        op_code_page0[i] = i;
+    }
+
+    for ( i = OP_CODE6309; i < OP_CODE6309_10; i++ )
+    {
+        op_code_page0[machine_code[i].op] = i;
+    }
+
+    for ( i = OP_CODE6309_10; i < OP_CODE6309_11; i++ )
+    {
+        op_code_page10[machine_code[i].op] = i;
+    }
+
+    for ( i = OP_CODE6309_11; i < sizeof(machine_code)/sizeof(machine_code_t); i++ )
+    {
+        op_code_page11[machine_code[i].op] = i;
+    }
+#else
+    for ( i = OP_CODE11; i < sizeof(machine_code)/sizeof(machine_code_t); i++ )
+    {
+        op_code_page11[machine_code[i].op] = i;
+    }
+#endif
+}
+
+#if (CPU_PROFILE==1)
+/*------------------------------------------------
+ * profile_count()
+ *
+ *  Count an instruction in the execution profile, in its PC bucket
+ *  and in its machine_code[] entry.
+ *
+ *  param:  Pointer to decoded instruction
+ *  return: Nothing
+ */
+static void profile_count(const decoded_op_t *op)
+{
+    int     bucket;
+
+    bucket = op->pc >> CPU_PROFILE_BUCKET_SHIFT;
+    if ( profile_pc[bucket] == 0 )
+        profile_first_pc[bucket] = op->pc;
+    profile_pc[bucket]++;
+
+    if ( op->prefix == 0x10 )
+        profile_op[op_code_page10[op->op_code]]++;
+    else if ( op->prefix == 0x11 )
+        profile_op[op_code_page11[op->op_code]]++;
+    else
+        profile_op[PAGE0_INDEX(op->op_code)]++;
+}
+#endif
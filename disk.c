@@ -18,6 +18,11 @@
 #include    <stdint.h>
 #include    <string.h>
 
+#if (RPI_BARE_METAL==0)
+    #include    <pthread.h>
+#endif
+
+#include    "config.h"
 #include    "fat32.h"
 #include    "disk.h"
 #include    "loader.h"
@@ -25,6 +30,9 @@
 #include    "mem.h"
 #include    "pia.h"
 #include    "rpi.h"
+#include    "sched.h"
+#include    "state.h"
+#include    "stats.h"
 
 #include    "dbgmsg.h"
 
@@ -55,6 +63,7 @@
 #define     WDCmdForceInt       0b11010000  // 0xD0 Force inturrupt (terminate with no interrupt)
 #define     WDCmdWriteTrack     0b11110100  // 0xF4 Write (format) track (SSO to 0)
 #define     WDCmdStepMask       0b11111100  // Step rate mask
+#define     WDCmdSide           0b00000010  // Side select, type 2 and 3 commands
 
 /* WD2797 Error flag and status bits
  */
@@ -84,15 +93,33 @@
 #define     DriveMask           0b00000011  // Mask to extract drives
 
 /* Diskette geometry
- * Single-side, normal density.
+ * Tracks and sides of each drive's disk are read from its VDK header.
  */
-#define     TRACK_PER_DISK      40          // 0 to 39
+#define     TRACK_PER_DISK      40          // 0 to 39, images without a VDK header
+#define     SIDES_PER_DISK      1           // Images without a VDK header
 #define     SEC_PER_TRACK       18          // 1 to 18
 #define     SECTOR_SIZE         256         // Bytes
 #define     BYTES_PER_TRACK     (SEC_PER_TRACK * SECTOR_SIZE)
 #define     ID_FIELD_SIZE       6           // Bytes
 #define     FILE_VDK_HEADER     12          // Bytes
-#define     DISK_INT_INTERVAL   1000        // uSec
+#define     DISK_INT_INTERVAL   SCHED_USEC_TO_CYCLES(1000)          // CPU cycles between DRQ
+#define     DISK_DRQ_FAST       SCHED_USEC_TO_CYCLES(32)            // CPU cycles from data register access to next DRQ
+#if (DISK_FAST_DRQ)
+#define     DISK_INTRQ_DELAY    SCHED_USEC_TO_CYCLES(100)           // CPU cycles from last DRQ to INTRQ
+#else
+#define     DISK_INTRQ_DELAY    SCHED_USEC_TO_CYCLES(249*1000)      // CPU cycles from last DRQ to INTRQ
+#endif
+#define     DISK_FLUSH_DELAY    SCHED_USEC_TO_CYCLES(2000*1000)     // CPU cycles from last write to image write back
+#define     DISK_JOB_LATENCY    SCHED_USEC_TO_CYCLES(500)           // CPU cycles from sector command to its job's completion
+
+#define     DISK_JOB_QUEUE      4           // Pending disk image jobs
+
+/* The bare metal multi-core disk image worker shares the job queue
+ * with core 0 through the sequence numbers, ordered with memory barriers
+ */
+#if (RPI_MULTI_CORE==1)
+    #define     job_barrier()   __asm__ __volatile__ ("mcr p15, 0, %0, c7, c10, 5" : : "r" (0) : "memory")
+#endif
 
 #define     INIT_SEC_FILL       0xe5        // Sector data initialization data
 #define     INIT_BYTE_SKIP      111         // Bytes to skip in track init byte stream.
@@ -108,8 +135,27 @@ typedef enum
     DISK_WRITE      = 2,    // Writeing
     DISK_READ_ID    = 3,    // Read 6-byte disk ID/location (see 'WDCmdReadAddr')
     DISK_WRITE_TRK  = 4,    // Write track / format
+    DISK_WAIT       = 5,    // Waiting for a disk image job to complete
 } disk_state_t;
 
+typedef enum
+{
+    DISK_JOB_READ_SEC,      // Read a sector into the sector buffer
+    DISK_JOB_WRITE_SEC,     // Write the sector buffer
+    DISK_JOB_WRITE_TRK,     // Write an initialized track
+    DISK_JOB_FLUSH,         // Write back the disk image cache
+} disk_job_op_t;
+
+typedef struct
+{
+    disk_job_op_t   op;
+    int             drive;
+    uint16_t        track;
+    uint16_t        side;
+    uint16_t        sector;
+    uint8_t         status;     // WD2797 error status bits when the job completes
+} disk_job_t;
+
 typedef struct
 {
     uint8_t     char_d;
@@ -142,19 +188,56 @@ static uint8_t  io_handler_wd2797_sector(uint16_t address, uint8_t data, mem_ope
 static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_operation_t op);
 static uint8_t  io_handler_drive_ctrl(uint16_t address, uint8_t data, mem_operation_t op);
 
-static uint32_t disk_to_image_offset(uint16_t track, uint16_t sector);
+static uint32_t disk_to_image_offset(disk_vdk_header_t *geometry, uint16_t track, uint16_t side, uint16_t sector);
 static void     disk_intrq(void);
+static void     disk_drq_event(void);
+static void     disk_drq_next(void);
+static void     disk_flush_event(void);
+static void     disk_flush_schedule(void);
+static void     disk_job_event(void);
+static void     disk_job_wait(disk_state_t next_state);
+static int      disk_image_geometry(int drive);
+static uint32_t disk_image_seek(disk_job_t *job);
+static void     disk_job_submit(disk_job_op_t op, uint16_t track, uint16_t side, uint16_t sector);
+static int      disk_job_is_done(uint32_t job_seq);
+static uint8_t  disk_job_status(uint32_t job_seq);
+static void     disk_job_run(disk_job_t *job);
+#if (RPI_BARE_METAL==0)
+static void    *disk_job_worker(void *arg);
+#elif (RPI_MULTI_CORE==1)
+static void     disk_job_core(void);
+#endif
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
 static int                  nmi_inhibit;
 static disk_state_t         state;
-static disk_vdk_header_t    vdk_header;
+static disk_vdk_header_t    vdk_header[LOADER_DISK_DRIVES];    // Geometry of each drive's image
 
 static uint8_t              buffer[BYTES_PER_TRACK];
 static int                  buffer_index;
 
+/* Disk image jobs run in order, on a worker thread on Linux or a worker core
+ * on bare metal multi-core, so that SD card access does not stall CPU emulation.
+ * The state after the sector buffer job completes is applied by disk_job_event(),
+ * a fixed emulated time after the command, so that the emulation does not depend
+ * on how long the job takes on the host.
+ */
+static disk_job_t           job_queue[DISK_JOB_QUEUE];
+static volatile uint32_t    job_submitted;          // Sequence number of the last job queued
+static volatile uint32_t    job_completed;          // Sequence number of the last job completed
+static uint32_t             job_wait_seq;           // Sector buffer job that DISK_WAIT waits for
+static disk_state_t         job_next_state;         // State to enter when it completes
+#if (RPI_BARE_METAL==0)
+static int                  job_worker_running = 0;
+static pthread_t            job_worker;
+static pthread_mutex_t      job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       job_cond = PTHREAD_COND_INITIALIZER;
+#elif (RPI_MULTI_CORE==1)
+static int                  job_worker_running = 0;
+#endif
+
 static struct   disk_reg_t
 {
     uint8_t disk_cmd;
@@ -164,6 +247,7 @@ static struct   disk_reg_t
     uint8_t disk_data;
     int     motor_on;
     int     disk_drive_num;
+    int     disk_side;
     int     disk_double_density;
 } disk_registers;
 
@@ -190,10 +274,33 @@ void disk_init(void)
     disk_registers.disk_data = 0;
     disk_registers.motor_on = 0;
     disk_registers.disk_drive_num = 0;
+    disk_registers.disk_side = 0;
     disk_registers.disk_double_density = 0;
 
     nmi_inhibit = 1;
     state = DISK_IDLE;
+
+    job_submitted = 0;
+    job_completed = 0;
+    job_wait_seq = 0;
+
+#if (RPI_BARE_METAL==0)
+    if ( !job_worker_running )
+    {
+        if ( pthread_create(&job_worker, NULL, disk_job_worker, NULL) == 0 )
+            job_worker_running = 1;
+        else
+            dbg_printf(1, "disk_init()[%3d]: Disk worker thread failed, using synchronous disk access.\n", __LINE__);
+    }
+#elif (RPI_MULTI_CORE==1)
+    if ( !job_worker_running )
+    {
+        if ( rpi_core_start(DISK_WORKER_CORE, disk_job_core) == 0 )
+            job_worker_running = 1;
+        else
+            dbg_printf(1, "disk_init()[%3d]: Disk worker core failed, using synchronous disk access.\n", __LINE__);
+    }
+#endif
 }
 
 /*------------------------------------------------
@@ -201,58 +308,119 @@ void disk_init(void)
  *
  *  Simulate interrupts from WD2797 that is ready for read or write.
  *  Call periodically from the main emulation loop.
+ *  Interrupt timing is done in emulated CPU cycles through the
+ *  event scheduler, this function only starts the DRQ event sequence.
  *
  *  param:  Nothing
  *  return: Nothing
  */
 void disk_io_interrupt(void)
 {
-    static uint32_t time_mark = 0;
-
-    uint32_t        duration;
-
-    /* The routine has a state machine with two states indicated
-     * by 'time_mark' as ==0 or !=0.
-     * In normal operation 'time_mark' is 0 and interrupts are not generator.
+    /* In normal operation no events are scheduled and interrupts are not generated.
      * When data is available for read or when the emulation is ready to write,
-     * a 'state' not DISK_IDLE triggers a transition to a state in which
-     * this routine generates FIRQ interrupts through PIA1.
+     * a 'state' not DISK_IDLE starts a sequence of DRQ events that
+     * generate FIRQ interrupts through PIA1.
      * When the 'state' transitions back to DISK_IDLE after all bytes have been
-     * read or written, the routine generates and NMI. 
+     * read or written, the DRQ event schedules an NMI through disk_intrq().
      */
-
-    if ( state != DISK_IDLE && time_mark == 0 )
+    if ( state != DISK_IDLE && !sched_is_pending(disk_drq_event) )
     {
-        time_mark = rpi_system_timer();
+        sched_cancel(disk_intrq);
+        sched_add(DISK_INT_INTERVAL, disk_drq_event);
     }
+}
 
-    /* This creates a delay between interrupts to compensate for emulation
-     * vs. code timing race conditions. The NMI interrupt is generated after a longer delay.
-     */
-    duration = (state == DISK_IDLE) ? (250*DISK_INT_INTERVAL) : DISK_INT_INTERVAL;
+/*------------------------------------------------
+ * disk_io_sync()
+ *
+ *  Wait for all queued disk image jobs to complete.
+ *  Call before the disk image is accessed or changed
+ *  outside of the disk controller emulation.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void disk_io_sync(void)
+{
+#if (RPI_BARE_METAL==0)
+    pthread_mutex_lock(&job_lock);
+    while ( job_completed != job_submitted )
+        pthread_cond_wait(&job_cond, &job_lock);
+    pthread_mutex_unlock(&job_lock);
+#elif (RPI_MULTI_CORE==1)
+    while ( job_completed != job_submitted );
+    job_barrier();
+#endif
+}
 
-    if ( time_mark && ((rpi_system_timer() - time_mark) >= duration) )
+/*------------------------------------------------
+ * disk_save_state()
+ *
+ *  Write the WD2797 and drive control registers, the command state
+ *  and the sector buffer to the machine state.
+ *  Queued disk image jobs are completed first, so the state is never
+ *  saved waiting for a job. The DRQ event sequence restarts from the
+ *  command state, and a pending INTRQ is saved with the state.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void disk_save_state(void)
+{
+    int     intrq_pending;
+
+    disk_io_sync();
+    if ( sched_is_pending(disk_job_event) )
     {
-        if ( state == DISK_READ ||
-             state == DISK_WRITE ||
-             state == DISK_READ_ID ||
-             state == DISK_WRITE_TRK )
-        {
-            time_mark = rpi_system_timer();
-            disk_registers.disk_status |= WDDRQ;
-            pia_cart_firq();
-        }
-        else if ( state == DISK_IDLE )
-        {
-            time_mark = 0;
-            disk_intrq();
-        }
-        else
-        {
-            dbg_printf(0, "disk_io_interrupt()[%3d]: unhandled state %d.\n", __LINE__, state);
-            rpi_halt();
-        }
+        sched_cancel(disk_job_event);
+        disk_job_event();
     }
+    disk_io_interrupt();
+
+    intrq_pending = sched_is_pending(disk_intrq);
+
+    state_write(&disk_registers, sizeof(disk_registers));
+    state_write(&nmi_inhibit, sizeof(nmi_inhibit));
+    state_write(&state, sizeof(state));
+    state_write(&buffer_index, sizeof(buffer_index));
+    state_write(buffer, sizeof(buffer));
+    state_write(&intrq_pending, sizeof(intrq_pending));
+}
+
+/*------------------------------------------------
+ * disk_restore_state()
+ *
+ *  Restore the disk controller from the machine state.
+ *  The disk controller events of the running session are cancelled,
+ *  and disk_io_interrupt() restarts the DRQ event sequence
+ *  of a command that was active.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void disk_restore_state(void)
+{
+    int     intrq_pending;
+
+    disk_io_sync();
+
+    state_read(&disk_registers, sizeof(disk_registers));
+    state_read(&nmi_inhibit, sizeof(nmi_inhibit));
+    state_read(&state, sizeof(state));
+    state_read(&buffer_index, sizeof(buffer_index));
+    state_read(buffer, sizeof(buffer));
+    state_read(&intrq_pending, sizeof(intrq_pending));
+
+    sched_cancel(disk_drq_event);
+    sched_cancel(disk_intrq);
+    sched_cancel(disk_job_event);
+    if ( intrq_pending )
+        sched_add(DISK_INTRQ_DELAY, disk_intrq);
+
+    if ( disk_registers.motor_on )
+        rpi_motor_led_on(MOTOR_LED_DISK);
+    else
+        rpi_motor_led_off(MOTOR_LED_DISK);
 }
 
 /*------------------------------------------------
@@ -266,16 +434,28 @@ void disk_io_interrupt(void)
 static uint8_t io_handler_wd2797_cmd_stat(uint16_t address, uint8_t data, mem_operation_t op)
 {
     uint8_t     response = 0;
-    uint32_t    seek_address;
 
     if ( op == MEM_WRITE )
     {
         disk_registers.disk_cmd = data;
 
+        /* Dragon DOS selects the second side of a double-sided disk
+         * with the side select bit of the read, write and format commands
+         */
+        if ( (data & ~WDCmdSide) == WDCmdReadSec ||
+             (data & ~WDCmdSide) == WDCmdWriteSec ||
+             (data & ~WDCmdSide) == WDCmdReadAddr ||
+             (data & ~WDCmdSide) == WDCmdWriteTrack )
+        {
+            disk_registers.disk_side = (data & WDCmdSide) ? 1 : 0;
+            data &= ~WDCmdSide;
+        }
+
         if ( data == WDCmdForceInt )
         {
             dbg_printf(2, "io_handler_wd2797_cmd_stat()[%3d]: WDCmdForceInt\n", __LINE__);
             state = DISK_IDLE;
+            sched_cancel(disk_job_event);
 
             disk_registers.disk_status = 0;
         }
@@ -307,25 +487,13 @@ static uint8_t io_handler_wd2797_cmd_stat(uint16_t address, uint8_t data, mem_op
             else if ( data == WDCmdReadSec )
             {
                 dbg_printf(2, "io_handler_wd2797_cmd_stat()[%3d]: WDCmdReadSec\n", __LINE__);
-                if ( loader_disk_img_type() != FILE_NONE )
+                if ( loader_disk_img_type(disk_registers.disk_drive_num) != FILE_NONE )
                 {
-                    state = DISK_READ;
-
-                    seek_address = disk_to_image_offset(disk_registers.disk_track, disk_registers.disk_sector);
-                    if ( loader_disk_img_type() == FILE_VDK )
-                    {
-                        loader_disk_fseek(0);
-                        loader_disk_fread((uint8_t*) &vdk_header, sizeof(disk_vdk_header_t));
-                        seek_address += vdk_header.header_size;
-                        dbg_printf(2, "                                   Disk: sides=%d, tracks=%d\n",
-                                   vdk_header.sides, vdk_header.tracks);
-                    }
-
-                    dbg_printf(2, "                                   Seek=0x%08x, track=%d, sec=%d\n",
-                               seek_address, disk_registers.disk_track, disk_registers.disk_sector);
-                    
-                    loader_disk_fseek(seek_address);
-                    loader_disk_fread(buffer, SECTOR_SIZE);
+                    /* The sector is read by a disk image job, and the
+                     * DRQ sequence starts when it completes
+                     */
+                    disk_job_submit(DISK_JOB_READ_SEC, disk_registers.disk_track, disk_registers.disk_side, disk_registers.disk_sector);
+                    disk_job_wait(DISK_READ);
 
                     disk_registers.disk_status = WDBusy;
 
@@ -335,24 +503,14 @@ static uint8_t io_handler_wd2797_cmd_stat(uint16_t address, uint8_t data, mem_op
             else if ( data == WDCmdWriteSec )
             {
                 dbg_printf(2, "io_handler_wd2797_cmd_stat()[%3d]: WDCmdWriteSec\n", __LINE__);
-                if ( loader_disk_img_type() != FILE_NONE )
+                if ( loader_disk_img_type(disk_registers.disk_drive_num) != FILE_NONE )
                 {
-                    state = DISK_WRITE;
+                    /* A job still using the sector buffer
+                     * after a forced interrupt must finish first
+                     */
+                    while ( !disk_job_is_done(job_wait_seq) );
 
-                    seek_address = disk_to_image_offset(disk_registers.disk_track, disk_registers.disk_sector);
-                    if ( loader_disk_img_type() == FILE_VDK )
-                    {
-                        loader_disk_fseek(0);
-                        loader_disk_fread((uint8_t*) &vdk_header, sizeof(disk_vdk_header_t));
-                        seek_address += vdk_header.header_size;
-                        dbg_printf(2, "                                   Disk: sides=%d, tracks=%d\n",
-                                   vdk_header.sides, vdk_header.tracks);
-                    }
-
-                    dbg_printf(2, "                                   Seek=0x%08x, track=%d, sec=%d\n",
-                               seek_address, disk_registers.disk_track, disk_registers.disk_sector);
-                    
-                    loader_disk_fseek(seek_address);
+                    state = DISK_WRITE;
 
                     disk_registers.disk_status = WDBusy;
 
@@ -362,6 +520,8 @@ static uint8_t io_handler_wd2797_cmd_stat(uint16_t address, uint8_t data, mem_op
             else if ( data == WDCmdReadAddr )
             {
                 dbg_printf(2, "io_handler_wd2797_cmd_stat()[%3d]: WDCmdReadAddr\n", __LINE__);
+                while ( !disk_job_is_done(job_wait_seq) );
+
                 state = DISK_READ_ID;
 
                 buffer[0] = disk_registers.disk_track;
@@ -378,19 +538,11 @@ static uint8_t io_handler_wd2797_cmd_stat(uint16_t address, uint8_t data, mem_op
             else if ( data == WDCmdWriteTrack)
             {
                 dbg_printf(2, "io_handler_wd2797_cmd_stat()[%3d]: WDCmdWriteTrack\n", __LINE__);
-                if ( loader_disk_img_type() != FILE_NONE )
+                if ( loader_disk_img_type(disk_registers.disk_drive_num) != FILE_NONE )
                 {
-                    state = DISK_WRITE_TRK;
+                    while ( !disk_job_is_done(job_wait_seq) );
 
-                    seek_address = disk_to_image_offset(disk_registers.disk_track, disk_registers.disk_sector);
-                    if ( loader_disk_img_type() == FILE_VDK )
-                    {
-                        loader_disk_fseek(0);
-                        loader_disk_fread((uint8_t*) &vdk_header, sizeof(disk_vdk_header_t));
-                        seek_address += vdk_header.header_size;
-                        dbg_printf(2, "                                   Disk: sides=%d, tracks=%d\n",
-                                vdk_header.sides, vdk_header.tracks);
-                    }
+                    state = DISK_WRITE_TRK;
 
                     disk_registers.disk_status = WDBusy;
 
@@ -478,11 +630,11 @@ static uint8_t io_handler_wd2797_sector(uint16_t address, uint8_t data, mem_oper
 static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_operation_t op)
 {
     uint8_t     response = 0;
-    uint32_t    seek_address;
 
     switch ( state )
     {
         case DISK_IDLE:
+        case DISK_WAIT:
             if ( op == MEM_READ )
                 response = disk_registers.disk_data;
             else // op == MEM_WRITE
@@ -502,6 +654,8 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
                     state = DISK_IDLE;
                     disk_registers.disk_status &= ~WDBusy;
                 }
+
+                disk_drq_next();
             }
             break;
 
@@ -515,10 +669,14 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
                 buffer_index++;
                 if ( buffer_index == SECTOR_SIZE )
                 {
-                    state = DISK_IDLE;
-                    loader_disk_fwrite(buffer, SECTOR_SIZE);
-                    disk_registers.disk_status &= ~WDBusy;
+                    /* Busy until the disk image job wrote the sector
+                     */
+                    disk_job_submit(DISK_JOB_WRITE_SEC, disk_registers.disk_track, disk_registers.disk_side, disk_registers.disk_sector);
+                    disk_flush_schedule();
+                    disk_job_wait(DISK_IDLE);
                 }
+
+                disk_drq_next();
             }
             break;
         
@@ -535,6 +693,8 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
                     state = DISK_IDLE;
                     disk_registers.disk_status &= ~(WDBusy + WDDRQ);
                 }
+
+                disk_drq_next();
             }
             break;
 
@@ -555,16 +715,12 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
                 }
                 else
                 {
-                    state = DISK_IDLE;
-                    seek_address = disk_to_image_offset(buffer[INIT_BYTE_SKIP], 1);
-                    seek_address += vdk_header.header_size;
-                    dbg_printf(2, "                                   Writing track %d (0x%08x).\n", buffer[INIT_BYTE_SKIP], seek_address);
-
-                    memset(buffer, INIT_SEC_FILL, BYTES_PER_TRACK);
-                    loader_disk_fseek(seek_address);
-                    loader_disk_fwrite(buffer, BYTES_PER_TRACK);
-                    disk_registers.disk_status &= ~WDBusy;
+                    disk_job_submit(DISK_JOB_WRITE_TRK, buffer[INIT_BYTE_SKIP], disk_registers.disk_side, 1);
+                    disk_flush_schedule();
+                    disk_job_wait(DISK_IDLE);
                 }                   
+
+                disk_drq_next();
             }
             break;
 
@@ -582,6 +738,7 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
  *
  *  IO call-back handler for disk drive and motor control register/IO-port.
  *  The call-back handles and updates drive state/mode parameters.
+ *  Turning the motor off writes back the disk image cache.
  *
  *  param:  Call address, data byte for write operation, and operation type
  *  return: Status or data byte
@@ -589,18 +746,22 @@ static uint8_t  io_handler_wd2797_data(uint16_t address, uint8_t data, mem_opera
 static uint8_t io_handler_drive_ctrl(uint16_t address, uint8_t data, mem_operation_t op)
 {
     int     new_drive_num;
+    int     motor_was_on;
+
+    motor_was_on = disk_registers.motor_on;
 
     new_drive_num = (int) (data & DriveMask);
     nmi_inhibit = (data & NMIE) ? 0 : 1;
     disk_registers.motor_on = (data & MotorOn) ? 1 : 0;
     disk_registers.disk_double_density = (data & SDensE) ? 1 : 0;
 
-    /* Handle drive change
+    /* Handle drive change, each drive has its own disk image,
+     * and jobs already queued complete on the drive they were issued to
      */
     if ( new_drive_num != disk_registers.disk_drive_num )
     {
-        dbg_printf(0, "io_handler_drive_ctrl()[%3d]: drive change to %d.\n", __LINE__, new_drive_num);
-        rpi_halt();
+        dbg_printf(2, "io_handler_drive_ctrl()[%3d]: drive change to %d.\n", __LINE__, new_drive_num);
+        disk_registers.disk_drive_num = new_drive_num;
     }
     
     /* Handle motor on-off state change
@@ -612,6 +773,12 @@ static uint8_t io_handler_drive_ctrl(uint16_t address, uint8_t data, mem_operati
     else
     {
         rpi_motor_led_off(MOTOR_LED_DISK);
+
+        if ( motor_was_on )
+        {
+            sched_cancel(disk_flush_event);
+            disk_job_submit(DISK_JOB_FLUSH, 0, 0, 0);
+        }
     }
 
     dbg_printf(2, "io_handler_drive_ctrl()[%3d]: data = 0x%02x\n"   \
@@ -629,15 +796,16 @@ static uint8_t io_handler_drive_ctrl(uint16_t address, uint8_t data, mem_operati
 /*------------------------------------------------
  * disk_to_image_offset()
  *
- *  Canculate data offset into single-side disk image file.
+ *  Canculate data offset into a disk image file.
+ *  Double-sided images hold side 0 and then side 1 of each track.
  *  The image file offset does not include optional header size.
  *
- *  param:  Track and Sector
+ *  param:  Image geometry, Track, Side and Sector
  *  return: Image file offset
  */
-static uint32_t disk_to_image_offset(uint16_t track, uint16_t sector)
+static uint32_t disk_to_image_offset(disk_vdk_header_t *geometry, uint16_t track, uint16_t side, uint16_t sector)
 {
-    return (uint32_t) (SECTOR_SIZE * (SEC_PER_TRACK * track + (sector - 1)));
+    return (uint32_t) (SECTOR_SIZE * (SEC_PER_TRACK * (track * geometry->sides + side) + (sector - 1)));
 }
 
 /*------------------------------------------------
@@ -654,4 +822,443 @@ static void disk_intrq(void)
     {
         cpu_nmi_trigger();
     }
-}
\ No newline at end of file
+}
+
+/*------------------------------------------------
+ * disk_drq_event()
+ *
+ *  Scheduler event that signals data request (DRQ) while a
+ *  read or write command is active. The event creates a delay between
+ *  interrupts to compensate for emulation vs. code timing race conditions.
+ *  Once the command completes, the NMI interrupt is scheduled after a longer delay.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void disk_drq_event(void)
+{
+    if ( state == DISK_READ ||
+         state == DISK_WRITE ||
+         state == DISK_READ_ID ||
+         state == DISK_WRITE_TRK )
+    {
+        disk_registers.disk_status |= WDDRQ;
+        pia_cart_firq();
+        sched_add(DISK_INT_INTERVAL, disk_drq_event);
+    }
+    else if ( state == DISK_WAIT )
+    {
+        sched_add(DISK_INT_INTERVAL, disk_drq_event);
+    }
+    else if ( state == DISK_IDLE )
+    {
+        sched_add(DISK_INTRQ_DELAY, disk_intrq);
+    }
+    else
+    {
+        dbg_printf(0, "disk_drq_event()[%3d]: unhandled state %d.\n", __LINE__, state);
+        rpi_halt();
+    }
+}
+
+/*------------------------------------------------
+ * disk_drq_next()
+ *
+ *  With fast disk DRQ timing, bring the next DRQ event forward to
+ *  a short delay after a data register access, instead of waiting for the
+ *  1mSec DRQ interval. The delay leaves the DOS transfer loop time to
+ *  clear the PIA1-CB1 FIRQ flag before it waits in SYNC for the next byte.
+ *  This also applies to the first DRQ after a disk image job completes,
+ *  and the INTRQ after the last byte.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void disk_drq_next(void)
+{
+#if (DISK_FAST_DRQ)
+    sched_cancel(disk_drq_event);
+    sched_add(DISK_DRQ_FAST, disk_drq_event);
+#endif
+}
+
+/*------------------------------------------------
+ * disk_flush_event()
+ *
+ *  Scheduler event that writes back the disk image cache
+ *  some time after the last sector or track write.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void disk_flush_event(void)
+{
+    disk_job_submit(DISK_JOB_FLUSH, 0, 0, 0);
+}
+
+/*------------------------------------------------
+ * disk_flush_schedule()
+ *
+ *  Restart the delayed disk image cache write back after a write.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void disk_flush_schedule(void)
+{
+    sched_cancel(disk_flush_event);
+    sched_add(DISK_FLUSH_DELAY, disk_flush_event);
+}
+
+/*------------------------------------------------
+ * disk_job_event()
+ *
+ *  Scheduler event that completes the sector buffer job of a command,
+ *  DISK_JOB_LATENCY cycles after the command. If the job is still running
+ *  on the host, the event waits for it, so the command always completes
+ *  at the same emulated time.
+ *
+ *  param:  None
+ *  return: None
+ */
+static void disk_job_event(void)
+{
+    if ( state != DISK_WAIT )
+        return;
+
+    while ( !disk_job_is_done(job_wait_seq) );
+
+    state = job_next_state;
+    if ( disk_job_status(job_wait_seq) )
+    {
+        /* Sector outside the image's geometry
+         */
+        state = DISK_IDLE;
+        disk_registers.disk_status |= disk_job_status(job_wait_seq);
+    }
+
+    if ( state == DISK_IDLE )
+        disk_registers.disk_status &= ~WDBusy;
+
+    disk_drq_next();
+}
+
+/*------------------------------------------------
+ * disk_job_wait()
+ *
+ *  Wait in DISK_WAIT for the last queued job, and schedule its
+ *  completion after the fixed job latency.
+ *
+ *  param:  State to enter when the job completes
+ *  return: None
+ */
+static void disk_job_wait(disk_state_t next_state)
+{
+    state = DISK_WAIT;
+    job_wait_seq = job_submitted;
+    job_next_state = next_state;
+
+    sched_cancel(disk_job_event);
+    sched_add(DISK_JOB_LATENCY, disk_job_event);
+}
+
+/*------------------------------------------------
+ * disk_image_geometry()
+ *
+ *  Read the geometry of a drive's disk image from its VDK header.
+ *  Images without a header are single-sided and their size is not checked.
+ *
+ *  param:  Drive number
+ *  return: 1=VDK image, 0=no header
+ */
+static int disk_image_geometry(int drive)
+{
+    disk_vdk_header_t  *geometry;
+
+    geometry = &vdk_header[drive];
+
+    if ( loader_disk_img_type(drive) == FILE_VDK )
+    {
+        loader_disk_fseek(drive, 0);
+        loader_disk_fread(drive, (uint8_t*) geometry, sizeof(disk_vdk_header_t));
+        if ( geometry->sides == 0 )
+            geometry->sides = SIDES_PER_DISK;
+
+        dbg_printf(2, "                                   Disk %d: sides=%d, tracks=%d\n",
+                   drive, geometry->sides, geometry->tracks);
+        return 1;
+    }
+
+    memset(geometry, 0, sizeof(disk_vdk_header_t));
+    geometry->tracks = TRACK_PER_DISK;
+    geometry->sides = SIDES_PER_DISK;
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * disk_image_seek()
+ *
+ *  Seek a drive's disk image to the sector of a job, skipping the VDK header
+ *  if the image has one. A sector read or write outside the image's tracks
+ *  and sides sets the record-not-found status of the job.
+ *  Formatting past the last track adds tracks to the image.
+ *
+ *  param:  Pointer to job
+ *  return: Image file offset
+ */
+static uint32_t disk_image_seek(disk_job_t *job)
+{
+    disk_vdk_header_t  *geometry;
+    uint32_t            seek_address;
+    int                 is_vdk;
+
+    is_vdk = disk_image_geometry(job->drive);
+    geometry = &vdk_header[job->drive];
+
+    if ( job->side >= geometry->sides ||
+         (is_vdk && job->op != DISK_JOB_WRITE_TRK && job->track >= geometry->tracks) )
+    {
+        dbg_printf(1, "disk_image_seek()[%3d]: Drive %d, track %d side %d not in image.\n",
+                   __LINE__, job->drive, job->track, job->side);
+        job->status = WDRNF;
+        return 0;
+    }
+
+    if ( is_vdk && job->track >= geometry->tracks )
+    {
+        geometry->tracks = job->track + 1;
+        loader_disk_fseek(job->drive, 0);
+        loader_disk_fwrite(job->drive, (uint8_t*) geometry, sizeof(disk_vdk_header_t));
+    }
+
+    seek_address = disk_to_image_offset(geometry, job->track, job->side, job->sector) + geometry->header_size;
+
+    dbg_printf(2, "                                   Seek=0x%08x, track=%d, side=%d, sec=%d\n",
+               seek_address, job->track, job->side, job->sector);
+
+    loader_disk_fseek(job->drive, seek_address);
+
+    return seek_address;
+}
+
+/*------------------------------------------------
+ * disk_job_submit()
+ *
+ *  Queue a disk image job. On Linux the job runs on the worker thread,
+ *  and on bare metal multi-core on the worker core, and the call only waits
+ *  if the queue is full. Otherwise, or if the worker is not running,
+ *  the job runs before the call returns.
+ *  The job's sequence number is 'job_submitted' when the call returns.
+ *
+ *  param:  Job operation, track and sector
+ *  return: None
+ */
+static void disk_job_submit(disk_job_op_t op, uint16_t track, uint16_t side, uint16_t sector)
+{
+    disk_job_t  job;
+
+    job.op = op;
+    job.drive = disk_registers.disk_drive_num;
+    job.track = track;
+    job.side = side;
+    job.sector = sector;
+    job.status = 0;
+
+#if (RPI_BARE_METAL==0)
+    if ( job_worker_running )
+    {
+        pthread_mutex_lock(&job_lock);
+        while ( (job_submitted - job_completed) >= DISK_JOB_QUEUE )
+            pthread_cond_wait(&job_cond, &job_lock);
+
+        job_submitted++;
+        job_queue[job_submitted % DISK_JOB_QUEUE] = job;
+
+        pthread_cond_broadcast(&job_cond);
+        pthread_mutex_unlock(&job_lock);
+        return;
+    }
+#elif (RPI_MULTI_CORE==1)
+    if ( job_worker_running )
+    {
+        while ( (job_submitted - job_completed) >= DISK_JOB_QUEUE );
+
+        job_queue[(job_submitted + 1) % DISK_JOB_QUEUE] = job;
+        job_barrier();
+
+        job_submitted++;
+        __asm__ __volatile__ ("sev");
+        return;
+    }
+#endif
+
+    job_submitted++;
+    disk_job_run(&job);
+    job_queue[job_submitted % DISK_JOB_QUEUE] = job;
+    job_completed = job_submitted;
+}
+
+/*------------------------------------------------
+ * disk_job_is_done()
+ *
+ *  Check if a disk image job completed.
+ *
+ *  param:  Job sequence number
+ *  return: 1=completed, 0=pending or running
+ */
+static int disk_job_is_done(uint32_t job_seq)
+{
+    int     done;
+
+#if (RPI_BARE_METAL==0)
+    pthread_mutex_lock(&job_lock);
+    done = ((int32_t)(job_completed - job_seq) >= 0);
+    pthread_mutex_unlock(&job_lock);
+#elif (RPI_MULTI_CORE==1)
+    done = ((int32_t)(job_completed - job_seq) >= 0);
+    job_barrier();
+#else
+    done = ((int32_t)(job_completed - job_seq) >= 0);
+#endif
+
+    return done;
+}
+
+/*------------------------------------------------
+ * disk_job_status()
+ *
+ *  Return the error status of a completed disk image job.
+ *  The status stays available until the job's queue slot is reused.
+ *
+ *  param:  Job sequence number
+ *  return: WD2797 error status bits, 0=no error
+ */
+static uint8_t disk_job_status(uint32_t job_seq)
+{
+    uint8_t     status;
+
+#if (RPI_BARE_METAL==0)
+    pthread_mutex_lock(&job_lock);
+    status = job_queue[job_seq % DISK_JOB_QUEUE].status;
+    pthread_mutex_unlock(&job_lock);
+#else
+    status = job_queue[job_seq % DISK_JOB_QUEUE].status;
+#endif
+
+    return status;
+}
+
+/*------------------------------------------------
+ * disk_job_run()
+ *
+ *  Execute a disk image job.
+ *
+ *  param:  Pointer to job
+ *  return: None
+ */
+static void disk_job_run(disk_job_t *job)
+{
+    uint32_t    seek_address;
+
+    stats_timer_start(STATS_DISK_IO);
+
+    switch ( job->op )
+    {
+        case DISK_JOB_READ_SEC:
+            disk_image_seek(job);
+            if ( !job->status )
+                loader_disk_fread(job->drive, buffer, SECTOR_SIZE);
+            break;
+
+        case DISK_JOB_WRITE_SEC:
+            disk_image_seek(job);
+            if ( !job->status )
+                loader_disk_fwrite(job->drive, buffer, SECTOR_SIZE);
+            break;
+
+        case DISK_JOB_WRITE_TRK:
+            seek_address = disk_image_seek(job);
+            if ( job->status )
+                break;
+
+            dbg_printf(2, "                                   Writing track %d side %d (0x%08x).\n", job->track, job->side, seek_address);
+
+            memset(buffer, INIT_SEC_FILL, BYTES_PER_TRACK);
+            loader_disk_fwrite(job->drive, buffer, BYTES_PER_TRACK);
+            break;
+
+        case DISK_JOB_FLUSH:
+            loader_disk_flush();
+            break;
+    }
+
+    stats_timer_stop(STATS_DISK_IO);
+}
+
+#if (RPI_BARE_METAL==0)
+/*------------------------------------------------
+ * disk_job_worker()
+ *
+ *  Disk image worker thread, runs queued jobs in order.
+ *
+ *  param:  Unused
+ *  return: Never returns
+ */
+static void *disk_job_worker(void *arg)
+{
+    disk_job_t  job;
+
+    pthread_mutex_lock(&job_lock);
+
+    for (;;)
+    {
+        while ( job_completed == job_submitted )
+            pthread_cond_wait(&job_cond, &job_lock);
+
+        job = job_queue[(job_completed + 1) % DISK_JOB_QUEUE];
+        pthread_mutex_unlock(&job_lock);
+
+        disk_job_run(&job);
+
+        pthread_mutex_lock(&job_lock);
+        job_queue[(job_completed + 1) % DISK_JOB_QUEUE].status = job.status;
+        job_completed++;
+        pthread_cond_broadcast(&job_cond);
+    }
+
+    return NULL;
+}
+#endif
+
+#if (RPI_MULTI_CORE==1)
+/*------------------------------------------------
+ * disk_job_core()
+ *
+ *  Bare metal disk image worker, runs queued jobs in order
+ *  on its own core. The core sleeps on WFE while the queue is empty.
+ *
+ *  param:  None
+ *  return: Never returns
+ */
+static void disk_job_core(void)
+{
+    disk_job_t  job;
+
+    for (;;)
+    {
+        while ( job_completed == job_submitted )
+            __asm__ __volatile__ ("wfe");
+
+        job_barrier();
+
+        job = job_queue[(job_completed + 1) % DISK_JOB_QUEUE];
+        disk_job_run(&job);
+        job_queue[(job_completed + 1) % DISK_JOB_QUEUE].status = job.status;
+
+        job_barrier();
+
+        job_completed++;
+    }
+}
+#endif
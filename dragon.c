@@ -8,6 +8,9 @@
  *
  *******************************************************************/
 
+#include    <string.h>
+#include    <stdlib.h>
+
 #include    "trace.h"
 
 #include    "config.h"
@@ -16,16 +19,27 @@
 #include    "mem.h"
 #include    "cpu.h"
 #include    "rpi.h"
+#include    "sched.h"
 #if (RPI_BARE_METAL==1)
   #include    "rpi-bm/gpio.h"
 #endif
 
 #include    "sam.h"
 #include    "vdg.h"
+#include    "intr.h"
 #include    "pia.h"
 #include    "disk.h"
+#include    "audio.h"
+#include    "joystk.h"
+#include    "kbd.h"
 #include    "fat32.h"
 #include    "loader.h"
+#include    "stats.h"
+#include    "state.h"
+#include    "replay.h"
+#if (DRAGON_MODEL==64)
+  #include    "acia.h"
+#endif
 
 /* -----------------------------------------
    Dragon 32 ROM image
@@ -38,24 +52,94 @@
 ----------------------------------------- */
 #define     DRAGON_ROM_START        0x8000
 #define     DRAGON_ROM_END          0xfeff
+#define     DRAGON_ROM_CSRDON       0xbde7  // Cassette motor on and leader sync
+#define     DRAGON_ROM_BLKIN        0xb93e  // Cassette block input
+#define     DRAGON_ROM_WRTLDR       0xbe68  // Cassette motor on and leader output
+#define     DRAGON_ROM_BLKOUT       0xb999  // Cassette block output
+#define     DRAGON64_ROM_SIZE       16384
+#define     DRAGON64_ROM1_FILE      "D64_1.ROM"     // Dragon 64 '32 mode' BASIC ROM on the SD card
+#define     DRAGON64_ROM2_FILE      "D64_2.ROM"     // Dragon 64 '64 mode' BASIC ROM
 #define     ESCAPE_LOADER           1       // Pressing F1
+#define     SPEED_TOGGLE            2       // Pressing F2
+#define     STATS_OVERLAY           3       // Pressing F3
+#define     STATS_DUMP              4       // Pressing F4
+#define     PROFILE_REPORT          5       // Pressing F5
+#define     DEBUG_BREAK             6       // Pressing F6
+#define     HISTORY_DUMP            7       // Pressing F7
+#define     STATE_SAVE              8       // Pressing F8
+#define     STATE_RESTORE           9       // Pressing F9
+#define     REPLAY_TOGGLE           10      // Pressing F10
 #define     LONG_RESET_DELAY        1500000 // Micro-seconds to force cold start
-#define     VDG_REFRESH_INTERVAL    ((uint32_t)(1000000/50))
+#define     VDG_REFRESH_INTERVAL    ((uint32_t)(SCHED_CPU_CLOCK_HZ/50))     // In CPU cycles
+#define     VDG_LINE_INTERVAL       (VDG_REFRESH_INTERVAL/VDG_FIELD_LINES)  // Scan line time in CPU cycles
+#define     VDG_BAND_INTERVAL       (VDG_LINE_INTERVAL*VDG_BAND_LINES)      // Band of scan lines in CPU cycles
 #define     HALF_SECOND             ((uint32_t)(500000))
+#define     CPU_BATCH_CYCLES        500     // CPU cycles to run between peripheral service calls
+#define     THROTTLE_MAX_LAG        100000  // Micro-seconds behind real time before re-synchronizing
+#define     TURBO_RENDER_RATE       10      // Render one in this many frames in turbo mode
+#define     FRAME_SKIP_MAX          2       // Render down to one in 2^FRAME_SKIP_MAX frames (12.5Hz)
+#define     FRAME_SKIP_LAG_HIGH     10000   // Micro-seconds behind real time to skip more frames
+#define     FRAME_SKIP_LAG_LOW      2000    // Micro-seconds behind real time to skip fewer frames
+#define     FRAME_SKIP_HOLD         50      // Frames to stay under the low lag before skipping fewer frames
+
+/* Host time of the real-time throttle in micro-seconds. On bare metal it is
+ * counted by the host tick interrupt, so the emulation loop reads a word in
+ * memory and sleeps until the next interrupt, instead of polling the System Timer.
+ */
+#if (RPI_BARE_METAL==1)
+    #define     host_time()         (rpi_tick_count * RPI_TICK_USEC)
+    #define     host_time_wait()    rpi_tick_wait()
+#else
+    #define     host_time()         rpi_system_timer()
+    #define     host_time_wait()
+#endif
+
+/* -----------------------------------------
+   Module types
+----------------------------------------- */
+typedef enum
+{
+    SPEED_REAL_TIME = 0,    // Throttle emulation to real time
+    SPEED_TURBO     = 1,    // Run flat out and render at a decimated frame rate
+} speed_mode_t;
 
 /********** Trace / Breakpoint **********/
 #if (RPI_BARE_METAL==0)
 cpu_state_t     cpu_state;
 cpu_run_state_t run_state;
 int             breakpoint_trigger = 0;
-uint16_t        breakpoint = 0xc179;        // 'DOSLowLevel' 0xc169 line #4024
 #endif
 /****************************************/
 
 /* -----------------------------------------
    Module functions
 ----------------------------------------- */
-static int get_reset_state(uint32_t time);
+static int  get_reset_state(uint32_t time);
+static int  reset_poll(void);
+static void vsync_event(void);
+static void band_event(void);
+static void hsync_event(void);
+static void throttle(int cycles);
+static void throttle_reset(void);
+static int  throttle_lag(void);
+static int  frame_skip_rate(void);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint32_t     host_time_mark;
+static uint32_t     throttle_cycles;
+static speed_mode_t speed_mode = SPEED_REAL_TIME;
+static int          frame_count = 0;
+static int          render_frame = 1;
+static int          frame_skip = 0;         // Render one in 2^frame_skip frames in real-time mode
+static int          frame_skip_hold = 0;
+static int          band = 0;
+static int          field_start = 0;        // A VDG field started in the last CPU batch
+static replay_mode_t replay_request = REPLAY_OFF;   // Start recording or playback at the next field
+#if (RPI_BARE_METAL==1)
+static uint32_t     button_tick = 0;        // Host tick of the last reset button poll
+#endif
 
 /*------------------------------------------------
  * main()
@@ -68,8 +152,72 @@ static int get_reset_state(uint32_t time);
 #endif
 {
     uint32_t    last_refresh_time;
-    int         i, no_disk;
+    uint32_t    budget;
+    int         no_disk;
+    int         cycles;
     int         emulator_escape_code;
+#if (RPI_BARE_METAL==0)
+    int         i;
+    int         benchmark = 0;
+    int         headless = 0;
+    int         frame_hash = 0;
+    int         snapshot_interval = 0;
+    int         replay_exit = 0;
+
+    /* Command line options
+     */
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strcmp(argv[i], "-t") == 0 )
+        {
+            speed_mode = SPEED_TURBO;
+        }
+        else if ( strcmp(argv[i], "-b") == 0 )
+        {
+            benchmark = 1;
+        }
+        else if ( strcmp(argv[i], "-H") == 0 )
+        {
+            headless = 1;
+        }
+        else if ( strcmp(argv[i], "-f") == 0 )
+        {
+            frame_hash = 1;
+        }
+        else if ( strcmp(argv[i], "-r") == 0 )
+        {
+            replay_request = REPLAY_PLAY;
+            replay_exit = 1;
+        }
+        else if ( strcmp(argv[i], "-s") == 0 && (i + 1) < argc && atoi(argv[i + 1]) > 0 )
+        {
+            snapshot_interval = atoi(argv[++i]);
+        }
+        else
+        {
+            dbg_printf(0, "Usage: %s [-t] [-b] [-H] [-f] [-r] [-s <frames>]\n", argv[0]);
+            dbg_printf(0, "  -t  start in turbo (unthrottled) speed mode\n");
+            dbg_printf(0, "  -b  run the video rendering benchmark and exit\n");
+            dbg_printf(0, "  -H  headless, render video to memory instead of /dev/fb0\n");
+            dbg_printf(0, "  -f  print a hash of every rendered frame\n");
+            dbg_printf(0, "  -r  replay the recorded input session and exit\n");
+            dbg_printf(0, "  -s  write a PPM snapshot every <frames> rendered frames, or on SIGUSR1\n");
+            return 1;
+        }
+    }
+
+    rpi_fb_output(headless, frame_hash, snapshot_interval);
+
+    /* The rendering benchmark only needs the video path,
+     * so it runs without GPIO and SD card, and headless on any Linux host
+     */
+    if ( benchmark )
+    {
+        vdg_init();
+        vdg_benchmark(VDG_BENCH_FRAMES);
+        return 0;
+    }
+#endif
 
     /* System GPIO initialization
      */
@@ -82,26 +230,42 @@ static int get_reset_state(uint32_t time);
     {
         dbg_printf(2, "GPIO initialized.\n");
     }
-    
-    if ( (i = fat32_init()) != NO_ERROR )
-    {
-        dbg_printf(0, "FAT32 initialization failed (%d).\n", i);
-    }
-    else
-    {
-        dbg_printf(2, "FAT32 on SD initialized.\n");
-    }
-    
-    dbg_printf(0, "Dragon 32 %s %s\n", __DATE__, __TIME__);
+
+    /* The SD card is mounted while the emulation starts
+     */
+    loader_mount();
+
+    dbg_printf(0, "Dragon %d %s %s\n", DRAGON_MODEL, __DATE__, __TIME__);
     dbg_printf(0, "Debug level = %d\n", DEBUG_LVL);
 
+    dbg_printf(1, "Speed mode: %s (F2 to toggle)\n", (speed_mode == SPEED_TURBO) ? "turbo" : "real-time");
+
     /* Emulation initialization
      */
     dbg_printf(1, "Initializing peripherals.\n");
     loader_init();
     sam_init();
+    audio_init();
+    joystk_init();
+    kbd_init();
+    intr_init();
     pia_init();
     vdg_init();
+    stats_init();
+    replay_init();
+
+#if (AUDIO_STREAM==1)
+    rpi_audio_start(AUDIO_SAMPLE_RATE, audio_sample);
+#endif
+#if (JOYSTK_SAMPLER==1)
+    rpi_joystk_start(joystk_sample_step);
+#endif
+#if (KBD_READER==1)
+    rpi_keyboard_start(kbd_poll_step);
+#endif
+#if (RPI_BARE_METAL==1)
+    rpi_tick_start();
+#endif
 
     /* If joystick button is pressed during bootup
      * then don't install disk support.
@@ -119,8 +283,30 @@ static int get_reset_state(uint32_t time);
      */
     dbg_printf(1, "Loading ROM.\n");
 
+#if (DRAGON_MODEL==64)
+    /* The Dragon 64 ROMs are read from the SD card, with the built-in
+     * Dragon 32 ROM in place of a missing '32 mode' ROM
+     */
+    if ( loader_state_fread(DRAGON64_ROM1_FILE, mem_block_load_buffer(MEM_BLOCK_ROM, 0, DRAGON64_ROM_SIZE), DRAGON64_ROM_SIZE) == DRAGON64_ROM_SIZE )
+    {
+        dbg_printf(2, "  Loaded %s, %i bytes.\n", DRAGON64_ROM1_FILE, DRAGON64_ROM_SIZE);
+    }
+    else
+    {
+        dbg_printf(0, "Dragon 64 ROM %s not found, using the Dragon 32 ROM.\n", DRAGON64_ROM1_FILE);
+        mem_load(LOAD_ADDRESS, code, sizeof(code));
+    }
+
+    if ( loader_state_fread(DRAGON64_ROM2_FILE, mem_block_load_buffer(MEM_BLOCK_ROM2, 0, DRAGON64_ROM_SIZE), DRAGON64_ROM_SIZE) == DRAGON64_ROM_SIZE )
+        dbg_printf(2, "  Loaded %s, %i bytes.\n", DRAGON64_ROM2_FILE, DRAGON64_ROM_SIZE);
+    else
+        dbg_printf(0, "Dragon 64 ROM %s not found, 64 mode will not start.\n", DRAGON64_ROM2_FILE);
+
+    acia_init();
+#else
     mem_load(LOAD_ADDRESS, code, sizeof(code));
     dbg_printf(2, "  Loaded Dragon 32, %i bytes.\n", sizeof(code));
+#endif
 
     if ( !no_disk )
     {
@@ -134,20 +320,90 @@ static int get_reset_state(uint32_t time);
     dbg_printf(2, "Initializing CPU.\n");
     cpu_init(RUN_ADDRESS);
 
+    /* The cassette traps are at Dragon 32 ROM addresses
+     */
+#if (CAS_FAST_LOAD==1) && (DRAGON_MODEL==32)
+    cpu_trap(DRAGON_ROM_CSRDON, pia_cas_csrdon);
+    cpu_trap(DRAGON_ROM_BLKIN, pia_cas_blkin);
+    dbg_printf(2, "  Cassette fast load.\n");
+#endif
+
+#if (CAS_SAVE==1) && (DRAGON_MODEL==32)
+    cpu_trap(DRAGON_ROM_WRTLDR, pia_cas_wrtldr);
+    cpu_trap(DRAGON_ROM_BLKOUT, pia_cas_blkout);
+    dbg_printf(2, "  Cassette save to CAS files.\n");
+#endif
+
     /* CPU endless execution loop.
      */
     dbg_printf(1, "Starting CPU.\n");
     cpu_reset(1);
 
-    last_refresh_time = rpi_system_timer();
+    /* Emulated-time events, timed in CPU cycles
+     */
+    sched_init();
+    sched_add(VDG_REFRESH_INTERVAL, vsync_event);
+
+    throttle_reset();
+
+#if (RPI_BARE_METAL==0)
+    /* Keep the emulation on its own core, away from the
+     * render thread and the IO threads started above
+     */
+    rpi_cpu_pin(EMU_CPU_CORE);
+#endif
 
     for (;;)
     {
+        /* Run the CPU up to the next scheduled event
+         */
+        budget = sched_cycles_to_next();
+        if ( budget > CPU_BATCH_CYCLES )
+            budget = CPU_BATCH_CYCLES;
+
         //rpi_testpoint_on();
-        cpu_run();
+#if (RPI_BARE_METAL==0)
+        /* Single step while tracing
+         */
+        run_state = cpu_run_cycles((breakpoint_trigger ? 1 : budget), &cycles);
+#else
+        cpu_run_cycles(budget, &cycles);
+#endif
         //rpi_testpoint_off();
 
-        switch ( get_reset_state(LONG_RESET_DELAY) )
+        sched_advance(cycles);
+
+        /* Input recording and playback start at the beginning of a VDG field
+         * so the recorded session and its playback have the same field timing
+         */
+        if ( field_start && replay_request != REPLAY_OFF )
+        {
+            if ( replay_request == REPLAY_RECORD )
+                replay_record_start();
+            else if ( replay_play_start() )
+                stats_reset();
+#if (RPI_BARE_METAL==0)
+            else if ( replay_exit )
+                return 1;
+#endif
+            replay_request = REPLAY_OFF;
+            throttle_reset();
+        }
+        field_start = 0;
+
+        if ( replay_done() )
+        {
+            replay_stop();
+#if (RPI_BARE_METAL==0)
+            if ( replay_exit )
+                return 0;
+#endif
+        }
+
+        if ( speed_mode == SPEED_REAL_TIME )
+            throttle(cycles);
+
+        switch ( replay_event(REPLAY_RESET, reset_poll()) )
         {
             case 0:
                 cpu_reset(0);
@@ -172,38 +428,97 @@ static int get_reset_state(uint32_t time);
 
         emulator_escape_code = pia_function_key();
         if ( emulator_escape_code == ESCAPE_LOADER )
+        {
+            replay_stop();
+            disk_io_sync();
             loader();
-
-        if ( (rpi_system_timer() - last_refresh_time) >= VDG_REFRESH_INTERVAL )
+            stats_reset();
+        }
+        else if ( emulator_escape_code == SPEED_TOGGLE )
         {
-            last_refresh_time = rpi_system_timer();
-            //rpi_testpoint_on();
-            vdg_render();
-            //rpi_testpoint_off();
-            pia_vsync_irq();
+            if ( speed_mode == SPEED_REAL_TIME )
+            {
+                speed_mode = SPEED_TURBO;
+            }
+            else
+            {
+                speed_mode = SPEED_REAL_TIME;
+                throttle_reset();
+            }
+            dbg_printf(1, "Speed mode: %s\n", (speed_mode == SPEED_TURBO) ? "turbo" : "real-time");
         }
-        
-        /********** Trace / Breakpoint **********/
+        else if ( emulator_escape_code == STATS_OVERLAY )
+        {
+            stats_overlay_toggle();
+        }
+        else if ( emulator_escape_code == STATS_DUMP )
+        {
+            stats_dump_toggle();
+        }
+        else if ( emulator_escape_code == STATE_SAVE )
+        {
+            state_save(STATE_FILE_NAME);
+            throttle_reset();
+        }
+        else if ( emulator_escape_code == STATE_RESTORE )
+        {
+            replay_stop();
+            state_restore(STATE_FILE_NAME);
+            throttle_reset();
+            stats_reset();
+        }
+        else if ( emulator_escape_code == REPLAY_TOGGLE )
+        {
+            if ( replay_mode() == REPLAY_OFF )
+                replay_request = REPLAY_RECORD;
+            else
+                replay_stop();
+            throttle_reset();
+        }
+#if (RPI_BARE_METAL==0 && CPU_PROFILE==1)
+        else if ( emulator_escape_code == PROFILE_REPORT )
+        {
+            trace_print_profile();
+            cpu_profile_reset();
+        }
+#endif
 #if (RPI_BARE_METAL==0)
+        else if ( emulator_escape_code == DEBUG_BREAK )
+        {
+            breakpoint_trigger = 1;
+        }
+        else if ( emulator_escape_code == HISTORY_DUMP )
+        {
+            trace_print_history();
+        }
+#endif
 
-        run_state = cpu_get_state(&cpu_state);
+        /********** Trace / Breakpoint **********/
+#if (RPI_BARE_METAL==0)
 
-        if ( cpu_state.cpu_state == CPU_EXCEPTION )
+        /* The CPU state is only needed when execution stops,
+         * the CPU checks breakpoints and watchpoints itself
+         */
+        if ( run_state == CPU_EXCEPTION )
         {
+            cpu_get_state(&cpu_state);
             dbg_printf(0, "Op-code Exception at pc=0x%04x last_pc=0x%04x\n", cpu_state.pc, cpu_state.last_pc);
+            if ( !breakpoint_trigger )
+                trace_print_history();
             breakpoint_trigger = 1;
         }
 
-        //if ( cpu_state.pc == breakpoint )
-        if ( 0 )
+        if ( cpu_break_hit() )
         {
+            trace_print_watch();
             breakpoint_trigger = 1;
         }
 
         if ( breakpoint_trigger )
         {
+            cpu_get_state(&cpu_state);
             trace_print_registers(&cpu_state);
-            breakpoint_trigger = trace_action(&breakpoint);
+            breakpoint_trigger = trace_action();
         }
         
 #endif
@@ -249,3 +564,241 @@ static int get_reset_state(uint32_t time)
 
     return reset_type;
 }
+
+/*------------------------------------------------
+ * reset_poll()
+ *
+ * Poll the reset button from the emulation loop. On bare metal the GPIO
+ * is read once per host tick instead of after every CPU batch.
+ * The result still goes through replay_event() after every batch,
+ * so a recorded reset replays at its recorded CPU cycle.
+ *
+ * param:  None
+ * return: '0'=no press, '1'=short reset, '2'=long reset press.
+ *
+ */
+static int reset_poll(void)
+{
+#if (RPI_BARE_METAL==1)
+    if ( rpi_tick_count == button_tick )
+        return 0;
+
+    button_tick = rpi_tick_count;
+#endif
+
+    return get_reset_state(LONG_RESET_DELAY);
+}
+
+/*------------------------------------------------
+ * vsync_event()
+ *
+ * Scheduler event at the VDG field rate that starts a field.
+ * The field's active scan lines are rendered to the frame buffer band by band
+ * by band_event(), and the VSYNC IRQ is generated at the end of the active area.
+ * Turbo speed mode renders at a decimated frame rate, and real-time mode
+ * skips frames when the emulation falls behind real time.
+ * The field is counted by the performance counters, and input recording
+ * or playback can start at the beginning of the field.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void vsync_event(void)
+{
+    int     render_rate;
+
+    /* In turbo mode, or when falling behind in real-time mode, only render
+     * a fraction of the frames, but keep the VSYNC IRQ at every frame for BASIC timing.
+     */
+    if ( speed_mode == SPEED_TURBO )
+        render_rate = TURBO_RENDER_RATE;
+    else
+        render_rate = frame_skip_rate();
+
+    frame_count++;
+    render_frame = 0;
+    if ( frame_count >= render_rate )
+    {
+        render_frame = 1;
+        frame_count = 0;
+    }
+
+    stats_frame(render_frame);
+
+    field_start = 1;
+
+    band = 0;
+    sched_add(VDG_BAND_INTERVAL, band_event);
+
+    sched_add(VDG_REFRESH_INTERVAL, vsync_event);
+}
+
+/*------------------------------------------------
+ * band_event()
+ *
+ * Scheduler event at the end of each band of VDG_BAND_LINES active scan lines,
+ * that renders the band so that rendering is spread over the field.
+ * After the last band, generate the VSYNC IRQ.
+ * The event also keeps the HSYNC status in PIA0 up to date, and starts
+ * per-line HSYNC events when line sync timing is in use.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void band_event(void)
+{
+    if ( render_frame )
+    {
+        stats_timer_start(STATS_RENDER);
+        vdg_render_band(band);
+        stats_timer_stop(STATS_RENDER);
+    }
+
+    if ( !sched_is_pending(hsync_event) )
+    {
+        pia_hsync_irq();
+        if ( pia_hsync_active() )
+            sched_add(VDG_LINE_INTERVAL, hsync_event);
+    }
+
+    band++;
+    if ( band < VDG_BANDS )
+        sched_add(VDG_BAND_INTERVAL, band_event);
+    else
+        pia_vsync_irq();
+}
+
+/*------------------------------------------------
+ * hsync_event()
+ *
+ * Scheduler event at the scan line rate that generates the HSYNC.
+ * The event runs only while line sync timing is in use,
+ * see pia_hsync_active().
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void hsync_event(void)
+{
+    pia_hsync_irq();
+
+    if ( pia_hsync_active() )
+        sched_add(VDG_LINE_INTERVAL, hsync_event);
+}
+
+/*------------------------------------------------
+ * throttle()
+ *
+ * Hold emulation back to real time by comparing emulated time,
+ * in CPU cycles, with host time, see host_time().
+ * If the emulation falls too far behind, for example after time spent
+ * in the loader, then re-synchronize instead of trying to catch up.
+ *
+ * param:  CPU cycles executed since last call
+ * return: None
+ *
+ */
+static void throttle(int cycles)
+{
+    uint32_t    emulated_time;
+
+    throttle_cycles += cycles;
+    if ( throttle_cycles < CPU_BATCH_CYCLES )
+        return;
+
+    emulated_time = (uint32_t)(((uint64_t)throttle_cycles * 1000000) / SCHED_CPU_CLOCK_HZ);
+
+    if ( (host_time() - host_time_mark) > (emulated_time + THROTTLE_MAX_LAG) )
+    {
+        throttle_reset();
+        return;
+    }
+
+    while ( (host_time() - host_time_mark) < emulated_time )
+        host_time_wait();
+
+    host_time_mark += emulated_time;
+    throttle_cycles -= SCHED_USEC_TO_CYCLES(emulated_time);
+}
+
+/*------------------------------------------------
+ * throttle_reset()
+ *
+ * Re-synchronize the real-time throttle to the host's system timer.
+ *
+ * param:  None
+ * return: None
+ *
+ */
+static void throttle_reset(void)
+{
+    host_time_mark = host_time();
+    throttle_cycles = 0;
+}
+
+/*------------------------------------------------
+ * throttle_lag()
+ *
+ * Return how far the emulation is behind real time, as measured by the
+ * real-time throttle since it was last synchronized.
+ *
+ * param:  None
+ * return: Micro-seconds behind real time, negative if ahead
+ *
+ */
+static int throttle_lag(void)
+{
+    uint32_t    emulated_time;
+
+    emulated_time = (uint32_t)(((uint64_t)throttle_cycles * 1000000) / SCHED_CPU_CLOCK_HZ);
+
+    return (int32_t)((host_time() - host_time_mark) - emulated_time);
+}
+
+/*------------------------------------------------
+ * frame_skip_rate()
+ *
+ * Adaptive frame skip for real-time speed mode.
+ * Halve the render rate, down to 12.5Hz, whenever the emulation is falling
+ * behind real time, and double it again after the emulation has been keeping
+ * up for FRAME_SKIP_HOLD frames.
+ *
+ * param:  None
+ * return: Render one in this many frames
+ *
+ */
+static int frame_skip_rate(void)
+{
+    int     lag;
+
+    lag = throttle_lag();
+
+    if ( lag > FRAME_SKIP_LAG_HIGH )
+    {
+        if ( frame_skip < FRAME_SKIP_MAX )
+        {
+            frame_skip++;
+            dbg_printf(2, "Frame skip: render 1 in %d frames\n", (1 << frame_skip));
+        }
+        frame_skip_hold = 0;
+    }
+    else if ( lag < FRAME_SKIP_LAG_LOW && frame_skip > 0 )
+    {
+        frame_skip_hold++;
+        if ( frame_skip_hold >= FRAME_SKIP_HOLD )
+        {
+            frame_skip--;
+            frame_skip_hold = 0;
+            dbg_printf(2, "Frame skip: render 1 in %d frames\n", (1 << frame_skip));
+        }
+    }
+    else
+    {
+        frame_skip_hold = 0;
+    }
+
+    return (1 << frame_skip);
+}
@@ -15,7 +15,9 @@
 #include    <stdio.h>
 #include    <assert.h>
 
+#include    "config.h"
 #include    "sd.h"
+#include    "stats.h"
 #include    "fat32.h"
 
 /* -----------------------------------------
@@ -47,6 +49,10 @@
 
 #define     MIN(a, b) (( a < b ) ? a : b)
 
+#if (FAT32_CACHE_SECTORS < 1)
+    #error "FAT32_CACHE_SECTORS must be at least 1"
+#endif
+
 /* -----------------------------------------
    Module types
 ----------------------------------------- */
@@ -112,14 +118,25 @@ typedef struct
 ----------------------------------------- */
 static error_t  fat32_read_sector(uint32_t lba, uint8_t *buffer, uint16_t buffer_len);
 static error_t  fat32_write_sector(uint32_t lba, uint8_t *buffer, uint16_t buffer_len);
+static error_t  fat32_read_sectors(uint32_t lba, uint8_t *buffer, uint16_t count);
+static error_t  fat32_write_sectors(uint32_t lba, uint8_t *buffer, uint16_t count);
+static int      fat32_cache_lookup(uint32_t lba);
+static error_t  fat32_cache_evict(int *entry);
 static error_t  fat32_get_next_cluster_num(uint32_t cluster_num, uint32_t *next_cluster_num);
 static error_t  fat32_get_new_cluster(uint32_t *new_cluster_num);
 static error_t  fat32_update_cluster_chain(uint32_t cluster_num, uint32_t new_cluster_num);
 static error_t  fat32_update_file_size(file_param_t *file, uint32_t file_size);
 static uint32_t fat32_get_cluster_base_lba(uint32_t);
+static void     fat32_map_clusters(file_param_t *file);
+static int      fat32_map_append(file_param_t *file, uint32_t cluster_num);
+static uint32_t fat32_map_lookup(file_param_t *file, uint32_t cluster_index);
+static error_t  fat32_get_file_next_cluster(file_param_t *file, uint32_t cluster_num, uint32_t *next_cluster_num);
+static uint16_t fat32_get_run_sectors(file_param_t *file, uint32_t cluster_num, uint8_t lba_index, uint16_t max_sectors);
+static void     fat32_write_done(error_t result);
 
 static int      dir_get_sfn(dir_record_t *dir_record, char *name, uint16_t name_length);
 static int      dir_get_lfn(dir_record_t *dir_record, char *name, uint16_t name_length);
+static int      dir_make_sfn(char *file_name, char *sfn);
 
 /* -----------------------------------------
    Module globals
@@ -131,6 +148,27 @@ static uint8_t *low_sector_buffer;
 static uint8_t *high_sector_buffer;
 static uint32_t absolute_lba_cached = 0;
 
+/* Write-back sector cache with least recently used eviction,
+ * shared by fat32_read_sector() and fat32_write_sector()
+ */
+static struct sector_cache_t
+{
+    int         valid;
+    int         dirty;
+    uint32_t    lba;
+    uint32_t    last_use;
+    uint8_t     data[FAT32_SEC_SIZE];
+} sector_cache[FAT32_CACHE_SECTORS];
+
+static uint32_t cache_use_count = 0;
+static uint32_t cache_hits = 0;
+static uint32_t cache_misses = 0;
+
+/* Modified sectors are written back with interrupt driven SD writes.
+ * A data block the card did not accept is reported by fat32_flush().
+ */
+static volatile error_t write_status = NO_ERROR;
+
 static struct fat_param_t
 {
     uint32_t    first_lba;
@@ -160,6 +198,11 @@ error_t fat32_init(void)
         return result;
     }
 
+    /* Start with an empty sector cache for the new card
+     */
+    memset(sector_cache, 0, sizeof(sector_cache));
+    absolute_lba_cached = 0;
+
     /* Initialize two buffer pointers
      */
     low_sector_buffer = &temp_sector_buffer[0];
@@ -218,6 +261,7 @@ error_t fat32_init(void)
     fat32_parameters.root_dir_first_cluster = bpb.cluster_number_root_dir;
     fat32_parameters.sectors_per_fat = bpb.logical_sectors_per_fat;
 
+    write_status = NO_ERROR;
     fat32_initialized = 1;
 
     return NO_ERROR;
@@ -240,10 +284,67 @@ void fat32_close(void)
     if ( !fat32_initialized )
         return;
 
+    fat32_flush();
     sd_close();
     fat32_initialized = 0;
 }
 
+/* -------------------------------------------------------------
+ * fat32_flush()
+ *
+ *  Write all modified sectors in the sector cache to the SD card,
+ *  and wait for the last interrupt driven write to complete.
+ *
+ *  Param:  None
+ *  Return: Driver error, of the writes since the last flush
+ */
+error_t fat32_flush(void)
+{
+    int         i;
+    error_t     result;
+
+    if ( !fat32_initialized )
+        return NO_ERROR;
+
+    for ( i = 0; i < FAT32_CACHE_SECTORS; i++ )
+    {
+        if ( sector_cache[i].valid && sector_cache[i].dirty )
+        {
+            stats_timer_start(STATS_SD);
+            result = sd_write_block_async(sector_cache[i].lba, sector_cache[i].data, fat32_write_done);
+            stats_timer_stop(STATS_SD);
+            if ( result != NO_ERROR )
+            {
+                return result;
+            }
+
+            sector_cache[i].dirty = 0;
+        }
+    }
+
+    while ( sd_is_busy() );
+
+    result = write_status;
+    write_status = NO_ERROR;
+
+    return result;
+}
+
+/* -------------------------------------------------------------
+ * fat32_cache_stats()
+ *
+ *  Return the sector cache hit and miss counts since initialization,
+ *  for tuning FAT32_CACHE_SECTORS.
+ *
+ *  Param:  Pointers to hit and miss count return variables
+ *  Return: None
+ */
+void fat32_cache_stats(uint32_t *hits, uint32_t *misses)
+{
+    *hits = cache_hits;
+    *misses = cache_misses;
+}
+
 /* -------------------------------------------------------------
  * fat32_is_initialized()
  *
@@ -447,16 +548,167 @@ int fat32_parse_dir(uint32_t start_cluster, dir_entry_t *directory_list, uint16_
 /* -------------------------------------------------------------
  * fat32_fcreate()
  *
- *  TODO: Stub for file or directory creation.
- *  Create a file or directory passed by name, in the parent
- *  directory pointed to by 'directory'.
+ *  Create an empty file passed by a DOS 8.3 name, in the parent
+ *  directory whose start cluster is in 'directory'. The file's first cluster
+ *  is allocated, so the file can be opened with fat32_fopen() and written
+ *  with fat32_fwrite(). A directory that has no free record is extended
+ *  by a cluster. No long file name records are written.
+ *  On return 'directory' holds the new file's directory entry.
  *
- *  Param:  File or directory name
+ *  TODO: Directory creation is not supported.
+ *
+ *  Param:  File name, pointer to the parent directory's entry
  *  Return: Error code
  */
 error_t fat32_fcreate(char *file_name, dir_entry_t *directory)
 {
-    return FAT_FILE_NOT_FOUND;
+    dir_record_t    dir_sector[FAT32_SEC_SIZE / sizeof(dir_record_t)];
+    char            sfn[FAT32_DOS_FILE_NAME - 2];
+    uint32_t        dir_cluster_num, next_cluster_num, file_cluster_num;
+    uint32_t        dir_base_cluster_lba, free_record_lba;
+    int             dir_sector_num, dir_record_num, free_record_num;
+    int             done;
+    error_t         result;
+
+    if ( !fat32_initialized )
+        return FAT_WRITE_FAIL;
+
+    if ( !dir_make_sfn(file_name, sfn) )
+        return FAT_FILE_NAME_ERR;
+
+    /* Scan the directory for the first free record, and for
+     * a file with the same name, up to the end-of-directory record.
+     */
+    dir_cluster_num = directory->cluster_chain_head;
+    free_record_lba = 0;
+    free_record_num = 0;
+    done = 0;
+
+    while ( !done )
+    {
+        dir_base_cluster_lba = fat32_get_cluster_base_lba(dir_cluster_num);
+
+        for ( dir_sector_num = 0; !done && dir_sector_num < fat32_parameters.sectors_per_cluster; dir_sector_num++ )
+        {
+            result = fat32_read_sector((dir_base_cluster_lba + dir_sector_num), (uint8_t*) dir_sector, FAT32_SEC_SIZE);
+            if ( result != NO_ERROR )
+            {
+                return result;
+            }
+
+            for ( dir_record_num = 0; dir_record_num < (FAT32_SEC_SIZE / sizeof(dir_record_t)); dir_record_num++ )
+            {
+                if ( (uint8_t) dir_sector[dir_record_num].short_dos_name[0] == 0 ||
+                     (uint8_t) dir_sector[dir_record_num].short_dos_name[0] == 0xe5 )
+                {
+                    if ( free_record_lba == 0 )
+                    {
+                        free_record_lba = dir_base_cluster_lba + dir_sector_num;
+                        free_record_num = dir_record_num;
+                    }
+
+                    if ( dir_sector[dir_record_num].short_dos_name[0] == 0 )
+                    {
+                        done = 1;
+                        break;
+                    }
+                }
+                else if ( (dir_sector[dir_record_num].attribute & FILE_ATTR_LONG_NAME) != FILE_ATTR_LONG_NAME &&
+                          memcmp(dir_sector[dir_record_num].short_dos_name, sfn, sizeof(sfn)) == 0 )
+                {
+                    return FAT_FILE_EXISTS;
+                }
+            }
+        }
+
+        if ( done )
+            break;
+
+        result = fat32_get_next_cluster_num(dir_cluster_num, &next_cluster_num);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        if ( next_cluster_num >= FAT32_END_OF_CHAIN )
+            break;
+
+        dir_cluster_num = next_cluster_num;
+    }
+
+    /* A full directory is extended with an empty cluster
+     */
+    if ( free_record_lba == 0 )
+    {
+        result = fat32_get_new_cluster(&next_cluster_num);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        result = fat32_update_cluster_chain(dir_cluster_num, next_cluster_num);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        memset(dir_sector, 0, sizeof(dir_sector));
+        dir_base_cluster_lba = fat32_get_cluster_base_lba(next_cluster_num);
+
+        for ( dir_sector_num = 0; dir_sector_num < fat32_parameters.sectors_per_cluster; dir_sector_num++ )
+        {
+            result = fat32_write_sector((dir_base_cluster_lba + dir_sector_num), (uint8_t*) dir_sector, FAT32_SEC_SIZE);
+            if ( result != NO_ERROR )
+            {
+                return result;
+            }
+        }
+
+        free_record_lba = dir_base_cluster_lba;
+        free_record_num = 0;
+    }
+
+    /* Allocate the file's first cluster and write its directory record
+     */
+    result = fat32_get_new_cluster(&file_cluster_num);
+    if ( result != NO_ERROR )
+    {
+        return result;
+    }
+
+    result = fat32_update_cluster_chain(0, file_cluster_num);
+    if ( result != NO_ERROR )
+    {
+        return result;
+    }
+
+    result = fat32_read_sector(free_record_lba, (uint8_t*) dir_sector, FAT32_SEC_SIZE);
+    if ( result != NO_ERROR )
+    {
+        return result;
+    }
+
+    memset(&dir_sector[free_record_num], 0, sizeof(dir_record_t));
+    memcpy(dir_sector[free_record_num].short_dos_name, sfn, sizeof(sfn));
+    dir_sector[free_record_num].attribute = FILE_ATTR_ARCHIVE;
+    dir_sector[free_record_num].fat32_high_cluster = (uint16_t)(file_cluster_num >> 16);
+    dir_sector[free_record_num].fat32_low_cluster = (uint16_t)(file_cluster_num & 0xffff);
+
+    result = fat32_write_sector(free_record_lba, (uint8_t*) dir_sector, FAT32_SEC_SIZE);
+    if ( result != NO_ERROR )
+    {
+        return FAT_CRITICAL_ERR;    /*** FAT corruption ***/
+    }
+
+    directory->is_directory = 0;
+    dir_get_sfn(&dir_sector[free_record_num], directory->sfn, FAT32_DOS_FILE_NAME);
+    strncpy(directory->lfn, directory->sfn, FAT32_DOS_FILE_NAME);
+    directory->cluster_chain_head = file_cluster_num;
+    directory->file_size = 0;
+    directory->dir_record_index = free_record_num;
+    directory->dir_record_lba = free_record_lba;
+
+    return NO_ERROR;
 }
 
 /* -------------------------------------------------------------
@@ -484,6 +736,9 @@ error_t fat32_fdelete(dir_entry_t *file_dir_info)
  *  or written to by fat32_fwrite(), starting at the file position pointer.
  *  The file position pointer can be changed with fat32_fseek().
  *
+ *  The file's cluster chain is resolved into a map of contiguous cluster runs,
+ *  so that seeking and reading do not need to walk the FAT.
+ *
  *  Example: call fat32_parse_dir(), find the
  *  file you want to access, and pass that entry to fat32_fopen().
  *
@@ -509,6 +764,8 @@ error_t fat32_fopen(dir_entry_t *directory_entry, file_param_t *file_parameters)
     file_parameters->dir_record_index = directory_entry->dir_record_index;
     file_parameters->dir_record_lba = directory_entry->dir_record_lba;
 
+    fat32_map_clusters(file_parameters);
+
     if ( file_parameters->file_size == 0 )
     {
         file_parameters->eof_flag = 1;
@@ -544,13 +801,15 @@ void fat32_fclose(file_param_t *file_parameters)
     file_parameters->sector_cached = 0;
     file_parameters->dir_record_index = 0;
     file_parameters->dir_record_lba = 0;
+    file_parameters->extent_count = 0;
 }
 
 /* -------------------------------------------------------------
  * fat32_fseek()
  *
  *  Set file read position for the next read command.
- *  The function reads the sector containing the next byte to read.
+ *  The cluster holding the position is looked up in the file's cluster map,
+ *  or by walking the cluster chain in the FAT if the file is not mapped.
  *
  *  Param:  Pointer to an open file structure, 0-based index file byte position.
  *  Return: Error code
@@ -581,7 +840,27 @@ error_t fat32_fseek(file_param_t *file_parameters, uint32_t byte_position)
 
     file_parameters->current_cluster = current_cluster_num;
     file_parameters->is_end_of_chain = 0;
-    
+
+    if ( file_parameters->extent_count )
+    {
+        current_cluster_num = fat32_map_lookup(file_parameters, cluster_index);
+
+        /* Past the last mapped cluster, stay on the last cluster of the chain
+         */
+        if ( current_cluster_num >= FAT32_END_OF_CHAIN )
+        {
+            file_parameters->is_end_of_chain = 1;
+            file_parameters->current_cluster = file_parameters->extents[file_parameters->extent_count - 1].first_cluster +
+                                               file_parameters->extents[file_parameters->extent_count - 1].cluster_count - 1;
+        }
+        else
+        {
+            file_parameters->current_cluster = current_cluster_num;
+        }
+
+        cluster_index = 0;
+    }
+
     for ( i = 0; i < cluster_index; i++ )
     {
         fat32_get_next_cluster_num(current_cluster_num, &current_cluster_num);
@@ -744,7 +1023,7 @@ int fat32_fread(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer_
             {
                 lba_index = 0;
                 file_parameters->is_end_of_chain = 0;
-                fat32_get_next_cluster_num(file_cluster, &file_cluster);
+                fat32_get_file_next_cluster(file_parameters, file_cluster, &file_cluster);
                 /* Just a guard, should not happen.
                  */
                 /* TODO: check and handle other possible values
@@ -759,6 +1038,39 @@ int fat32_fread(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer_
             }
         }
 
+        /* Read whole sectors in a contiguous cluster run directly into the client
+         * buffer with one multiple sector read. The sector holding the last byte
+         * to read is left for the cached read below.
+         */
+        k = MIN((uint32_t)(buffer_length - byte_count), file_parameters->file_size - file_position);
+        r = 0;
+
+        if ( byte_offset == 0 && k > FAT32_SEC_SIZE )
+        {
+            r = fat32_get_run_sectors(file_parameters, file_cluster, lba_index, (k - 1) / FAT32_SEC_SIZE);
+        }
+
+        if ( r > 0 )
+        {
+            result = fat32_read_sectors((base_lba + lba_index), &buffer[byte_count], r);
+            if ( result != NO_ERROR )
+            {
+                return result;
+            }
+
+            byte_count += r * FAT32_SEC_SIZE;
+            file_position += r * FAT32_SEC_SIZE;
+
+            r += lba_index;
+            if ( r >= fat32_parameters.sectors_per_cluster )
+            {
+                file_parameters->is_end_of_chain = 0;
+                file_cluster += r / fat32_parameters.sectors_per_cluster;
+                base_lba = fat32_get_cluster_base_lba(file_cluster);
+            }
+            lba_index = r % fat32_parameters.sectors_per_cluster;
+        }
+
         /* Read next sector into cache
          */
         result = fat32_read_sector((base_lba + lba_index), high_sector_buffer, FAT32_SEC_SIZE);
@@ -787,7 +1099,7 @@ int fat32_fread(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer_
  *  Write data to an open file starting at current position towards end-of-file.
  *  Write stops if FAT is full or all bytes in buffer have been written.
  *  Function will allocate clusters as required and update FAT.
- *  A fat32_fcreate() [not implemented] or fat32_fopen(), and an optional fat32_fseek(), must be called before fat32_fwrite().
+ *  A fat32_fcreate() and fat32_fopen(), or a fat32_fopen(), and an optional fat32_fseek(), must be called before fat32_fwrite().
  *
  *  Note: Internal write errors abort write operation without attempting cleanup.
  *
@@ -810,10 +1122,10 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
     if ( !file_parameters->file_is_open )
         return FAT_FILE_NOT_OPEN;
 
-    /* File with zero-bytes size requires special handling
-     * and currently not supported.
+    /* File with zero-bytes size and no cluster requires special handling
+     * and currently not supported. Files made by fat32_fcreate() have a cluster.
      */
-    if ( file_parameters->file_size == 0 )
+    if ( file_parameters->file_start_cluster < FAT32_VALID_CLUST_LOW )
     {
         return FAT_WRITE_FAIL;
     }
@@ -825,11 +1137,14 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
     lba_index = file_parameters->current_lba_index;
     byte_offset = file_parameters->current_byte_index;
 
-    /* Allocate a new cluster is the 'currnet_cluster is the last one in the chain.
-     * Leave 'is_end_of_chain' true becasue the new cluster is still the last one in the chain.
+    /* Allocate a new cluster if the write position is past the last cluster in the chain.
+     * The position is then in the new cluster, so 'is_end_of_chain' is cleared, otherwise
+     * the next write would allocate another cluster.
      */
     if ( file_parameters->is_end_of_chain )
     {
+        file_parameters->is_end_of_chain = 0;
+
         temp_file_cluster = file_cluster;
 
         result = fat32_get_new_cluster(&file_cluster);
@@ -844,6 +1159,8 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
             return result;
         }
 
+        fat32_map_append(file_parameters, file_cluster);
+
         base_lba = fat32_get_cluster_base_lba(file_cluster);
     }
 
@@ -930,7 +1247,7 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
                 temp_file_cluster = file_cluster;
                 file_parameters->is_end_of_chain = 0;
 
-                result = fat32_get_next_cluster_num(file_cluster, &file_cluster);
+                result = fat32_get_file_next_cluster(file_parameters, file_cluster, &file_cluster);
                 if ( result != NO_ERROR )
                 {
                     return result;
@@ -938,8 +1255,6 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
 
                 if ( file_cluster >=  FAT32_END_OF_CHAIN )
                 {
-                    file_parameters->is_end_of_chain = 1;
-
                     result = fat32_get_new_cluster(&file_cluster);
                     if ( result != NO_ERROR )
                     {
@@ -951,12 +1266,44 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
                     {
                         return result;
                     }
+
+                    fat32_map_append(file_parameters, file_cluster);
                 }
 
                 base_lba = fat32_get_cluster_base_lba(file_cluster);
             }
         }
 
+        /* Write whole sectors in an allocated contiguous cluster run directly from
+         * the client buffer with one multiple sector write. The sector holding the
+         * last byte to write is left for the read-modify-write below.
+         */
+        i = buffer_length - byte_count;
+        r = fat32_get_run_sectors(file_parameters, file_cluster, lba_index, (i - 1) / FAT32_SEC_SIZE);
+
+        if ( r > 0 )
+        {
+            result = fat32_write_sectors((base_lba + lba_index), &buffer[byte_count], r);
+            if ( result != NO_ERROR )
+            {
+                return result;
+            }
+
+            byte_count += r * FAT32_SEC_SIZE;
+            file_position += r * FAT32_SEC_SIZE;
+            if ( file_position > new_file_size )
+                new_file_size = file_position;
+
+            r += lba_index;
+            if ( r >= fat32_parameters.sectors_per_cluster )
+            {
+                file_parameters->is_end_of_chain = 0;
+                file_cluster += r / fat32_parameters.sectors_per_cluster;
+                base_lba = fat32_get_cluster_base_lba(file_cluster);
+            }
+            lba_index = r % fat32_parameters.sectors_per_cluster;
+        }
+
         /* Read next sector into cache
          */
         result = fat32_read_sector((base_lba + lba_index), high_sector_buffer, FAT32_SEC_SIZE);
@@ -1003,7 +1350,8 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
 /* -------------------------------------------------------------
  * fat32_read_sector()
  *
- *  Read a sector (of 'block size') from SD to buffer.
+ *  Read a sector (of 'block size') to buffer, from the sector cache
+ *  or from SD into the cache.
  *  Buffer must be at least one sector worth of bytes in size.
  *
  *  Param:  Sector's LBA, buffer pointer, and its length
@@ -1011,16 +1359,53 @@ int fat32_fwrite(file_param_t *file_parameters, uint8_t *buffer, uint16_t buffer
  */
 static error_t fat32_read_sector(uint32_t lba, uint8_t *buffer, uint16_t buffer_len)
 {
+    int         entry;
+    error_t     result;
+
     if ( !fat32_initialized || buffer_len < FAT32_SEC_SIZE )
         return FAT_READ_FAIL;
 
-    return sd_read_block(lba, buffer, FAT32_SEC_SIZE);
+    entry = fat32_cache_lookup(lba);
+
+    if ( entry < 0 )
+    {
+        cache_misses++;
+
+        result = fat32_cache_evict(&entry);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        stats_timer_start(STATS_SD);
+        result = sd_read_block(lba, sector_cache[entry].data, FAT32_SEC_SIZE);
+        stats_timer_stop(STATS_SD);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        sector_cache[entry].valid = 1;
+        sector_cache[entry].dirty = 0;
+        sector_cache[entry].lba = lba;
+    }
+    else
+    {
+        cache_hits++;
+    }
+
+    sector_cache[entry].last_use = ++cache_use_count;
+    memcpy(buffer, sector_cache[entry].data, FAT32_SEC_SIZE);
+
+    return NO_ERROR;
 }
 
 /* -------------------------------------------------------------
  * fat32_write_sector()
  *
- *  Write a sector (of 'block size') to SD from buffer.
+ *  Write a sector (of 'block size') from buffer to the sector cache.
+ *  The sector is written to SD when it is evicted from the cache,
+ *  or by fat32_flush().
  *  Buffer must be at least one sector worth of bytes in size.
  *
  *  Param:  Sector's LBA, buffer pointer, and its length
@@ -1028,10 +1413,186 @@ static error_t fat32_read_sector(uint32_t lba, uint8_t *buffer, uint16_t buffer_
  */
 static error_t fat32_write_sector(uint32_t lba, uint8_t *buffer, uint16_t buffer_len)
 {
+    int         entry;
+    error_t     result;
+
     if ( !fat32_initialized || buffer_len < FAT32_SEC_SIZE )
         return FAT_WRITE_FAIL;
 
-    return sd_write_block(lba, buffer, FAT32_SEC_SIZE);
+    entry = fat32_cache_lookup(lba);
+
+    if ( entry < 0 )
+    {
+        cache_misses++;
+
+        result = fat32_cache_evict(&entry);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+
+        sector_cache[entry].valid = 1;
+        sector_cache[entry].lba = lba;
+    }
+    else
+    {
+        cache_hits++;
+    }
+
+    sector_cache[entry].dirty = 1;
+    sector_cache[entry].last_use = ++cache_use_count;
+    memcpy(sector_cache[entry].data, buffer, FAT32_SEC_SIZE);
+
+    return NO_ERROR;
+}
+
+/* -------------------------------------------------------------
+ * fat32_read_sectors()
+ *
+ *  Read consecutive sectors from SD to buffer with one multiple block read,
+ *  bypassing the sector cache. Sectors that are in the sector cache are
+ *  taken from the cache, because they may be modified and not yet written to SD.
+ *  Buffer must be at least 'count' sectors worth of bytes in size.
+ *
+ *  Param:  First sector's LBA, buffer pointer, and sector count
+ *  Return: Driver error
+ */
+static error_t fat32_read_sectors(uint32_t lba, uint8_t *buffer, uint16_t count)
+{
+    int         i;
+    error_t     result;
+
+    if ( !fat32_initialized )
+        return FAT_READ_FAIL;
+
+    stats_timer_start(STATS_SD);
+    result = sd_read_blocks(lba, buffer, count);
+    stats_timer_stop(STATS_SD);
+    if ( result != NO_ERROR )
+    {
+        return result;
+    }
+
+    for ( i = 0; i < FAT32_CACHE_SECTORS; i++ )
+    {
+        if ( sector_cache[i].valid &&
+             sector_cache[i].lba >= lba &&
+             sector_cache[i].lba < (lba + count) )
+        {
+            memcpy(&buffer[(sector_cache[i].lba - lba) * FAT32_SEC_SIZE], sector_cache[i].data, FAT32_SEC_SIZE);
+        }
+    }
+
+    return NO_ERROR;
+}
+
+/* -------------------------------------------------------------
+ * fat32_write_sectors()
+ *
+ *  Write consecutive sectors from buffer to SD with one multiple block write,
+ *  bypassing the sector cache. Sectors that are in the sector cache are
+ *  updated in the cache, and are no longer modified.
+ *  Buffer must be at least 'count' sectors worth of bytes in size.
+ *
+ *  Param:  First sector's LBA, buffer pointer, and sector count
+ *  Return: Driver error
+ */
+static error_t fat32_write_sectors(uint32_t lba, uint8_t *buffer, uint16_t count)
+{
+    int         i;
+    error_t     result;
+
+    if ( !fat32_initialized )
+        return FAT_WRITE_FAIL;
+
+    stats_timer_start(STATS_SD);
+    result = sd_write_blocks(lba, buffer, count);
+    stats_timer_stop(STATS_SD);
+    if ( result != NO_ERROR )
+    {
+        return result;
+    }
+
+    for ( i = 0; i < FAT32_CACHE_SECTORS; i++ )
+    {
+        if ( sector_cache[i].valid &&
+             sector_cache[i].lba >= lba &&
+             sector_cache[i].lba < (lba + count) )
+        {
+            memcpy(sector_cache[i].data, &buffer[(sector_cache[i].lba - lba) * FAT32_SEC_SIZE], FAT32_SEC_SIZE);
+            sector_cache[i].dirty = 0;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+/* -------------------------------------------------------------
+ * fat32_cache_lookup()
+ *
+ *  Find a sector in the sector cache.
+ *
+ *  Param:  Sector's LBA
+ *  Return: Cache entry index, or -1 if not cached
+ */
+static int fat32_cache_lookup(uint32_t lba)
+{
+    int     i;
+
+    for ( i = 0; i < FAT32_CACHE_SECTORS; i++ )
+    {
+        if ( sector_cache[i].valid && sector_cache[i].lba == lba )
+            return i;
+    }
+
+    return -1;
+}
+
+/* -------------------------------------------------------------
+ * fat32_cache_evict()
+ *
+ *  Free a sector cache entry, an empty one or the least recently used one.
+ *  A modified sector is written to SD before its entry is reused. The SD write
+ *  copies the sector, so the entry is free while its data block is sent.
+ *
+ *  Param:  Pointer to free cache entry index return variable
+ *  Return: Driver error
+ */
+static error_t fat32_cache_evict(int *entry)
+{
+    int         i, lru;
+    error_t     result;
+
+    lru = 0;
+
+    for ( i = 0; i < FAT32_CACHE_SECTORS; i++ )
+    {
+        if ( !sector_cache[i].valid )
+        {
+            lru = i;
+            break;
+        }
+
+        if ( sector_cache[i].last_use < sector_cache[lru].last_use )
+            lru = i;
+    }
+
+    if ( sector_cache[lru].valid && sector_cache[lru].dirty )
+    {
+        stats_timer_start(STATS_SD);
+        result = sd_write_block_async(sector_cache[lru].lba, sector_cache[lru].data, fat32_write_done);
+        stats_timer_stop(STATS_SD);
+        if ( result != NO_ERROR )
+        {
+            return result;
+        }
+    }
+
+    sector_cache[lru].valid = 0;
+    sector_cache[lru].dirty = 0;
+    *entry = lru;
+
+    return NO_ERROR;
 }
 
 /* -------------------------------------------------------------
@@ -1132,7 +1693,7 @@ static error_t fat32_get_new_cluster(uint32_t *new_cluster_num)
  * fat32_update_cluster_chain()
  *
  *  Update FAT32 tables chaining 'cluster_num' with 'new_cluster_num'
- *  entries.
+ *  entries. A 'cluster_num' of 0 starts a new chain with 'new_cluster_num'.
  *
  *  Param:  Current cluster number to link, new/next cluster number.
  *  Return: Error code.
@@ -1178,6 +1739,9 @@ static error_t fat32_update_cluster_chain(uint32_t cluster_num, uint32_t new_clu
         return result;
     }
 
+    if ( cluster_num == 0 )
+        return NO_ERROR;
+
     /* Read the sector holding the previous cluster number location.
      * Update it to point to the new cluster number,
      * and store the sector back into FAT.
@@ -1249,6 +1813,217 @@ static uint32_t fat32_get_cluster_base_lba(uint32_t cluster)
     return (fat32_parameters.cluster_begin_lba + (cluster - 2) * fat32_parameters.sectors_per_cluster);
 }
 
+/* -------------------------------------------------------------
+ * fat32_map_clusters()
+ *
+ *  Walk a file's cluster chain once and store it in the file's
+ *  cluster map as runs of contiguous clusters.
+ *  A FAT sector is read once for all the chain entries it holds.
+ *  If the chain has more runs than the map holds, or the chain is broken,
+ *  the file is left unmapped and the cluster chain is walked in the FAT.
+ *
+ *  Param:  Open file parameters
+ *  Return: None
+ */
+static void fat32_map_clusters(file_param_t *file)
+{
+    uint32_t    cluster_num, fat32_sector_lba, cached_lba, max_clusters, i;
+    int         sector_cached;
+
+    file->extent_count = 0;
+
+    cluster_num = file->file_start_cluster;
+    max_clusters = fat32_parameters.sectors_per_fat * FAT32_CLUS_PER_SECTOR;
+    sector_cached = 0;
+    cached_lba = 0;
+
+    for ( i = 0; i < max_clusters; i++ )
+    {
+        if ( cluster_num < FAT32_VALID_CLUST_LOW || cluster_num > FAT32_VALID_CLUST_HIGH )
+            break;
+
+        if ( !fat32_map_append(file, cluster_num) )
+            return;
+
+        fat32_sector_lba = fat32_parameters.fat_begin_lba + cluster_num / FAT32_CLUS_PER_SECTOR;
+
+        if ( !sector_cached || fat32_sector_lba != cached_lba )
+        {
+            if ( fat32_read_sector(fat32_sector_lba, low_sector_buffer, FAT32_SEC_SIZE) != NO_ERROR )
+            {
+                file->extent_count = 0;
+                return;
+            }
+
+            cached_lba = fat32_sector_lba;
+            sector_cached = 1;
+        }
+
+        cluster_num = ((uint32_t*) low_sector_buffer)[cluster_num % FAT32_CLUS_PER_SECTOR] & FAT32_FAT_MASK;
+    }
+
+    /* Only a chain that ends with an end-of-chain mark is kept
+     */
+    if ( cluster_num < FAT32_END_OF_CHAIN && file->extent_count )
+    {
+        file->extent_count = 0;
+    }
+}
+
+/* -------------------------------------------------------------
+ * fat32_map_append()
+ *
+ *  Append a cluster to the end of the file's cluster map.
+ *  The map is dropped if it has no room for a new run of clusters.
+ *
+ *  Param:  Open file parameters, cluster number
+ *  Return: 1=Cluster mapped, 0=File is not mapped
+ */
+static int fat32_map_append(file_param_t *file, uint32_t cluster_num)
+{
+    fat32_extent_t *extent;
+
+    if ( file->extent_count )
+    {
+        extent = &file->extents[file->extent_count - 1];
+
+        if ( cluster_num == (extent->first_cluster + extent->cluster_count) )
+        {
+            extent->cluster_count++;
+            return 1;
+        }
+    }
+    else if ( cluster_num != file->file_start_cluster )
+    {
+        /* Not mapped at open, or the map was dropped
+         */
+        return 0;
+    }
+
+    if ( file->extent_count == FAT32_MAX_EXTENTS )
+    {
+        file->extent_count = 0;
+        return 0;
+    }
+
+    extent = &file->extents[file->extent_count];
+    extent->first_cluster = cluster_num;
+    extent->cluster_count = 1;
+    extent->file_cluster_index = 0;
+
+    if ( file->extent_count )
+    {
+        extent->file_cluster_index = file->extents[file->extent_count - 1].file_cluster_index +
+                                     file->extents[file->extent_count - 1].cluster_count;
+    }
+
+    file->extent_count++;
+
+    return 1;
+}
+
+/* -------------------------------------------------------------
+ * fat32_map_lookup()
+ *
+ *  Binary search the file's cluster map for the cluster number
+ *  at a cluster index within the file.
+ *
+ *  Param:  Open file parameters, cluster index within the file
+ *  Return: Cluster number, or FAT32_END_OF_CHAIN if past the end of the map
+ */
+static uint32_t fat32_map_lookup(file_param_t *file, uint32_t cluster_index)
+{
+    int             low, high, mid;
+    fat32_extent_t *extent;
+
+    low = 0;
+    high = file->extent_count - 1;
+
+    while ( low <= high )
+    {
+        mid = (low + high) / 2;
+        extent = &file->extents[mid];
+
+        if ( cluster_index < extent->file_cluster_index )
+            high = mid - 1;
+        else if ( cluster_index >= (extent->file_cluster_index + extent->cluster_count) )
+            low = mid + 1;
+        else
+            return extent->first_cluster + (cluster_index - extent->file_cluster_index);
+    }
+
+    return FAT32_END_OF_CHAIN;
+}
+
+/* -------------------------------------------------------------
+ * fat32_get_file_next_cluster()
+ *
+ *  Return the next cluster number in a file's cluster chain,
+ *  from the file's cluster map without reading the FAT when the file is mapped.
+ *
+ *  Param:  Open file parameters, cluster number, pointer to next cluster number return variable
+ *  Return: error code, if error (i.e. not NO_ERROR) then next cluster retuens FAT32_END_OF_CHAIN
+ */
+static error_t fat32_get_file_next_cluster(file_param_t *file, uint32_t cluster_num, uint32_t *next_cluster_num)
+{
+    int             i;
+    fat32_extent_t *extent;
+
+    for ( i = 0; i < file->extent_count; i++ )
+    {
+        extent = &file->extents[i];
+
+        if ( cluster_num >= extent->first_cluster &&
+             cluster_num < (extent->first_cluster + extent->cluster_count) )
+        {
+            if ( cluster_num + 1 < (extent->first_cluster + extent->cluster_count) )
+                *next_cluster_num = cluster_num + 1;
+            else if ( (i + 1) < file->extent_count )
+                *next_cluster_num = file->extents[i + 1].first_cluster;
+            else
+                *next_cluster_num = FAT32_END_OF_CHAIN;
+
+            return NO_ERROR;
+        }
+    }
+
+    return fat32_get_next_cluster_num(cluster_num, next_cluster_num);
+}
+
+/* -------------------------------------------------------------
+ * fat32_get_run_sectors()
+ *
+ *  Count the sectors that can be transferred in one multiple block SD command
+ *  starting at a sector of a file's cluster. The run extends over following clusters
+ *  while they are contiguous, and ends before the last sector of the run's last cluster,
+ *  so that the sector after the run is always in a contiguous cluster.
+ *
+ *  Param:  Pointer to an open file structure, cluster number, LBA index within cluster,
+ *          and maximum sector count
+ *  Return: Sector count, 0 to 'max_sectors'
+ */
+static uint16_t fat32_get_run_sectors(file_param_t *file, uint32_t cluster_num, uint8_t lba_index, uint16_t max_sectors)
+{
+    uint32_t    run_sectors;
+    uint32_t    next_cluster_num;
+
+    run_sectors = fat32_parameters.sectors_per_cluster - lba_index;
+
+    while ( run_sectors <= max_sectors )
+    {
+        if ( fat32_get_file_next_cluster(file, cluster_num, &next_cluster_num) != NO_ERROR ||
+             next_cluster_num != (cluster_num + 1) )
+        {
+            break;
+        }
+
+        run_sectors += fat32_parameters.sectors_per_cluster;
+        cluster_num = next_cluster_num;
+    }
+
+    return (uint16_t) MIN((run_sectors - 1), max_sectors);
+}
+
 /* -------------------------------------------------------------
  * dir_get_sfn()
  *
@@ -1267,18 +2042,23 @@ static int dir_get_sfn(dir_record_t *dir_record, char *name, uint16_t name_lengt
 
     record = (char *) dir_record;
 
-    for ( i = 0, c = 0; i < (FAT32_DOS_FILE_NAME-2); i++ )
+    for ( i = 0, c = 0; i < 8; i++ )
     {
-        if ( record[i] == 0x20 )
-            continue;
+        if ( record[i] != 0x20 )
+            name[c++] = record[i];
+    }
+
+    /* Separate the extension, if there is one, with a '.'
+     */
+    if ( record[8] != 0x20 )
+    {
+        name[c++] = '.';
 
-        if ( i == 8)
+        for ( i = 8; i < (FAT32_DOS_FILE_NAME-2); i++ )
         {
-            name[i] = '.';
+            if ( record[i] != 0x20 )
+                name[c++] = record[i];
         }
-
-        name[i] = record[i];
-        c++;
     }
 
     name[c] = 0;
@@ -1325,3 +2105,61 @@ static int dir_get_lfn(dir_record_t *dir_record, char *name, uint16_t name_lengt
 
     return j;
 }
+
+/* -------------------------------------------------------------
+ * dir_make_sfn()
+ *
+ *  Convert a file name to the space padded, upper case, short (DOS 8.3)
+ *  file name of a directory record.
+ *
+ *  Param:  File name, buffer for the 11 characters of the directory record name
+ *  Return: 1=Converted, 0=Not a valid 8.3 file name
+ */
+static int dir_make_sfn(char *file_name, char *sfn)
+{
+    int     i, c, limit;
+
+    memset(sfn, 0x20, (FAT32_DOS_FILE_NAME-2));
+
+    for ( i = 0, c = 0, limit = 8; file_name[i] != 0; i++ )
+    {
+        /* The extension starts after the first '.'
+         */
+        if ( file_name[i] == '.' && limit == 8 && c > 0 )
+        {
+            c = 8;
+            limit = (FAT32_DOS_FILE_NAME-2);
+            continue;
+        }
+
+        if ( c == limit ||
+             file_name[i] <= 0x20 || file_name[i] >= 0x7f ||
+             strchr("\"*+,./:;<=>?[\\]|", file_name[i]) != NULL )
+            return 0;
+
+        if ( file_name[i] >= 'a' && file_name[i] <= 'z' )
+            sfn[c++] = file_name[i] - 'a' + 'A';
+        else
+            sfn[c++] = file_name[i];
+    }
+
+    return ( c > 0 && (limit == 8 || c > 8) );
+}
+
+/* -------------------------------------------------------------
+ * fat32_write_done()
+ *
+ *  Completion callback of an interrupt driven sector write.
+ *  Keeps a failed write's status for fat32_flush() to return.
+ *  Called in interrupt context on bare metal.
+ *
+ *  Param:  Write status
+ *  Return: None
+ */
+static void fat32_write_done(error_t result)
+{
+    if ( result != NO_ERROR )
+    {
+        write_status = result;
+    }
+}
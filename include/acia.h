@@ -0,0 +1,18 @@
+/********************************************************************
+ * acia.h
+ *
+ *  Header file that defines the Dragon 64 MC6551 ACIA serial port.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __ACIA_H__
+#define __ACIA_H__
+
+/********************************************************************
+ *  ACIA API
+ */
+void    acia_init(void);
+
+#endif  /* __ACIA_H__ */
@@ -0,0 +1,27 @@
+/********************************************************************
+ * audio.h
+ *
+ *  Header file that defines the buffered DAC audio stream.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#include    <stdint.h>
+
+#define     AUDIO_SAMPLE_RATE       10000       // Hz, DAC output rate of the platform's sample timer
+
+/********************************************************************
+ *  Audio stream API
+ */
+void     audio_init(void);
+
+void     audio_stream(int on);
+void     audio_dac_write(uint32_t cycles, int dac_value);
+
+int      audio_sample(void);
+
+#endif  /* __AUDIO_H__ */
@@ -10,12 +10,198 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
-#define     SD_CARD_BIT_RATE    2000000     // Hz
+/* Emulated computer, 32=Dragon 32, 64=Dragon 64 with 64K RAM, the SAM
+ * all-RAM map type, the two BASIC ROMs loaded from the SD card, and the ACIA
+ */
+#ifndef DRAGON_MODEL
+    #define     DRAGON_MODEL        32
+#endif
+
+#define     SD_CARD_INIT_RATE   400000      // Hz, card identification phase
+#define     SD_CARD_BIT_RATE    25000000    // Hz, highest data transfer rate to try
+
+/* SD card data block CRC16, 1=checked on reads and sent with writes,
+ * 0=not computed, for cards in a trusted state
+ */
+#ifndef SD_DATA_CRC
+    #define     SD_DATA_CRC         1
+#endif
+
+/* FAT32 write-back sector cache size in sectors, at least 1
+ */
+#ifndef FAT32_CACHE_SECTORS
+    #define     FAT32_CACHE_SECTORS 16
+#endif
+
+/* WD2797 DRQ timing, 1=fast disk, the next DRQ follows shortly after the
+ * data register access and INTRQ shortly after the last byte,
+ * 0=fixed 1mSec DRQ interval and 249mSec INTRQ delay
+ */
+#ifndef DISK_FAST_DRQ
+    #define     DISK_FAST_DRQ       1
+#endif
+
+/* DAC audio output, 1=DAC writes are time stamped and queued, and played out
+ * at a fixed sample rate by a thread (Linux) or timer interrupt (bare metal),
+ * 0=DAC writes go straight to the GPIO DAC pins
+ */
+#ifndef AUDIO_STREAM
+    #define     AUDIO_STREAM        1
+#endif
+
+/* Joystick comparator input, 1=a background sampler converts the joystick
+ * position while the DAC is not routed to the audio output, and PIA reads
+ * compare the written DAC level to it, 0=PIA reads wait for the comparator
+ * GPIO input to settle after each DAC write
+ */
+#ifndef JOYSTK_SAMPLER
+    #define     JOYSTK_SAMPLER      1
+#endif
+
+/* Keyboard input, 1=a background reader queues the AVR keyboard
+ * interface scan codes, and PIA keyboard column writes take them from
+ * the queue, 0=each PIA keyboard column write reads the AVR through SPI
+ */
+#ifndef KBD_READER
+    #define     KBD_READER          1
+#endif
+
+/* Cassette tape fast load, 1=the Dragon ROM's CSRDON and BLKIN routines are
+ * trapped and CAS file blocks are copied straight to memory,
+ * 0=all tape input goes through the PIA cassette bit stream
+ */
+#ifndef CAS_FAST_LOAD
+    #define     CAS_FAST_LOAD       1
+#endif
+
+/* Cassette tape save, 1=the Dragon ROM's WRTLDR and BLKOUT routines are
+ * trapped and tape output is written to a new CAS file on the SD card,
+ * 0=tape output only goes to the DAC
+ */
+#ifndef CAS_SAVE
+    #define     CAS_SAVE            1
+#endif
+
+/* Emulator performance counters, 1=counters shown in a display overlay with F3
+ * and sent to the debug output with F4, 0=no counters
+ */
+#ifndef EMU_STATS
+    #define     EMU_STATS           1
+#endif
+
+/* CPU core, 0=Motorola MC6809E, 1=Hitachi HD6309 with the E, F, V and MD registers,
+ * and the HD6309 op-codes, native mode selected by LDMD, and the illegal op-code
+ * and division by zero trap
+ */
+#ifndef CPU_6309
+    #define     CPU_6309            0
+#endif
+
+/* CPU execution profile, 1=count executed instructions per 16 byte PC bucket
+ * and per op-code, reported with F5 on Linux, 0=no profile
+ */
+#ifndef CPU_PROFILE
+    #define     CPU_PROFILE         0
+#endif
 
-#if (RPI_BARE_METAL==0)
+/* CPU instruction history, ring buffer of the last CPU_HISTORY executed
+ * instructions and their registers, printed on Linux on an op-code exception
+ * or with F7, 0=no history
+ */
+#ifndef CPU_HISTORY
+    #define     CPU_HISTORY         64
+#endif
+
+/* Machine state files saved with F8 and restored with F9,
+ * 1=run-length encode memory in the file, 0=store memory as is
+ */
+#ifndef STATE_RLE
+    #define     STATE_RLE           1
+#endif
+
+/* Bare metal multi-core, RPi 2 and 3 (BCM2836/7, make PIMODEL=RPI2 or RPI3),
+ * 1=secondary cores are started for the VDG renderer and the disk image worker,
+ * 0=everything runs on core 0
+ */
+#ifndef RPI_MULTI_CORE
+  #if (RPI_BARE_METAL==1) && (defined(RPI2) || defined(RPI3))
+    #define     RPI_MULTI_CORE      1
+  #else
+    #define     RPI_MULTI_CORE      0
+  #endif
+#endif
+
+/* VDG rendering, 1=each rendered band's changed video memory and video settings
+ * are copied to a queue at band time, and a render thread (Linux) or
+ * core (bare metal multi-core) draws them, 0=bands are drawn by the emulation
+ */
+#ifndef VDG_RENDER_THREAD
+  #if (RPI_BARE_METAL==0)
+    #define     VDG_RENDER_THREAD   1
+  #else
+    #define     VDG_RENDER_THREAD   RPI_MULTI_CORE
+  #endif
+#endif
+
+/* CPU cores that the emulation and render threads are pinned to on Linux,
+ * -1=not pinned, a core the host does not have is not used.
+ * On bare metal the emulation runs on core 0, and the renderer and the
+ * disk image worker are started on their own cores.
+ */
+#ifndef EMU_CPU_CORE
+    #define     EMU_CPU_CORE        1
+#endif
+
+#ifndef VDG_RENDER_CORE
+  #if (RPI_BARE_METAL==0)
+    #define     VDG_RENDER_CORE     2
+  #else
+    #define     VDG_RENDER_CORE     1
+  #endif
+#endif
+
+#ifndef DISK_WORKER_CORE
+    #define     DISK_WORKER_CORE    2
+#endif
+
+#ifndef DEBUG_LVL
+  #if (RPI_BARE_METAL==0)
     #define     DEBUG_LVL       2           // 0=Errors, 1=Warnings, 2=Info
-#else
+  #else
     #define     DEBUG_LVL       1
+  #endif
+#endif
+
+/* VDG frame buffer output: VDG_SCALE=1, 2 or 3 integer scales the 256x192 display,
+ * VDG_BORDER=1 adds a border that makes a 320x240 frame at scale 1.
+ * Set with -DVDG_SCALE= and -DVDG_BORDER=
+ */
+#ifndef VDG_SCALE
+    #define     VDG_SCALE   1
+#endif
+
+#ifndef VDG_BORDER
+    #define     VDG_BORDER  0
+#endif
+
+#if (VDG_SCALE < 1 || VDG_SCALE > 3)
+    #error "VDG_SCALE must be 1, 2 or 3"
+#endif
+
+/* VDG frame buffer rendering backend: 0=Scalar pixel tables, 1=ARM NEON.
+ * Defaults to NEON when the compiler targets it (Pi 2/3/Zero 2) and the display
+ * is not scaled, and can be forced with -DVDG_SIMD=0 or 1.
+ */
+#ifndef VDG_SIMD
+    #if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (VDG_SCALE == 1)
+        #define     VDG_SIMD    1
+    #else
+        #define     VDG_SIMD    0
+    #endif
+#endif
+
+#if (VDG_SIMD == 1 && VDG_SCALE != 1)
+    #error "NEON rendering backend supports VDG_SCALE=1 only"
 #endif
 
 #endif  /* __CONFIG_H__ */
\ No newline at end of file
@@ -12,6 +12,14 @@
 
 #include    <stdint.h>
 
+#include    "config.h"
+
+/* Execution profile PC buckets
+ */
+#define     CPU_PROFILE_BUCKET_SHIFT    4
+#define     CPU_PROFILE_BUCKET_SIZE     (1 << CPU_PROFILE_BUCKET_SHIFT)
+#define     CPU_PROFILE_BUCKETS         (65536 >> CPU_PROFILE_BUCKET_SHIFT)
+
 /********************************************************************
  *  CPU run state
  */
@@ -48,6 +56,12 @@ typedef struct
     uint8_t     b;
     uint8_t     dp;
     uint8_t     cc;
+#if (CPU_6309==1)
+    uint8_t     e;                  // HD6309 registers, W is E:F and Q is D:W
+    uint8_t     f;
+    uint16_t    v;
+    uint8_t     md;                 // Mode and error register
+#endif
 
     /* State after last command execution
      */
@@ -61,6 +75,26 @@ typedef struct
     int     exception_line_num;
 } cpu_state_t;
 
+/* Instruction history entry, the registers after executing an instruction
+ */
+#define     CPU_HISTORY_CODE    5           // Longest instruction in bytes
+
+typedef struct
+{
+    uint32_t    cycles;                     // CPU cycles since power-up at the end of the instruction
+    uint16_t    pc;                         // Instruction address
+    uint16_t    x, y, u, s;
+    uint8_t     a, b, dp, cc;
+    uint8_t     bytes;                      // Instruction length
+    uint8_t     code[CPU_HISTORY_CODE];     // Instruction bytes
+} cpu_history_t;
+
+/* ROM routine trap handler, called with the CPU registers when PC reaches
+ * the trapped address. Returns 1 when it replaced the routine, which then
+ * returns to its caller, or 0 to execute the routine.
+ */
+typedef int (*cpu_trap_handler_t)(cpu_state_t*);
+
 /********************************************************************
  *  CPU module API
  */
@@ -73,8 +107,25 @@ void cpu_firq(int state);
 void cpu_irq(int state);
 
 cpu_run_state_t cpu_run(void);
+cpu_run_state_t cpu_run_cycles(int cycle_budget, int *cycles_used);
+int             cpu_batch_cycles(void);
+uint32_t        cpu_instructions(void);
+
+int  cpu_trap(uint16_t address, cpu_trap_handler_t handler);
+
+void cpu_breakpoint(uint16_t address, int set);
+int  cpu_is_breakpoint(uint16_t address);
+int  cpu_break_hit(void);
 
 cpu_run_state_t cpu_get_state(cpu_state_t* cpu_state);
+void            cpu_save_state(void);
+void            cpu_restore_state(void);
 const char*     cpu_get_menmonic(uint16_t address);
+const char*     cpu_get_code_menmonic(const uint8_t *code);
+int             cpu_history(int n, cpu_history_t *entry);
+
+void            cpu_profile_reset(void);
+uint32_t        cpu_profile_pc(int bucket, uint16_t *first_pc);
+int             cpu_profile_op(int index, uint32_t *count, uint16_t *op_code, const char **mnemonic);
 
 #endif  /* __CPU_H__ */
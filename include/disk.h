@@ -13,5 +13,9 @@
 
 void disk_init(void);
 void disk_io_interrupt(void);
+void disk_io_sync(void);
+
+void disk_save_state(void);
+void disk_restore_state(void);
 
 #endif  /* __DISK_H__ */
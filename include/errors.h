@@ -42,6 +42,8 @@ typedef enum
         FAT_FILE_NOT_FOUND = -24,
         FAT_OUT_OF_SPACE = -25,         // No more room on media, FAT full
         FAT_CRITICAL_ERR = -26,         // FAT or data corruption possible
+        FAT_FILE_NAME_ERR = -27,        // Not a valid DOS 8.3 file name
+        FAT_FILE_EXISTS = -28,          // File to create is already in the directory
     } error_t;
 
 #endif  /* __ERRORS_H__ */
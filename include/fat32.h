@@ -21,6 +21,7 @@
 #define     FAT32_LONG_FILE_NAME    256
 #define     FAT32_DOS_FILE_NAME     13
 #define     FAT32_ROOT_DIR_CLUSTER  2
+#define     FAT32_MAX_EXTENTS       32      // Contiguous cluster runs in a file's cluster map
 
 typedef struct
 {
@@ -33,6 +34,13 @@ typedef struct
     uint32_t    dir_record_lba;     // in case we need to access it for updates.
 } dir_entry_t;
 
+typedef struct
+{
+    uint32_t    first_cluster;      // First cluster number of a run of contiguous clusters
+    uint32_t    cluster_count;      // Clusters in the run
+    uint32_t    file_cluster_index; // Index of the run's first cluster within the file
+} fat32_extent_t;
+
 typedef struct
 {
     int         file_is_open;       // File open flag
@@ -48,6 +56,8 @@ typedef struct
     int         sector_cached;      // Has a new sector been read and cached in the buffer?
     uint8_t     dir_record_index;   // Location of directory record index and LBA,
     uint32_t    dir_record_lba;     // in case we need to access it for updates.
+    int         extent_count;       // Cluster map extents, 0 if the file's cluster chain is not mapped
+    fat32_extent_t extents[FAT32_MAX_EXTENTS];
 } file_param_t;
 
 /********************************************************************
@@ -56,6 +66,8 @@ typedef struct
 error_t     fat32_init(void);
 void        fat32_close(void);
 int         fat32_is_initialized(void);
+error_t     fat32_flush(void);
+void        fat32_cache_stats(uint32_t*, uint32_t*);
 
 uint32_t    fat32_get_rootdir_cluster(void);
 int         fat32_parse_dir(uint32_t, dir_entry_t*, uint16_t);
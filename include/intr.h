@@ -0,0 +1,34 @@
+/********************************************************************
+ * intr.h
+ *
+ *  Header file that defines the IRQ and FIRQ interrupt controller.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __INTR_H__
+#define __INTR_H__
+
+#include    <stdint.h>
+
+/* Interrupt sources, one bit per device interrupt output
+ */
+#define     INTR_SRC_PIA0_A     0x00000001      // PIA0 IRQA, line sync on CA1
+#define     INTR_SRC_PIA0_B     0x00000002      // PIA0 IRQB, field sync on CB1
+#define     INTR_SRC_PIA1_A     0x00000004      // PIA1 IRQA, printer acknowledge on CA1
+#define     INTR_SRC_PIA1_B     0x00000008      // PIA1 IRQB, cartridge interrupt on CB1
+
+/* Sources wired to the CPU interrupt lines
+ */
+#define     INTR_IRQ_SOURCES    (INTR_SRC_PIA0_A | INTR_SRC_PIA0_B)
+#define     INTR_FIRQ_SOURCES   (INTR_SRC_PIA1_A | INTR_SRC_PIA1_B)
+
+/********************************************************************
+ *  Interrupt controller API
+ */
+void     intr_init(void);
+
+void     intr_assert(uint32_t source, int state);
+
+#endif  /* __INTR_H__ */
@@ -0,0 +1,25 @@
+/********************************************************************
+ * joystk.h
+ *
+ *  Header file that defines the background joystick sampler.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __JOYSTK_H__
+#define __JOYSTK_H__
+
+#include    <stdint.h>
+
+/********************************************************************
+ *  Joystick sampler API
+ */
+void     joystk_init(void);
+
+void     joystk_sampling(int on);
+int      joystk_comparator(int axis, int dac_level);
+
+uint32_t joystk_sample_step(void);
+
+#endif  /* __JOYSTK_H__ */
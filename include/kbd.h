@@ -0,0 +1,24 @@
+/********************************************************************
+ * kbd.h
+ *
+ *  Header file that defines the background keyboard reader.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __KBD_H__
+#define __KBD_H__
+
+#include    <stdint.h>
+
+/********************************************************************
+ *  Keyboard reader API
+ */
+void     kbd_init(void);
+
+int      kbd_read(void);
+
+uint32_t kbd_poll_step(void);
+
+#endif  /* __KBD_H__ */
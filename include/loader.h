@@ -10,6 +10,11 @@
 #ifndef __LOADER_H__
 #define __LOADER_H__
 
+/* -----------------------------------------
+   Definitions
+----------------------------------------- */
+#define     LOADER_DISK_DRIVES      4       // Dragon DOS drives 1 to 4
+
 /* -----------------------------------------
    Types
 ----------------------------------------- */
@@ -27,13 +32,23 @@ typedef enum
    Interface functions
 ----------------------------------------- */
 void loader_init(void);
+void loader_mount(void);
 void loader(void);
 
 int  loader_cas_fread(uint8_t*, uint16_t);
+int  loader_cas_fwrite(uint8_t*, uint16_t);
+void loader_cas_fclose(void);
+uint32_t loader_cas_ftell(uint32_t*);
+int  loader_cas_fseek(uint32_t, uint32_t);
+
+int  loader_disk_fread(int, uint8_t*, uint16_t);
+int  loader_disk_fwrite(int, uint8_t*, uint16_t);
+int  loader_disk_fseek(int, uint32_t);
+void loader_disk_flush(void);
+loader_file_type_t  loader_disk_img_type(int);
+uint32_t            loader_disk_img_cluster(int);
 
-int  loader_disk_fread(uint8_t*, uint16_t);
-int  loader_disk_fwrite(uint8_t*, uint16_t);
-int  loader_disk_fseek(uint32_t);
-loader_file_type_t  loader_disk_img_type(void);
+int  loader_state_fwrite(char*, uint8_t*, uint32_t);
+int  loader_state_fread(char*, uint8_t*, uint32_t);
 
 #endif  /* __LOADER_H__ */
@@ -27,6 +27,71 @@ typedef enum
 
 typedef uint8_t (*io_handler_callback)(uint16_t, uint8_t, mem_operation_t);
 
+/* Watchpoint access types
+ */
+#define     MEM_WATCH_READ          1
+#define     MEM_WATCH_WRITE         2
+
+/* Memory attributes are held per page of MEM_PAGE_SIZE bytes,
+ * see mem.c for per-address attributes of MEM_TYPE_MIXED pages.
+ */
+#define     MEM_PAGE_SIZE           256         // Bytes per attribute page
+#define     MEM_PAGE_SHIFT          8
+#define     MEM_PAGE_MASK           (MEM_PAGE_SIZE-1)
+#define     MEM_PAGES               (MEMORY/MEM_PAGE_SIZE)
+
+typedef enum
+{
+    MEM_TYPE_RAM,
+    MEM_TYPE_ROM,
+    MEM_TYPE_IO,
+    MEM_TYPE_ALIAS,         // Address is an alias of another address
+    MEM_TYPE_MIXED,         // Page attribute only, use per-address attributes in sub-page
+} memory_flag_t;
+
+typedef struct
+{
+    memory_flag_t           page_type;
+    struct mem_sub_page_t  *sub_page;
+} mem_page_t;
+
+/* The CPU address space is mapped to RAM, ROM and cartridge storage in
+ * banks of MEM_BANK_SIZE bytes. The SAM map type and the Dragon 64 ROM select
+ * switch a bank between RAM and ROM by changing its pointer, see mem_set_map_type().
+ */
+#define     MEM_BANK_SIZE           16384
+#define     MEM_BANK_SHIFT          14
+#define     MEM_BANK_MASK           (MEM_BANK_SIZE-1)
+#define     MEM_BANKS               (MEMORY/MEM_BANK_SIZE)
+#define     MEM_ROMS                2           // BASIC ROMs at 0x8000, two in the Dragon 64
+
+#define     mem_byte(address)       mem_bank[((address) >> MEM_BANK_SHIFT)][((address) & MEM_BANK_MASK)]
+
+typedef enum
+{
+    MEM_BLOCK_RAM,          // 64K RAM as the VDG addresses it, 0x0000 to 0x7fff only in the Dragon 32
+    MEM_BLOCK_ROM,          // BASIC ROM, 0x8000 to 0xbfff
+    MEM_BLOCK_ROM2,         // Dragon 64 '64 mode' BASIC ROM
+    MEM_BLOCK_CARTRIDGE,    // Cartridge ROM, 0xc000 to 0xfeff
+} mem_block_t;
+
+/* RAM writes mark the line of MEM_DIRTY_LINE bytes that holds the address
+ * as dirty, so that a video renderer can skip memory that did not change.
+ * Lines are tracked with a byte each so marking costs a single store.
+ */
+#define     MEM_DIRTY_SHIFT         5
+#define     MEM_DIRTY_LINE          (1 << MEM_DIRTY_SHIFT)  // Bytes per dirty line
+#define     MEM_DIRTY_LINES         (MEMORY/MEM_DIRTY_LINE)
+
+/* Memory module data used by the inline accessors
+ */
+extern uint8_t      mem_data[MEMORY];     // RAM
+extern uint8_t     *mem_bank[MEM_BANKS];  // RAM, ROM or cartridge storage of each CPU address bank
+extern mem_page_t   mem_pages[MEM_PAGES];
+extern uint8_t      mem_dirty[MEM_DIRTY_LINES];
+extern uint32_t     mem_rom_version;        // Incremented when memory content is loaded or the map changes
+extern int          mem_watch_hit;          // A watched address was accessed
+
 /********************************************************************
  *  Memory module API
  */
@@ -37,6 +102,120 @@ int  mem_read(int address);
 int  mem_write(int address, int data);
 int  mem_define_rom(int addr_start, int addr_end);
 int  mem_define_io(int addr_start, int addr_end, io_handler_callback io_handler);
+int  mem_define_alias(int addr_start, int addr_end, int target_start);
+int  mem_define_watch(int address, int mode);
+int  mem_get_watch(int address);
+int  mem_watch_triggered(int *address, mem_operation_t *op);
 int  mem_load(int addr_start, const uint8_t *buffer, int length);
+uint8_t *mem_load_buffer(int addr_start, int length);
+void mem_push_block(uint16_t *stack_pointer, const uint8_t *buffer, int length);
+void mem_pull_block(uint16_t *stack_pointer, uint8_t *buffer, int length);
+int  mem_is_dirty(int addr_start, int length);
+void mem_clear_dirty(int addr_start, int length);
+void mem_set_map_type(int all_ram);
+void mem_select_rom(int rom);
+const uint8_t *mem_block(mem_block_t block);
+uint8_t *mem_block_load_buffer(mem_block_t block, int offset, int length);
+
+/********************************************************************
+ *  Fast-path memory accessors for CPU op-code, operand and stack access.
+ *  Addresses are always 16-bit so there is no range check, and
+ *  only pages with IO addresses or mixed attributes use the
+ *  checked mem_read() and mem_write() path.
+ */
+
+/*------------------------------------------------
+ * mem_fetch8()
+ *
+ *  Read a byte from memory
+ *
+ *  param:  Memory address
+ *  return: Memory content at address
+ */
+static inline uint8_t mem_fetch8(uint16_t address)
+{
+    if ( mem_pages[(address >> MEM_PAGE_SHIFT)].page_type != MEM_TYPE_MIXED )
+        return mem_byte(address);
+
+    return (uint8_t) mem_read(address);
+}
+
+/*------------------------------------------------
+ * mem_fetch16()
+ *
+ *  Read a big-endian word from memory
+ *
+ *  param:  Memory address of high order byte
+ *  return: Word at address
+ */
+static inline uint16_t mem_fetch16(uint16_t address)
+{
+    return ((uint16_t) mem_fetch8(address) << 8) + (uint16_t) mem_fetch8((uint16_t)(address + 1));
+}
+
+/*------------------------------------------------
+ * mem_store8()
+ *
+ *  Write a byte to memory, writes to ROM are ignored
+ *
+ *  param:  Memory address and data to write
+ *  return: Nothing
+ */
+static inline void mem_store8(uint16_t address, uint8_t data)
+{
+    if ( mem_pages[(address >> MEM_PAGE_SHIFT)].page_type == MEM_TYPE_RAM )
+    {
+        mem_byte(address) = data;
+        mem_dirty[(address >> MEM_DIRTY_SHIFT)] = 1;
+    }
+    else
+        mem_write(address, data);
+}
+
+/*------------------------------------------------
+ * mem_store16()
+ *
+ *  Write a big-endian word to memory, writes to ROM are ignored
+ *
+ *  param:  Memory address of high order byte and word to write
+ *  return: Nothing
+ */
+static inline void mem_store16(uint16_t address, uint16_t data)
+{
+    mem_store8(address, (uint8_t)(data >> 8));
+    mem_store8((uint16_t)(address + 1), (uint8_t) data);
+}
+
+/*------------------------------------------------
+ * mem_push8()
+ *
+ *  Push a byte to a stack, pre-decrement the stack pointer
+ *
+ *  param:  Pointer to stack pointer, and data to push
+ *  return: Nothing
+ */
+static inline void mem_push8(uint16_t *stack_pointer, uint8_t data)
+{
+    (*stack_pointer)--;
+    mem_store8(*stack_pointer, data);
+}
+
+/*------------------------------------------------
+ * mem_pull8()
+ *
+ *  Pull a byte from a stack, post-increment the stack pointer
+ *
+ *  param:  Pointer to stack pointer
+ *  return: Data byte pulled from the stack
+ */
+static inline uint8_t mem_pull8(uint16_t *stack_pointer)
+{
+    uint8_t data;
+
+    data = mem_fetch8(*stack_pointer);
+    (*stack_pointer)++;
+
+    return data;
+}
 
 #endif  /* __MEM_H__ */
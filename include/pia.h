@@ -10,10 +10,21 @@
 #ifndef __PIA_H__
 #define __PIA_H__
 
+#include    "cpu.h"
+
 void pia_init(void);
 
 void pia_vsync_irq(void);
+void pia_hsync_irq(void);
+int  pia_hsync_active(void);
 void pia_cart_firq(void);
+void pia_save_state(void);
+void pia_restore_state(void);
 int  pia_function_key(void);
 
+int  pia_cas_csrdon(cpu_state_t *registers);
+int  pia_cas_blkin(cpu_state_t *registers);
+int  pia_cas_wrtldr(cpu_state_t *registers);
+int  pia_cas_blkout(cpu_state_t *registers);
+
 #endif  /* __PIA_H__ */
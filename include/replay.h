@@ -0,0 +1,53 @@
+/********************************************************************
+ * replay.h
+ *
+ *  Header file that defines the input recorder and player.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include    <stdint.h>
+
+#define     REPLAY_FILE_NAME        "DRAGON32.RPL"  // Recorded input events
+#define     REPLAY_STATE_FILE_NAME  "DRAGON32.RPS"  // Machine state at the start of the recording
+
+/* Recorder and player modes
+ */
+typedef enum
+{
+    REPLAY_OFF = 0,
+    REPLAY_RECORD,
+    REPLAY_PLAY,
+} replay_mode_t;
+
+/* Input sources
+ */
+typedef enum
+{
+    REPLAY_KEYBOARD = 0,    // Keyboard scan codes, without the function keys
+    REPLAY_JOYSTK_COMP,     // Joystick comparator level
+    REPLAY_JOYSTK_BUTTON,   // Right joystick button level
+    REPLAY_RESET,           // Reset button, short or long press
+    REPLAY_END,             // End of the recording
+    REPLAY_SOURCES
+} replay_source_t;
+
+/********************************************************************
+ *  Input recorder and player API
+ */
+void            replay_init(void);
+
+int             replay_record_start(void);
+int             replay_play_start(void);
+void            replay_stop(void);
+replay_mode_t   replay_mode(void);
+int             replay_done(void);
+
+int             replay_event(replay_source_t source, int value);
+int             replay_level(replay_source_t source, int level);
+
+#endif  /* __REPLAY_H__ */
@@ -41,9 +41,13 @@
 /* -----------------------------------------------------
  *      Register bank base addresses
  */
-#define     BCM2835_PERI_BASE           0x20000000      // RPi 1 and Zero
 #define     BCM2835_RPI2_PERI_BASE      0x3F000000      // RPi 2 & 3
 #define     BCM2835_RPI4_PERI_BASE      0xFE000000      // RPi 4
+#if defined(RPI2) || defined(RPI3)
+#define     BCM2835_PERI_BASE           BCM2835_RPI2_PERI_BASE
+#else
+#define     BCM2835_PERI_BASE           0x20000000      // RPi 1 and Zero
+#endif
 
 #define     BCM2835_ST_BASE             (BCM2835_PERI_BASE+0x003000)    // System Timer
 #define     BCM2835_INT_BASE            (BCM2835_PERI_BASE+0x00B200)    // Interrupt controller
@@ -58,6 +62,16 @@
 #define     BCM2835_AUX_SPI1            (BCM2835_PERI_BASE+0x215080)    // AUX peripherals' SPI1 base
 // TODO #define     BCM2835_BSC1_BASE           (BCM2835_PERI_BASE+0x804000)    // BSC1 I2C
 
+/* -----------------------------------------------------
+ *      ARM local peripherals of the quad core BCM2836/7, RPi 2 & 3
+ *      The firmware parks cores 1 to 3 polling their mailbox 3,
+ *      a core jumps to the address written to its 'set' register.
+ */
+#define     BCM2836_CORES               4
+#define     BCM2836_LOCAL_BASE          0x40000000
+#define     BCM2836_CORE_MBOX3_SET(c)   (BCM2836_LOCAL_BASE+0x00008C+0x10*(c))  // Core mailbox 3 write-set
+#define     BCM2836_CORE_MBOX3_CLR(c)   (BCM2836_LOCAL_BASE+0x0000CC+0x10*(c))  // Core mailbox 3 read/write-clear
+
 /* -----------------------------------------------------
  *      Speed of the core clock core_clk
  */
@@ -0,0 +1,25 @@
+/*
+ * mmu.h
+ *
+ *  Header file for the ARM MMU and L1 cache set up.
+ *
+ *   Resources:
+ *      ARM1176JZF-S Technical Reference Manual, chapter 6 Memory Management Unit
+ *      ARM Architecture Reference Manual ARMv7-A, short-descriptor translation table format
+ *
+ */
+
+#ifndef __MMU_H__
+#define __MMU_H__
+
+#include    <stdint.h>
+
+#include    "rpi-bm/bcm2835.h"
+
+void    mmu_init(uint32_t arm_memory_size);                 // Build the translation table and enable the MMU on core 0
+void    mmu_enable(void);                                   // Enable the MMU and caches on the calling core
+
+void    mmu_dcache_clean(const void *address, uint32_t length);         // Write back data cache lines to memory
+void    mmu_dcache_invalidate(const void *address, uint32_t length);    // Discard data cache lines
+
+#endif  /* __MMU_H__ */
@@ -31,7 +31,7 @@
 #define     SPI1_CPOL_HI            0x00000002  // Rest state of clock = high
 #define     SPI1_CSPOL_HI           0x00000004  // Chip select lines are active high
 #define     SPI1_ENA_DMA            0x00000008  // Enable DMA
-#define     SPI1_ENA_TX_IRQ         0x00000010  // Enable transmission done interrupt
+#define     SPI1_ENA_TX_IRQ         0x00000010  // Enable interrupt driven transfers, see bcm2835_spi1_transfer_irq()
 #define     SPI1_ENA_RX_IRQ         0x00000020  // Enable receive data interrupt
 #define     SPI1_LONG_DATA          0x00000040  // Set to 32-bit data IO
 #define     SPI1_LOSSI_MODE         0x00000080  // Interface will be in LoSSI mode
@@ -76,6 +76,9 @@ void bcm2835_spi1_send_byte(uint8_t byte);                   // Transmit one byt
 int  bcm2835_spi1_recv_byte(void);                           // Receive one byte
 int  bcm2835_spi1_transfer_byte(uint8_t tx_byte);            // Transmit a byte and return the received byte
 
+int  bcm2835_spi1_transfer_irq(uint8_t *tx_buf, uint8_t *rx_buf, uint32_t count, void (*callback)(void));
+int  bcm2835_spi1_is_busy(void);                             // Interrupt driven transfer in progress
+
 void bcm2835_spi1_set_cs_high(void);                         // Only CS2, header P1 pin 36
 void bcm2835_spi1_set_cs_spi_func(void);
 
@@ -32,6 +32,7 @@ void        spi_aux_set_rate(uint32_t);
 
 uint8_t     spi_aux_transfer_byte(uint8_t);
 void        spi_aux_transfer_buffer(uint8_t*, uint16_t);
+void        spi_aux_write_buffer(const uint8_t*, uint16_t);
 
 void        spi_aux_set_cs_high(void);
 void        spi_aux_set_cs_spi_func(void);
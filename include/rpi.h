@@ -17,6 +17,7 @@
 #define     DEFAULT_SPI0_RATE   2000000     // Keyboard interface Hz bit rate
 #define     MOTOR_LED_DISK      0b00000001
 #define     MOTOR_LED_TAPE      0b00000010
+#define     RPI_TICK_USEC       1000        // Bare metal host tick period in micro-seconds
 
 /********************************************************************
  *  RPi bare meta module API
@@ -24,13 +25,27 @@
 int      rpi_gpio_init(void);
 
 uint8_t *rpi_fb_init(int h, int v);
+void     rpi_fb_flip(const uint8_t *buffer);
+#if (RPI_BARE_METAL==0)
+void     rpi_fb_output(int headless, int frame_hash, int snapshot_interval);
+void     rpi_cpu_pin(int core);
+#else
+int      rpi_core_start(int core, void (*entry)(void));
+
+extern volatile uint32_t rpi_tick_count;    // Host ticks since rpi_tick_start()
+void     rpi_tick_start(void);
+void     rpi_tick_wait(void);
+#endif
 
 uint32_t rpi_system_timer(void);
 
 int      rpi_keyboard_read(void);
 void     rpi_keyboard_reset(void);
+void     rpi_keyboard_start(uint32_t (*poll_step)(void));
 
 int      rpi_joystk_comp(void);
+int      rpi_joystk_comp_settled(void);
+void     rpi_joystk_start(uint32_t (*sample_step)(void));
 int      rpi_rjoystk_button(void);
 
 int      rpi_reset_button(void);
@@ -38,6 +53,7 @@ int      rpi_reset_button(void);
 void     rpi_audio_mux_set(int);
 
 void     rpi_write_dac(int);
+void     rpi_audio_start(int sample_rate, int (*sample_source)(void));
 
 void     rpi_disable(void);
 void     rpi_enable(void);
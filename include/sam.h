@@ -13,4 +13,7 @@
 
 void sam_init(void);
 
+void sam_save_state(void);
+void sam_restore_state(void);
+
 #endif  /* __SAM_H__ */
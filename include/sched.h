@@ -0,0 +1,36 @@
+/********************************************************************
+ * sched.h
+ *
+ *  Header file that defines the emulated-time event scheduler.
+ *  Time is counted in CPU clock cycles.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include    <stdint.h>
+
+#define     SCHED_CPU_CLOCK_HZ      894886      // Dragon MC6809E E clock, 14.31818MHz / 16
+#define     SCHED_USEC_TO_CYCLES(t) ((uint32_t)(((uint64_t)(t) * SCHED_CPU_CLOCK_HZ) / 1000000))
+
+/* Scheduler event call-back
+ */
+typedef void (*sched_callback_t)(void);
+
+/********************************************************************
+ *  Scheduler API
+ */
+void     sched_init(void);
+
+int      sched_add(uint32_t delay_cycles, sched_callback_t callback);
+void     sched_cancel(sched_callback_t callback);
+int      sched_is_pending(sched_callback_t callback);
+
+void     sched_advance(int cycles);
+uint32_t sched_get_cycles(void);
+uint32_t sched_cycles_to_next(void);
+
+#endif  /* __SCHED_H__ */
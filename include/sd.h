@@ -23,5 +23,10 @@ void    sd_close(void);
 
 error_t sd_read_block(uint32_t lba, uint8_t *buffer, uint16_t length);
 error_t sd_write_block(uint32_t lba, uint8_t *buffer, uint16_t length);
+error_t sd_read_blocks(uint32_t lba, uint8_t *buffer, uint16_t count);
+error_t sd_write_blocks(uint32_t lba, uint8_t *buffer, uint16_t count);
+
+error_t sd_write_block_async(uint32_t lba, uint8_t *buffer, void (*callback)(error_t));
+int     sd_is_busy(void);
 
 #endif  /* __SD_H__ */
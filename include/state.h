@@ -0,0 +1,29 @@
+/********************************************************************
+ * state.h
+ *
+ *  Header file that defines the machine state save and restore.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __STATE_H__
+#define __STATE_H__
+
+#include    <stdint.h>
+
+#define     STATE_FILE_NAME         "DRAGON32.SAV"  // Machine state file of the F8 and F9 keys
+
+/********************************************************************
+ *  Machine state API
+ */
+int      state_save(char *file_name);
+int      state_restore(char *file_name);
+
+/* Module state records, called by the modules'
+ * *_save_state() and *_restore_state() functions
+ */
+void     state_write(const void *data, int length);
+void     state_read(void *data, int length);
+
+#endif  /* __STATE_H__ */
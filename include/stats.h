@@ -0,0 +1,56 @@
+/********************************************************************
+ * stats.h
+ *
+ *  Header file that defines the emulator performance counters.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include    <stdint.h>
+
+#include    "config.h"
+
+/* Host time accumulators
+ */
+typedef enum
+{
+    STATS_RENDER = 0,       // VDG rendering to the frame buffer
+    STATS_DISK_IO,          // Disk image jobs
+    STATS_SD,               // SD card block transfers
+    STATS_IO_CALLBACK,      // Memory mapped IO call-backs
+    STATS_TIMERS
+} stats_timer_t;
+
+/********************************************************************
+ *  Performance counters API
+ */
+#if (EMU_STATS==1)
+
+void     stats_init(void);
+void     stats_reset(void);
+
+void     stats_frame(int rendered);
+
+void     stats_overlay_toggle(void);
+void     stats_dump_toggle(void);
+
+void     stats_timer_start(stats_timer_t timer);
+void     stats_timer_stop(stats_timer_t timer);
+
+#else
+
+#define  stats_init()
+#define  stats_reset()
+#define  stats_frame(rendered)
+#define  stats_overlay_toggle()
+#define  stats_dump_toggle()
+#define  stats_timer_start(timer)
+#define  stats_timer_stop(timer)
+
+#endif
+
+#endif  /* __STATS_H__ */
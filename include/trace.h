@@ -18,7 +18,10 @@
  *  Memory module API
  */
 
-int trace_action(uint16_t* breakpoint_address);
+int trace_action(void);
 void trace_print_registers(cpu_state_t* state);
+void trace_print_watch(void);
+void trace_print_history(void);
+void trace_print_profile(void);
 
 #endif  /* __TRACE_H__ */
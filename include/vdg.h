@@ -12,12 +12,23 @@
 #define __VDG_H__
 
 #define     VDG_REFRESH_RATE        50      // in Hz
+#define     VDG_BENCH_FRAMES        100     // Frames per mode and pattern in vdg_benchmark()
+
+#define     VDG_FIELD_LINES         312     // Scan lines per 50Hz field
+#define     VDG_BAND_LINES          12      // Scan lines per rendered band, one text row
+#define     VDG_BANDS               16      // Bands in the 192 active scan lines
+#define     VDG_OVERLAY_ROWS        3       // Overlay text rows over the top bands
 
 void vdg_init(void);
 void vdg_render(void);
+void vdg_render_band(int band);
+void vdg_render_sync(void);
+void vdg_overlay(int row, const char *text);
 
 void vdg_set_video_offset(uint8_t offset);
 void vdg_set_mode_sam(int sam_mode);
 void vdg_set_mode_pia(uint8_t pia_mode);
 
+void vdg_benchmark(int frames);
+
 #endif  /* __VDG_H__ */
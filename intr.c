@@ -0,0 +1,92 @@
+/********************************************************************
+ * intr.c
+ *
+ *  IRQ and FIRQ interrupt controller.
+ *  Each device interrupt output is a bit in the set of asserted sources.
+ *  Devices assert and clear only their own bit, and the CPU IRQ and FIRQ
+ *  lines are the OR of the sources wired to them. The CPU is told of
+ *  a line only when its level changes, so a source that clears its bit
+ *  does not release a line another source is still holding.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "cpu.h"
+
+#include    "intr.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint32_t     asserted_sources = 0;
+static int          irq_line = 0;
+static int          firq_line = 0;
+
+/*------------------------------------------------
+ * intr_init()
+ *
+ *  Initialize the interrupt controller with all sources
+ *  and the CPU interrupt lines cleared.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void intr_init(void)
+{
+    asserted_sources = 0;
+    irq_line = 0;
+    firq_line = 0;
+
+    cpu_irq(0);
+    cpu_firq(0);
+}
+
+/*------------------------------------------------
+ * intr_assert()
+ *
+ *  Assert or clear interrupt sources,
+ *  and update the CPU interrupt lines that changed level.
+ *
+ *  param:  Source bits INTR_SRC_*, 1- assert, 0- clear
+ *  return: Nothing
+ */
+void intr_assert(uint32_t source, int state)
+{
+    uint32_t    sources;
+    int         line;
+
+    if ( state )
+        sources = asserted_sources | source;
+    else
+        sources = asserted_sources & ~source;
+
+    if ( sources == asserted_sources )
+        return;
+
+    asserted_sources = sources;
+
+    line = ( (sources & INTR_IRQ_SOURCES) != 0 );
+    if ( line != irq_line )
+    {
+        irq_line = line;
+        cpu_irq(line);
+    }
+
+    line = ( (sources & INTR_FIRQ_SOURCES) != 0 );
+    if ( line != firq_line )
+    {
+        firq_line = line;
+        cpu_firq(line);
+    }
+}
@@ -0,0 +1,201 @@
+/********************************************************************
+ * joystk.c
+ *
+ *  Background joystick sampler.
+ *  The joystick position is converted by successive approximation
+ *  with the DAC and the joystick comparator, one DAC probe per call of
+ *  joystk_sample_step() from the platform's sampler timer (a thread on
+ *  Linux, a timer interrupt on bare metal). Each call returns the time
+ *  the DAC and comparator need to settle before the next probe,
+ *  so the emulation does not wait for them.
+ *  The PIA reads the comparator bit from the cached positions and
+ *  the DAC level last written by the emulated program.
+ *  The sampler uses the DAC and audio multiplexer only while the
+ *  emulation does not route the DAC to the audio output.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#if (RPI_BARE_METAL==0)
+#include    <pthread.h>
+#endif
+
+#include    "config.h"
+#include    "rpi.h"
+
+#include    "joystk.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     JOYSTK_AXES             2           // Right joystick X and Y, audio multiplexer select 0 and 1
+#define     JOYSTK_LEVELS           64          // 6-bit DAC
+#define     JOYSTK_FIRST_PROBE      (JOYSTK_LEVELS)
+#define     JOYSTK_SETTLE_USEC      20          // DAC, comparator and level shifter settling time
+#define     JOYSTK_IDLE_USEC        5000        // Time between conversions of both axes
+
+/* On Linux the sampler thread and the emulation both drive the DAC
+ * and multiplexer, so a probe and sampling stop do not overlap.
+ * On bare metal the sampler interrupt always runs a whole probe.
+ */
+#if (RPI_BARE_METAL==0)
+    #define     joystk_lock()       pthread_mutex_lock(&joystk_access_lock)
+    #define     joystk_unlock()     pthread_mutex_unlock(&joystk_access_lock)
+#else
+    #define     joystk_lock()
+    #define     joystk_unlock()
+#endif
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static volatile int     sampling = 0;
+static volatile int     joystk_level[JOYSTK_AXES];  // DAC levels below the joystick position, 0 to 64
+
+static int      axis = 0;
+static int      probe_bit = 0;                      // Twice the probed bit, '1' for the last probe, '0' between conversions
+static int      approximation = 0;
+
+#if (RPI_BARE_METAL==0)
+static pthread_mutex_t  joystk_access_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*------------------------------------------------
+ * joystk_init()
+ *
+ *  Initialize the joystick sampler to a centered joystick,
+ *  with sampling stopped.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void joystk_init(void)
+{
+    int     i;
+
+    sampling = 0;
+    probe_bit = 0;
+    axis = 0;
+
+    for ( i = 0; i < JOYSTK_AXES; i++ )
+        joystk_level[i] = (JOYSTK_LEVELS / 2);
+}
+
+/*------------------------------------------------
+ * joystk_sampling()
+ *
+ *  Start or stop joystick sampling. When this returns with sampling
+ *  stopped the sampler does not use the DAC and multiplexer,
+ *  and a conversion in progress is restarted when sampling resumes.
+ *
+ *  param:  1- start, 0- stop
+ *  return: Nothing
+ */
+void joystk_sampling(int on)
+{
+    if ( on == sampling )
+        return;
+
+    joystk_lock();
+    sampling = on;
+    probe_bit = 0;
+    joystk_unlock();
+}
+
+/*------------------------------------------------
+ * joystk_comparator()
+ *
+ *  Return the joystick comparator bit for a DAC level
+ *  from the cached joystick position of an axis.
+ *
+ *  param:  Audio multiplexer select, DAC level 0x00 to 0x3f
+ *  return: 1- joystick is above the DAC level, 0- below or not a joystick axis
+ */
+int joystk_comparator(int axis, int dac_level)
+{
+    if ( axis < 0 || axis >= JOYSTK_AXES )
+        return 0;
+
+    return ( dac_level < joystk_level[axis] );
+}
+
+/*------------------------------------------------
+ * joystk_sample_step()
+ *
+ *  Called by the platform sampler timer.
+ *  Reads the comparator for the DAC probe of the previous call,
+ *  updates the approximation, and writes the next probe to the DAC.
+ *  Six probes approximate the highest level under the joystick position,
+ *  and a seventh probes that level to tell levels 0 and 1 apart.
+ *  Both axes are converted one after the other, every JOYSTK_IDLE_USEC.
+ *
+ *  param:  Nothing
+ *  return: Micro-seconds to the next call
+ */
+uint32_t joystk_sample_step(void)
+{
+    int     probe;
+
+    joystk_lock();
+
+    if ( !sampling )
+    {
+        joystk_unlock();
+        return JOYSTK_IDLE_USEC;
+    }
+
+    if ( probe_bit == 0 )
+    {
+        /* Start a conversion
+         */
+        rpi_audio_mux_set(axis);
+        approximation = 0;
+        probe_bit = JOYSTK_FIRST_PROBE;
+    }
+    else
+    {
+        if ( probe_bit > 1 )
+        {
+            /* Approximation bit probes
+             */
+            if ( rpi_joystk_comp_settled() )
+                approximation += (probe_bit >> 1);
+            probe_bit >>= 1;
+        }
+        else
+        {
+            /* Last probe of the approximated level
+             */
+            joystk_level[axis] = approximation + rpi_joystk_comp_settled();
+            probe_bit = 0;
+
+            axis = (axis + 1) % JOYSTK_AXES;
+            if ( axis == 0 )
+            {
+                joystk_unlock();
+                return JOYSTK_IDLE_USEC;
+            }
+
+            rpi_audio_mux_set(axis);
+            approximation = 0;
+            probe_bit = JOYSTK_FIRST_PROBE;
+        }
+    }
+
+    /* Probes 'approximation + bit' for bits 5 to 0,
+     * then 'approximation' when 'probe_bit' is 1
+     */
+    probe = approximation + (probe_bit >> 1);
+    rpi_write_dac(probe);
+
+    joystk_unlock();
+
+    return JOYSTK_SETTLE_USEC;
+}
@@ -0,0 +1,138 @@
+/********************************************************************
+ * kbd.c
+ *
+ *  Background keyboard reader.
+ *  The platform's keyboard timer (a thread on Linux, a timer interrupt
+ *  on bare metal) calls kbd_poll_step() to read the scan codes buffered
+ *  by the AVR keyboard interface through SPI, and queues them
+ *  in a ring buffer. The emulation takes scan codes from the ring buffer,
+ *  so PIA keyboard column writes and the loader do not wait for an
+ *  SPI transfer.
+ *  The ring buffer has one writer and one reader, the keyboard timer
+ *  only moves the head and the emulation only moves the tail.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "config.h"
+#include    "rpi.h"
+
+#include    "kbd.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     KBD_RING_SIZE           64          // Scan codes, must be a power of 2
+#define     KBD_RING_MASK           (KBD_RING_SIZE-1)
+#define     KBD_POLL_USEC           2000        // Time between AVR FIFO reads
+#define     KBD_POLL_BURST          8           // Scan codes read per poll
+
+/* Order ring buffer entry and index accesses between the emulation
+ * and the keyboard timer. Bare metal reads the keyboard in an interrupt on one core.
+ */
+#if (RPI_BARE_METAL==0)
+    #define     kbd_barrier()       __sync_synchronize()
+#else
+    #define     kbd_barrier()       __asm__ __volatile__ ("" ::: "memory")
+#endif
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint8_t              kbd_ring[KBD_RING_SIZE];
+
+static volatile uint32_t    ring_head = 0;      // Next entry to write, keyboard timer
+static volatile uint32_t    ring_tail = 0;      // Next entry to read, emulation
+
+/*------------------------------------------------
+ * kbd_init()
+ *
+ *  Initialize the keyboard reader and empty the ring buffer.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void kbd_init(void)
+{
+    ring_head = 0;
+    ring_tail = 0;
+}
+
+/*------------------------------------------------
+ * kbd_read()
+ *
+ *  Take the next scan code from the ring buffer. Without the
+ *  background reader the scan code is read from the AVR.
+ *
+ *  param:  Nothing
+ *  return: Scan code, bit.7 set for a 'break' code, '0' if no key code is waiting
+ */
+int kbd_read(void)
+{
+#if (KBD_READER==1)
+    uint32_t    tail;
+    int         scan_code;
+
+    tail = ring_tail;
+    if ( tail == ring_head )
+        return 0;
+
+    kbd_barrier();
+
+    scan_code = kbd_ring[tail];
+
+    kbd_barrier();
+
+    ring_tail = (tail + 1) & KBD_RING_MASK;
+
+    return scan_code;
+#else
+    return rpi_keyboard_read();
+#endif
+}
+
+/*------------------------------------------------
+ * kbd_poll_step()
+ *
+ *  Called by the platform keyboard timer.
+ *  Reads the scan codes waiting in the AVR FIFO into the ring buffer.
+ *  When the ring buffer is full the scan codes are left in the AVR FIFO.
+ *
+ *  param:  Nothing
+ *  return: Micro-seconds to the next call
+ */
+uint32_t kbd_poll_step(void)
+{
+    uint32_t    head, next_head;
+    int         scan_code;
+    int         i;
+
+    head = ring_head;
+
+    for ( i = 0; i < KBD_POLL_BURST; i++ )
+    {
+        next_head = (head + 1) & KBD_RING_MASK;
+        if ( next_head == ring_tail )
+            break;
+
+        scan_code = rpi_keyboard_read();
+        if ( scan_code == 0 )
+            break;
+
+        kbd_ring[head] = (uint8_t) scan_code;
+
+        kbd_barrier();
+
+        ring_head = next_head;
+        head = next_head;
+    }
+
+    return KBD_POLL_USEC;
+}
@@ -12,6 +12,11 @@
 #include    <ctype.h>
 #include    <string.h>
 
+#if (RPI_BARE_METAL==0)
+    #include    <pthread.h>
+#endif
+
+#include    "config.h"
 #include    "dbgmsg.h"
 
 #include    "cpu.h"
@@ -19,7 +24,9 @@
 #include    "sd.h"
 #include    "rpi.h"
 #include    "vdg.h"
+#include    "kbd.h"
 #include    "fat32.h"
+#include    "disk.h"
 
 #include    "loader.h"
 
@@ -31,17 +38,37 @@
 
 #define     FAT32_MAX_DIR_LIST      256
 
+/* Directory listings are cached by their start cluster, so opening a directory
+ * again does not read it from the SD card. Entries are parsed as the list is
+ * scrolled, and their long file names are kept in a string pool per listing.
+ */
+#define     DIR_CACHE_LISTINGS      4
+#define     DIR_CACHE_POOL_SIZE     (8 * 1024)
+#define     DIR_CACHE_FREE          0       // Start cluster of an unused listing
+
+/* Letter keys jump to the first name, in name order, that starts with the letters
+ * typed. Letters typed within the timeout of each other add to the name prefix.
+ */
+#define     TYPE_AHEAD_LENGTH       8
+#define     TYPE_AHEAD_TIMEOUT      1000000 // Micro-seconds
+
+#define     SCAN_CODE_1             2
+#define     SCAN_CODE_4             5
 #define     SCAN_CODE_Q             16
 #define     SCAN_CODE_ENTR          28
 #define     SCAN_CODE_UP            72
+#define     SCAN_CODE_PGUP          73
 #define     SCAN_CODE_DOWN          80
+#define     SCAN_CODE_PGDN          81
+#define     SCAN_CODE_LETTERS       16      // First scan code in the scan_code_letter[] table
 
 #define     TERMINAL_STATUS_ROW     15
 #define     TERMINAL_LIST_LENGTH    (TERMINAL_STATUS_ROW-1)
 #define     TERMINAL_LINE_LENGTH    31
+#define     TERMINAL_PAGE_LENGTH    (TERMINAL_LIST_LENGTH+1)
 
 #define     MSG_EXIT                "PRESS <Q> TO EXIT.              "
-#define     MSG_STATUS              "PRESS: <UP> <DOWN> <ENTER> <Q>  "
+#define     MSG_STATUS              "<UP><DN><ENTER> <1>-<4> DRV <Q> "
 #define     MSG_SD_ERROR            "SD CARD INITIALIZATION FAILED,  " \
                                     "REPLACE OR INSERT A CARD.       "
 #define     MSG_FAT32_ERROR         "FAT32 INITIALIZATION FAILED,    " \
@@ -51,29 +78,140 @@
 #define     MSG_ROM_READ_DONE       "ROM IMAGE LOAD COMPLETED.       "
 #define     MSG_CAS_READ_ERROR      "CAS FILE READ ERROR.            "
 #define     MSG_CAS_FILE_MOUNTED    "CAS FILE MOUNTED.               "
-#define     MSG_DISK_IMG_MOUNTED    "DISK IMAGE MOUNTED.             "
+#define     MSG_DISK_IMG_MOUNTED    "DISK IMAGE MOUNTED IN DRIVE 1.  "
+#define     MSG_DISK_DRIVE_DIGIT    28
 
-#define     CODE_BUFFER_SIZE        (16*1024)
 #define     CARTRIDGE_ROM_BASE      0xc000
-#define     CARTRIDGE_ROM_END       0xffef
+#define     CARTRIDGE_ROM_END       0xfeff
+#define     CARTRIDGE_ROM_SIZE      (CARTRIDGE_ROM_END - CARTRIDGE_ROM_BASE + 1)
 
 #define     EXEC_VECTOR_HI          0x9d
 #define     EXEC_VECTOR_LO          0x9e
 
+/* Disk image RAM cache per drive, large enough for an 80 track double-sided
+ * image and its header. Dirty blocks match the SD card sector size.
+ */
+#define     DISK_CACHE_SIZE         (2 * 80 * 18 * 256 + 512)
+#define     DISK_CACHE_BLOCK        512
+#define     DISK_CACHE_BLOCKS       (DISK_CACHE_SIZE / DISK_CACHE_BLOCK)
+#define     DISK_CACHE_READ_CHUNK   (16 * 1024)
+
+/* CAS file read-ahead buffer, refilled from the SD card in one read
+ * when the tape input has used all of it
+ */
+#define     CAS_BUFFER_SIZE         (4 * 1024)
+
+/* Tape output is saved to a new CAS file through a write-behind buffer.
+ * The file is created when the buffer is first written back, and is named
+ * after the program in the namefile block at the start of the buffer.
+ */
+#define     CAS_SAVE_EXT            ".CAS"
+#define     CAS_SAVE_DEFAULT_NAME   "CSAVE"
+#define     CAS_SAVE_NAME_LENGTH    8
+#define     CAS_SAVE_RETRIES        9       // Digit suffixes tried when the file name exists
+#define     CAS_LEADER_BYTE         0x55
+#define     CAS_SYNC_BYTE           0x3c
+#define     CAS_BLOCK_NAMEFILE      0x00
+
+/* Machine state files are read and written in chunks
+ * of up to this length per FAT32 call
+ */
+#define     LOADER_STATE_CHUNK      (32 * 1024)
+#define     LOADER_STATE_DIR_LIST   16      // Directory entries parsed per call when looking for the file
+
+/* On Linux disk image access runs on the disk controller's worker thread,
+ * so FAT32 calls that can overlap with CAS file reads are serialized.
+ * On bare metal multi-core the disk image worker runs on its own core, and
+ * FAT32 calls outside of the disk image functions wait for its queued jobs.
+ */
+#if (RPI_BARE_METAL==0)
+    #define     fat32_lock()        pthread_mutex_lock(&fat32_access_lock)
+    #define     fat32_unlock()      pthread_mutex_unlock(&fat32_access_lock)
+    #define     disk_image_lock()   fat32_lock()
+    #define     disk_image_unlock() fat32_unlock()
+#elif (RPI_MULTI_CORE==1)
+    #define     fat32_lock()        disk_io_sync()
+    #define     fat32_unlock()
+    #define     disk_image_lock()
+    #define     disk_image_unlock()
+#else
+    #define     fat32_lock()
+    #define     fat32_unlock()
+    #define     disk_image_lock()
+    #define     disk_image_unlock()
+#endif
+
 /* -----------------------------------------
    Module types
 ----------------------------------------- */
+typedef struct
+{
+    file_param_t        img_file;
+    loader_file_type_t  img_file_type;
+    uint8_t             cache[DISK_CACHE_SIZE];
+    uint8_t             cache_dirty[DISK_CACHE_BLOCKS];
+    int                 cache_valid;        // Open disk image is held in RAM cache
+    int                 cache_modified;     // Cache has dirty blocks
+    uint32_t            cache_size;         // Disk image bytes in cache
+    uint32_t            cache_position;     // Read/write position in cache
+} disk_drive_t;
+
+typedef struct
+{
+    uint32_t            cluster_chain_head;
+    uint32_t            file_size;
+    uint32_t            dir_record_lba;
+    uint16_t            name;               // Long file name offset in the string pool
+    uint8_t             dir_record_index;
+    uint8_t             is_directory;
+} dir_cache_entry_t;
+
+typedef struct
+{
+    uint32_t            cluster;            // Directory start cluster, or DIR_CACHE_FREE
+    uint32_t            last_used;          // Loader use count when the listing was last opened
+    int                 length;             // Entries parsed so far
+    int                 complete;           // All entries were parsed
+    int                 pool_used;          // String pool bytes in use
+    int                 sorted;             // Name index was built for the complete listing
+    dir_cache_entry_t   entry[FAT32_MAX_DIR_LIST];
+    uint16_t            name_index[FAT32_MAX_DIR_LIST]; // Entries in name order
+    char                pool[DIR_CACHE_POOL_SIZE];
+} dir_cache_t;
 
 /* -----------------------------------------
    Module function
 ----------------------------------------- */
 static loader_file_type_t file_get_type(char *directory_entry);
 
+static int         disk_mount(int drive, dir_entry_t *directory_entry);
+static void        disk_unmount(int drive);
+static int         disk_cache_load(disk_drive_t *disk);
+static void        disk_cache_write_back(disk_drive_t *disk);
+
+static void        cas_save_write_back(void);
+static int         cas_save_create(void);
+
+static int         state_file_find(char *file_name, dir_entry_t *directory_entry);
+
+static int         dir_cache_open(uint32_t cluster);
+static int         dir_cache_fill(int length);
+static dir_entry_t *dir_cache_get(int index);
+static int         dir_cache_find(char *prefix);
+static void        dir_cache_invalidate(uint32_t cluster);
+static int         dir_name_compare(const char *name, const char *prefix, int length);
+
 static void        text_write(int row, int col, char *text);
 static void        text_highlight(int on_off, int row);
-static void        text_dir_output(int list_start, int list_length, dir_entry_t *directory_list);
+static void        text_dir_output(int list_start, int list_length);
 static void        text_clear(void);
 
+static void        mount_sd(void);
+static void        mount_wait(void);
+#if (RPI_BARE_METAL==0)
+static void       *mount_thread(void *arg);
+#endif
+
 static void        util_wait_quit(void);
 static void        util_save_text_screen(void);
 static void        util_restore_text_screen(void);
@@ -82,10 +220,32 @@ static void        util_restore_text_screen(void);
    Module globals
 ----------------------------------------- */
 static uint8_t              text_screen_save[512];
-static uint8_t              code_buffer[CODE_BUFFER_SIZE];
 static file_param_t         cas_file;
-static file_param_t         disk_img_file;
-static loader_file_type_t   disk_img_file_type;
+static uint8_t              cas_buffer[CAS_BUFFER_SIZE];
+static int                  cas_buffer_length = 0;  // Bytes read into the buffer
+static int                  cas_buffer_index = 0;   // Next byte to return
+static file_param_t         cas_save_file;
+static uint8_t              cas_save_buffer[CAS_BUFFER_SIZE];
+static int                  cas_save_length = 0;    // Bytes waiting to be written back
+static int                  cas_save_failed = 0;    // File not created, tape output is dropped until closed
+static uint32_t             cas_save_directory = FAT32_ROOT_DIR_CLUSTER;
+static disk_drive_t         disk_drive[LOADER_DISK_DRIVES];
+static dir_cache_t          dir_cache[DIR_CACHE_LISTINGS];
+static dir_cache_t         *dir_cache_listing = 0L; // Listing displayed by the loader
+static int                  dir_cache_resume = 0;   // fat32_parse_dir() continues from the end of the displayed listing
+static uint32_t             dir_cache_uses = 0;
+static dir_entry_t          dir_cache_scratch;      // Directory entry parsed from, or rebuilt out of the cache
+
+/* Letters by their PC keyboard scan code,
+ * starting at SCAN_CODE_LETTERS
+ */
+static const char           scan_code_letter[] = "QWERTYUIOP\0\0\0\0" "ASDFGHJKL\0\0\0\0\0" "ZXCVBNM";
+
+#if (RPI_BARE_METAL==0)
+static pthread_mutex_t      fat32_access_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t            mount_thread_id;
+static int                  mount_pending = 0;      // Mount thread is running or was not joined
+#endif
 
 /*------------------------------------------------
  * loader_init()
@@ -97,9 +257,49 @@ static loader_file_type_t   disk_img_file_type;
  */
 void loader_init(void)
 {
+    int     drive, i;
+
     memset(&cas_file, 0, sizeof(file_param_t));
-    memset(&disk_img_file, 0, sizeof(file_param_t));
-    disk_img_file_type = FILE_NONE;
+    memset(&cas_save_file, 0, sizeof(file_param_t));
+
+    for ( drive = 0; drive < LOADER_DISK_DRIVES; drive++ )
+    {
+        memset(&disk_drive[drive].img_file, 0, sizeof(file_param_t));
+        disk_drive[drive].img_file_type = FILE_NONE;
+        disk_drive[drive].cache_valid = 0;
+        disk_drive[drive].cache_modified = 0;
+    }
+
+    for ( i = 0; i < DIR_CACHE_LISTINGS; i++ )
+        dir_cache[i].cluster = DIR_CACHE_FREE;
+}
+
+/*------------------------------------------------
+ * loader_mount()
+ *
+ *  Mount the SD card and its FAT32 file system.
+ *  On Linux the mount runs on a thread while the emulation starts,
+ *  and loader functions that access the SD card wait for it to complete.
+ *  There are no disk images mounted until the loader is used, so the disk
+ *  controller reports its drives as not ready until then.
+ *  On bare metal the mount completes before the call returns.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void loader_mount(void)
+{
+#if (RPI_BARE_METAL==0)
+    if ( pthread_create(&mount_thread_id, NULL, mount_thread, NULL) == 0 )
+    {
+        mount_pending = 1;
+        return;
+    }
+
+    dbg_printf(1, "loader_mount()[%d]: Mount thread failed, mounting before start-up.\n", __LINE__);
+#endif
+
+    mount_sd();
 }
 
 /*------------------------------------------------
@@ -115,11 +315,17 @@ void loader(void)
 {
     int             key_pressed;
     int             rom_bytes;
+    int             drive;
+    char            mount_message[] = MSG_DISK_IMG_MOUNTED;
 
-    dir_entry_t     directory_list[FAT32_MAX_DIR_LIST];
+    dir_entry_t    *directory_entry;
     file_param_t    file;
     int             list_start, prev_list_start, list_length;
-    int             highlighted_line;
+    int             highlighted_line, selected;
+    char            type_ahead[(TYPE_AHEAD_LENGTH + 1)] = {0};
+    int             type_ahead_length = 0;
+    uint32_t        type_ahead_time = 0;
+    uint32_t        now;
 
     loader_file_type_t  file_type;
 
@@ -127,6 +333,8 @@ void loader(void)
 
     /* Check if SD card and FAT32 are available.
      */
+    mount_wait();
+
     if ( !fat32_is_initialized() )
     {
         dbg_printf(0, "loader()[%d]: FAT32 or SD not available.\n", __LINE__);
@@ -139,9 +347,12 @@ void loader(void)
         return;
     }
 
-    /* Initial directory load
+    /* Initial directory load, the root directory is
+     * only read from the SD card if it is not cached
      */
-    if ( (list_length = fat32_parse_dir(2, directory_list, FAT32_MAX_DIR_LIST)) == -1 )
+    dir_cache_resume = 0;
+
+    if ( (list_length = dir_cache_open(FAT32_ROOT_DIR_CLUSTER)) == -1 )
     {
         text_write(0, 0, MSG_DIR_READ_ERROR);
         text_write(TERMINAL_STATUS_ROW, 0, MSG_EXIT);
@@ -151,19 +362,36 @@ void loader(void)
         return;
     }
 
+    cas_save_directory = FAT32_ROOT_DIR_CLUSTER;
+
     /* Main loop.
      */
     list_start = 0;
     prev_list_start = -1;
     highlighted_line = 0;
-    text_dir_output(list_start, list_length, directory_list);
+    text_dir_output(list_start, list_length);
     text_write(TERMINAL_STATUS_ROW, 0, MSG_STATUS);
 
     for (;;)
     {
         vdg_render();
 
-        key_pressed = rpi_keyboard_read();
+        key_pressed = kbd_read();
+
+        /* Parse the entries in view and the page after them,
+         * so scrolling and paging down know if there are more
+         */
+        if ( (list_length = dir_cache_fill(list_start + 2 * TERMINAL_PAGE_LENGTH + 1)) == -1 )
+        {
+            text_clear();
+            text_write(0, 0, MSG_DIR_READ_ERROR);
+            text_write(TERMINAL_STATUS_ROW, 0, MSG_EXIT);
+
+            util_wait_quit();
+            break;
+        }
+
+        directory_entry = dir_cache_get(list_start + highlighted_line);
 
         if ( key_pressed == SCAN_CODE_Q )
         {
@@ -202,16 +430,82 @@ void loader(void)
                     list_start = list_length - (TERMINAL_LIST_LENGTH + 1);
             }
         }
-        else if ( key_pressed == SCAN_CODE_ENTR )
+        else if ( key_pressed == SCAN_CODE_PGUP )
+        {
+            /* Scroll the list down one page,
+             * or highlight the top line if at top of list
+             */
+            if ( list_start == 0 )
+                highlighted_line = 0;
+
+            list_start -= TERMINAL_PAGE_LENGTH;
+            if ( list_start < 0 )
+                list_start = 0;
+        }
+        else if ( key_pressed == SCAN_CODE_PGDN )
+        {
+            /* Scroll the list up one page,
+             * or highlight the bottom line if at end of list
+             */
+            list_start += TERMINAL_PAGE_LENGTH;
+            if ( list_start > (list_length - TERMINAL_PAGE_LENGTH) )
+                list_start = list_length - TERMINAL_PAGE_LENGTH;
+            if ( list_start < 0 )
+                list_start = 0;
+
+            if ( list_start == prev_list_start || (list_start + highlighted_line) >= list_length )
+                highlighted_line = list_length - 1 - list_start;
+        }
+        else if ( key_pressed > SCAN_CODE_LETTERS &&
+                  key_pressed < (SCAN_CODE_LETTERS + (int) sizeof(scan_code_letter)) &&
+                  scan_code_letter[(key_pressed - SCAN_CODE_LETTERS)] )
+        {
+            /* Add the letter to the typed name prefix, or start a new prefix
+             * after a pause, and jump to the first name that starts with it.
+             * A letter that matches no name is dropped from the prefix.
+             */
+            now = rpi_system_timer();
+            if ( (now - type_ahead_time) > TYPE_AHEAD_TIMEOUT || type_ahead_length == TYPE_AHEAD_LENGTH )
+                type_ahead_length = 0;
+            type_ahead_time = now;
+
+            type_ahead[type_ahead_length++] = scan_code_letter[(key_pressed - SCAN_CODE_LETTERS)];
+            type_ahead[type_ahead_length] = 0;
+
+            if ( (selected = dir_cache_find(type_ahead)) == -1 )
+            {
+                type_ahead[--type_ahead_length] = 0;
+            }
+            else
+            {
+                list_length = dir_cache_fill(FAT32_MAX_DIR_LIST);
+
+                if ( selected < list_start || selected >= (list_start + TERMINAL_PAGE_LENGTH) )
+                {
+                    list_start = selected;
+                    if ( list_start > (list_length - TERMINAL_PAGE_LENGTH) )
+                        list_start = list_length - TERMINAL_PAGE_LENGTH;
+                    if ( list_start < 0 )
+                        list_start = 0;
+                }
+
+                highlighted_line = selected - list_start;
+            }
+        }
+        else if ( key_pressed == SCAN_CODE_ENTR ||
+                  (key_pressed >= SCAN_CODE_1 && key_pressed <= SCAN_CODE_4 &&
+                   file_get_type(directory_entry->lfn) == FILE_VDK) )
         {
-            if ( directory_list[(list_start + highlighted_line)].is_directory )
+            if ( directory_entry->is_directory )
             {
                 text_clear();
 
-                /* Read and display the directory
+                /* Read and display the directory, tape output
+                 * is saved to the directory last displayed
                  */
-                if ( (list_length = fat32_parse_dir(directory_list[(list_start + highlighted_line)].cluster_chain_head,
-                                                    directory_list, FAT32_MAX_DIR_LIST)) == -1 )
+                cas_save_directory = directory_entry->cluster_chain_head;
+
+                if ( (list_length = dir_cache_open(cas_save_directory)) == -1 )
                 {
                     text_write(0, 0, MSG_DIR_READ_ERROR);
                     text_write(TERMINAL_STATUS_ROW, 0, MSG_EXIT);
@@ -223,37 +517,41 @@ void loader(void)
                 list_start = 0;
                 prev_list_start = 0;
                 highlighted_line = 0;
-                text_dir_output(list_start, list_length, directory_list);
+                type_ahead_length = 0;
+                text_dir_output(list_start, list_length);
             }
             else
             {
-                dbg_printf(2, "loader()[%d]: Accessing '%s'\n", __LINE__, directory_list[(list_start + highlighted_line)].lfn);
+                /* Opening a file reads over the directory parser's sectors
+                 */
+                dir_cache_resume = 0;
+
+                dbg_printf(2, "loader()[%d]: Accessing '%s'\n", __LINE__, directory_entry->lfn);
 
                 /* Handle .ROM .CAS and .VDK extensions ignore
                  * all other file types
                  */
-                file_type = file_get_type(directory_list[(list_start + highlighted_line)].lfn);
+                file_type = file_get_type(directory_entry->lfn);
 
                 if ( file_type == FILE_ROM )
                 {
-                    /* Load ROM image into emulator memory
-                     * and change EXEC default vector to 0xC000
+                    /* Read ROM image straight into the cartridge address space
+                     * of emulator memory and change EXEC default vector to 0xC000
                      */
-                    fat32_fopen(&directory_list[(list_start + highlighted_line)], &file);
-                    rom_bytes = fat32_fread(&file, code_buffer, CODE_BUFFER_SIZE);
+                    fat32_fopen(directory_entry, &file);
+                    rom_bytes = fat32_fread(&file, mem_load_buffer(CARTRIDGE_ROM_BASE, CARTRIDGE_ROM_SIZE), CARTRIDGE_ROM_SIZE);
                     fat32_fclose(&file);
 
                     text_clear();
 
-                    if ( rom_bytes == -1 )
+                    if ( rom_bytes <= 0 )
                     {
                         text_write(0, 0, MSG_ROM_READ_ERROR);
                         text_write(TERMINAL_STATUS_ROW, 0, MSG_EXIT);
                     }
                     else
                     {
-                        mem_load(CARTRIDGE_ROM_BASE, code_buffer, rom_bytes);
-                        mem_define_rom(CARTRIDGE_ROM_BASE, (rom_bytes - 1));
+                        mem_define_rom(CARTRIDGE_ROM_BASE, (CARTRIDGE_ROM_BASE + rom_bytes - 1));
                         mem_write(EXEC_VECTOR_HI, 0xc0);
                         mem_write(EXEC_VECTOR_LO, 0x00);
 
@@ -269,7 +567,9 @@ void loader(void)
                     /* Open the selected CAS file.
                      */
                     fat32_fclose(&cas_file);
-                    if ( fat32_fopen(&directory_list[(list_start + highlighted_line)], &cas_file) == NO_ERROR )
+                    cas_buffer_length = 0;
+                    cas_buffer_index = 0;
+                    if ( fat32_fopen(directory_entry, &cas_file) == NO_ERROR )
                     {
                         text_clear();
 
@@ -282,18 +582,19 @@ void loader(void)
                 }
                 else if ( file_type == FILE_VDK )
                 {
-                    /* Open the selected disk image
+                    /* Mount the disk image in drive 1 with <ENTER>,
+                     * or in the drive selected with keys <1> to <4>
                      */
-                    fat32_fclose(&disk_img_file);
-                    disk_img_file_type = FILE_NONE;
-                    
-                    if ( fat32_fopen(&directory_list[(list_start + highlighted_line)], &disk_img_file) == NO_ERROR )
-                    {
-                        disk_img_file_type = file_type;
+                    drive = 0;
+                    if ( key_pressed != SCAN_CODE_ENTR )
+                        drive = key_pressed - SCAN_CODE_1;
 
+                    if ( disk_mount(drive, directory_entry) )
+                    {
                         text_clear();
 
-                        text_write(0, 0, MSG_DISK_IMG_MOUNTED);
+                        mount_message[MSG_DISK_DRIVE_DIGIT] = '1' + drive;
+                        text_write(0, 0, mount_message);
                         text_write(TERMINAL_STATUS_ROW, 0, MSG_EXIT);
 
                         util_wait_quit();
@@ -309,8 +610,11 @@ void loader(void)
 
         if ( list_start != prev_list_start )
         {
-            text_clear();
-            text_dir_output(list_start, list_length, directory_list);
+            /* Only the screen rows that changed are written,
+             * so the VDG redraws only their video memory lines
+             */
+            text_highlight_off();
+            text_dir_output(list_start, list_length);
             prev_list_start = list_start;
         }
 
@@ -323,223 +627,1265 @@ void loader(void)
 /*------------------------------------------------
  * loader_cas_fread()
  *
- *  Read the open CAS file.
+ *  Read the open CAS file through the read-ahead buffer.
+ *  The buffer is refilled from the file when it is empty, so byte by byte
+ *  reads of the tape input only copy from RAM.
  *
  *  param:  Pointer to caller buffer and bytes to read
- *  return: Bytes read
+ *  return: Bytes read, or FAT32 error code at end of file or read error
  */
 int loader_cas_fread(uint8_t *buffer, uint16_t bytes)
 {
-    return fat32_fread(&cas_file, buffer, bytes);
-}
+    int     count, result;
 
-/*------------------------------------------------
- * loader_disk_fread()
- *
- *  Read the open disk image file.
- *
- *  param:  Pointer to caller buffer and bytes to read
- *  return: Bytes read
- */
-int  loader_disk_fread(uint8_t *buffer, uint16_t bytes)
-{
-    return fat32_fread(&disk_img_file, buffer, bytes);
+    for ( count = 0; count < bytes; count += result )
+    {
+        if ( cas_buffer_index == cas_buffer_length )
+        {
+            fat32_lock();
+            result = fat32_fread(&cas_file, cas_buffer, CAS_BUFFER_SIZE);
+            fat32_unlock();
+
+            if ( result <= 0 )
+                return (count ? count : result);
+
+            cas_buffer_length = result;
+            cas_buffer_index = 0;
+        }
+
+        result = cas_buffer_length - cas_buffer_index;
+        if ( result > (bytes - count) )
+            result = bytes - count;
+
+        memcpy(&buffer[count], &cas_buffer[cas_buffer_index], result);
+        cas_buffer_index += result;
+    }
+
+    return count;
 }
 
 /*------------------------------------------------
- * loader_disk_fwrite()
+ * loader_cas_fwrite()
  *
- *  Write the open disk image file.
+ *  Write tape output to the CAS file being saved, through the
+ *  write-behind buffer. The buffer is written back to the SD card when it
+ *  is full, so byte by byte writes of the tape output only copy to RAM.
+ *  A write after loader_cas_fclose() starts a new CAS file, created in
+ *  the directory last displayed by the loader.
  *
  *  param:  Pointer to caller buffer and bytes to write
  *  return: Bytes written
  */
-int  loader_disk_fwrite(uint8_t *buffer, uint16_t bytes)
+int loader_cas_fwrite(uint8_t *buffer, uint16_t bytes)
 {
-    return fat32_fwrite(&disk_img_file, buffer, bytes);
+    int     count, result;
+
+    for ( count = 0; count < bytes; count += result )
+    {
+        if ( cas_save_length == CAS_BUFFER_SIZE )
+            cas_save_write_back();
+
+        result = CAS_BUFFER_SIZE - cas_save_length;
+        if ( result > (bytes - count) )
+            result = bytes - count;
+
+        memcpy(&cas_save_buffer[cas_save_length], &buffer[count], result);
+        cas_save_length += result;
+    }
+
+    return count;
 }
 
 /*------------------------------------------------
- * loader_disk_fseek()
+ * loader_cas_fclose()
  *
- *  Seek to location of an open disk image file.
+ *  Write back the tape output buffer and close the CAS file
+ *  it is saved to, with the file system's sector cache written to the
+ *  SD card so the saved file outlasts the emulation session.
  *
- *  param:  Location to seek
- *  return: 0=Seek error, -1=Ok
+ *  param:  None
+ *  return: None
  */
-int loader_disk_fseek(uint32_t position)
+void loader_cas_fclose(void)
 {
-    return fat32_fseek(&disk_img_file, position);
+    int     result;
+
+    cas_save_write_back();
+    cas_save_failed = 0;
+
+    if ( !cas_save_file.file_is_open )
+        return;
+
+    fat32_lock();
+
+    if ( (result = fat32_flush()) != NO_ERROR )
+        dbg_printf(0, "loader_cas_fclose()[%d]: Sector cache flush failed (%d).\n", __LINE__, result);
+
+    dbg_printf(2, "loader_cas_fclose()[%d]: CAS file saved (%u bytes).\n", __LINE__, cas_save_file.file_size);
+
+    fat32_fclose(&cas_save_file);
+
+    fat32_unlock();
 }
 
 /*------------------------------------------------
- * loader_disk_img_type()
+ * loader_disk_fread()
  *
- *  Return the open image file type.
+ *  Read the open disk image file of a drive, from the RAM cache
+ *  when the image is cached.
  *
- *  param:  None
- *  return: Image file type.
+ *  param:  Drive number 0 to 3, pointer to caller buffer and bytes to read
+ *  return: Bytes read
  */
-loader_file_type_t loader_disk_img_type(void)
+int  loader_disk_fread(int drive, uint8_t *buffer, uint16_t bytes)
 {
-    return disk_img_file_type;
+    disk_drive_t   *disk;
+    uint32_t        count;
+    int             result;
+
+    disk = &disk_drive[drive];
+
+    if ( !disk->cache_valid )
+    {
+        disk_image_lock();
+        result = fat32_fread(&disk->img_file, buffer, bytes);
+        disk_image_unlock();
+        return result;
+    }
+
+    if ( disk->cache_position >= disk->cache_size )
+        return FAT_EOF;
+
+    count = disk->cache_size - disk->cache_position;
+    if ( count > bytes )
+        count = bytes;
+
+    memcpy(buffer, &disk->cache[disk->cache_position], count);
+    disk->cache_position += count;
+
+    return (int) count;
 }
 
 /*------------------------------------------------
- * file_get_type()
+ * loader_disk_fwrite()
  *
- *  Parse a file name passed in a directory entry record
- *  and return its type.
+ *  Write the open disk image file of a drive. When the image is cached
+ *  the data is written to the RAM cache and its blocks are marked dirty,
+ *  to be written back to the SD card by loader_disk_flush().
  *
- *  param:  Pointer to directory entry record
- *  return: File type
+ *  param:  Drive number 0 to 3, pointer to caller buffer and bytes to write
+ *  return: Bytes written
  */
-static loader_file_type_t file_get_type(char *directory_entry)
+int  loader_disk_fwrite(int drive, uint8_t *buffer, uint16_t bytes)
 {
-    if ( strstr(directory_entry, ".ROM") || strstr(directory_entry, ".rom") )
+    disk_drive_t   *disk;
+    uint32_t        block, end_position;
+    int             result;
+
+    disk = &disk_drive[drive];
+
+    if ( !disk->cache_valid )
     {
-        return FILE_ROM;
+        disk_image_lock();
+        result = fat32_fwrite(&disk->img_file, buffer, bytes);
+        disk_image_unlock();
+        return result;
     }
-    else if ( strstr(directory_entry, ".CAS") || strstr(directory_entry, ".cas") )
+
+    end_position = disk->cache_position + bytes;
+    if ( end_position > DISK_CACHE_SIZE )
     {
-        return FILE_CAS;
+        dbg_printf(1, "loader_disk_fwrite()[%d]: Write past disk cache end.\n", __LINE__);
+        return FAT_WRITE_FAIL;
     }
-    else if ( strstr(directory_entry, ".VDK") || strstr(directory_entry, ".vdk") )
+
+    memcpy(&disk->cache[disk->cache_position], buffer, bytes);
+
+    /* A write past the end of the image grows it, and all blocks
+     * from the old end are written back so the file grows in order
+     */
+    block = disk->cache_position / DISK_CACHE_BLOCK;
+    if ( end_position > disk->cache_size )
     {
-        return FILE_VDK;
+        if ( (disk->cache_size / DISK_CACHE_BLOCK) < block )
+            block = disk->cache_size / DISK_CACHE_BLOCK;
+        disk->cache_size = end_position;
     }
 
-    return FILE_OTHER;
+    for ( ; block <= ((end_position - 1) / DISK_CACHE_BLOCK); block++ )
+        disk->cache_dirty[block] = 1;
+
+    disk->cache_position = end_position;
+    disk->cache_modified = 1;
+
+    return (int) bytes;
 }
 
 /*------------------------------------------------
- * text_write()
+ * loader_disk_fseek()
  *
- *  Output text to the text screen buffer
- *  vdg_render() will output. This function allows
- *  the loader to use the regular text display of the
- *  Dragon emulation.
- *  Text longer than a row will be wrapped to next line.
- *  Row and column numbers are 0 based.
+ *  Seek to location of the open disk image file of a drive.
  *
- *  param:  Row (0..15) and column (0..31) positions, text to output
- *  return: Nothing
+ *  param:  Drive number 0 to 3, location to seek
+ *  return: 0=Seek error, -1=Ok
  */
-static void text_write(int row, int col, char *text)
+int loader_disk_fseek(int drive, uint32_t position)
 {
-    int     count;
+    disk_drive_t   *disk;
+    int             result;
 
-    count = row * 32 + col;
+    disk = &disk_drive[drive];
 
-    while ( *text && (count < 512) )
+    if ( !disk->cache_valid )
     {
-        mem_write(0x400 + count, toupper((int)(*text)) & 0xbf);
-        text++;
-        count++;
+        disk_image_lock();
+        result = fat32_fseek(&disk->img_file, position);
+        disk_image_unlock();
+        return result;
     }
+
+    if ( position > disk->cache_size )
+        return FAT_FILE_SEEK_RANGE;
+
+    disk->cache_position = position;
+
+    return NO_ERROR;
 }
 
 /*------------------------------------------------
- * text_highlight()
+ * loader_disk_flush()
  *
- *  Highlight a row on the screen by flipping
- *  its video inverse bit
+ *  Write back the dirty blocks of the disk image RAM caches
+ *  of all drives to the disk image files on the SD card.
  *
- *  param:  Text highlighted ('1') and not ('0'), and row number (0..14)
- *  return: Nothing
+ *  param:  None
+ *  return: None
  */
-static void text_highlight(int on_off, int row)
+void loader_disk_flush(void)
 {
-    static int  highlighted_row = -1;
+    uint32_t    hits, misses;
+    int         drive;
+    int         result;
 
-    int     i, c;
-    int     row_address;
+    disk_image_lock();
 
-    /* Remove row-highlight if one is highlighted
-     */
-    if ( on_off == 0 && highlighted_row != -1 )
+    for ( drive = 0; drive < LOADER_DISK_DRIVES; drive++ )
+        disk_cache_write_back(&disk_drive[drive]);
+
+    if ( (result = fat32_flush()) != NO_ERROR )
     {
-        row_address = 0x400 + highlighted_row * 32;
-        for ( i = 1; i < 32; i++ )
-        {
-            c = mem_read((row_address + i)) & 0xbf;
-            mem_write((row_address + i), c);
-        }
-        highlighted_row = -1;
+        dbg_printf(0, "loader_disk_flush()[%d]: Sector cache flush failed (%d).\n", __LINE__, result);
     }
-
-    /* Highlight a row
-     */
-    else if ( on_off == 1 )
+    else
     {
-        if ( row < 0 || row > 14 )
-        {
-            return;
-        }
-        else if ( highlighted_row == row )
-        {
-            return;
-        }
-        else if ( highlighted_row == -1 )
-        {
-            row_address = 0x400 + row * 32;
-            for ( i = 1; i < 32; i++ )
-            {
-                c = mem_read((row_address + i)) | 0x40;
-                mem_write((row_address + i), c);
-            }
-            highlighted_row = row;
-        }
-        else
-        {
-            text_highlight(0, 0);
-            text_highlight(1, row);
-        }
+        fat32_cache_stats(&hits, &misses);
+        dbg_printf(2, "loader_disk_flush()[%d]: Disk images written back. Sector cache hits=%u misses=%u\n",
+                   __LINE__, hits, misses);
     }
+
+    disk_image_unlock();
 }
 
 /*------------------------------------------------
- * text_dir_output()
+ * disk_cache_write_back()
  *
- *  Print directory content
+ *  Write the dirty blocks of a drive's disk image RAM cache
+ *  to the disk image file.
  *
- *  param:  Where to start in the list, total list length, pointer to dir info
- *  return: Nothing
+ *  param:  Pointer to drive
+ *  return: None
  */
-static void text_dir_output(int list_start, int list_length, dir_entry_t *directory_list)
+static void disk_cache_write_back(disk_drive_t *disk)
 {
-    int     row;
-    char    text_line[(TERMINAL_LINE_LENGTH + 1)] = {0};
+    uint32_t    block, position, count;
+    int         result;
 
-    for ( row = 0; row <= TERMINAL_LIST_LENGTH; row++)
+    if ( !disk->cache_valid || !disk->cache_modified )
+        return;
+
+    for ( block = 0; block < DISK_CACHE_BLOCKS; block++ )
     {
-        if ( (row + list_start) < list_length )
+        if ( !disk->cache_dirty[block] )
+            continue;
+
+        position = block * DISK_CACHE_BLOCK;
+        if ( position >= disk->cache_size )
+            break;
+
+        count = disk->cache_size - position;
+        if ( count > DISK_CACHE_BLOCK )
+            count = DISK_CACHE_BLOCK;
+
+        if ( (result = fat32_fseek(&disk->img_file, position)) != NO_ERROR ||
+             (result = fat32_fwrite(&disk->img_file, &disk->cache[position], count)) < 0 )
         {
-            if ( directory_list[(row + list_start)].is_directory )
-                text_write(row, 0, "*");
-            strncpy(text_line, directory_list[(row + list_start)].lfn, TERMINAL_LINE_LENGTH);
-            text_line[(TERMINAL_LINE_LENGTH)] = 0;
-            text_write(row, 1, text_line);
+            dbg_printf(0, "disk_cache_write_back()[%d]: Write back failed (%d) at 0x%08x.\n", __LINE__, result, position);
+            return;
         }
+
+        disk->cache_dirty[block] = 0;
     }
+
+    disk->cache_modified = 0;
 }
 
 /*------------------------------------------------
- * text_clear()
+ * loader_disk_img_type()
  *
- *  Clear the text output area
+ *  Return the open image file type of a drive.
  *
- *  param:  Nothing
- *  return: Nothing
+ *  param:  Drive number 0 to 3
+ *  return: Image file type, FILE_NONE if no image is mounted.
  */
-static void text_clear(void)
+loader_file_type_t loader_disk_img_type(int drive)
 {
-    int     i;
+    return disk_drive[drive].img_file_type;
+}
 
-    text_highlight_off();
-    for ( i = 0; i < TERMINAL_STATUS_ROW; i++)
-        text_write(i, 0, "                                ");
+/*------------------------------------------------
+ * loader_disk_img_cluster()
+ *
+ *  Return the first cluster of the open image file of a drive,
+ *  which identifies the image on the SD card.
+ *
+ *  param:  Drive number 0 to 3
+ *  return: First cluster number, 0 if no image is mounted.
+ */
+uint32_t loader_disk_img_cluster(int drive)
+{
+    if ( !disk_drive[drive].img_file.file_is_open )
+        return 0;
+
+    return disk_drive[drive].img_file.file_start_cluster;
+}
+
+/*------------------------------------------------
+ * loader_cas_ftell()
+ *
+ *  Return the tape input position in the mounted CAS file,
+ *  the next byte that the tape input will read, which is behind
+ *  the file position by the bytes still waiting in the read-ahead buffer.
+ *
+ *  param:  Pointer to the first cluster of the CAS file, set to 0 if no file is mounted
+ *  return: Byte position in the CAS file
+ */
+uint32_t loader_cas_ftell(uint32_t *start_cluster)
+{
+    if ( !cas_file.file_is_open )
+    {
+        *start_cluster = 0;
+        return 0;
+    }
+
+    *start_cluster = cas_file.file_start_cluster;
+
+    return cas_file.current_position - (cas_buffer_length - cas_buffer_index);
+}
+
+/*------------------------------------------------
+ * loader_cas_fseek()
+ *
+ *  Move the tape input to a position in the mounted CAS file,
+ *  provided the mounted file is the one identified by its first cluster.
+ *  The read-ahead buffer is emptied and refilled from the new position.
+ *
+ *  param:  First cluster of the CAS file, byte position in the file
+ *  return: 1=Position set, 0=The file is not mounted or seek error
+ */
+int loader_cas_fseek(uint32_t start_cluster, uint32_t position)
+{
+    error_t     result;
+
+    if ( !cas_file.file_is_open || cas_file.file_start_cluster != start_cluster )
+        return 0;
+
+    fat32_lock();
+    result = fat32_fseek(&cas_file, position);
+    fat32_unlock();
+
+    cas_buffer_length = 0;
+    cas_buffer_index = 0;
+
+    return ( result == NO_ERROR );
+}
+
+/*------------------------------------------------
+ * loader_state_fwrite()
+ *
+ *  Write a machine state file to the directory last displayed by the loader,
+ *  in one sequential stream. An existing file by that name is overwritten
+ *  from its start and keeps its length if it was longer, the machine state
+ *  records its own length.
+ *
+ *  param:  File name, pointer to the machine state and its length in bytes
+ *  return: 1=File written, 0=Write failed
+ */
+int loader_state_fwrite(char *file_name, uint8_t *buffer, uint32_t length)
+{
+    dir_entry_t     directory_entry;
+    file_param_t    state_file;
+    uint32_t        count;
+    int             chunk, result;
+
+    mount_wait();
+
+    if ( !fat32_is_initialized() )
+        return 0;
+
+    fat32_lock();
+
+    if ( !state_file_find(file_name, &directory_entry) )
+    {
+        directory_entry.cluster_chain_head = cas_save_directory;
+        if ( (result = fat32_fcreate(file_name, &directory_entry)) != NO_ERROR )
+        {
+            fat32_unlock();
+            dbg_printf(0, "loader_state_fwrite()[%d]: State file '%s' not created (%d).\n", __LINE__, file_name, result);
+            return 0;
+        }
+    }
+
+    if ( fat32_fopen(&directory_entry, &state_file) != NO_ERROR )
+    {
+        fat32_unlock();
+        dbg_printf(0, "loader_state_fwrite()[%d]: State file '%s' open failed.\n", __LINE__, file_name);
+        return 0;
+    }
+
+    for ( count = 0; count < length; count += chunk )
+    {
+        chunk = ( (length - count) > LOADER_STATE_CHUNK ) ? LOADER_STATE_CHUNK : (int)(length - count);
+
+        if ( (result = fat32_fwrite(&state_file, &buffer[count], chunk)) != chunk )
+        {
+            dbg_printf(0, "loader_state_fwrite()[%d]: State file write failed (%d).\n", __LINE__, result);
+            break;
+        }
+    }
+
+    if ( (result = fat32_flush()) != NO_ERROR )
+        dbg_printf(0, "loader_state_fwrite()[%d]: Sector cache flush failed (%d).\n", __LINE__, result);
+
+    fat32_fclose(&state_file);
+
+    dir_cache_invalidate(cas_save_directory);
+
+    fat32_unlock();
+
+    return ( count >= length );
+}
+
+/*------------------------------------------------
+ * loader_state_fread()
+ *
+ *  Read a machine state file from the directory last displayed by the loader.
+ *
+ *  param:  File name, pointer to caller buffer and its length in bytes
+ *  return: Bytes read, or -1 if the file was not found
+ */
+int loader_state_fread(char *file_name, uint8_t *buffer, uint32_t length)
+{
+    dir_entry_t     directory_entry;
+    file_param_t    state_file;
+    uint32_t        count;
+    int             chunk, result;
+
+    mount_wait();
+
+    if ( !fat32_is_initialized() )
+        return -1;
+
+    fat32_lock();
+
+    if ( !state_file_find(file_name, &directory_entry) ||
+         fat32_fopen(&directory_entry, &state_file) != NO_ERROR )
+    {
+        fat32_unlock();
+        return -1;
+    }
+
+    for ( count = 0; count < length; count += result )
+    {
+        chunk = ( (length - count) > LOADER_STATE_CHUNK ) ? LOADER_STATE_CHUNK : (int)(length - count);
+
+        if ( (result = fat32_fread(&state_file, &buffer[count], chunk)) <= 0 )
+            break;
+    }
+
+    fat32_fclose(&state_file);
+
+    fat32_unlock();
+
+    return (int) count;
+}
+
+/*------------------------------------------------
+ * cas_save_write_back()
+ *
+ *  Write the tape output buffer to the CAS file being saved,
+ *  creating the file first if this is the start of the tape output.
+ *  The buffer is emptied even when the file cannot be written, and
+ *  if the file could not be created the rest of the tape output is dropped
+ *  until loader_cas_fclose().
+ *
+ *  param:  None
+ *  return: None
+ */
+static void cas_save_write_back(void)
+{
+    int     result;
+
+    if ( cas_save_length == 0 || cas_save_failed )
+    {
+        cas_save_length = 0;
+        return;
+    }
+
+    mount_wait();
+
+    fat32_lock();
+
+    if ( !cas_save_file.file_is_open )
+        cas_save_failed = !cas_save_create();
+
+    if ( cas_save_file.file_is_open )
+    {
+        if ( (result = fat32_fwrite(&cas_save_file, cas_save_buffer, cas_save_length)) != cas_save_length )
+            dbg_printf(0, "cas_save_write_back()[%d]: CAS file write failed (%d).\n", __LINE__, result);
+
+        dir_cache_invalidate(cas_save_directory);
+    }
+
+    fat32_unlock();
+
+    cas_save_length = 0;
+}
+
+/*------------------------------------------------
+ * cas_save_create()
+ *
+ *  Create and open the CAS file for the tape output in the buffer.
+ *  The file is named after the program in the namefile block
+ *  that follows the leader at the start of the buffer, and a digit is
+ *  added to the name when a file by that name already exists.
+ *  Call with the FAT32 access lock held.
+ *
+ *  param:  None
+ *  return: 1=File open, 0=File not created
+ */
+static int cas_save_create(void)
+{
+    dir_entry_t     directory_entry;
+    char            file_name[FAT32_DOS_FILE_NAME];
+    int             i, length, retry;
+    error_t         result;
+
+    strcpy(file_name, CAS_SAVE_DEFAULT_NAME);
+
+    for ( i = 0; i < cas_save_length && cas_save_buffer[i] == CAS_LEADER_BYTE; i++ );
+
+    if ( (i + 3 + CAS_SAVE_NAME_LENGTH) <= cas_save_length &&
+         cas_save_buffer[i] == CAS_SYNC_BYTE &&
+         cas_save_buffer[i + 1] == CAS_BLOCK_NAMEFILE &&
+         cas_save_buffer[i + 2] >= CAS_SAVE_NAME_LENGTH )
+    {
+        /* Keep letters and digits of the program name, the
+         * Dragon pads the name with spaces
+         */
+        for ( length = 0; length < CAS_SAVE_NAME_LENGTH; length++ )
+        {
+            if ( !isalnum(cas_save_buffer[i + 3 + length]) )
+                break;
+            file_name[length] = toupper(cas_save_buffer[i + 3 + length]);
+        }
+
+        if ( length > 0 )
+            file_name[length] = 0;
+    }
+
+    length = strlen(file_name);
+    strcat(file_name, CAS_SAVE_EXT);
+
+    for ( retry = 0; retry <= CAS_SAVE_RETRIES; retry++ )
+    {
+        if ( retry > 0 )
+        {
+            i = ( length < CAS_SAVE_NAME_LENGTH ) ? length : (CAS_SAVE_NAME_LENGTH - 1);
+            file_name[i] = '0' + retry;
+            strcpy(&file_name[i + 1], CAS_SAVE_EXT);
+        }
+
+        directory_entry.cluster_chain_head = cas_save_directory;
+
+        if ( (result = fat32_fcreate(file_name, &directory_entry)) != FAT_FILE_EXISTS )
+            break;
+    }
+
+    if ( result != NO_ERROR || fat32_fopen(&directory_entry, &cas_save_file) != NO_ERROR )
+    {
+        dbg_printf(0, "cas_save_create()[%d]: CAS file '%s' not created (%d).\n", __LINE__, file_name, result);
+        return 0;
+    }
+
+    dbg_printf(2, "cas_save_create()[%d]: Saving to CAS file '%s'\n", __LINE__, file_name);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * state_file_find()
+ *
+ *  Look for a file by its short name in the directory
+ *  last displayed by the loader.
+ *  Call with the FAT32 access lock held.
+ *
+ *  param:  File name, pointer to directory entry returned for the file
+ *  return: 1=File found, 0=Not found
+ */
+static int state_file_find(char *file_name, dir_entry_t *directory_entry)
+{
+    static dir_entry_t  directory_list[LOADER_STATE_DIR_LIST];
+
+    uint32_t    cluster;
+    int         i, count;
+
+    cluster = cas_save_directory;
+    dir_cache_resume = 0;
+
+    do
+    {
+        if ( (count = fat32_parse_dir(cluster, directory_list, LOADER_STATE_DIR_LIST)) < 0 )
+            return 0;
+
+        for ( i = 0; i < count; i++ )
+        {
+            if ( !directory_list[i].is_directory && strcmp(directory_list[i].sfn, file_name) == 0 )
+            {
+                memcpy(directory_entry, &directory_list[i], sizeof(dir_entry_t));
+                return 1;
+            }
+        }
+
+        cluster = (uint32_t) -1;
+    }
+    while ( count == LOADER_STATE_DIR_LIST );
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * dir_cache_open()
+ *
+ *  Make a directory's listing the one displayed by the loader.
+ *  A cached listing is used as is, otherwise the least recently used
+ *  listing is replaced and only the entries of the first screen are
+ *  parsed, the rest are parsed by dir_cache_fill() as the list is scrolled.
+ *
+ *  param:  Directory start cluster
+ *  return: Entries parsed so far, or -1 if the directory read failed
+ */
+static int dir_cache_open(uint32_t cluster)
+{
+    int     i;
+
+    dir_cache_listing = &dir_cache[0];
+
+    for ( i = 0; i < DIR_CACHE_LISTINGS; i++ )
+    {
+        if ( dir_cache[i].cluster == cluster )
+        {
+            dir_cache_listing = &dir_cache[i];
+            break;
+        }
+
+        if ( dir_cache[i].last_used < dir_cache_listing->last_used )
+            dir_cache_listing = &dir_cache[i];
+    }
+
+    if ( dir_cache_listing->cluster != cluster )
+    {
+        dir_cache_listing->cluster = cluster;
+        dir_cache_listing->length = 0;
+        dir_cache_listing->complete = 0;
+        dir_cache_listing->pool_used = 0;
+        dir_cache_listing->sorted = 0;
+    }
+
+    dir_cache_listing->last_used = ++dir_cache_uses;
+    dir_cache_resume = 0;
+
+    return dir_cache_fill(TERMINAL_LIST_LENGTH + 2);
+}
+
+/*------------------------------------------------
+ * dir_cache_fill()
+ *
+ *  Parse entries of the displayed directory listing until it holds
+ *  the requested number of entries or the directory ends.
+ *  Parsing continues where the last call stopped, unless other FAT32
+ *  access was made since, then the directory is parsed again from its
+ *  start and the cached entries are skipped.
+ *  A listing is truncated if its entries or names do not fit the cache.
+ *
+ *  param:  Entries required
+ *  return: Entries parsed so far, or -1 if the directory read failed or no listing is displayed
+ */
+static int dir_cache_fill(int length)
+{
+    dir_cache_t        *listing;
+    dir_cache_entry_t  *entry;
+    uint32_t            cluster;
+    int                 skip, name_length, result;
+
+    if ( (listing = dir_cache_listing) == 0L )
+        return -1;
+
+    if ( length > FAT32_MAX_DIR_LIST )
+        length = FAT32_MAX_DIR_LIST;
+
+    cluster = (uint32_t) -1;
+    skip = 0;
+
+    if ( !dir_cache_resume )
+    {
+        cluster = listing->cluster;
+        skip = listing->length;
+    }
+
+    fat32_lock();
+
+    while ( !listing->complete && listing->length < length )
+    {
+        if ( (result = fat32_parse_dir(cluster, &dir_cache_scratch, 1)) < 0 )
+        {
+            fat32_unlock();
+            dbg_printf(0, "dir_cache_fill()[%d]: Directory read failed (%d).\n", __LINE__, result);
+            listing->cluster = DIR_CACHE_FREE;
+            dir_cache_listing = 0L;
+            return -1;
+        }
+
+        cluster = (uint32_t) -1;
+        dir_cache_resume = 1;
+
+        if ( result == 0 )
+        {
+            listing->complete = 1;
+            break;
+        }
+
+        if ( skip > 0 )
+        {
+            skip--;
+            continue;
+        }
+
+        name_length = strlen(dir_cache_scratch.lfn) + 1;
+        if ( (listing->pool_used + name_length) > DIR_CACHE_POOL_SIZE )
+        {
+            dbg_printf(1, "dir_cache_fill()[%d]: Directory listing truncated at %d entries.\n", __LINE__, listing->length);
+            listing->complete = 1;
+            break;
+        }
+
+        entry = &listing->entry[listing->length];
+        entry->cluster_chain_head = dir_cache_scratch.cluster_chain_head;
+        entry->file_size = dir_cache_scratch.file_size;
+        entry->dir_record_lba = dir_cache_scratch.dir_record_lba;
+        entry->dir_record_index = dir_cache_scratch.dir_record_index;
+        entry->is_directory = dir_cache_scratch.is_directory;
+        entry->name = listing->pool_used;
+
+        memcpy(&listing->pool[listing->pool_used], dir_cache_scratch.lfn, name_length);
+        listing->pool_used += name_length;
+
+        listing->length++;
+    }
+
+    fat32_unlock();
+
+    if ( listing->length == FAT32_MAX_DIR_LIST )
+        listing->complete = 1;
+
+    return listing->length;
+}
+
+/*------------------------------------------------
+ * dir_cache_get()
+ *
+ *  Rebuild a directory entry of the displayed listing, for the
+ *  directory listing output and the FAT32 file functions.
+ *  The entry is valid until the next dir_cache_*() call.
+ *
+ *  param:  Entry index in the listing
+ *  return: Pointer to directory entry, an empty entry if index is out of the listing
+ */
+static dir_entry_t *dir_cache_get(int index)
+{
+    dir_cache_entry_t  *entry;
+
+    memset(&dir_cache_scratch, 0, sizeof(dir_entry_t));
+
+    if ( dir_cache_listing == 0L || index < 0 || index >= dir_cache_listing->length )
+        return &dir_cache_scratch;
+
+    entry = &dir_cache_listing->entry[index];
+
+    dir_cache_scratch.is_directory = entry->is_directory;
+    dir_cache_scratch.cluster_chain_head = entry->cluster_chain_head;
+    dir_cache_scratch.file_size = entry->file_size;
+    dir_cache_scratch.dir_record_index = entry->dir_record_index;
+    dir_cache_scratch.dir_record_lba = entry->dir_record_lba;
+    strncpy(dir_cache_scratch.lfn, &dir_cache_listing->pool[entry->name], (FAT32_LONG_FILE_NAME - 1));
+
+    return &dir_cache_scratch;
+}
+
+/*------------------------------------------------
+ * dir_cache_find()
+ *
+ *  Find the first entry in name order of the displayed listing, that starts
+ *  with a name prefix. The whole directory is parsed, and its name index
+ *  is built, the first time the listing is searched.
+ *
+ *  param:  Upper case name prefix
+ *  return: Entry index in the listing, or -1 if no name starts with the prefix
+ */
+static int dir_cache_find(char *prefix)
+{
+    dir_cache_t    *listing;
+    int             i, j, first, last, middle, length;
+    uint16_t        index;
+
+    if ( dir_cache_fill(FAT32_MAX_DIR_LIST) <= 0 )
+        return -1;
+
+    listing = dir_cache_listing;
+
+    /* Insertion sort of the entry numbers by name,
+     * the listing holds a few hundred entries at most
+     */
+    if ( !listing->sorted )
+    {
+        for ( i = 0; i < listing->length; i++ )
+        {
+            index = i;
+            for ( j = i; j > 0; j-- )
+            {
+                if ( dir_name_compare(&listing->pool[listing->entry[listing->name_index[(j - 1)]].name],
+                                      &listing->pool[listing->entry[index].name], FAT32_LONG_FILE_NAME) <= 0 )
+                    break;
+                listing->name_index[j] = listing->name_index[(j - 1)];
+            }
+            listing->name_index[j] = index;
+        }
+
+        listing->sorted = 1;
+    }
+
+    /* Binary search for the first name that is not
+     * before the prefix, and check that it starts with it
+     */
+    length = strlen(prefix);
+    first = 0;
+    last = listing->length;
+
+    while ( first < last )
+    {
+        middle = (first + last) / 2;
+        if ( dir_name_compare(&listing->pool[listing->entry[listing->name_index[middle]].name], prefix, length) < 0 )
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    if ( first == listing->length ||
+         dir_name_compare(&listing->pool[listing->entry[listing->name_index[first]].name], prefix, length) != 0 )
+        return -1;
+
+    return listing->name_index[first];
+}
+
+/*------------------------------------------------
+ * dir_cache_invalidate()
+ *
+ *  Drop a directory's cached listing after a file in
+ *  it was created or written, so it is read again when opened.
+ *
+ *  param:  Directory start cluster
+ *  return: None
+ */
+static void dir_cache_invalidate(uint32_t cluster)
+{
+    int     i;
+
+    for ( i = 0; i < DIR_CACHE_LISTINGS; i++ )
+    {
+        if ( dir_cache[i].cluster == cluster )
+        {
+            dir_cache[i].cluster = DIR_CACHE_FREE;
+            dir_cache[i].last_used = 0;
+            if ( dir_cache_listing == &dir_cache[i] )
+                dir_cache_listing = 0L;
+        }
+    }
+}
+
+/*------------------------------------------------
+ * dir_name_compare()
+ *
+ *  Compare up to 'length' characters of a file name
+ *  with a name or prefix, ignoring case.
+ *
+ *  param:  File name, name or prefix to compare with, characters to compare
+ *  return: Less than, equal to, or more than 0 as the name sorts before, with or after the prefix
+ */
+static int dir_name_compare(const char *name, const char *prefix, int length)
+{
+    int     i, difference;
+
+    for ( i = 0; i < length; i++ )
+    {
+        difference = toupper((int) name[i]) - toupper((int) prefix[i]);
+        if ( difference != 0 || name[i] == 0 )
+            return difference;
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * disk_mount()
+ *
+ *  Write back and close the disk image mounted in a drive,
+ *  then open the selected disk image and load it to the drive's RAM cache.
+ *  An image already mounted in another drive is unmounted from it first,
+ *  so that two caches never hold the same file.
+ *
+ *  param:  Drive number 0 to 3, pointer to the image's directory entry
+ *  return: 1=Image mounted, 0=Open failed
+ */
+static int disk_mount(int drive, dir_entry_t *directory_entry)
+{
+    disk_drive_t   *disk;
+    int             i;
+
+    for ( i = 0; i < LOADER_DISK_DRIVES; i++ )
+    {
+        if ( i == drive ||
+             disk_drive[i].img_file_type == FILE_NONE ||
+             disk_drive[i].img_file.file_start_cluster != directory_entry->cluster_chain_head )
+            continue;
+
+        dbg_printf(2, "disk_mount()[%d]: Image moved from drive %d.\n", __LINE__, i + 1);
+        disk_unmount(i);
+    }
+
+    disk_unmount(drive);
+
+    disk = &disk_drive[drive];
+
+    if ( fat32_fopen(directory_entry, &disk->img_file) != NO_ERROR )
+        return 0;
+
+    disk->img_file_type = FILE_VDK;
+    disk->cache_valid = disk_cache_load(disk);
+
+    dbg_printf(2, "disk_mount()[%d]: Drive %d '%s'\n", __LINE__, drive + 1, directory_entry->lfn);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * disk_unmount()
+ *
+ *  Write back and close the disk image mounted in a drive.
+ *
+ *  param:  Drive number 0 to 3
+ *  return: None
+ */
+static void disk_unmount(int drive)
+{
+    disk_drive_t   *disk;
+
+    disk = &disk_drive[drive];
+
+    if ( disk->img_file_type == FILE_NONE )
+        return;
+
+    disk_cache_write_back(disk);
+    fat32_flush();
+    fat32_fclose(&disk->img_file);
+
+    disk->img_file_type = FILE_NONE;
+    disk->cache_valid = 0;
+}
+
+/*------------------------------------------------
+ * disk_cache_load()
+ *
+ *  Load the open disk image file of a drive into its RAM cache.
+ *  Images larger than the cache are accessed directly on the SD card.
+ *
+ *  param:  Pointer to drive
+ *  return: 1=Image cached, 0=Not cached
+ */
+static int disk_cache_load(disk_drive_t *disk)
+{
+    uint32_t    position;
+    int         count;
+
+    memset(disk->cache_dirty, 0, sizeof(disk->cache_dirty));
+    disk->cache_modified = 0;
+    disk->cache_position = 0;
+    disk->cache_size = disk->img_file.file_size;
+
+    if ( disk->cache_size > DISK_CACHE_SIZE )
+    {
+        dbg_printf(1, "disk_cache_load()[%d]: Disk image too large for cache (%d bytes).\n", __LINE__, disk->cache_size);
+        return 0;
+    }
+
+    for ( position = 0; position < disk->cache_size; position += count )
+    {
+        count = fat32_fread(&disk->img_file, &disk->cache[position], DISK_CACHE_READ_CHUNK);
+        if ( count <= 0 )
+        {
+            dbg_printf(0, "disk_cache_load()[%d]: Disk image read error (%d).\n", __LINE__, count);
+            return 0;
+        }
+    }
+
+    dbg_printf(2, "disk_cache_load()[%d]: Disk image cached (%d bytes).\n", __LINE__, disk->cache_size);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * file_get_type()
+ *
+ *  Parse a file name passed in a directory entry record
+ *  and return its type.
+ *
+ *  param:  Pointer to directory entry record
+ *  return: File type
+ */
+static loader_file_type_t file_get_type(char *directory_entry)
+{
+    if ( strstr(directory_entry, ".ROM") || strstr(directory_entry, ".rom") )
+    {
+        return FILE_ROM;
+    }
+    else if ( strstr(directory_entry, ".CAS") || strstr(directory_entry, ".cas") )
+    {
+        return FILE_CAS;
+    }
+    else if ( strstr(directory_entry, ".VDK") || strstr(directory_entry, ".vdk") )
+    {
+        return FILE_VDK;
+    }
+
+    return FILE_OTHER;
+}
+
+/*------------------------------------------------
+ * text_write()
+ *
+ *  Output text to the text screen buffer
+ *  vdg_render() will output. This function allows
+ *  the loader to use the regular text display of the
+ *  Dragon emulation.
+ *  Text longer than a row will be wrapped to next line.
+ *  Characters already on the screen are not written again,
+ *  so vdg_render() only redraws the lines that changed.
+ *  Row and column numbers are 0 based.
+ *
+ *  param:  Row (0..15) and column (0..31) positions, text to output
+ *  return: Nothing
+ */
+static void text_write(int row, int col, char *text)
+{
+    int     count, c;
+
+    count = row * 32 + col;
+
+    while ( *text && (count < 512) )
+    {
+        c = toupper((int)(*text)) & 0xbf;
+        if ( mem_read(0x400 + count) != c )
+            mem_write(0x400 + count, c);
+        text++;
+        count++;
+    }
+}
+
+/*------------------------------------------------
+ * text_highlight()
+ *
+ *  Highlight a row on the screen by flipping
+ *  its video inverse bit
+ *
+ *  param:  Text highlighted ('1') and not ('0'), and row number (0..14)
+ *  return: Nothing
+ */
+static void text_highlight(int on_off, int row)
+{
+    static int  highlighted_row = -1;
+
+    int     i, c;
+    int     row_address;
+
+    /* Remove row-highlight if one is highlighted
+     */
+    if ( on_off == 0 && highlighted_row != -1 )
+    {
+        row_address = 0x400 + highlighted_row * 32;
+        for ( i = 1; i < 32; i++ )
+        {
+            c = mem_read((row_address + i)) & 0xbf;
+            mem_write((row_address + i), c);
+        }
+        highlighted_row = -1;
+    }
+
+    /* Highlight a row
+     */
+    else if ( on_off == 1 )
+    {
+        if ( row < 0 || row > 14 )
+        {
+            return;
+        }
+        else if ( highlighted_row == row )
+        {
+            return;
+        }
+        else if ( highlighted_row == -1 )
+        {
+            row_address = 0x400 + row * 32;
+            for ( i = 1; i < 32; i++ )
+            {
+                c = mem_read((row_address + i)) | 0x40;
+                mem_write((row_address + i), c);
+            }
+            highlighted_row = row;
+        }
+        else
+        {
+            text_highlight(0, 0);
+            text_highlight(1, row);
+        }
+    }
+}
+
+/*------------------------------------------------
+ * text_dir_output()
+ *
+ *  Print directory content from the displayed listing.
+ *  Every row of the list is written in full, rows after
+ *  the end of the listing are blank.
+ *
+ *  param:  Where to start in the list, entries parsed in the list
+ *  return: Nothing
+ */
+static void text_dir_output(int list_start, int list_length)
+{
+    int             row, length;
+    char            text_line[(TERMINAL_LINE_LENGTH + 2)];
+    dir_entry_t    *directory_entry;
+
+    text_line[(TERMINAL_LINE_LENGTH + 1)] = 0;
+
+    for ( row = 0; row <= TERMINAL_LIST_LENGTH; row++)
+    {
+        memset(text_line, ' ', (TERMINAL_LINE_LENGTH + 1));
+
+        if ( (row + list_start) < list_length )
+        {
+            directory_entry = dir_cache_get(row + list_start);
+            if ( directory_entry->is_directory )
+                text_line[0] = '*';
+            length = strlen(directory_entry->lfn);
+            if ( length > TERMINAL_LINE_LENGTH )
+                length = TERMINAL_LINE_LENGTH;
+            memcpy(&text_line[1], directory_entry->lfn, length);
+        }
+
+        text_write(row, 0, text_line);
+    }
+}
+
+/*------------------------------------------------
+ * text_clear()
+ *
+ *  Clear the text output area
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void text_clear(void)
+{
+    int     i;
+
+    text_highlight_off();
+    for ( i = 0; i < TERMINAL_STATUS_ROW; i++)
+        text_write(i, 0, "                                ");
+}
+
+/*------------------------------------------------
+ * mount_sd()
+ *
+ *  Initialize the SD card and mount its FAT32 file system.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void mount_sd(void)
+{
+    error_t     result;
+
+    if ( (result = fat32_init()) != NO_ERROR )
+        dbg_printf(0, "mount_sd()[%d]: FAT32 initialization failed (%d).\n", __LINE__, result);
+    else
+        dbg_printf(2, "mount_sd()[%d]: FAT32 on SD initialized.\n", __LINE__);
+}
+
+/*------------------------------------------------
+ * mount_wait()
+ *
+ *  Wait for the SD card mount started by loader_mount() to complete.
+ *  Called from the emulation thread before accessing the SD card.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void mount_wait(void)
+{
+#if (RPI_BARE_METAL==0)
+    if ( mount_pending )
+    {
+        pthread_join(mount_thread_id, NULL);
+        mount_pending = 0;
+    }
+#endif
+}
+
+#if (RPI_BARE_METAL==0)
+/*------------------------------------------------
+ * mount_thread()
+ *
+ *  SD card mount thread.
+ *
+ *  param:  Not used
+ *  return: Not used
+ */
+static void *mount_thread(void *arg)
+{
+    mount_sd();
+
+    return 0L;
 }
+#endif
 
 /*------------------------------------------------
  * util_wait_quit()
@@ -557,7 +1903,7 @@ static void util_wait_quit(void)
     {
         vdg_render();
 
-        key_pressed = rpi_keyboard_read();
+        key_pressed = kbd_read();
     }
     while ( key_pressed != SCAN_CODE_Q );
 }
@@ -7,35 +7,70 @@
  *
  *******************************************************************/
 
+#include    <string.h>
+
 #include    "mem.h"
+#include    "stats.h"
 
 /* -----------------------------------------
    Local definitions
 ----------------------------------------- */
+#define     MEM_SUB_PAGES       8                           // Pages with per-address attributes
 
-typedef enum
-{
-    MEM_TYPE_RAM,
-    MEM_TYPE_ROM,
-    MEM_TYPE_IO,
-} memory_flag_t;
+/* Pages that the SAM map type switches between ROM and RAM, 0x8000 to 0xfeff
+ */
+#define     ROM_MAP_FIRST_PAGE  (0x8000 >> MEM_PAGE_SHIFT)
+#define     ROM_MAP_PAGES       ((0xff00 - 0x8000) >> MEM_PAGE_SHIFT)
+#define     ROM_BANK            (0x8000 >> MEM_BANK_SHIFT)
+#define     CARTRIDGE_BANK      (0xc000 >> MEM_BANK_SHIFT)
 
-typedef struct
+/* Per-address attributes, IO handlers and alias targets for
+ * pages holding IO addresses or aliases, or mixing RAM and ROM.
+ */
+typedef struct mem_sub_page_t
 {
-    uint8_t data_byte;
-    memory_flag_t memory_type;
-    io_handler_callback io_handler;
-} memory_t;
+    uint8_t             memory_type[MEM_PAGE_SIZE];
+    io_handler_callback io_handler[MEM_PAGE_SIZE];
+    uint16_t            alias[MEM_PAGE_SIZE];
+    uint8_t             io_data[MEM_PAGE_SIZE];     // Last IO register values, independent of the bank mapping
+    uint8_t             watch[MEM_PAGE_SIZE];       // Watchpoint MEM_WATCH_* bits
+    int                 watch_count;                // Addresses with a watchpoint
+    int                 watch_only;                 // Allocated for watchpoints only
+    int                 in_use;
+} mem_sub_page_t;
 
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
 static uint8_t do_nothing_io_handler(uint16_t address, uint8_t data, mem_operation_t op);
+static int     mem_set_attribute(int addr_start, int addr_end, memory_flag_t memory_type, io_handler_callback io_handler);
+static mem_sub_page_t *mem_get_sub_page(int page);
+static void    mem_load_mark(int addr_start, int length);
+static void    mem_watch_trigger(int address, mem_operation_t op);
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
-static memory_t memory[MEMORY];
+static uint8_t          rom_data[MEM_ROMS][MEM_BANK_SIZE];
+static uint8_t          cartridge_data[MEM_BANK_SIZE];
+uint8_t                 mem_data[MEMORY];          // Exported for mem.h fast-path accessors
+uint8_t                *mem_bank[MEM_BANKS] =     // Map type 0
+{
+    &mem_data[0],
+    &mem_data[MEM_BANK_SIZE],
+    rom_data[0],
+    cartridge_data,
+};
+mem_page_t              mem_pages[MEM_PAGES];
+uint8_t                 mem_dirty[MEM_DIRTY_LINES];
+uint32_t                mem_rom_version = 0;
+int                     mem_watch_hit = 0;
+static mem_sub_page_t   sub_pages[MEM_SUB_PAGES];
+static int              watch_address;
+static mem_operation_t  watch_op;
+static mem_page_t       inactive_map_pages[ROM_MAP_PAGES];  // Page attributes of the map type not in use
+static int              map_all_ram = 0;
+static int              rom_select = 0;
 
 /*------------------------------------------------
  * mem_init()
@@ -51,10 +86,47 @@ void mem_init(void)
 
     for ( i = 0; i < MEMORY; i++ )
     {
-        memory[i].data_byte = 0;
-        memory[i].memory_type = MEM_TYPE_RAM;
-        memory[i].io_handler = do_nothing_io_handler;
+        mem_data[i] = 0;
     }
+
+    memset(rom_data, 0, sizeof(rom_data));
+    memset(cartridge_data, 0, sizeof(cartridge_data));
+
+    for ( i = 0; i < MEM_PAGES; i++ )
+    {
+        mem_pages[i].page_type = MEM_TYPE_RAM;
+        mem_pages[i].sub_page = 0L;
+    }
+
+    for ( i = 0; i < ROM_MAP_PAGES; i++ )
+    {
+        inactive_map_pages[i].page_type = MEM_TYPE_RAM;
+        inactive_map_pages[i].sub_page = 0L;
+    }
+
+    /* Map type 0, 32K RAM and the BASIC ROM and cartridge
+     */
+    map_all_ram = 0;
+    rom_select = 0;
+
+    for ( i = 0; i < CARTRIDGE_BANK; i++ )
+    {
+        mem_bank[i] = &mem_data[(i * MEM_BANK_SIZE)];
+    }
+
+    mem_bank[ROM_BANK] = rom_data[0];
+    mem_bank[CARTRIDGE_BANK] = cartridge_data;
+
+    memset(mem_dirty, 1, sizeof(mem_dirty));
+
+    for ( i = 0; i < MEM_SUB_PAGES; i++ )
+    {
+        sub_pages[i].in_use = 0;
+    }
+
+    mem_watch_hit = 0;
+
+    mem_rom_version++;
 }
 
 /*------------------------------------------------
@@ -68,19 +140,40 @@ void mem_init(void)
  */
 int mem_read(int address)
 {
+    mem_sub_page_t *sub_page;
+    int             offset;
+
     if ( address < 0 || address > (MEMORY-1) )
         return MEM_ADD_RANGE;
 
-    if ( memory[address].memory_type == MEM_TYPE_IO &&
-         memory[address].io_handler != do_nothing_io_handler )
+    if ( mem_pages[(address >> MEM_PAGE_SHIFT)].page_type == MEM_TYPE_MIXED )
     {
-        /* An attempt to read an IO address will trigger
-         * the callback that may return an alternative value.
-         */
-        memory[address].data_byte = memory[address].io_handler((uint16_t) address, memory[address].data_byte, MEM_READ);
+        sub_page = mem_pages[(address >> MEM_PAGE_SHIFT)].sub_page;
+        offset = address & MEM_PAGE_MASK;
+
+        if ( sub_page->watch[offset] & MEM_WATCH_READ )
+            mem_watch_trigger(address, MEM_READ);
+
+        if ( sub_page->memory_type[offset] == MEM_TYPE_ALIAS )
+            return mem_read((int) sub_page->alias[offset]);
+
+        if ( sub_page->memory_type[offset] == MEM_TYPE_IO )
+        {
+            /* An attempt to read an IO address will trigger
+             * the callback that may return an alternative value.
+             */
+            if ( sub_page->io_handler[offset] != do_nothing_io_handler )
+            {
+                stats_timer_start(STATS_IO_CALLBACK);
+                sub_page->io_data[offset] = sub_page->io_handler[offset]((uint16_t) address, sub_page->io_data[offset], MEM_READ);
+                stats_timer_stop(STATS_IO_CALLBACK);
+            }
+
+            return (int)(sub_page->io_data[offset]);
+        }
     }
 
-    return (int)(memory[address].data_byte);
+    return (int)(mem_byte(address));
 }
 
 /*------------------------------------------------
@@ -95,18 +188,51 @@ int mem_read(int address)
  */
 int mem_write(int address, int data)
 {
+    mem_sub_page_t *sub_page;
+    int             offset;
+
     if ( address < 0 || address > (MEMORY-1) )
         return MEM_ADD_RANGE;
 
-    if ( memory[address].memory_type == MEM_TYPE_ROM )
-        return MEM_ROM;
+    switch ( mem_pages[(address >> MEM_PAGE_SHIFT)].page_type )
+    {
+        case MEM_TYPE_RAM:
+            mem_byte(address) = (uint8_t) data;
+            mem_dirty[(address >> MEM_DIRTY_SHIFT)] = 1;
+            break;
 
-    memory[address].data_byte = (uint8_t) data;
+        case MEM_TYPE_MIXED:
+            sub_page = mem_pages[(address >> MEM_PAGE_SHIFT)].sub_page;
+            offset = address & MEM_PAGE_MASK;
 
-    if ( memory[address].memory_type == MEM_TYPE_IO &&
-         memory[address].io_handler != do_nothing_io_handler )
-    {
-        memory[address].io_handler((uint16_t) address, (uint8_t)data, MEM_WRITE);
+            if ( sub_page->watch[offset] & MEM_WATCH_WRITE )
+                mem_watch_trigger(address, MEM_WRITE);
+
+            if ( sub_page->memory_type[offset] == MEM_TYPE_ROM )
+                return MEM_ROM;
+
+            if ( sub_page->memory_type[offset] == MEM_TYPE_ALIAS )
+                return mem_write((int) sub_page->alias[offset], data);
+
+            if ( sub_page->memory_type[offset] != MEM_TYPE_IO )
+            {
+                mem_byte(address) = (uint8_t) data;
+                mem_dirty[(address >> MEM_DIRTY_SHIFT)] = 1;
+                break;
+            }
+
+            sub_page->io_data[offset] = (uint8_t) data;
+
+            if ( sub_page->io_handler[offset] != do_nothing_io_handler )
+            {
+                stats_timer_start(STATS_IO_CALLBACK);
+                sub_page->io_handler[offset]((uint16_t) address, (uint8_t)data, MEM_WRITE);
+                stats_timer_stop(STATS_IO_CALLBACK);
+            }
+            break;
+
+        default:
+            return MEM_ROM;
     }
 
     return MEM_OK;
@@ -121,22 +247,16 @@ int mem_write(int address, int data)
  *  param:  Memory address range start and end, inclusive
  *  return: ' 0' - write ok,
  *          '-1' - memory location is out of range
+ *          '-3' - Out of per-address attribute pages
  */
 int  mem_define_rom(int addr_start, int addr_end)
 {
-    int i;
-
     if ( addr_start < 0 || addr_start > (MEMORY-1) ||
          addr_end < 0   || addr_end > (MEMORY-1)   ||
          addr_start > addr_end )
         return MEM_ADD_RANGE;
 
-    for (i = addr_start; i <= addr_end; i++)
-    {
-        memory[i].memory_type = MEM_TYPE_ROM;
-    }
-
-    return MEM_OK;
+    return mem_set_attribute(addr_start, addr_end, MEM_TYPE_ROM, 0L);
 }
 
 /*------------------------------------------------
@@ -153,23 +273,178 @@ int  mem_define_rom(int addr_start, int addr_end)
  */
 int  mem_define_io(int addr_start, int addr_end, io_handler_callback io_handler)
 {
-    int i;
-
     if ( addr_start < 0 || addr_start > (MEMORY-1) ||
          addr_end < 0   || addr_end > (MEMORY-1)   ||
          addr_start > addr_end )
         return MEM_ADD_RANGE;
 
-    for (i = addr_start; i <= addr_end; i++)
+    return mem_set_attribute(addr_start, addr_end, MEM_TYPE_IO, io_handler);
+}
+
+/*------------------------------------------------
+ * mem_define_alias()
+ *
+ *  Define address range as an alias of another address range of the
+ *  same length. Reads and writes to the range are directed to the
+ *  target range and follow the target's attributes.
+ *  The target address is resolved when the alias is defined, so an alias
+ *  of an alias points directly to the final target address.
+ *
+ *  param:  Memory address range start and end, inclusive,
+ *          and start address of the target range
+ *  return: ' 0' - ok,
+ *          '-1' - memory location is out of range
+ *          '-3' - Out of per-address attribute pages
+ */
+int  mem_define_alias(int addr_start, int addr_end, int target_start)
+{
+    int             i, target, page;
+    mem_sub_page_t *sub_page;
+
+    if ( addr_start < 0 || addr_start > (MEMORY-1) ||
+         addr_end < 0   || addr_end > (MEMORY-1)   ||
+         addr_start > addr_end ||
+         target_start < 0 || (target_start + addr_end - addr_start) > (MEMORY-1) )
+        return MEM_ADD_RANGE;
+
+    mem_rom_version++;
+
+    for ( i = addr_start; i <= addr_end; i++ )
     {
-        memory[i].memory_type = MEM_TYPE_IO;
-        if ( io_handler != 0L )
-            memory[i].io_handler = io_handler;
+        target = target_start + (i - addr_start);
+
+        page = target >> MEM_PAGE_SHIFT;
+        if ( mem_pages[page].page_type == MEM_TYPE_MIXED &&
+             mem_pages[page].sub_page->memory_type[(target & MEM_PAGE_MASK)] == MEM_TYPE_ALIAS )
+        {
+            target = mem_pages[page].sub_page->alias[(target & MEM_PAGE_MASK)];
+        }
+
+        /* An address cannot be an alias of itself
+         */
+        if ( target == i )
+            return MEM_ADD_RANGE;
+
+        if ( (sub_page = mem_get_sub_page(i >> MEM_PAGE_SHIFT)) == 0L )
+            return MEM_HANDLER_ERR;
+
+        sub_page->watch_only = 0;
+        sub_page->memory_type[(i & MEM_PAGE_MASK)] = MEM_TYPE_ALIAS;
+        sub_page->alias[(i & MEM_PAGE_MASK)] = (uint16_t) target;
+    }
+
+    return MEM_OK;
+}
+
+/*------------------------------------------------
+ * mem_define_watch()
+ *
+ *  Set or clear a watchpoint on an address. An access to a watched address
+ *  is recorded for mem_watch_triggered(), with the CPU stopping after
+ *  the instruction that made it. The watched address's page uses
+ *  per-address attributes, so pages without watchpoints keep their
+ *  fast access path, and a page that only needed per-address attributes
+ *  for watchpoints gets its page attribute back when they are all cleared.
+ *
+ *  param:  Memory address, MEM_WATCH_* bits or 0 to clear the watchpoint
+ *  return: ' 0' - ok,
+ *          '-1' - memory location is out of range
+ *          '-3' - Out of per-address attribute pages
+ */
+int  mem_define_watch(int address, int mode)
+{
+    int             page, offset, watch_only;
+    mem_sub_page_t *sub_page;
+
+    if ( address < 0 || address > (MEMORY-1) )
+        return MEM_ADD_RANGE;
+
+    page = address >> MEM_PAGE_SHIFT;
+    offset = address & MEM_PAGE_MASK;
+    mode &= (MEM_WATCH_READ | MEM_WATCH_WRITE);
+
+    if ( mode == 0 )
+    {
+        if ( mem_pages[page].page_type != MEM_TYPE_MIXED )
+            return MEM_OK;
+
+        sub_page = mem_pages[page].sub_page;
+        if ( sub_page->watch[offset] == 0 )
+            return MEM_OK;
+
+        sub_page->watch[offset] = 0;
+        sub_page->watch_count--;
+
+        if ( sub_page->watch_count == 0 && sub_page->watch_only )
+        {
+            mem_pages[page].page_type = (memory_flag_t) sub_page->memory_type[0];
+            mem_pages[page].sub_page = 0L;
+            sub_page->in_use = 0;
+            mem_rom_version++;
+        }
+
+        return MEM_OK;
     }
 
+    watch_only = ( mem_pages[page].page_type != MEM_TYPE_MIXED );
+
+    if ( (sub_page = mem_get_sub_page(page)) == 0L )
+        return MEM_HANDLER_ERR;
+
+    if ( watch_only )
+    {
+        sub_page->watch_only = 1;
+        mem_rom_version++;
+    }
+
+    if ( sub_page->watch[offset] == 0 )
+    {
+        sub_page->watch_count++;
+    }
+
+    sub_page->watch[offset] = (uint8_t) mode;
+
     return MEM_OK;
 }
 
+/*------------------------------------------------
+ * mem_get_watch()
+ *
+ *  Get the watchpoint of an address.
+ *
+ *  param:  Memory address
+ *  return: MEM_WATCH_* bits, 0 if the address is not watched
+ */
+int  mem_get_watch(int address)
+{
+    if ( address < 0 || address > (MEMORY-1) ||
+         mem_pages[(address >> MEM_PAGE_SHIFT)].page_type != MEM_TYPE_MIXED )
+        return 0;
+
+    return mem_pages[(address >> MEM_PAGE_SHIFT)].sub_page->watch[(address & MEM_PAGE_MASK)];
+}
+
+/*------------------------------------------------
+ * mem_watch_triggered()
+ *
+ *  Get and clear the first watchpoint access recorded
+ *  since the last call.
+ *
+ *  param:  Pointers to address and access type return variables
+ *  return: 1- a watched address was accessed, 0- no access
+ */
+int  mem_watch_triggered(int *address, mem_operation_t *op)
+{
+    if ( !mem_watch_hit )
+        return 0;
+
+    *address = watch_address;
+    *op = watch_op;
+    mem_watch_hit = 0;
+
+    return 1;
+}
+
 /*------------------------------------------------
  * mem_load()
  *
@@ -183,20 +458,316 @@ int  mem_define_io(int addr_start, int addr_end, io_handler_callback io_handler)
  */
 int mem_load(int addr_start, const uint8_t *buffer, int length)
 {
-    int i;
+    int     address, chunk;
 
     if ( addr_start < 0 || addr_start > (MEMORY-1) ||
-         (addr_start + length) > MEMORY )
+         length < 0 || (addr_start + length) > MEMORY )
         return MEM_ADD_RANGE;
 
-    for (i = 0; i < length; i++)
+    /* Copy to each bank the range crosses
+     */
+    for ( address = addr_start; address < (addr_start + length); address += chunk )
     {
-        memory[(i+addr_start)].data_byte = buffer[i];
+        chunk = MEM_BANK_SIZE - (address & MEM_BANK_MASK);
+        if ( chunk > (addr_start + length - address) )
+            chunk = addr_start + length - address;
+
+        memcpy(&mem_byte(address), &buffer[(address - addr_start)], chunk);
     }
 
+    mem_load_mark(addr_start, length);
+
     return MEM_OK;
 }
 
+/*------------------------------------------------
+ * mem_load_buffer()
+ *
+ *  Get a pointer to a memory range, to load it in place
+ *  with one bulk transfer, such as a file read straight into memory.
+ *  The range is marked as loaded content before it is returned,
+ *  and the caller must not keep the pointer after the load.
+ *  The range must be within one memory bank.
+ *
+ *  param:  Memory address start and length of the range
+ *  return: Pointer to the range in memory, NULL if out of range
+ */
+uint8_t *mem_load_buffer(int addr_start, int length)
+{
+    if ( addr_start < 0 || addr_start > (MEMORY-1) ||
+         length <= 0 || (addr_start + length) > MEMORY ||
+         (addr_start >> MEM_BANK_SHIFT) != ((addr_start + length - 1) >> MEM_BANK_SHIFT) )
+        return 0L;
+
+    mem_load_mark(addr_start, length);
+
+    return &mem_byte(addr_start);
+}
+
+/*------------------------------------------------
+ * mem_push_block()
+ *
+ *  Push a block of bytes onto a stack that grows down, as
+ *  the CPU does with a register list. The buffer is in ascending
+ *  memory address order, and the stack pointer is pre-decremented.
+ *  The block is copied directly when the stack area is RAM in one bank,
+ *  otherwise one byte at a time through the IO/ROM checks.
+ *
+ *  param:  Pointer to stack pointer, data buffer and its length
+ *  return: Nothing
+ */
+void mem_push_block(uint16_t *stack_pointer, const uint8_t *buffer, int length)
+{
+    int         i;
+    uint16_t    address;
+
+    if ( length <= 0 )
+        return;
+
+    address = (uint16_t)(*stack_pointer - length);
+
+    if ( *stack_pointer >= length &&
+         (address >> MEM_BANK_SHIFT) == ((*stack_pointer - 1) >> MEM_BANK_SHIFT) &&
+         mem_pages[(address >> MEM_PAGE_SHIFT)].page_type == MEM_TYPE_RAM &&
+         mem_pages[((*stack_pointer - 1) >> MEM_PAGE_SHIFT)].page_type == MEM_TYPE_RAM )
+    {
+        memcpy(&mem_byte(address), buffer, length);
+        mem_dirty[(address >> MEM_DIRTY_SHIFT)] = 1;
+        mem_dirty[((*stack_pointer - 1) >> MEM_DIRTY_SHIFT)] = 1;
+    }
+    else
+    {
+        for ( i = (length - 1); i >= 0; i-- )
+        {
+            mem_store8((uint16_t)(address + i), buffer[i]);
+        }
+    }
+
+    *stack_pointer = address;
+}
+
+/*------------------------------------------------
+ * mem_pull_block()
+ *
+ *  Pull a block of bytes from a stack that grows down, as
+ *  the CPU does with a register list. The buffer is filled in ascending
+ *  memory address order, and the stack pointer is post-incremented.
+ *  The block is copied directly when the stack area is RAM or ROM in one bank,
+ *  otherwise one byte at a time through the IO handlers.
+ *
+ *  param:  Pointer to stack pointer, data buffer and its length
+ *  return: Nothing
+ */
+void mem_pull_block(uint16_t *stack_pointer, uint8_t *buffer, int length)
+{
+    int         i;
+    uint16_t    address;
+
+    if ( length <= 0 )
+        return;
+
+    address = *stack_pointer;
+
+    if ( (address + length) <= MEMORY &&
+         (address >> MEM_BANK_SHIFT) == ((address + length - 1) >> MEM_BANK_SHIFT) &&
+         mem_pages[(address >> MEM_PAGE_SHIFT)].page_type != MEM_TYPE_MIXED &&
+         mem_pages[((address + length - 1) >> MEM_PAGE_SHIFT)].page_type != MEM_TYPE_MIXED )
+    {
+        memcpy(buffer, &mem_byte(address), length);
+    }
+    else
+    {
+        for ( i = 0; i < length; i++ )
+        {
+            buffer[i] = mem_fetch8((uint16_t)(address + i));
+        }
+    }
+
+    *stack_pointer = (uint16_t)(address + length);
+}
+
+/*------------------------------------------------
+ * mem_is_dirty()
+ *
+ *  Check if any memory line in an address range was written
+ *  since the range was last cleared with mem_clear_dirty().
+ *  The range is clipped to the memory size.
+ *
+ *  param:  Memory address start and range length
+ *  return: '1' if a line in the range is dirty, '0' if not
+ */
+int mem_is_dirty(int addr_start, int length)
+{
+    int     line, last_line;
+
+    if ( addr_start < 0 || addr_start > (MEMORY-1) || length <= 0 )
+        return 0;
+
+    if ( (addr_start + length) > MEMORY )
+        length = MEMORY - addr_start;
+
+    last_line = (addr_start + length - 1) >> MEM_DIRTY_SHIFT;
+
+    for ( line = (addr_start >> MEM_DIRTY_SHIFT); line <= last_line; line++ )
+    {
+        if ( mem_dirty[line] )
+            return 1;
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * mem_clear_dirty()
+ *
+ *  Clear the dirty state of the memory lines in an address range.
+ *  The range is clipped to the memory size.
+ *
+ *  param:  Memory address start and range length
+ *  return: Nothing
+ */
+void mem_clear_dirty(int addr_start, int length)
+{
+    int     first_line;
+
+    if ( addr_start < 0 || addr_start > (MEMORY-1) || length <= 0 )
+        return;
+
+    if ( (addr_start + length) > MEMORY )
+        length = MEMORY - addr_start;
+
+    first_line = addr_start >> MEM_DIRTY_SHIFT;
+
+    memset(&mem_dirty[first_line], 0, ((addr_start + length - 1) >> MEM_DIRTY_SHIFT) - first_line + 1);
+}
+
+/*------------------------------------------------
+ * mem_set_map_type()
+ *
+ *  Set the SAM memory map type. Map type 0 has 32K RAM, the BASIC ROM from
+ *  0x8000 and the cartridge ROM from 0xc000. Map type 1 has RAM up to 0xfeff.
+ *  The switch changes the storage pointers of the two upper banks and swaps
+ *  the page attributes of 0x8000 to 0xfeff with those of the other map type,
+ *  so memory is not copied, and attributes defined while a map type is in use
+ *  stay with that map type. The IO page at 0xff00 is the same in both map types.
+ *
+ *  param:  1- map type 1 all RAM, 0- map type 0 RAM and ROM
+ *  return: Nothing
+ */
+void mem_set_map_type(int all_ram)
+{
+    mem_page_t  page;
+    int         i;
+
+    all_ram = ( all_ram != 0 );
+
+    if ( all_ram == map_all_ram )
+        return;
+
+    for ( i = 0; i < ROM_MAP_PAGES; i++ )
+    {
+        page = mem_pages[(ROM_MAP_FIRST_PAGE + i)];
+        mem_pages[(ROM_MAP_FIRST_PAGE + i)] = inactive_map_pages[i];
+        inactive_map_pages[i] = page;
+    }
+
+    if ( all_ram )
+    {
+        mem_bank[ROM_BANK] = &mem_data[(ROM_BANK * MEM_BANK_SIZE)];
+        mem_bank[CARTRIDGE_BANK] = &mem_data[(CARTRIDGE_BANK * MEM_BANK_SIZE)];
+    }
+    else
+    {
+        mem_bank[ROM_BANK] = rom_data[rom_select];
+        mem_bank[CARTRIDGE_BANK] = cartridge_data;
+    }
+
+    map_all_ram = all_ram;
+
+    /* Pre-decoded ROM code is no longer mapped
+     */
+    mem_rom_version++;
+}
+
+/*------------------------------------------------
+ * mem_select_rom()
+ *
+ *  Select the BASIC ROM mapped at 0x8000 to 0xbfff in map type 0,
+ *  the Dragon 64 PIA1-PB2 ROM select.
+ *
+ *  param:  0- Dragon 32 compatible BASIC ROM, 1- Dragon 64 '64 mode' ROM
+ *  return: Nothing
+ */
+void mem_select_rom(int rom)
+{
+    if ( rom < 0 || rom >= MEM_ROMS || rom == rom_select )
+        return;
+
+    rom_select = rom;
+
+    if ( !map_all_ram )
+    {
+        mem_bank[ROM_BANK] = rom_data[rom_select];
+        mem_rom_version++;
+    }
+}
+
+/*------------------------------------------------
+ * mem_block()
+ *
+ *  Get the storage of a RAM or ROM block, for reading it
+ *  independently of the memory map.
+ *
+ *  param:  Memory block
+ *  return: Pointer to the block's storage
+ */
+const uint8_t *mem_block(mem_block_t block)
+{
+    switch ( block )
+    {
+        case MEM_BLOCK_ROM:
+            return rom_data[0];
+
+        case MEM_BLOCK_ROM2:
+            return rom_data[1];
+
+        case MEM_BLOCK_CARTRIDGE:
+            return cartridge_data;
+
+        default:
+            return mem_data;
+    }
+}
+
+/*------------------------------------------------
+ * mem_block_load_buffer()
+ *
+ *  Get a pointer to a range of a RAM or ROM block, to load it in place
+ *  whether or not the block is mapped. The range is marked as loaded
+ *  content before it is returned, and the caller must not keep the pointer
+ *  after the load. Block offsets are from the block's first CPU address,
+ *  0x0000 for RAM, 0x8000 for the ROMs and 0xc000 for the cartridge.
+ *
+ *  param:  Memory block, offset and length of the range
+ *  return: Pointer to the range in the block, NULL if out of range
+ */
+uint8_t *mem_block_load_buffer(mem_block_t block, int offset, int length)
+{
+    int     block_size;
+
+    block_size = ( block == MEM_BLOCK_RAM ) ? MEMORY : MEM_BANK_SIZE;
+
+    if ( offset < 0 || length <= 0 || (offset + length) > block_size )
+        return 0L;
+
+    if ( block == MEM_BLOCK_RAM )
+        mem_load_mark(offset, length);
+    else
+        mem_rom_version++;
+
+    return (uint8_t*) &mem_block(block)[offset];
+}
+
 /*------------------------------------------------
  * do_nothing_io_handler()
  *
@@ -212,3 +783,137 @@ static uint8_t do_nothing_io_handler(uint16_t address, uint8_t data, mem_operati
     return 0;
 }
 
+/*------------------------------------------------
+ * mem_set_attribute()
+ *
+ *  Set the memory type of an address range.
+ *  Pages fully covered by a RAM or ROM range get a page attribute,
+ *  IO ranges and partially covered pages use per-address attributes.
+ *
+ *  param:  Memory address range start to end, inclusive,
+ *          memory type, and IO handler callback or NULL
+ *  return: ' 0' - ok,
+ *          '-3' - Out of per-address attribute pages
+ */
+static int mem_set_attribute(int addr_start, int addr_end, memory_flag_t memory_type, io_handler_callback io_handler)
+{
+    int             i, page;
+    mem_sub_page_t *sub_page;
+
+    /* A change of memory map invalidates pre-decoded ROM code
+     */
+    mem_rom_version++;
+
+    for ( i = addr_start; i <= addr_end; )
+    {
+        page = i >> MEM_PAGE_SHIFT;
+
+        /* Whole page that does not hold IO handlers
+         */
+        if ( memory_type != MEM_TYPE_IO &&
+             mem_pages[page].page_type != MEM_TYPE_MIXED &&
+             (i & MEM_PAGE_MASK) == 0 &&
+             (i + MEM_PAGE_MASK) <= addr_end )
+        {
+            mem_pages[page].page_type = memory_type;
+            i += MEM_PAGE_SIZE;
+            continue;
+        }
+
+        /* Per-address attribute
+         */
+        if ( (sub_page = mem_get_sub_page(page)) == 0L )
+            return MEM_HANDLER_ERR;
+
+        sub_page->watch_only = 0;
+        sub_page->memory_type[(i & MEM_PAGE_MASK)] = memory_type;
+        if ( io_handler != 0L )
+            sub_page->io_handler[(i & MEM_PAGE_MASK)] = io_handler;
+
+        i++;
+    }
+
+    return MEM_OK;
+}
+
+/*------------------------------------------------
+ * mem_get_sub_page()
+ *
+ *  Get the per-address attribute sub-page of a memory page.
+ *  Allocate and initialize the sub-page from the page attribute
+ *  if the page does not have one yet.
+ *
+ *  param:  Page number
+ *  return: Pointer to sub-page, NULL if out of sub-pages
+ */
+static mem_sub_page_t *mem_get_sub_page(int page)
+{
+    int             i;
+    mem_sub_page_t *sub_page;
+
+    if ( mem_pages[page].page_type == MEM_TYPE_MIXED )
+        return mem_pages[page].sub_page;
+
+    for ( i = 0; i < MEM_SUB_PAGES && sub_pages[i].in_use; i++ );
+
+    if ( i == MEM_SUB_PAGES )
+        return 0L;
+
+    sub_page = &sub_pages[i];
+
+    for ( i = 0; i < MEM_PAGE_SIZE; i++ )
+    {
+        sub_page->memory_type[i] = mem_pages[page].page_type;
+        sub_page->io_handler[i] = do_nothing_io_handler;
+        sub_page->alias[i] = 0;
+        sub_page->io_data[i] = 0;
+        sub_page->watch[i] = 0;
+    }
+
+    sub_page->watch_count = 0;
+    sub_page->watch_only = 0;
+    sub_page->in_use = 1;
+
+    mem_pages[page].page_type = MEM_TYPE_MIXED;
+    mem_pages[page].sub_page = sub_page;
+
+    return sub_page;
+}
+
+/*------------------------------------------------
+ * mem_load_mark()
+ *
+ *  Mark a memory range with loaded content as dirty, and
+ *  invalidate ROM code that the CPU has pre-decoded, since the
+ *  loaded content may replace it.
+ *
+ *  param:  Memory address start and length of the range
+ *  return: Nothing
+ */
+static void mem_load_mark(int addr_start, int length)
+{
+    if ( length > 0 )
+        memset(&mem_dirty[(addr_start >> MEM_DIRTY_SHIFT)], 1,
+               ((addr_start + length - 1) >> MEM_DIRTY_SHIFT) - (addr_start >> MEM_DIRTY_SHIFT) + 1);
+
+    mem_rom_version++;
+}
+
+/*------------------------------------------------
+ * mem_watch_trigger()
+ *
+ *  Record an access to a watched address, keeping the first
+ *  access until it is taken by mem_watch_triggered().
+ *
+ *  param:  Memory address and access type
+ *  return: Nothing
+ */
+static void mem_watch_trigger(int address, mem_operation_t op)
+{
+    if ( mem_watch_hit )
+        return;
+
+    watch_address = address;
+    watch_op = op;
+    mem_watch_hit = 1;
+}
@@ -16,31 +16,48 @@
 #include    "vdg.h"
 #include    "pia.h"
 #include    "loader.h"
+#include    "sched.h"
+#include    "audio.h"
+#include    "joystk.h"
+#include    "kbd.h"
+#include    "intr.h"
+#include    "state.h"
+#include    "replay.h"
+#include    "config.h"
 #include    "dbgmsg.h"
 
 /* -----------------------------------------
    Local definitions
 ----------------------------------------- */
-#define     PIA0_PA             0xff00
-#define     PIA0_CRA            0xff01
-#define     PIA0_PB             0xff02
-#define     PIA0_CRB            0xff03
+#define     PIA0_BASE           0xff00  // PIA0 registers repeat through 0xFF1F
+#define     PIA0_END            0xff1f
+#define     PIA1_BASE           0xff20  // PIA1 registers repeat through 0xFF3F
+#define     PIA1_END            0xff3f
 
-#define     PIA1_PA             0xff20
-#define     PIA1_CRA            0xff21
-#define     PIA1_PB             0xff22
-#define     PIA1_CRB            0xff23
+#define     PIA_REG_MASK        0x03
+#define     PIA_REG_PA          0       // Data or data direction register A
+#define     PIA_REG_CRA         1
+#define     PIA_REG_PB          2       // Data or data direction register B
+#define     PIA_REG_CRB         3
 
 #define     PIACR_CAB2_MASK     0X38
 #define     PIACR_CAB2_SET      0x38
-#define     PIACR_CABS_CLR      0x30
+#define     PIACR_CAB2_OUTPUT   0x20    // CA2/CB2 is an output
+#define     PIACR_CAB2_MANUAL   0x30    // CA2/CB2 output follows bit.3
 
 #define     KBD_ROWS            7
-
-#define     PIA_VSYNC_INTERVAL  ((uint32_t)(1000000/50))
+#define     KBD_COLUMN_STROBES  256
 
 #define     PIA_CR_INTR         0x01    // CA1/CB1 interrupt enable bit
+#define     PIA_CR_DATA_SEL     0x04    // Data register select, '0' selects the data direction register
+#define     PIA_CR_INTR2        0x08    // CA2/CB2 interrupt enable bit, when CA2/CB2 is an input
+#define     PIA_CR_WRITE_MASK   0x3f
 #define     PIA_CR_IRQ_STAT     0x80    // IRQA1/IRQB1 status bit
+#define     PIA_CR_IRQ2_STAT    0x40    // IRQA2/IRQB2 status bit
+
+#define     PIA0_PB_INPUT       0xff    // Keyboard column pull-ups
+#define     PIA1_PB_INPUT       0x00    // 32K RAM size, no printer busy
+#define     PIA1_PB_ROM_SELECT  0x04    // Dragon 64 BASIC ROM select output, '1' (pulled up) selects the '32 mode' ROM
 
 #define     AUDIO_MUX_JSTKX     0
 #define     AUDIO_MUX_JSTKY     1
@@ -52,29 +69,83 @@
 #define     BIT_THRESHOLD_HI    4
 #define     BIT_THRESHOLD_LO    20
 
+/* Dragon ROM cassette variables and CAS block format,
+ * used by the fast load traps of CSRDON and BLKIN
+ * and the save traps of WRTLDR and BLKOUT
+ */
+#define     CAS_BLKTYP          0x007c  // Block type
+#define     CAS_BLKLEN          0x007d  // Block length
+#define     CAS_CBUFAD          0x007e  // Block buffer address (16-bit)
+#define     CAS_CCKSUM          0x0080  // Block checksum
+#define     CAS_CSRERR          0x0081  // Block read error code
+#define     CAS_CPULWD          0x0083  // Bit counter of the byte input routine
+#define     CAS_LEADER_LEN      0x0090  // Leader byte count (16-bit)
+#define     CAS_LEADER_BYTE     0x55
+#define     CAS_SYNC_BYTE       0x3c
+#define     CAS_BLOCK_EOF       0xff
+#define     CAS_BLOCK_HEADER    4       // Leader byte, sync byte, block type and length
+#define     CAS_BLOCK_TRAILER   2       // Checksum and leader byte
+#define     CAS_ERR_NONE        0
+#define     CAS_ERR_CHECKSUM    1       // Checksum error, or the CAS file ended in the block
+#define     CAS_ERR_MEMORY      2       // Block data did not write to memory (ROM)
+
+#define     CC_C                0x01
+#define     CC_V                0x02
+#define     CC_Z                0x04
+#define     CC_N                0x08
+#define     CC_I                0x10
+#define     CC_F                0x40
+
 #define     SCAN_CODE_F1        58
 
+#define     HSYNC_POLL_FIELDS   2       // Fields to keep HSYNC line timing after last PIA0-CRA read
+
+/* MC6821 side A or B registers
+ */
+typedef struct
+{
+    uint8_t     output;                 // Output register
+    uint8_t     ddr;                    // Data direction register, '1' bits are outputs
+    uint8_t     control;                // Control register bits 0 to 5
+    uint8_t     irq_status;             // IRQx1 and IRQx2 status, control register bits 7 and 6
+    uint32_t    intr_source;            // Interrupt controller source of the IRQx output
+} pia_port_t;
+
+typedef struct
+{
+    pia_port_t  a;
+    pia_port_t  b;
+} pia_t;
+
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
-static uint8_t io_handler_pia0_pa(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia0_pb(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia0_cra(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia0_crb(uint16_t address, uint8_t data, mem_operation_t op);
-
-static uint8_t io_handler_pia1_pa(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia1_pb(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia1_cra(uint16_t address, uint8_t data, mem_operation_t op);
-static uint8_t io_handler_pia1_crb(uint16_t address, uint8_t data, mem_operation_t op);
-
+static uint8_t io_handler_pia0(uint16_t address, uint8_t data, mem_operation_t op);
+static uint8_t io_handler_pia1(uint16_t address, uint8_t data, mem_operation_t op);
+
+static uint8_t pia_data_read(pia_port_t *port, uint8_t input);
+static int     pia_data_write(pia_port_t *port, uint8_t data);
+static uint8_t pia_port_pins(pia_port_t *port);
+static int     pia_c2_level(pia_port_t *port);
+static void    pia_port_irq(pia_port_t *port);
+
+static void    keyboard_scan_code(void);
+static uint8_t keyboard_input(void);
+static uint8_t cassette_input(void);
+static void    cassette_motor_update(void);
 static uint8_t get_keyboard_row_scan(uint8_t data);
+static int     joystick_comparator(void);
+static void    audio_mux_update(void);
+static int     cas_read_byte(uint8_t *byte);
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
-static int     pia0_cb1_int_enabled = 0;
-static int     pia1_cb1_int_enabled = 0;
+static pia_t   pia0;                    // CA1 HSYNC, CB1 VSYNC, CA2 audio multiplexer bit.0
+static pia_t   pia1;                    // CB1 cartridge FIRQ, CA2 cassette motor, CB2 audio multiplexer bit.1
+static int     pia0_ca1_poll_fields = 0;
 static uint8_t audio_mux_select = AUDIO_MUX_OTHER;
+static int     dac_level = 0;           // Last DAC value written by the emulation
 static int     function_key = 0;
 
 /*
@@ -187,6 +258,12 @@ static uint8_t keyboard_rows[KBD_ROWS] = {
         255,    // row PIA0_PA6
 };
 
+/* Row inputs for each column strobe pattern written to PIA0_PB,
+ * computed from 'keyboard_rows' on first use and invalidated when a key changes
+ */
+static uint8_t keyboard_row_scan[KBD_COLUMN_STROBES];
+static uint8_t keyboard_row_scan_valid[KBD_COLUMN_STROBES];
+
 /*------------------------------------------------
  * pia_init()
  *
@@ -197,18 +274,30 @@ static uint8_t keyboard_rows[KBD_ROWS] = {
  */
 void pia_init(void)
 {
+    /* Registers are cleared as after an MC6821 reset,
+     * all port lines are inputs and the data direction registers are selected
+     */
+    memset(&pia0, 0, sizeof(pia_t));
+    memset(&pia1, 0, sizeof(pia_t));
+    pia0.a.intr_source = INTR_SRC_PIA0_A;
+    pia0.b.intr_source = INTR_SRC_PIA0_B;
+    pia1.a.intr_source = INTR_SRC_PIA1_A;
+    pia1.b.intr_source = INTR_SRC_PIA1_B;
+    pia0_ca1_poll_fields = 0;
+    dac_level = 0;
+
+    /* No keys are pressed, and the row scan cache is empty
+     */
+    memset(keyboard_rows, 0xff, sizeof(keyboard_rows));
+    memset(keyboard_row_scan_valid, 0, sizeof(keyboard_row_scan_valid));
+    function_key = 0;
+
     /* Link IO call-backs
      */
-    mem_write(PIA0_PA, 0x7f);
-    mem_define_io(PIA0_PA, PIA0_PA, io_handler_pia0_pa);    // Joystick comparator, keyboard row input
-    mem_define_io(PIA0_PB, PIA0_PB, io_handler_pia0_pb);    // Keyboard column output
-    mem_define_io(PIA0_CRA, PIA0_CRA, io_handler_pia0_cra); // Audio multiplexer select bit.0
-    mem_define_io(PIA0_CRB, PIA0_CRB, io_handler_pia0_crb); // Field sync interrupt
-
-    mem_define_io(PIA1_PA, PIA1_PA, io_handler_pia1_pa);    // 6-bit DAC output, cassette interface input bit
-    mem_define_io(PIA1_PB, PIA1_PB, io_handler_pia1_pb);    // VDG mode bits output
-    mem_define_io(PIA1_CRA, PIA1_CRA, io_handler_pia1_cra); // Cassette tape motor control
-    mem_define_io(PIA1_CRB, PIA1_CRB, io_handler_pia1_crb); // Audio multiplexer select bit.1
+    mem_define_io(PIA0_BASE, PIA0_END, io_handler_pia0);    // Keyboard, joystick comparator, audio multiplexer bit.0, sync interrupts
+    mem_define_io(PIA1_BASE, PIA1_END, io_handler_pia1);    // DAC, cassette, VDG mode, audio multiplexer bit.1, cartridge interrupt
+
+    audio_mux_update();
 }
 
 /*------------------------------------------------
@@ -216,24 +305,54 @@ void pia_init(void)
  *
  *  Assert an external interrupt from the VDG Field Sync line (V-Sync)
  *  through PIA0-CB1 that geterates an IRQ interrupt.
+ *  The IRQB1 status is set at every field sync, and the sync pulse
+ *  has both edges so the CB1 edge select does not matter.
  *
  *  param:  Nothing
  *  return: Nothing
  */
 void pia_vsync_irq(void)
 {
-    uint8_t temp;
+    if ( pia0_ca1_poll_fields )
+        pia0_ca1_poll_fields--;
 
-    /* Assert interrupt if enabled
-     */
-    if ( pia0_cb1_int_enabled )
-    {
-        temp = mem_read(PIA0_CRB);
-        temp |= PIA_CR_IRQ_STAT;
-        mem_write(PIA0_CRB, temp);
+    pia0.b.irq_status |= PIA_CR_IRQ_STAT;
 
-        cpu_irq(1);
-    }
+    pia_port_irq(&pia0.b);
+}
+
+/*------------------------------------------------
+ * pia_hsync_irq()
+ *
+ *  Assert an external interrupt from the VDG Horizontal Sync line (H-Sync)
+ *  through PIA0-CA1. The IRQA1 status is set at every line sync
+ *  and generates an IRQ interrupt if enabled.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void pia_hsync_irq(void)
+{
+    pia0.a.irq_status |= PIA_CR_IRQ_STAT;
+
+    if ( pia0.a.control & PIA_CR_INTR )
+        intr_assert(INTR_SRC_PIA0_A, 1);
+}
+
+/*------------------------------------------------
+ * pia_hsync_active()
+ *
+ *  Check if line sync timing is in use, either because the PIA0-CA1 interrupt
+ *  is enabled or because the IRQA1 status was recently polled.
+ *  When it is not, pia_hsync_irq() does not need to be called at every
+ *  scan line, and calling it once in a while keeps the status up to date.
+ *
+ *  param:  Nothing
+ *  return: '1' if line sync timing is in use, '0' if not
+ */
+int pia_hsync_active(void)
+{
+    return ( (pia0.a.control & PIA_CR_INTR) || pia0_ca1_poll_fields );
 }
 
 /*------------------------------------------------
@@ -247,18 +366,56 @@ void pia_vsync_irq(void)
  */
 void pia_cart_firq(void)
 {
-    uint8_t temp;
+    pia1.b.irq_status |= PIA_CR_IRQ_STAT;
 
-    /* Assert interrupt if enabled
-     */
-    if ( pia1_cb1_int_enabled )
-    {
-        temp = mem_read(PIA1_CRB);
-        temp |= PIA_CR_IRQ_STAT;
-        mem_write(PIA1_CRB, temp);
+    pia_port_irq(&pia1.b);
+}
 
-        cpu_firq(1);
-    }
+/*------------------------------------------------
+ * pia_save_state()
+ *
+ *  Write the PIA registers to the machine state.
+ *  The keyboard matrix follows the host keyboard and is not saved.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void pia_save_state(void)
+{
+    state_write(&pia0, sizeof(pia_t));
+    state_write(&pia1, sizeof(pia_t));
+    state_write(&pia0_ca1_poll_fields, sizeof(pia0_ca1_poll_fields));
+    state_write(&dac_level, sizeof(dac_level));
+}
+
+/*------------------------------------------------
+ * pia_restore_state()
+ *
+ *  Restore the PIA registers from the machine state, and apply
+ *  their outputs: the audio multiplexer, the cassette motor, the VDG mode,
+ *  the Dragon 64 ROM select, and the interrupt outputs to the interrupt controller.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void pia_restore_state(void)
+{
+    state_read(&pia0, sizeof(pia_t));
+    state_read(&pia1, sizeof(pia_t));
+    state_read(&pia0_ca1_poll_fields, sizeof(pia0_ca1_poll_fields));
+    state_read(&dac_level, sizeof(dac_level));
+
+    audio_mux_update();
+    cassette_motor_update();
+    vdg_set_mode_pia(((pia_port_pins(&pia1.b) >> 3) & 0x1f));
+#if (DRAGON_MODEL==64)
+    mem_select_rom(!(pia_port_pins(&pia1.b) & PIA1_PB_ROM_SELECT));
+#endif
+
+    pia_port_irq(&pia0.a);
+    pia_port_irq(&pia0.b);
+    pia_port_irq(&pia1.a);
+    pia_port_irq(&pia1.b);
 }
 
 /*------------------------------------------------
@@ -283,273 +440,302 @@ int pia_function_key(void)
 }
 
 /*------------------------------------------------
- * io_handler_pia0_pa()
+ * pia_cas_csrdon()
  *
- *  IO call-back handler 0xFF00 PIA0-A Data read:
+ *  Trap handler of the Dragon ROM CSRDON routine.
+ *  Turns the cassette motor on without the ROM's motor start delay
+ *  and leader synchronization, which pia_cas_blkin() does not need.
  *
- *  Bit 0..6 keyboard row input
- *  Bit 0    Right joystick button input
- *  Bit 1    Left joystick button input ** not implemented **
- *  Bit 7    Joystick comparator input
- *
- *  This call-back will only deal with joystick comparator input read.
- *  Keyboard row inputs are handled by io_handler_pia0_pb()
- *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Pointer to CPU registers
+ *  return: 1, routine replaced
  */
-static uint8_t io_handler_pia0_pa(uint16_t address, uint8_t data, mem_operation_t op)
+int pia_cas_csrdon(cpu_state_t *registers)
 {
-    if ( op == MEM_READ )
-    {
-        /* Check joystick comparator and button GPIO and set bits
-         */
-        if ( rpi_joystk_comp() )
-            data |= 0x80;
-        else
-            data &= 0x7f;
-
-        /* Do not force a '1' if joystick button is not pressed
-         * this will interfere with keyboard scan.
-         */
-        if ( rpi_rjoystk_button() == 0 )
-            data &= 0xfe;
+    pia1.a.control |= MOTOR_ON;
+    cassette_motor_update();
+    mem_write(CAS_CPULWD, 0);
 
-        /* Keyboard row scan inputs are set by 'io_handler_pia0_pb()'
-         */
-    }
+    registers->cc |= (CC_F | CC_I);
 
-    return data;
+    return 1;
 }
 
 /*------------------------------------------------
- * io_handler_pia0_pb()
+ * pia_cas_blkin()
  *
- *  IO call-back handler 0xFF02 PIA0-B Data
- *  Bit 0..7 Output to keyboard columns
+ *  Trap handler of the Dragon ROM BLKIN routine.
+ *  Reads a whole block from the CAS file into the buffer at CBUFAD,
+ *  and returns to the ROM with the block variables, A, X and CC
+ *  as the routine leaves them: A=CSRERR and Z set when the block is good,
+ *  X past the last byte stored.
+ *  Without a CAS file, or at its end, the ROM routine runs and waits
+ *  for the tape input bit stream as before.
  *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Pointer to CPU registers
+ *  return: 1=Routine replaced, 0=No block in the CAS file, run the ROM routine
  */
-static uint8_t io_handler_pia0_pb(uint16_t address, uint8_t data, mem_operation_t op)
+int pia_cas_blkin(cpu_state_t *registers)
 {
-    uint8_t scan_code = 0;
-    uint8_t row_switch_bits;
-    uint8_t temp;
-    int     row_index;
+    uint8_t     byte, block_type, block_length, checksum;
+    uint16_t    buffer;
+    int         count, error;
 
-    /* Activate the call back to read keyboard scan code from
-     * external AVR interface only when testing the keyboard columns
-     * for a key press.
+    /* Skip leader bytes up to the block sync byte
      */
-    if ( op == MEM_WRITE )
+    do
     {
-        /* When writing to the port, the ROM code is checking if any
-         * key is pressed. So a good opportunity
-         * to read the keyboard scan code.
-         */
-        scan_code = (uint8_t) rpi_keyboard_read();
+        if ( !cas_read_byte(&byte) )
+            return 0;
+    }
+    while ( byte != CAS_SYNC_BYTE );
 
-        if ( (scan_code & 0x7f) >= 59 && (scan_code & 0x7f) <= 68 )
-        {
-            /* Store special function keys as emulator escapes
-             * values between 1 an 10 for F1 to F10 keys
-             * while discarding 'break' codes.
-             */
-            if ( !(scan_code & 0x80) && (function_key == 0) )
-                function_key = scan_code - SCAN_CODE_F1;
-        }
-        else if ( scan_code != 0 )
-        {
-            /* Sanity check
-             */
-            if ( (row_index = scan_code_table[(scan_code & 0x7f)][1]) == 255 )
-            {
-                dbg_printf(0, "io_handler_pia0_pb()[%d]: Illegal scan code.\n", __LINE__);
-                rpi_halt();
-            }
+    buffer = (mem_read(CAS_CBUFAD) << 8) + mem_read(CAS_CBUFAD + 1);
+    block_type = 0;
+    block_length = 0;
+    checksum = 0;
+    error = CAS_ERR_CHECKSUM;
 
-            /* Generate row bit patterns emulating row key closures
-             * and match to 'make' or 'break' codes (bit.7 of scan code)
-             */
-            row_switch_bits = scan_code_table[(scan_code & 0x7f)][0];
+    if ( cas_read_byte(&block_type) && cas_read_byte(&block_length) )
+    {
+        mem_write(CAS_BLKTYP, block_type);
+        mem_write(CAS_BLKLEN, block_length);
+        checksum = block_type + block_length;
 
-            if ( scan_code & 0x80 )
-            {
-                keyboard_rows[row_index] |= ~row_switch_bits;
-            }
-            else
+        for ( count = 0; count < block_length; count++ )
+        {
+            if ( !cas_read_byte(&byte) )
+                break;
+
+            mem_write(buffer, byte);
+            if ( mem_read(buffer++) != byte )
             {
-                keyboard_rows[row_index] &= row_switch_bits;
+                error = CAS_ERR_MEMORY;
+                break;
             }
-        }
 
-        /* Store the appropriate row bit value
-         * for PIA0_PA bit pattern after merging with comparator input
-         */
-        row_switch_bits = get_keyboard_row_scan(data);
-        if ( rpi_joystk_comp() )
-            row_switch_bits |= 0x80;
-        else
-            row_switch_bits &= 0x7f;
+            checksum += byte;
+        }
 
-        mem_write(PIA0_PA, (int) row_switch_bits);
+        if ( count == block_length &&
+             cas_read_byte(&byte) &&
+             byte == checksum )
+        {
+            error = CAS_ERR_NONE;
+        }
     }
 
-    /* A read to the port address has the effect of resetting
-     * the IRQ status line
-     */
-    else
-    {
-        temp = mem_read(PIA0_CRB);
-        temp &= ~PIA_CR_IRQ_STAT;
-        mem_write(PIA0_CRB, temp);
+    mem_write(CAS_CCKSUM, checksum);
+    mem_write(CAS_CSRERR, error);
+    mem_write(CAS_CPULWD, 0);
 
-        cpu_irq(0);
-    }
+    registers->a = error;
+    registers->x = buffer;
+    registers->cc &= ~(CC_N | CC_Z | CC_V | CC_C);
+    registers->cc |= (CC_F | CC_I) | ((error == CAS_ERR_NONE) ? CC_Z : 0);
 
-    return data;
+    dbg_printf(2, "pia_cas_blkin()[%d]: Block type=%d length=%d error=%d\n",
+               __LINE__, block_type, block_length, error);
+
+    return 1;
 }
 
 /*------------------------------------------------
- * io_handler_pia0_cra()
+ * pia_cas_wrtldr()
  *
- *  IO call-back handler 0xFF03 PIA0-A Control register
- *  responding the audio multiplexer select bits
+ *  Trap handler of the Dragon ROM WRTLDR routine.
+ *  Turns the cassette motor on without the ROM's motor start delay,
+ *  and writes the leader bytes to the CAS file being saved instead of
+ *  to the DAC. Returns to the ROM with A and X as the routine leaves them.
  *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Pointer to CPU registers
+ *  return: 1, routine replaced
  */
-static uint8_t io_handler_pia0_cra(uint16_t address, uint8_t data, mem_operation_t op)
+int pia_cas_wrtldr(cpu_state_t *registers)
 {
-    if ( op == MEM_WRITE )
-    {
-        if ( (data & PIACR_CAB2_MASK) == PIACR_CAB2_SET )
-            audio_mux_select |= 0x01;
-        else
-            audio_mux_select &= 0xfe;
+    uint8_t     byte;
+    uint16_t    count;
 
-        rpi_audio_mux_set((int) audio_mux_select);
+    pia1.a.control |= MOTOR_ON;
+    cassette_motor_update();
+
+    byte = CAS_LEADER_BYTE;
+    count = (mem_read(CAS_LEADER_LEN) << 8) + mem_read(CAS_LEADER_LEN + 1);
+
+    do
+    {
+        loader_cas_fwrite(&byte, 1);
     }
+    while ( --count );
 
-    return data;
+    registers->a = CAS_LEADER_BYTE;
+    registers->x = 0;
+    registers->cc |= (CC_F | CC_I | CC_Z);
+
+    return 1;
 }
 
 /*------------------------------------------------
- * io_handler_pia0_crb()
+ * pia_cas_blkout()
  *
- *  IO call-back handler 0xFF03 PIA0-B Control register
- *  to enabled/disable IRQ interrupt source.
+ *  Trap handler of the Dragon ROM BLKOUT routine.
+ *  Writes the block in the buffer at CBUFAD to the CAS file being saved,
+ *  with its sync byte, checksum and the leader bytes around it,
+ *  and returns to the ROM with the block variables, A, B and X as the routine
+ *  leaves them. The CAS file is closed after the end-of-file block.
  *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Pointer to CPU registers
+ *  return: 1, routine replaced
  */
-static uint8_t io_handler_pia0_crb(uint16_t address, uint8_t data, mem_operation_t op)
+int pia_cas_blkout(cpu_state_t *registers)
 {
-    if ( op == MEM_WRITE )
+    uint8_t     block[CAS_BLOCK_HEADER + 256 + CAS_BLOCK_TRAILER];
+    uint8_t     block_type, block_length, checksum;
+    uint16_t    buffer;
+    int         count;
+
+    buffer = (mem_read(CAS_CBUFAD) << 8) + mem_read(CAS_CBUFAD + 1);
+    block_type = mem_read(CAS_BLKTYP);
+    block_length = mem_read(CAS_BLKLEN);
+    checksum = block_type + block_length;
+
+    block[0] = CAS_LEADER_BYTE;
+    block[1] = CAS_SYNC_BYTE;
+    block[2] = block_type;
+    block[3] = block_length;
+
+    for ( count = 0; count < block_length; count++ )
     {
-        if ( data & PIA_CR_INTR )
-            pia0_cb1_int_enabled = 1;
-        else
-            pia0_cb1_int_enabled = 0;
+        block[CAS_BLOCK_HEADER + count] = mem_read(buffer++);
+        checksum += block[CAS_BLOCK_HEADER + count];
     }
 
-    return data;
+    block[CAS_BLOCK_HEADER + count] = checksum;
+    block[CAS_BLOCK_HEADER + count + 1] = CAS_LEADER_BYTE;
+
+    loader_cas_fwrite(block, (CAS_BLOCK_HEADER + block_length + CAS_BLOCK_TRAILER));
+
+    if ( block_type == CAS_BLOCK_EOF )
+        loader_cas_fclose();
+
+    mem_write(CAS_CCKSUM, checksum);
+    mem_write(CAS_CSRERR, 0);
+
+    registers->a = CAS_LEADER_BYTE;
+    registers->b = 0;
+    registers->x = buffer;
+    registers->cc |= (CC_F | CC_I);
+
+    dbg_printf(2, "pia_cas_blkout()[%d]: Block type=%d length=%d\n",
+               __LINE__, block_type, block_length);
+
+    return 1;
 }
 
 /*------------------------------------------------
- * io_handler_pia1_pa()
+ * io_handler_pia0()
+ *
+ *  IO call-back handler 0xFF00 to 0xFF03 PIA0, repeated through 0xFF1F
+ *
+ *  0xFF00 PIA0-A Data
+ *  Bit 0..6 I  Keyboard row input
+ *  Bit 0    I  Right joystick button input
+ *  Bit 1    I  Left joystick button input ** not implemented **
+ *  Bit 7    I  Joystick comparator input
+ *
+ *  0xFF01 PIA0-A Control, CA1 line sync interrupt, CA2 audio multiplexer select bit.0
+ *
+ *  0xFF02 PIA0-B Data
+ *  Bit 0..7 O  Output to keyboard columns
  *
- *  IO call-back handler 0xFF20 Dir PIA1-A output to 6-bit DAC
- *  Traps and handles writes to PA bit.2 to bit.7,
- *  and cassette tape input bit.
+ *  0xFF03 PIA0-B Control, CB1 field sync interrupt
+ *
+ *  A data register read resets the side's IRQ status.
  *
  *  param:  Call address, data byte for write operation, and operation type
  *  return: Status or data byte
  */
-static uint8_t io_handler_pia1_pa(uint16_t address, uint8_t data, mem_operation_t op)
+static uint8_t io_handler_pia0(uint16_t address, uint8_t data, mem_operation_t op)
 {
-    static  uint8_t byte = 0;
-    static  int     bit_index = 0;
-    static  int     bit_timing_threshold = 0;
-    static  int     bit_timing_count = 0;
+    uint8_t irq_status;
 
-    int     cas_eof;
-    int     dac_output;
-
-    if ( op == MEM_WRITE )
-    {
-        dac_output = (data >> 2) & 0x3f;
-        rpi_write_dac(dac_output);
-    }
-    else
+    switch ( address & PIA_REG_MASK )
     {
-        /* Reading the cassette tape input bit PIA1-PA0:
-         * 1) Bits are fed into PA0 with LSB first
-         * 2) a '1' bit toggles PA0 to '0' then '1' for BIT_THRESHOLD_HI/2 reads of PA0
-         * 3) a '0' bit toggles PA0 to '0' then '1' for BIT_THRESHOLD_LO/2 reads of PA0
-         * 4) The read count threshold of PA0 that determines the bit state is 18
-         *    according to the Dragon ROM listing
-         * 5) The normal PA0 state is '0'
-         *
-         * This process fakes the bit stream coming from the cassette tape interface
-         * with the advantage that it can synchronize on the bit reads. The interface
-         * can be hacked to speed up the load time by changing the threshold of 18
-         * in Dragon RAM location 0x0092 to a lower number.
-         *
-         */
-        if ( bit_index == 0 )
-        {
-            cas_eof = !loader_cas_fread(&byte, 1);
-
-            bit_index = 9;
-            bit_timing_threshold = 0;
-            bit_timing_count = 0;
-
-            /* Force sync/fill bytes just in case.
-             */
-            if ( cas_eof )
+        case PIA_REG_PA:
+            if ( op == MEM_WRITE )
             {
-                byte = 0x55;
+                pia_data_write(&pia0.a, data);
             }
-        }
+            else
+            {
+                irq_status = pia0.a.irq_status;
+                data = pia_data_read(&pia0.a, keyboard_input());
+                if ( irq_status != pia0.a.irq_status )
+                    pia_port_irq(&pia0.a);
+            }
+            break;
 
-        if ( bit_timing_count == bit_timing_threshold )
-        {
-            if ( byte & 0b00000001 )
+        case PIA_REG_CRA:
+            if ( op == MEM_WRITE )
             {
-                bit_timing_threshold = BIT_THRESHOLD_HI;
+                pia0.a.control = data & PIA_CR_WRITE_MASK;
+                audio_mux_update();
+                pia_port_irq(&pia0.a);
             }
             else
             {
-                bit_timing_threshold = BIT_THRESHOLD_LO;
+                pia0_ca1_poll_fields = HSYNC_POLL_FIELDS;
+                data = pia0.a.irq_status | pia0.a.control;
             }
+            break;
 
-            bit_timing_count = 0;
-
-            byte = byte >> 1;
-            bit_index--;
-        }
-
-        if ( bit_timing_count < (bit_timing_threshold / 2) )
-        {
-            data &= 0b11111110;
-        }
-        else
-        {
-            data |= 0b00000001;
-        }
+        case PIA_REG_PB:
+            if ( op == MEM_WRITE )
+            {
+                /* When writing to the port, the ROM code is checking if any
+                 * key is pressed. So a good opportunity
+                 * to take the next keyboard scan code.
+                 */
+                if ( pia_data_write(&pia0.b, data) )
+                    keyboard_scan_code();
+            }
+            else
+            {
+                irq_status = pia0.b.irq_status;
+                data = pia_data_read(&pia0.b, PIA0_PB_INPUT);
+                if ( irq_status != pia0.b.irq_status )
+                    pia_port_irq(&pia0.b);
+            }
+            break;
 
-        bit_timing_count++;
+        case PIA_REG_CRB:
+            if ( op == MEM_WRITE )
+            {
+                pia0.b.control = data & PIA_CR_WRITE_MASK;
+                pia_port_irq(&pia0.b);
+            }
+            else
+            {
+                data = pia0.b.irq_status | pia0.b.control;
+            }
+            break;
     }
 
     return data;
 }
 
 /*------------------------------------------------
- * io_handler_pia1_pb()
+ * io_handler_pia1()
+ *
+ *  IO call-back handler 0xFF20 to 0xFF23 PIA1, repeated through 0xFF3F
+ *
+ *  0xFF20 PIA1-A Data
+ *  Bit 2..7 O  6-bit DAC
+ *  Bit 1    O  RS232 output / printer strobe, not implemented
+ *  Bit 0    I  Cassette tape input
  *
- *  IO call-back handler 0xFF22 Dir PIA1-B Data
+ *  0xFF21 PIA1-A Control, CA2 cassette motor on-off
+ *
+ *  0xFF22 PIA1-B Data
  *  Bit 7   O   Screen Mode G/^A
  *  Bit 6   O   Screen Mode GM2
  *  Bit 5   O   Screen Mode GM1
@@ -558,100 +744,171 @@ static uint8_t io_handler_pia1_pa(uint16_t address, uint8_t data, mem_operation_
  *  Bit 2   I   Ram Size (1=16k 0=32/64k), not implemented
  *  Bit 1   I   Single bit sound
  *  Bit 0   I   Rs232 In / Printer Busy, not implemented
- * 
- *  A read resets FIRQ request output.
+ *
+ *  0xFF23 PIA1-B Control, CB1 cartridge FIRQ, CB2 audio multiplexer select bit.1
+ *
+ *  A data register read resets the side's FIRQ status.
  *
  *  param:  Call address, data byte for write operation, and operation type
  *  return: Status or data byte
  */
-static uint8_t io_handler_pia1_pb(uint16_t address, uint8_t data, mem_operation_t op)
+static uint8_t io_handler_pia1(uint16_t address, uint8_t data, mem_operation_t op)
 {
-    uint8_t temp;
-
-    if ( op == MEM_WRITE )
-    {
-        vdg_set_mode_pia(((data >> 3) & 0x1f));
-    }
+    uint8_t irq_status;
+    int     dac_output;
 
-    /* A read to the port address has the effect of resetting
-     * the IRQ status line
-     */
-    else
+    switch ( address & PIA_REG_MASK )
     {
-        temp = mem_read(PIA1_CRB);
-        temp &= ~PIA_CR_IRQ_STAT;
-        mem_write(PIA1_CRB, temp);
+        case PIA_REG_PA:
+            if ( op == MEM_WRITE )
+            {
+                pia_data_write(&pia1.a, data);
+
+                dac_output = (pia_port_pins(&pia1.a) >> 2) & 0x3f;
+                dac_level = dac_output;
+
+                if ( audio_mux_select == AUDIO_MUX_DAC )
+                {
+#if (AUDIO_STREAM==1)
+                    /* Sound is queued with its emulated time
+                     */
+                    audio_dac_write(sched_get_cycles() + cpu_batch_cycles(), dac_output);
+#else
+                    rpi_write_dac(dac_output);
+#endif
+                }
+                else
+                {
+#if (JOYSTK_SAMPLER==0)
+                    /* The joystick comparator conversion needs the DAC output right away,
+                     * with the joystick sampler the DAC level is compared to the cached position
+                     */
+                    rpi_write_dac(dac_output);
+#endif
+                }
+            }
+            else
+            {
+                irq_status = pia1.a.irq_status;
+                data = pia_data_read(&pia1.a, cassette_input());
+                if ( irq_status != pia1.a.irq_status )
+                    pia_port_irq(&pia1.a);
+            }
+            break;
 
-        cpu_firq(0);
-    }
+        case PIA_REG_CRA:
+            if ( op == MEM_WRITE )
+            {
+                pia1.a.control = data & PIA_CR_WRITE_MASK;
+                cassette_motor_update();
+                pia_port_irq(&pia1.a);
+            }
+            else
+            {
+                data = pia1.a.irq_status | pia1.a.control;
+            }
+            break;
 
-    return data;
-}
+        case PIA_REG_PB:
+            if ( op == MEM_WRITE )
+            {
+                pia_data_write(&pia1.b, data);
+                vdg_set_mode_pia(((pia_port_pins(&pia1.b) >> 3) & 0x1f));
+#if (DRAGON_MODEL==64)
+                mem_select_rom(!(pia_port_pins(&pia1.b) & PIA1_PB_ROM_SELECT));
+#endif
+            }
+            else
+            {
+                irq_status = pia1.b.irq_status;
+                data = pia_data_read(&pia1.b, PIA1_PB_INPUT);
+                if ( irq_status != pia1.b.irq_status )
+                    pia_port_irq(&pia1.b);
+            }
+            break;
 
-/*------------------------------------------------
- * io_handler_pia1_cra()
- *
- *  IO call-back handler 0xFF21 PIA1-A Control register
- *  responding the cassette motor on-off select bit CA2
- *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
- */
-static uint8_t io_handler_pia1_cra(uint16_t address, uint8_t data, mem_operation_t op)
-{
-    if ( op == MEM_WRITE )
-    {
-        if ( data & CA2_SET_CLR )
-        {
-            if ( data & MOTOR_ON )
+        case PIA_REG_CRB:
+            if ( op == MEM_WRITE )
             {
-                rpi_motor_led_on(MOTOR_LED_TAPE);
+                pia1.b.control = data & PIA_CR_WRITE_MASK;
+                audio_mux_update();
+                pia_port_irq(&pia1.b);
             }
             else
             {
-                rpi_motor_led_off(MOTOR_LED_TAPE);
+                data = pia1.b.irq_status | pia1.b.control;
             }
-        }
+            break;
     }
 
     return data;
 }
 
 /*------------------------------------------------
- * io_handler_pia1_crb()
+ * joystick_comparator()
  *
- *  IO call-back handler 0xFF23 PIA1-B Control register
- *  responding the audio multiplexer select bits, and
- *  PIA1-CRB1 interrupt enable/disable.
+ *  Return the joystick comparator input for the DAC level
+ *  and the joystick axis selected by the audio multiplexer.
  *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Nothing
+ *  return: Comparator input level
  */
-static uint8_t io_handler_pia1_crb(uint16_t address, uint8_t data, mem_operation_t op)
+static int joystick_comparator(void)
 {
-    if ( op == MEM_WRITE )
-    {
-        if ( data & PIA_CR_INTR )
-            pia1_cb1_int_enabled = 1;
-        else
-            pia1_cb1_int_enabled = 0;
+#if (JOYSTK_SAMPLER==1)
+    return replay_level(REPLAY_JOYSTK_COMP, joystk_comparator((int) audio_mux_select, dac_level));
+#else
+    return replay_level(REPLAY_JOYSTK_COMP, rpi_joystk_comp());
+#endif
+}
 
-        if ( (data & PIACR_CAB2_MASK) == PIACR_CAB2_SET )
-            audio_mux_select |= 0x02;
-        else
-            audio_mux_select &= 0xfd;
+/*------------------------------------------------
+ * audio_mux_update()
+ *
+ *  Apply a change of the audio multiplexer select bits,
+ *  PIA0-CA2 for bit.0 and PIA1-CB2 for bit.1.
+ *  The joystick sampler uses the multiplexer and DAC while the DAC
+ *  is not routed to the audio output, so it is stopped before the
+ *  multiplexer selects the DAC, and the audio stream runs only then.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void audio_mux_update(void)
+{
+    audio_mux_select = (uint8_t)((pia_c2_level(&pia1.b) << 1) | pia_c2_level(&pia0.a));
 
+#if (JOYSTK_SAMPLER==1)
+    joystk_sampling(audio_mux_select != AUDIO_MUX_DAC);
+    if ( audio_mux_select == AUDIO_MUX_DAC )
         rpi_audio_mux_set((int) audio_mux_select);
-    }
+#else
+    rpi_audio_mux_set((int) audio_mux_select);
+#endif
 
-    return data;
+    audio_stream(audio_mux_select == AUDIO_MUX_DAC);
+}
+
+/*------------------------------------------------
+ * cas_read_byte()
+ *
+ *  Read the next byte of the CAS file.
+ *
+ *  param:  Pointer to byte
+ *  return: 1=Byte read, 0=End of file or no file
+ */
+static int cas_read_byte(uint8_t *byte)
+{
+    return ( loader_cas_fread(byte, 1) > 0 );
 }
 
 /*------------------------------------------------
  * get_keyboard_row_scan()
  *
  *  Using the Row scan bit pattern and the key closure
- *  matrix in 'keyboard_rows', generate the row scan bit pattern
+ *  matrix in 'keyboard_rows', generate the row scan bit pattern.
+ *  The result is cached per column strobe pattern until a key changes,
+ *  so repeated keyboard polls cost one table lookup.
  *
  *  param:  Row scan bit pattern
  *  return: Column scan bit pattern
@@ -663,6 +920,9 @@ static uint8_t get_keyboard_row_scan(uint8_t row_scan)
     uint8_t test;
     int     row;
 
+    if ( keyboard_row_scan_valid[row_scan] )
+        return keyboard_row_scan[row_scan];
+
     for ( row = 0; row < KBD_ROWS; row++ )
     {
         test = (~row_scan) & keyboard_rows[row];
@@ -675,5 +935,292 @@ static uint8_t get_keyboard_row_scan(uint8_t row_scan)
         bit_position = bit_position << 1;
     }
 
+    keyboard_row_scan[row_scan] = result;
+    keyboard_row_scan_valid[row_scan] = 1;
+
     return result;
 }
+
+/*------------------------------------------------
+ * pia_data_read()
+ *
+ *  Read a PIA side's data register, or its data direction register
+ *  when it is selected. A data register read resets the side's IRQ status.
+ *
+ *  param:  Pointer to PIA side, input line levels
+ *  return: Output register bits merged with the input bits
+ */
+static uint8_t pia_data_read(pia_port_t *port, uint8_t input)
+{
+    if ( !(port->control & PIA_CR_DATA_SEL) )
+        return port->ddr;
+
+    port->irq_status = 0;
+
+    return (port->output & port->ddr) | (input & ~port->ddr);
+}
+
+/*------------------------------------------------
+ * pia_data_write()
+ *
+ *  Write a PIA side's output register, or its data direction register
+ *  when it is selected.
+ *
+ *  param:  Pointer to PIA side, data byte
+ *  return: 1- output register written, 0- data direction register written
+ */
+static int pia_data_write(pia_port_t *port, uint8_t data)
+{
+    if ( !(port->control & PIA_CR_DATA_SEL) )
+    {
+        port->ddr = data;
+        return 0;
+    }
+
+    port->output = data;
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * pia_port_pins()
+ *
+ *  Return the line levels of a PIA side's port.
+ *  Lines that are not outputs read as pulled up.
+ *
+ *  param:  Pointer to PIA side
+ *  return: Port line levels
+ */
+static uint8_t pia_port_pins(pia_port_t *port)
+{
+    return (port->output & port->ddr) | (uint8_t)(~port->ddr);
+}
+
+/*------------------------------------------------
+ * pia_c2_level()
+ *
+ *  Return the level of a PIA side's CA2 or CB2 line.
+ *  The line follows control bit.3 when set as a manual output,
+ *  and is high otherwise, as an input or an idle handshake output.
+ *
+ *  param:  Pointer to PIA side
+ *  return: 1- high, 0- low
+ */
+static int pia_c2_level(pia_port_t *port)
+{
+    if ( (port->control & PIACR_CAB2_MANUAL) != PIACR_CAB2_MANUAL )
+        return 1;
+
+    return ( (port->control & PIACR_CAB2_MASK) == PIACR_CAB2_SET );
+}
+
+/*------------------------------------------------
+ * pia_port_irq()
+ *
+ *  Set the interrupt output of a PIA side in the interrupt controller,
+ *  its IRQ status bits masked by their enable bits.
+ *  The CA2/CB2 interrupt is enabled only when CA2/CB2 is an input.
+ *  PIA0 outputs are wired to IRQ and PIA1 outputs to FIRQ.
+ *
+ *  param:  Pointer to PIA side
+ *  return: Nothing
+ */
+static void pia_port_irq(pia_port_t *port)
+{
+    uint8_t irq_enable;
+
+    irq_enable = (port->control & PIA_CR_INTR) ? PIA_CR_IRQ_STAT : 0;
+
+    if ( (port->control & (PIACR_CAB2_OUTPUT | PIA_CR_INTR2)) == PIA_CR_INTR2 )
+        irq_enable |= PIA_CR_IRQ2_STAT;
+
+    intr_assert(port->intr_source, (port->irq_status & irq_enable) != 0);
+}
+
+/*------------------------------------------------
+ * keyboard_scan_code()
+ *
+ *  Take the next keyboard scan code and update the key closure matrix
+ *  in 'keyboard_rows', or latch an emulator function key.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void keyboard_scan_code(void)
+{
+    uint8_t scan_code;
+    uint8_t row_switch_bits;
+    int     row_index;
+
+    scan_code = (uint8_t) kbd_read();
+
+    if ( (scan_code & 0x7f) >= 59 && (scan_code & 0x7f) <= 68 )
+    {
+        /* Store special function keys as emulator escapes
+         * values between 1 an 10 for F1 to F10 keys
+         * while discarding 'break' codes.
+         * Function keys are not recorded or replayed.
+         */
+        if ( !(scan_code & 0x80) && (function_key == 0) )
+            function_key = scan_code - SCAN_CODE_F1;
+    }
+    else if ( (scan_code = (uint8_t) replay_event(REPLAY_KEYBOARD, scan_code)) != 0 )
+    {
+        /* Sanity check
+         */
+        if ( (row_index = scan_code_table[(scan_code & 0x7f)][1]) == 255 )
+        {
+            dbg_printf(0, "keyboard_scan_code()[%d]: Illegal scan code.\n", __LINE__);
+            rpi_halt();
+        }
+
+        /* Generate row bit patterns emulating row key closures
+         * and match to 'make' or 'break' codes (bit.7 of scan code)
+         */
+        row_switch_bits = scan_code_table[(scan_code & 0x7f)][0];
+
+        if ( scan_code & 0x80 )
+        {
+            keyboard_rows[row_index] |= ~row_switch_bits;
+        }
+        else
+        {
+            keyboard_rows[row_index] &= row_switch_bits;
+        }
+
+        memset(keyboard_row_scan_valid, 0, sizeof(keyboard_row_scan_valid));
+    }
+}
+
+/*------------------------------------------------
+ * keyboard_input()
+ *
+ *  Return the PIA0-A input lines: the keyboard rows of the columns
+ *  strobed by PIA0-B, the joystick comparator in bit.7,
+ *  and the right joystick button pulling bit.0 low.
+ *
+ *  param:  Nothing
+ *  return: PIA0-A input line levels
+ */
+static uint8_t keyboard_input(void)
+{
+    uint8_t input;
+
+    input = get_keyboard_row_scan(pia_port_pins(&pia0.b));
+
+    if ( joystick_comparator() )
+        input |= 0x80;
+    else
+        input &= 0x7f;
+
+    /* Do not force a '1' if joystick button is not pressed
+     * this will interfere with keyboard scan.
+     */
+    if ( replay_level(REPLAY_JOYSTK_BUTTON, rpi_rjoystk_button()) == 0 )
+        input &= 0xfe;
+
+    return input;
+}
+
+/*------------------------------------------------
+ * cassette_input()
+ *
+ *  Return the PIA1-A input lines, with the cassette tape input bit
+ *  in bit.0, for a read of PIA1-A.
+ *
+ *  Reading the cassette tape input bit PIA1-PA0:
+ *  1) Bits are fed into PA0 with LSB first
+ *  2) a '1' bit toggles PA0 to '0' then '1' for BIT_THRESHOLD_HI/2 reads of PA0
+ *  3) a '0' bit toggles PA0 to '0' then '1' for BIT_THRESHOLD_LO/2 reads of PA0
+ *  4) The read count threshold of PA0 that determines the bit state is 18
+ *     according to the Dragon ROM listing
+ *  5) The normal PA0 state is '0'
+ *
+ *  This process fakes the bit stream coming from the cassette tape interface
+ *  with the advantage that it can synchronize on the bit reads. The interface
+ *  can be hacked to speed up the load time by changing the threshold of 18
+ *  in Dragon RAM location 0x0092 to a lower number.
+ *
+ *  param:  Nothing
+ *  return: PIA1-A input line levels
+ */
+static uint8_t cassette_input(void)
+{
+    static  uint8_t byte = 0;
+    static  int     bit_index = 0;
+    static  int     bit_timing_threshold = 0;
+    static  int     bit_timing_count = 0;
+
+    uint8_t input;
+    int     cas_eof;
+
+    if ( bit_index == 0 )
+    {
+        cas_eof = ( loader_cas_fread(&byte, 1) <= 0 );
+
+        bit_index = 9;
+        bit_timing_threshold = 0;
+        bit_timing_count = 0;
+
+        /* Force sync/fill bytes just in case.
+         */
+        if ( cas_eof )
+        {
+            byte = 0x55;
+        }
+    }
+
+    if ( bit_timing_count == bit_timing_threshold )
+    {
+        if ( byte & 0b00000001 )
+        {
+            bit_timing_threshold = BIT_THRESHOLD_HI;
+        }
+        else
+        {
+            bit_timing_threshold = BIT_THRESHOLD_LO;
+        }
+
+        bit_timing_count = 0;
+
+        byte = byte >> 1;
+        bit_index--;
+    }
+
+    if ( bit_timing_count < (bit_timing_threshold / 2) )
+    {
+        input = 0b00000000;
+    }
+    else
+    {
+        input = 0b00000001;
+    }
+
+    bit_timing_count++;
+
+    return input;
+}
+
+/*------------------------------------------------
+ * cassette_motor_update()
+ *
+ *  Apply the cassette motor on-off select bit PIA1-CA2
+ *  to the motor LED.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void cassette_motor_update(void)
+{
+    if ( pia1.a.control & CA2_SET_CLR )
+    {
+        if ( pia1.a.control & MOTOR_ON )
+        {
+            rpi_motor_led_on(MOTOR_LED_TAPE);
+        }
+        else
+        {
+            rpi_motor_led_off(MOTOR_LED_TAPE);
+        }
+    }
+}
@@ -0,0 +1,450 @@
+/********************************************************************
+ * replay.c
+ *
+ *  Input recorder and player.
+ *  While recording, the keyboard scan codes, the joystick comparator and
+ *  button levels and the reset button presses that the emulation reads
+ *  are logged with the emulated CPU cycle of the read. During playback
+ *  the emulation reads the logged inputs instead of the live ones, so a
+ *  session runs the same instructions, and renders the same frames, in
+ *  every build, to compare the speed and frame hashes of the builds.
+ *
+ *  A recording starts from a machine state file saved when recording
+ *  started, at the beginning of a VDG field, and playback restores it
+ *  at the beginning of a field. The recording is kept in a RAM buffer
+ *  and written to a file when recording stops:
+ *
+ *    Header  'D32R', format version (2), event count (4)
+ *    Event   CPU cycle from the start (4), input source (1), value (1)
+ *
+ *  Fields are little endian. The keyboard and the reset button are logged
+ *  as a stream of events, the joystick inputs as level changes.
+ *  The function keys are not recorded, so they work the same in both modes.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+#include    <string.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+
+#include    "cpu.h"
+#include    "rpi.h"
+#include    "sched.h"
+#include    "loader.h"
+#include    "state.h"
+
+#include    "replay.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     REPLAY_MAGIC            "D32R"
+#define     REPLAY_VERSION          1
+#define     REPLAY_HEADER_SIZE      10
+#define     REPLAY_EVENT_SIZE       6
+#define     REPLAY_EVENTS           65536   // Events in the recording buffer
+#define     REPLAY_BUFFER_SIZE      (REPLAY_HEADER_SIZE + REPLAY_EVENTS * REPLAY_EVENT_SIZE)
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static uint32_t replay_time(void);
+static void     replay_append(replay_source_t source, int value);
+static int      replay_next(replay_source_t source, int index);
+static int      replay_is_due(int index);
+static void     replay_put32(uint8_t *buffer, uint32_t value);
+static uint32_t replay_get32(const uint8_t *buffer);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static replay_mode_t    mode = REPLAY_OFF;
+
+static uint8_t      replay_buffer[REPLAY_BUFFER_SIZE];
+static int          event_count;
+static int          replay_full;                    // Recording buffer is full
+static uint32_t     start_cycles;                   // Emulated cycle count at the start
+static uint32_t     start_time;                     // Host time at the start of playback
+static uint32_t     end_cycle;                      // CPU cycle of the end event
+
+static int          next_event[REPLAY_SOURCES];     // Playback, next event of each source
+static int          level[REPLAY_SOURCES];          // Last level of each level source, -1 before the first
+
+/*------------------------------------------------
+ * replay_init()
+ *
+ *  Initialize the input recorder and player, with
+ *  recording and playback stopped.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void replay_init(void)
+{
+    mode = REPLAY_OFF;
+    event_count = 0;
+    replay_full = 0;
+}
+
+/*------------------------------------------------
+ * replay_record_start()
+ *
+ *  Save the machine state and start recording input.
+ *  Call at the beginning of a VDG field.
+ *
+ *  param:  Nothing
+ *  return: 1- recording, 0- machine state could not be saved
+ */
+int replay_record_start(void)
+{
+    int     source;
+
+    replay_stop();
+
+    if ( !state_save(REPLAY_STATE_FILE_NAME) )
+    {
+        dbg_printf(0, "replay_record_start()[%d]: Recording not started.\n", __LINE__);
+        return 0;
+    }
+
+    for ( source = 0; source < REPLAY_SOURCES; source++ )
+        level[source] = -1;
+
+    event_count = 0;
+    replay_full = 0;
+    start_cycles = sched_get_cycles();
+    mode = REPLAY_RECORD;
+
+    dbg_printf(1, "Input recording started (F10 to stop).\n");
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * replay_play_start()
+ *
+ *  Read a recording, restore the machine state of its start
+ *  and start playback. Call at the beginning of a VDG field.
+ *
+ *  param:  Nothing
+ *  return: 1- playing, 0- no recording, or it could not be restored
+ */
+int replay_play_start(void)
+{
+    int     file_length, last;
+    int     source;
+
+    replay_stop();
+
+    if ( (file_length = loader_state_fread(REPLAY_FILE_NAME, replay_buffer, REPLAY_BUFFER_SIZE)) < 0 )
+    {
+        dbg_printf(0, "replay_play_start()[%d]: Recording %s not found.\n", __LINE__, REPLAY_FILE_NAME);
+        return 0;
+    }
+
+    if ( file_length < REPLAY_HEADER_SIZE || memcmp(replay_buffer, REPLAY_MAGIC, 4) != 0 ||
+         (replay_buffer[4] | (replay_buffer[5] << 8)) != REPLAY_VERSION )
+    {
+        dbg_printf(0, "replay_play_start()[%d]: Not a recording of this version.\n", __LINE__);
+        return 0;
+    }
+
+    event_count = (int) replay_get32(&replay_buffer[6]);
+    last = REPLAY_HEADER_SIZE + (event_count - 1) * REPLAY_EVENT_SIZE;
+
+    if ( event_count < 1 || event_count > REPLAY_EVENTS ||
+         file_length < (last + REPLAY_EVENT_SIZE) || replay_buffer[last + 4] != REPLAY_END )
+    {
+        dbg_printf(0, "replay_play_start()[%d]: Recording is damaged.\n", __LINE__);
+        event_count = 0;
+        return 0;
+    }
+
+    if ( !state_restore(REPLAY_STATE_FILE_NAME) )
+    {
+        dbg_printf(0, "replay_play_start()[%d]: Playback not started.\n", __LINE__);
+        event_count = 0;
+        return 0;
+    }
+
+    end_cycle = replay_get32(&replay_buffer[last]);
+
+    for ( source = 0; source < REPLAY_SOURCES; source++ )
+    {
+        level[source] = -1;
+        next_event[source] = replay_next(source, 0);
+    }
+
+    start_cycles = sched_get_cycles();
+    start_time = rpi_system_timer();
+    mode = REPLAY_PLAY;
+
+    dbg_printf(1, "Input playback started, %d events.\n", event_count);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * replay_stop()
+ *
+ *  Stop recording or playback. A recording is closed with an end event
+ *  and written to the recording file.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void replay_stop(void)
+{
+    uint32_t    cycles;
+
+    if ( mode == REPLAY_RECORD )
+    {
+        mode = REPLAY_OFF;
+
+        replay_append(REPLAY_END, 0);
+
+        memcpy(replay_buffer, REPLAY_MAGIC, 4);
+        replay_buffer[4] = (uint8_t) REPLAY_VERSION;
+        replay_buffer[5] = (uint8_t)(REPLAY_VERSION >> 8);
+        replay_put32(&replay_buffer[6], (uint32_t) event_count);
+
+        if ( !loader_state_fwrite(REPLAY_FILE_NAME, replay_buffer,
+                                  (uint32_t)(REPLAY_HEADER_SIZE + event_count * REPLAY_EVENT_SIZE)) )
+        {
+            dbg_printf(0, "replay_stop()[%d]: Recording file write failed.\n", __LINE__);
+            return;
+        }
+
+        dbg_printf(1, "Input recording stopped%s, %d events saved to %s.\n",
+                   (replay_full ? " (buffer full)" : ""), event_count, REPLAY_FILE_NAME);
+    }
+    else if ( mode == REPLAY_PLAY )
+    {
+        mode = REPLAY_OFF;
+
+        cycles = sched_get_cycles() - start_cycles;
+        dbg_printf(0, "Input playback ended, %u CPU cycles in %u mSec.\n",
+                   cycles, (rpi_system_timer() - start_time) / 1000);
+    }
+}
+
+/*------------------------------------------------
+ * replay_mode()
+ *
+ *  Return the recorder and player mode.
+ *
+ *  param:  Nothing
+ *  return: REPLAY_OFF, REPLAY_RECORD or REPLAY_PLAY
+ */
+replay_mode_t replay_mode(void)
+{
+    return mode;
+}
+
+/*------------------------------------------------
+ * replay_done()
+ *
+ *  Check if playback reached the end of the recording, or if the
+ *  recording buffer is full. The caller then stops with replay_stop().
+ *
+ *  param:  Nothing
+ *  return: 1- playback or recording should stop, 0- continue
+ */
+int replay_done(void)
+{
+    if ( mode == REPLAY_PLAY )
+        return ( (int32_t)(replay_time() - end_cycle) >= 0 );
+
+    if ( mode == REPLAY_RECORD )
+        return replay_full;
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * replay_event()
+ *
+ *  Record or replay an input that is read as a stream of events, such as
+ *  keyboard scan codes. While recording, a non-zero input is logged.
+ *  During playback, the live input is discarded and the next logged
+ *  input is returned once the emulation reached its CPU cycle.
+ *
+ *  param:  Input source, live input
+ *  return: Input, '0' for no event
+ */
+int replay_event(replay_source_t source, int value)
+{
+    if ( mode == REPLAY_OFF )
+        return value;
+
+    if ( mode == REPLAY_RECORD )
+    {
+        if ( value )
+            replay_append(source, value);
+        return value;
+    }
+
+    if ( !replay_is_due(next_event[source]) )
+        return 0;
+
+    value = replay_buffer[next_event[source] + 5];
+    next_event[source] = replay_next(source, next_event[source] + REPLAY_EVENT_SIZE);
+
+    return value;
+}
+
+/*------------------------------------------------
+ * replay_level()
+ *
+ *  Record or replay an input that is read as a level, such as a
+ *  joystick button. While recording, a level change is logged.
+ *  During playback, the live level is discarded and the logged level
+ *  of the emulation's CPU cycle is returned.
+ *
+ *  param:  Input source, live input level 0 to 255
+ *  return: Input level
+ */
+int replay_level(replay_source_t source, int value)
+{
+    if ( mode == REPLAY_OFF )
+        return value;
+
+    if ( mode == REPLAY_RECORD )
+    {
+        if ( value != level[source] )
+        {
+            level[source] = value;
+            replay_append(source, value);
+        }
+        return value;
+    }
+
+    while ( replay_is_due(next_event[source]) )
+    {
+        level[source] = replay_buffer[next_event[source] + 5];
+        next_event[source] = replay_next(source, next_event[source] + REPLAY_EVENT_SIZE);
+    }
+
+    if ( level[source] < 0 )
+        return value;
+
+    return level[source];
+}
+
+/*------------------------------------------------
+ * replay_time()
+ *
+ *  Return the emulated CPU cycle from the start of the recording
+ *  or the playback, up to the instruction being executed.
+ *
+ *  param:  Nothing
+ *  return: CPU cycles
+ */
+static uint32_t replay_time(void)
+{
+    return (sched_get_cycles() + cpu_batch_cycles() - start_cycles);
+}
+
+/*------------------------------------------------
+ * replay_append()
+ *
+ *  Add an event to the recording buffer. When the buffer is full,
+ *  one event is left for the end event.
+ *
+ *  param:  Input source, input value
+ *  return: Nothing
+ */
+static void replay_append(replay_source_t source, int value)
+{
+    uint8_t    *event;
+
+    if ( event_count >= (REPLAY_EVENTS - 1) && source != REPLAY_END )
+    {
+        replay_full = 1;
+        return;
+    }
+
+    event = &replay_buffer[REPLAY_HEADER_SIZE + event_count * REPLAY_EVENT_SIZE];
+
+    replay_put32(event, replay_time());
+    event[4] = (uint8_t) source;
+    event[5] = (uint8_t) value;
+
+    event_count++;
+}
+
+/*------------------------------------------------
+ * replay_next()
+ *
+ *  Find the next event of an input source in the recording buffer.
+ *
+ *  param:  Input source, buffer offset to search from
+ *  return: Buffer offset of the event, or -1 if there are no more events
+ */
+static int replay_next(replay_source_t source, int index)
+{
+    int     end;
+
+    if ( index < REPLAY_HEADER_SIZE )
+        index = REPLAY_HEADER_SIZE;
+
+    end = REPLAY_HEADER_SIZE + event_count * REPLAY_EVENT_SIZE;
+
+    for ( ; index < end; index += REPLAY_EVENT_SIZE )
+    {
+        if ( replay_buffer[index + 4] == source )
+            return index;
+    }
+
+    return -1;
+}
+
+/*------------------------------------------------
+ * replay_is_due()
+ *
+ *  Check if the emulation reached the CPU cycle of an event.
+ *
+ *  param:  Buffer offset of the event, or -1
+ *  return: 1- event is due, 0- event is not due or no event
+ */
+static int replay_is_due(int index)
+{
+    if ( index < 0 )
+        return 0;
+
+    return ( (int32_t)(replay_time() - replay_get32(&replay_buffer[index])) >= 0 );
+}
+
+/*------------------------------------------------
+ * replay_put32()
+ *
+ *  Store a 32 bit little endian value.
+ *
+ *  param:  Buffer, value
+ *  return: Nothing
+ */
+static void replay_put32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t) value;
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+}
+
+/*------------------------------------------------
+ * replay_get32()
+ *
+ *  Load a 32 bit little endian value.
+ *
+ *  param:  Buffer
+ *  return: Value
+ */
+static uint32_t replay_get32(const uint8_t *buffer)
+{
+    return ( (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8) |
+             ((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24) );
+}
@@ -38,6 +38,7 @@
 #include    <string.h>
 
 #include    "rpi-bm/mailbox.h"
+#include    "rpi-bm/mmu.h"
 
 /* -----------------------------------------
    Definitions
@@ -70,7 +71,7 @@ static int          property_index = 0;
  * but I don't like the fact that there is a buffer overrun risk.
  * TODO Find an elegant way to allocate space, or protect from overrun.
  */
-static uint32_t     pt[8192] __attribute__((aligned(16)));
+static uint32_t     pt[8192] __attribute__((aligned(64)));     // Cache line aligned, see bcm2835_mailbox_process()
 
 /*------------------------------------------------
  * bcm2835_mailbox0_write()
@@ -322,11 +323,18 @@ uint32_t *bcm2835_mailbox_process(void)
     pt[PT_OSIZE] = (property_index + 1) << 2;
     pt[PT_OREQUEST_OR_RESPONSE] = 0;
 
+    /* The VideoCore reads and writes the buffer in memory,
+     * past the ARM data cache
+     */
+    mmu_dcache_clean(pt, pt[PT_OSIZE]);
+
     if ( !bcm2835_mailbox0_write(MB0_TAGS_ARM_TO_VC, (uint32_t)pt) )
         return NULL;
 
     result = bcm2835_mailbox0_read(MB0_TAGS_ARM_TO_VC);
 
+    mmu_dcache_invalidate(pt, (property_index + 1) << 2);
+
     return (uint32_t*) result;
 }
 
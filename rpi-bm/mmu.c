@@ -0,0 +1,207 @@
+/*
+ * mmu.c
+ *
+ *  Module for the ARM MMU and L1 cache set up.
+ *  Memory is identity mapped with 1MB sections of a single first level
+ *  translation table. ARM RAM is normal write-back cached memory, the GPU
+ *  memory above it that holds the frame buffer is normal non-cached memory,
+ *  and the peripherals are device memory. Other addresses are not mapped.
+ *  Without the MMU the ARM1176 does not use its data cache at all.
+ *  On the RPi 2 and 3 the firmware's boot stub sets the SMP bit of each core,
+ *  so the shareable RAM is kept coherent between the cores.
+ *
+ *   Resources:
+ *      ARM1176JZF-S Technical Reference Manual, chapter 6 Memory Management Unit
+ *      ARM Architecture Reference Manual ARMv7-A, short-descriptor translation table format
+ *      https://www.raspberrypi.org/app/uploads/2012/02/BCM2835-ARM-Peripherals.pdf
+ *
+ */
+
+#include    "config.h"
+#include    "rpi-bm/bcm2835.h"
+#include    "rpi-bm/mmu.h"
+
+/* -----------------------------------------
+   Definitions
+----------------------------------------- */
+#define     SECTION_SIZE            0x00100000      // 1MB sections
+#define     SECTION_SHIFT           20
+#define     TABLE_ENTRIES           4096            // Sections in the 4GB address space
+#define     CACHE_LINE              32              // Smallest L1 data cache line of the RPi cores
+
+#define     PERIPHERAL_SIZE         0x01000000      // 16MB of peripheral registers
+
+/* Section descriptor fields
+ */
+#define     SECT_TYPE               0x00002         // Section descriptor
+#define     SECT_B                  0x00004
+#define     SECT_C                  0x00008
+#define     SECT_XN                 0x00010         // Execute never
+#define     SECT_AP_RW              0x00c00         // Full access, domain 0 is a client domain
+#define     SECT_TEX(t)             ((t) << 12)
+#define     SECT_S                  0x10000         // Shareable
+
+#define     SECT_NORMAL_WB          (SECT_TEX(1) | SECT_C | SECT_B)     // Normal, write-back write-allocate
+#define     SECT_NORMAL_NC          (SECT_TEX(1))                       // Normal, non-cached
+#define     SECT_DEVICE             (SECT_B | SECT_XN)                  // Shared device
+
+#if (RPI_MULTI_CORE==1)
+#define     SECT_RAM                (SECT_NORMAL_WB | SECT_S)           // Coherent between the cores
+#else
+#define     SECT_RAM                (SECT_NORMAL_WB)
+#endif
+
+/* System Control Register bits
+ */
+#define     SCTLR_MMU               0x00000001
+#define     SCTLR_DATA_CACHE        0x00000004
+#define     SCTLR_BRANCH_PREDICTION 0x00000800
+#define     SCTLR_INSTRUCTION_CACHE 0x00001000
+#define     SCTLR_UNALIGNED         0x00400000      // ARMv6 unaligned access support, always on in ARMv7
+#define     SCTLR_XP                0x00800000      // ARMv6 extended page tables, always on in ARMv7
+
+#define     DACR_DOMAIN0_CLIENT     0x00000001
+
+/* -----------------------------------------
+   Types and data structures
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static void mmu_map(uint32_t start, uint32_t end, uint32_t attributes);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static uint32_t     translation_table[TABLE_ENTRIES] __attribute__((aligned(16384)));
+
+/*------------------------------------------------
+ * mmu_init()
+ *
+ *  Build the identity mapped translation table and enable the
+ *  MMU and caches on core 0. Must be called before any other core is
+ *  started, and before the frame buffer is allocated.
+ *
+ * param:  ARM memory size in bytes, from the VideoCore TAG_ARM_MEMORY
+ * return: none
+ *
+ */
+void mmu_init(uint32_t arm_memory_size)
+{
+    int     i;
+
+    for ( i = 0; i < TABLE_ENTRIES; i++ )
+        translation_table[i] = 0;
+
+    mmu_map(0, arm_memory_size, SECT_RAM);
+    mmu_map(arm_memory_size, BCM2835_PERI_BASE, SECT_NORMAL_NC);
+    mmu_map(BCM2835_PERI_BASE, BCM2835_PERI_BASE + PERIPHERAL_SIZE, SECT_DEVICE);
+#if defined(RPI2) || defined(RPI3)
+    mmu_map(BCM2836_LOCAL_BASE, BCM2836_LOCAL_BASE + SECTION_SIZE, SECT_DEVICE);
+#endif
+
+    mmu_enable();
+}
+
+/*------------------------------------------------
+ * mmu_enable()
+ *
+ *  Enable the MMU with the translation table, and the L1 caches and branch
+ *  prediction, on the calling core. Secondary cores call it from start.S.
+ *  The table is walked without caching, so it does not need cache maintenance.
+ *
+ * param:  none
+ * return: none
+ *
+ */
+void mmu_enable(void)
+{
+    uint32_t    control;
+
+    /* Invalidate the caches and TLB, cores 1 to 3 of the RPi 2 and 3
+     * invalidate their data cache at reset.
+     */
+#if !defined(RPI2) && !defined(RPI3)
+    __asm__ __volatile__ ("mcr p15, 0, %0, c7, c6, 0" : : "r" (0) : "memory");     // Invalidate data cache
+#endif
+    __asm__ __volatile__ ("mcr p15, 0, %0, c7, c5, 0" : : "r" (0) : "memory");     // Invalidate instruction cache
+    __asm__ __volatile__ ("mcr p15, 0, %0, c8, c7, 0" : : "r" (0) : "memory");     // Invalidate TLB
+    dsb();
+
+    __asm__ __volatile__ ("mcr p15, 0, %0, c3, c0, 0" : : "r" (DACR_DOMAIN0_CLIENT) : "memory");
+    __asm__ __volatile__ ("mcr p15, 0, %0, c2, c0, 2" : : "r" (0) : "memory");     // TTBCR, TTBR0 only
+    __asm__ __volatile__ ("mcr p15, 0, %0, c2, c0, 0" : : "r" ((uint32_t) translation_table) : "memory");
+    isb();
+
+    __asm__ __volatile__ ("mrc p15, 0, %0, c1, c0, 0" : "=r" (control));
+    control |= (SCTLR_MMU | SCTLR_DATA_CACHE | SCTLR_BRANCH_PREDICTION | SCTLR_INSTRUCTION_CACHE);
+#if !defined(RPI2) && !defined(RPI3)
+    control |= (SCTLR_UNALIGNED | SCTLR_XP);
+#endif
+    __asm__ __volatile__ ("mcr p15, 0, %0, c1, c0, 0" : : "r" (control) : "memory");
+    isb();
+}
+
+/*------------------------------------------------
+ * mmu_dcache_clean()
+ *
+ *  Write back the data cache lines of a buffer, so that the VideoCore
+ *  reads the buffer's content from memory.
+ *
+ * param:  Buffer address and length in bytes
+ * return: none
+ *
+ */
+void mmu_dcache_clean(const void *address, uint32_t length)
+{
+    uint32_t    line, end;
+
+    end = (uint32_t) address + length;
+
+    for ( line = (uint32_t) address & ~(CACHE_LINE - 1); line < end; line += CACHE_LINE )
+        __asm__ __volatile__ ("mcr p15, 0, %0, c7, c10, 1" : : "r" (line) : "memory");
+
+    dsb();
+}
+
+/*------------------------------------------------
+ * mmu_dcache_invalidate()
+ *
+ *  Discard the data cache lines of a buffer, so that the next reads
+ *  get the content that the VideoCore wrote to memory.
+ *  The buffer should be aligned to, and a multiple of, 64 bytes
+ *  so that no other variable shares its first and last cache lines.
+ *
+ * param:  Buffer address and length in bytes
+ * return: none
+ *
+ */
+void mmu_dcache_invalidate(const void *address, uint32_t length)
+{
+    uint32_t    line, end;
+
+    end = (uint32_t) address + length;
+
+    for ( line = (uint32_t) address & ~(CACHE_LINE - 1); line < end; line += CACHE_LINE )
+        __asm__ __volatile__ ("mcr p15, 0, %0, c7, c6, 1" : : "r" (line) : "memory");
+
+    dsb();
+}
+
+/*------------------------------------------------
+ * mmu_map()
+ *
+ *  Identity map an address range in the translation table.
+ *
+ * param:  Range start and end addresses, section attributes
+ * return: none
+ *
+ */
+static void mmu_map(uint32_t start, uint32_t end, uint32_t attributes)
+{
+    uint32_t    section;
+
+    for ( section = (start >> SECTION_SHIFT); section < (end >> SECTION_SHIFT); section++ )
+        translation_table[section] = (section << SECTION_SHIFT) | SECT_AP_RW | attributes | SECT_TYPE;
+}
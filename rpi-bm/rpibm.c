@@ -17,7 +17,9 @@
 #include    "rpi-bm/spi0.h"
 #include    "rpi-bm/spi1.h"
 #include    "rpi-bm/mailbox.h"
+#include    "rpi-bm/mmu.h"
 #include    "rpi-bm/irq.h"
+#include    "config.h"
 #include    "dbgmsg.h"
 #include    "rpi.h"
 
@@ -29,6 +31,14 @@
 #define     TEST_POINT          RPI_V2_GPIO_P1_07
 #define     MOTOR_LED           RPI_V2_GPIO_P1_12
 
+/* After a reset the AVR is polled until it answers with an empty
+ * key code FIFO for a few reads in a row, instead of a fixed wait
+ */
+#define     AVR_BOOT_DELAY      100000          // Micro-seconds before the first poll
+#define     AVR_POLL_INTERVAL   10000           // Micro-seconds between polls
+#define     AVR_READY_READS     3               // Consecutive empty reads that signal ready
+#define     AVR_READY_TIMEOUT   3000000         // Micro-seconds, then continue anyway
+
 // Miscellaneous IO
 #define     EMULATOR_RESET      RPI_V2_GPIO_P1_29
 
@@ -50,23 +60,59 @@
 #define     DAC_BIT_MASK        ((1 << DAC_BIT0) | (1 << DAC_BIT1) | (1 << DAC_BIT2) | \
                                  (1 << DAC_BIT3) | (1 << DAC_BIT4) | (1 << DAC_BIT5))
 
+// System Timer compare 3 clients
+#define     SAMPLER_IDLE_USEC   1000000             // Compare interval when no client is due
+
+// Secondary cores
+#define     CORE_STACK_SIZE     (16*1024)           // Stack bytes of each secondary core
+
+// Frame buffer
+#define     FB_PAGES            2                   // Display pages for page flipping
+
 typedef struct
     {
         int yoffset;    // Current offset into virtual buffer
         int pitch;      // Bytes per display line
         int xres;       // X pixels
         int yres;       // Y pixels
+        int pages;      // Display pages in virtual buffer, 2 for page flipping
     } var_info_t;
 
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
+static void         audio_timer_isr(void);
+static void         sampler_timer_start(void);
+static void         sampler_timer_isr(void);
+static int          avr_wait_ready(void);
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
 static uint8_t      motor_led_ctrl = 0;     // Holds the source and state of LED
 static var_info_t   var_info;
+static uint8_t     *fb_base = 0L;          // Frame buffer pages
+static int        (*audio_source)(void) = 0;// Audio sample source
+static uint32_t     audio_period = 0;       // Audio sample period in micro-seconds
+static uint32_t   (*joystk_step)(void) = 0; // Joystick sampler step
+static uint32_t     joystk_due = 0;         // System Timer time of the next joystick step
+static uint32_t   (*keyboard_step)(void) = 0;// Keyboard reader step
+static uint32_t     keyboard_due = 0;       // System Timer time of the next keyboard step
+static int          sampler_timer_on = 0;
+static int          tick_on = 0;
+static uint32_t     tick_due = 0;           // System Timer time of the next host tick
+
+volatile uint32_t   rpi_tick_count = 0;     // Host ticks, RPI_TICK_USEC each
+
+#if (RPI_MULTI_CORE==1)
+/* Secondary core start up, read by secondary_start in start.S
+ */
+extern void         secondary_start(void);
+
+uint32_t            core_stack_top[BCM2836_CORES];
+void              (*core_entry[BCM2836_CORES])(void);
+static uint8_t      core_stack[BCM2836_CORES][CORE_STACK_SIZE] __attribute__((aligned(8)));
+#endif
 
 /* Palette for 8-bpp color depth.
  * The palette is in BGR format, and 'set pixel order' does not affect
@@ -108,6 +154,25 @@ static uint32_t     palette_bgr[] =
  */
 int rpi_gpio_init(void)
 {
+    mailbox_tag_property_t *mp;
+
+    /* Map the ARM memory as cached with the MMU, the data cache
+     * has no effect without it.
+     */
+    bcm2835_mailbox_init();
+    bcm2835_mailbox_add_tag(TAG_ARM_MEMORY);
+    if ( bcm2835_mailbox_process() &&
+         (mp = bcm2835_mailbox_get_property(TAG_ARM_MEMORY)) != 0L )
+    {
+        mmu_init(mp->values.memory.size);
+    }
+
+    /* Interrupt vectors for the SD card's SPI1 transfer interrupt.
+     * The interrupt controller only passes device interrupts that drivers enable.
+     */
+    irq_init();
+    enable();
+
     /* Initialize auxiliary UART for console output.
      * Safe to continue with system bring-up even if UART failed.
      */
@@ -129,7 +194,7 @@ int rpi_gpio_init(void)
     bcm2835_gpio_set(AVR_RESET);
 
     rpi_keyboard_reset();
-    bcm2835_st_delay(3000000);
+    avr_wait_ready();
 
     /* Initialize GPIO for RPi test point and motor-LED
      */
@@ -186,7 +251,7 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
     bcm2835_mailbox_init();
     bcm2835_mailbox_add_tag(TAG_FB_ALLOCATE, 4);
     bcm2835_mailbox_add_tag(TAG_FB_SET_PHYS_DISPLAY, x_pix, y_pix);
-    bcm2835_mailbox_add_tag(TAG_FB_SET_VIRT_DISPLAY, x_pix, y_pix);
+    bcm2835_mailbox_add_tag(TAG_FB_SET_VIRT_DISPLAY, x_pix, FB_PAGES * y_pix);
     bcm2835_mailbox_add_tag(TAG_FB_SET_DEPTH, 8);
     bcm2835_mailbox_add_tag(TAG_FB_SET_PALETTE, 0, 16, (uint32_t)palette_bgr);
     bcm2835_mailbox_add_tag(TAG_FB_GET_PITCH);
@@ -202,7 +267,7 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
     if ( mp )
     {
         screen_size = mp->values.fb_alloc.param2;
-        fbp = (uint8_t*)(mp->values.fb_alloc.param1);
+        fbp = (uint8_t*)(mp->values.fb_alloc.param1 & 0x3fffffff);     // VideoCore bus address to ARM address
     }
     else
     {
@@ -237,13 +302,74 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
         return 0;
     }
 
+    /* Use page flipping only if the second page was allocated
+     */
+    var_info.pages = 1;
+    mp = bcm2835_mailbox_get_property(TAG_FB_SET_VIRT_DISPLAY);
+    if ( mp &&
+         mp->values.fb_set.param2 >= (FB_PAGES * y_pix) &&
+         screen_size >= (FB_PAGES * y_pix * var_info.pitch) )
+    {
+        var_info.pages = FB_PAGES;
+    }
+
+    fb_base = fbp;
+
     dbg_printf(2, "Frame buffer device is open:\n");
-    dbg_printf(2, "  x_pix=%d, y_pix=%d, screen_size=%d, page_size=%d\n",
-                       x_pix, y_pix, screen_size, page_size);
+    dbg_printf(2, "  x_pix=%d, y_pix=%d, screen_size=%d, page_size=%d, pages=%d\n",
+                       x_pix, y_pix, screen_size, page_size, var_info.pages);
 
     return fbp;
 }
 
+/********************************************************************
+ * rpi_fb_flip()
+ *
+ *  Copy a complete frame from an off-screen buffer to the frame buffer
+ *  in one sequential pass. If the frame buffer has two pages, the frame is
+ *  copied to the hidden page and the display virtual offset is then set to it.
+ *
+ *  param:  Off-screen frame buffer
+ *  return: None
+ */
+void rpi_fb_flip(const uint8_t *buffer)
+{
+    int         line, back_page;
+    uint8_t    *dest;
+
+    if ( fb_base == 0L )
+        return;
+
+    back_page = 0;
+    if ( var_info.pages == FB_PAGES && var_info.yoffset == 0 )
+        back_page = var_info.yres;
+
+    dest = fb_base + back_page * var_info.pitch;
+
+    for ( line = 0; line < var_info.yres; line++ )
+    {
+        memcpy(dest, buffer, var_info.xres);
+        dest += var_info.pitch;
+        buffer += var_info.xres;
+    }
+
+    if ( var_info.pages == FB_PAGES )
+    {
+        bcm2835_mailbox_init();
+        bcm2835_mailbox_add_tag(TAG_FB_SET_VIRT_OFFSET, 0, back_page);
+        if ( bcm2835_mailbox_process() )
+        {
+            var_info.yoffset = back_page;
+        }
+        else
+        {
+            dbg_printf(1, "rpi_fb_flip(): TAG_FB_SET_VIRT_OFFSET failed, using one page.\n");
+            var_info.pages = 1;
+            var_info.yoffset = 0;
+        }
+    }
+}
+
 /********************************************************************
  * rpi_fb_resolution()
  *
@@ -306,6 +432,24 @@ void rpi_keyboard_reset(void)
     bcm2835_gpio_set(AVR_RESET);
 }
 
+/*------------------------------------------------
+ * rpi_keyboard_start()
+ *
+ *  Start the keyboard reader. The System Timer compare 3 interrupt,
+ *  shared with the joystick sampler, calls the reader step function,
+ *  and runs the next step after the micro-seconds it returns.
+ *
+ *  param:  Reader step function
+ *  return: None
+ */
+void rpi_keyboard_start(uint32_t (*poll_step)(void))
+{
+    keyboard_due = bcm2835_st_read();
+    keyboard_step = poll_step;
+
+    sampler_timer_start();
+}
+
 /*------------------------------------------------
  * rpi_joystk_comp()
  *
@@ -335,6 +479,21 @@ int rpi_joystk_comp(void)
     return (int) bcm2835_gpio_lev(JOYSTK_COMP);
 }
 
+/*------------------------------------------------
+ * rpi_joystk_comp_settled()
+ *
+ *  Read joystick comparator GPIO input pin and return its value,
+ *  without waiting for the DAC and comparator to settle.
+ *  For callers that allowed the settling time between the DAC write and this read.
+ *
+ *  param:  None
+ *  return: GPIO joystick comparator input level
+ */
+int rpi_joystk_comp_settled(void)
+{
+    return (int) bcm2835_gpio_lev(JOYSTK_COMP);
+}
+
 /*------------------------------------------------
  * rpi_rjoystk_button()
  *
@@ -365,6 +524,8 @@ int rpi_reset_button(void)
  * rpi_audio_mux_set()
  *
  *  Set GPIO to select analog multiplexer output.
+ *  The comparator read and the joystick sampler allow the multiplexer
+ *  to settle together with the DAC.
  *
  *  param:  Multiplexer select bit field: b.1=PIA1-CB2, b.0=PIA0-CA2
  *  return: None
@@ -376,7 +537,6 @@ void rpi_audio_mux_set(int select)
     if ( select != previous_select )
     {
         bcm2835_gpio_write_mask((uint32_t)select << AUDIO_MUX0, (uint32_t) AUDIO_MUX_MASK);
-        bcm2835_crude_delay(20);    // TODO check if this is needed to reduce value noise
         previous_select = select;
     }
 }
@@ -404,6 +564,77 @@ void rpi_write_dac(int dac_value)
     bcm2835_gpio_write_mask(dac_bit_values, (uint32_t) DAC_BIT_MASK);
 }
 
+/*------------------------------------------------
+ * rpi_audio_start()
+ *
+ *  Start the audio sample timer. The System Timer compare 1 interrupt
+ *  takes a sample from the sample source at a fixed rate and writes
+ *  it to the DAC. A negative sample leaves the DAC as it is.
+ *
+ *  param:  Sample rate in Hz, sample source function
+ *  return: None
+ */
+void rpi_audio_start(int sample_rate, int (*sample_source)(void))
+{
+    audio_source = sample_source;
+    audio_period = 1000000 / sample_rate;
+
+    irq_register_handler(IRQ_SYSTEM_TIMER1, audio_timer_isr);
+    bcm2835_st_set_compare(ST_COMPARE1, audio_period);
+    irq_enable(IRQ_SYSTEM_TIMER1);
+}
+
+/*------------------------------------------------
+ * rpi_tick_start()
+ *
+ *  Start the host tick. The System Timer compare 3 interrupt, shared with
+ *  the joystick sampler and keyboard reader, counts 'rpi_tick_count' every
+ *  RPI_TICK_USEC, so the emulation loop can keep host time by reading
+ *  one word in memory instead of the System Timer register.
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_tick_start(void)
+{
+    tick_due = bcm2835_st_read() + RPI_TICK_USEC;
+    tick_on = 1;
+
+    sampler_timer_start();
+}
+
+/*------------------------------------------------
+ * rpi_tick_wait()
+ *
+ *  Wait for the next interrupt, the host tick or any other,
+ *  with the core in low power state.
+ *
+ *  param:  None
+ *  return: None
+ */
+void rpi_tick_wait(void)
+{
+    __asm__ __volatile__ ("wfi" ::: "memory");
+}
+
+/*------------------------------------------------
+ * rpi_joystk_start()
+ *
+ *  Start the joystick sampler. The System Timer compare 3 interrupt
+ *  calls the sampler step function, and runs the next step
+ *  after the micro-seconds it returns.
+ *
+ *  param:  Sampler step function
+ *  return: None
+ */
+void rpi_joystk_start(uint32_t (*sample_step)(void))
+{
+    joystk_due = bcm2835_st_read();
+    joystk_step = sample_step;
+
+    sampler_timer_start();
+}
+
 /*------------------------------------------------
  * rpi_disable()
  *
@@ -487,6 +718,40 @@ void rpi_testpoint_off(void)
     bcm2835_gpio_clr(TEST_POINT);
 }
 
+/*------------------------------------------------
+ * rpi_core_start()
+ *
+ *  Start a secondary core of the RPi 2 or 3 running a function.
+ *  The core is released from the firmware's mailbox spin loop, and runs
+ *  the function on its own stack with interrupts disabled.
+ *  Shared data is exchanged with the core through rings that are
+ *  ordered with memory barriers.
+ *
+ *  param:  Core number 1 to 3, function that should not return
+ *  return: 0 core started, -1 no such core or already started
+ */
+int rpi_core_start(int core, void (*entry)(void))
+{
+#if (RPI_MULTI_CORE==1)
+    if ( core < 1 || core >= BCM2836_CORES || core_entry[core] )
+        return -1;
+
+    core_entry[core] = entry;
+    core_stack_top[core] = (uint32_t) &core_stack[core][CORE_STACK_SIZE];
+
+    dsb();
+
+    *((volatile uint32_t *) BCM2836_CORE_MBOX3_SET(core)) = (uint32_t) secondary_start;
+    __asm__ __volatile__ ("sev");
+
+    dbg_printf(2, "rpi_core_start(): Core %d started\n", core);
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
 /********************************************************************
  * rpi_halt()
  *
@@ -521,3 +786,136 @@ void _putchar(char character)
         bcm2835_auxuart_putchr('\r');
     bcm2835_auxuart_putchr(character);
 }
+
+/*------------------------------------------------
+ * audio_timer_isr()
+ *
+ *  System Timer compare 1 interrupt handler.
+ *  Sets the next sample time and writes the sample source's output to the DAC.
+ *
+ *  param:  none
+ *  return: none
+ */
+static void audio_timer_isr(void)
+{
+    int     sample;
+
+    bcm2835_st_clr_compare_match(ST_COMPARE1);
+    bcm2835_st_set_compare(ST_COMPARE1, audio_period);
+
+    sample = audio_source();
+    if ( sample >= 0 )
+        rpi_write_dac(sample);
+}
+
+/*------------------------------------------------
+ * sampler_timer_start()
+ *
+ *  Enable the System Timer compare 3 interrupt
+ *  that runs the host tick, joystick sampler and keyboard reader steps.
+ *
+ *  param:  none
+ *  return: none
+ */
+static void sampler_timer_start(void)
+{
+    if ( sampler_timer_on )
+        return;
+
+    sampler_timer_on = 1;
+
+    irq_register_handler(IRQ_SYSTEM_TIMER3, sampler_timer_isr);
+    bcm2835_st_set_compare(ST_COMPARE3, 1);
+    irq_enable(IRQ_SYSTEM_TIMER3);
+}
+
+/*------------------------------------------------
+ * sampler_timer_isr()
+ *
+ *  System Timer compare 3 interrupt handler.
+ *  Counts the host ticks and runs the joystick sampler and keyboard reader
+ *  steps that are due, and sets the compare to the earliest next due time.
+ *  Ticks missed while interrupts were disabled are counted, so tick time
+ *  does not fall behind the System Timer.
+ *
+ *  param:  none
+ *  return: none
+ */
+static void sampler_timer_isr(void)
+{
+    uint32_t    now, next_due;
+    int32_t     interval;
+
+    bcm2835_st_clr_compare_match(ST_COMPARE3);
+
+    now = bcm2835_st_read();
+
+    if ( tick_on )
+    {
+        while ( (int32_t)(now - tick_due) >= 0 )
+        {
+            rpi_tick_count++;
+            tick_due += RPI_TICK_USEC;
+        }
+    }
+
+    if ( joystk_step && (int32_t)(now - joystk_due) >= 0 )
+        joystk_due = now + joystk_step();
+
+    if ( keyboard_step && (int32_t)(now - keyboard_due) >= 0 )
+        keyboard_due = now + keyboard_step();
+
+    next_due = now + SAMPLER_IDLE_USEC;
+    if ( tick_on && (int32_t)(tick_due - next_due) < 0 )
+        next_due = tick_due;
+    if ( joystk_step && (int32_t)(joystk_due - next_due) < 0 )
+        next_due = joystk_due;
+    if ( keyboard_step && (int32_t)(keyboard_due - next_due) < 0 )
+        next_due = keyboard_due;
+
+    interval = (int32_t)(next_due - bcm2835_st_read());
+    if ( interval <= 0 )
+        interval = 1;
+
+    bcm2835_st_set_compare(ST_COMPARE3, (uint32_t) interval);
+}
+
+/*------------------------------------------------
+ * avr_wait_ready()
+ *
+ *  Wait for the AVR (PS2 keyboard controller) to start after a reset.
+ *  The AVR answers a read with a '0' when its key code FIFO is empty,
+ *  so it is ready when a few reads in a row return '0'.
+ *  Key codes read while waiting are dropped.
+ *
+ *  param:  None
+ *  return: 1 AVR ready, 0 timed out
+ */
+static int avr_wait_ready(void)
+{
+    int     elapsed, empty_reads;
+
+    bcm2835_st_delay(AVR_BOOT_DELAY);
+
+    empty_reads = 0;
+
+    for ( elapsed = AVR_BOOT_DELAY; elapsed < AVR_READY_TIMEOUT; elapsed += AVR_POLL_INTERVAL )
+    {
+        if ( rpi_keyboard_read() == 0 )
+            empty_reads++;
+        else
+            empty_reads = 0;
+
+        if ( empty_reads == AVR_READY_READS )
+        {
+            dbg_printf(2, "avr_wait_ready(): AVR ready after %d mSec.\n", elapsed / 1000);
+            return 1;
+        }
+
+        bcm2835_st_delay(AVR_POLL_INTERVAL);
+    }
+
+    dbg_printf(1, "avr_wait_ready(): AVR did not answer, continuing.\n");
+
+    return 0;
+}
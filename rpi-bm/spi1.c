@@ -5,13 +5,16 @@
  *  The SPI1 interface is available on RPi Zero 40-pin
  *  header and SPI2 is not available on the RPi header pins.
  *
- *  TODO Provide an option to configure interrupts.
  *  Default configuration:
  *  - Only CE2 is enabled on header P1 pin 36
  *  - Default clock rate 128KHZ
  *  - SPI Mode-0
  *  - MSB first
  *
+ *  With the SPI1_ENA_TX_IRQ option, bcm2835_spi1_transfer_irq() moves a buffer
+ *  through the FIFOs from the AUX interrupt, and calls a completion callback.
+ *  The AUX SPI has no DMA request lines, so this is the non-blocking transfer path.
+ *
  *   Resources:
  *      https://www.raspberrypi.org/app/uploads/2012/02/BCM2835-ARM-Peripherals.pdf
  *      http://en.wikipedia.org/wiki/Serial_Peripheral_Interface_Bus
@@ -20,6 +23,7 @@
 
 #include    "rpi-bm/gpio.h"
 #include    "rpi-bm/spi1.h"
+#include    "rpi-bm/irq.h"
 
 /* -----------------------------------------
    Definitions
@@ -30,6 +34,7 @@
 #define     AUX_ENABLE                  0x0004
 
 #define     AUX_ENABLE_SPI1             0x00000002
+#define     AUX_IRQ_SPI1                0x00000002
 
 #define     AUX_SPI_CNTL0               0x0000
 #define     AUX_SPI_CNTL1               0x0004
@@ -65,6 +70,7 @@
 #define     AUX_SPI_CNTL1_IDLE          0x00000080
 #define     AUX_SPI_CNTL1_TXEMPTY       0x00000040
 #define     AUX_SPI_CNTL1_MSBF_IN       0x00000002
+#define     AUX_SPI_CNTL1_IRQS          (AUX_SPI_CNTL1_IDLE | AUX_SPI_CNTL1_TXEMPTY)
 #define     AUX_SPI_CNTL1_KEEP_IN       0x00000001
 
 #define     AUX_SPI_STAT_TX_LVL         0xF0000000
@@ -82,10 +88,21 @@
 /* -----------------------------------------
    Types and data structures
 ----------------------------------------- */
+struct irq_transfer_t
+{
+    uint8_t            *tx_buf;
+    uint8_t            *rx_buf;
+    uint32_t            count;
+    uint32_t            tx_count;
+    uint32_t            rx_count;
+    void              (*callback)(void);
+    volatile int        busy;
+};
 
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
+static void bcm2835_spi1_isr(void);
 
 /* -----------------------------------------
    Module globals
@@ -93,6 +110,9 @@
 static auxiliary_peripherals_regs_t *pAux = (auxiliary_peripherals_regs_t*)BCM2835_AUX_BASE;
 static auxiliary_spi1_regs_t        *pSPI = (auxiliary_spi1_regs_t*)BCM2835_AUX_SPI1;
 
+static int                   irq_enabled = 0;
+static struct irq_transfer_t irq_transfer;
+
 /*------------------------------------------------
  * bcm2835_spi1_init()
  *
@@ -147,6 +167,22 @@ int bcm2835_spi1_init(uint32_t configuration)
     pSPI->aux_spi1_cntl0_reg = spi_config0;
     pSPI->aux_spi1_cntl1_reg = spi_config1;
 
+    /* Configure transfer interrupts if required.
+     * Device interrupts are only enabled while a transfer is in progress.
+     */
+    if ( (configuration & SPI1_ENA_TX_IRQ) && !irq_enabled )
+    {
+        irq_transfer.busy = 0;
+
+        irq_register_handler(IRQ_AUX_SERDEV, bcm2835_spi1_isr);
+
+        dmb();
+
+        irq_enable(IRQ_AUX_SERDEV);
+
+        irq_enabled = 1;
+    }
+
     return 1;
 }
 
@@ -170,6 +206,8 @@ void bcm2835_spi1_close(void)
     bcm2835_gpio_fsel(RPI_V2_GPIO_P1_11, BCM2835_GPIO_FSEL_INPT);  // CE1
     bcm2835_gpio_fsel(RPI_V2_GPIO_P1_12, BCM2835_GPIO_FSEL_INPT);  // CE0
 */
+    while ( irq_transfer.busy );
+
     dmb();
 
     pAux->aux_enables &= ~AUX_ENABLE_SPI1;
@@ -233,6 +271,10 @@ void bcm2835_spi1_transfer_Ex(uint8_t *tx_buf, uint8_t *rx_buf, uint32_t count)
     uint32_t rx_count = 0;
     uint8_t  byte;
 
+    /* Wait for an interrupt driven transfer to complete
+     */
+    while ( irq_transfer.busy );
+
     pSPI->aux_spi1_cntl0_reg |= AUX_SPI_CNTL0_CLEARFIFO;
 
     dmb();
@@ -268,6 +310,131 @@ void bcm2835_spi1_transfer_Ex(uint8_t *tx_buf, uint8_t *rx_buf, uint32_t count)
     }
 }
 
+/*------------------------------------------------
+ * bcm2835_spi1_transfer_irq()
+ *
+ *  Start an interrupt driven transfer of one or more bytes to and from
+ *  the currently selected SPI device, and return without waiting for it.
+ *  The AUX interrupt refills the transmit FIFO and drains the receive FIFO,
+ *  and calls 'callback' in interrupt context when the last byte was received.
+ *  Buffers must remain valid until the transfer completes.
+ *  If rx_buf != NULL returns the read data byte(s) from the device.
+ *  Requires the SPI1_ENA_TX_IRQ configuration option.
+ *
+ * param:  Transmit data buffer, receive data buffer, byte count
+ *         and completion callback (or NULL)
+ * return: 1- if transfer started, 0- otherwise
+ *
+ */
+int bcm2835_spi1_transfer_irq(uint8_t *tx_buf, uint8_t *rx_buf, uint32_t count, void (*callback)(void))
+{
+    if ( !irq_enabled || count == 0 )
+        return 0;
+
+    while ( irq_transfer.busy );
+
+    irq_transfer.tx_buf = tx_buf;
+    irq_transfer.rx_buf = rx_buf;
+    irq_transfer.count = count;
+    irq_transfer.tx_count = 0;
+    irq_transfer.rx_count = 0;
+    irq_transfer.callback = callback;
+    irq_transfer.busy = 1;
+
+    pSPI->aux_spi1_cntl0_reg |= AUX_SPI_CNTL0_CLEARFIFO;
+
+    dmb();
+
+    pSPI->aux_spi1_cntl0_reg &= ~AUX_SPI_CNTL0_CLEARFIFO;
+
+    /* Prime the transmit FIFO, the interrupt handler moves the rest
+     */
+    while ( !(pSPI->aux_spi1_stat_reg & AUX_SPI_STAT_TX_FULL) && (irq_transfer.tx_count < count) )
+    {
+        dmb();
+        pSPI->aux_spi1_io_reg = tx_buf[irq_transfer.tx_count] << 24;
+        irq_transfer.tx_count++;
+    }
+
+    dmb();
+
+    pSPI->aux_spi1_cntl1_reg |= AUX_SPI_CNTL1_IRQS;
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * bcm2835_spi1_is_busy()
+ *
+ *  Check for an interrupt driven transfer in progress.
+ *
+ * param:  none
+ * return: 1- if a transfer is in progress, 0- otherwise
+ *
+ */
+int bcm2835_spi1_is_busy(void)
+{
+    return irq_transfer.busy;
+}
+
+/*------------------------------------------------
+ * bcm2835_spi1_isr()
+ *
+ *  SPI1 transfer interrupt handler.
+ *  Drains the receive FIFO and refills the transmit FIFO,
+ *  and ends the transfer when all bytes were received.
+ *
+ * param:  none
+ * return: none
+ *
+ */
+static void bcm2835_spi1_isr(void)
+{
+    uint8_t     byte;
+
+    dmb();
+
+    if ( !(pAux->aux_irq & AUX_IRQ_SPI1) || !irq_transfer.busy )
+        return;
+
+    while ( !(pSPI->aux_spi1_stat_reg & AUX_SPI_STAT_RX_EMPTY) && (irq_transfer.rx_count < irq_transfer.count) )
+    {
+        dmb();
+        byte = pSPI->aux_spi1_io_reg;
+        if ( irq_transfer.rx_buf )
+        {
+            irq_transfer.rx_buf[irq_transfer.rx_count] = byte;
+        }
+        irq_transfer.rx_count++;
+    }
+
+    while ( !(pSPI->aux_spi1_stat_reg & AUX_SPI_STAT_TX_FULL) && (irq_transfer.tx_count < irq_transfer.count) )
+    {
+        dmb();
+        pSPI->aux_spi1_io_reg = irq_transfer.tx_buf[irq_transfer.tx_count] << 24;
+        irq_transfer.tx_count++;
+    }
+
+    if ( irq_transfer.rx_count == irq_transfer.count )
+    {
+        pSPI->aux_spi1_cntl1_reg &= ~AUX_SPI_CNTL1_IRQS;
+
+        /* The transfer stays busy until the callback returns, so that
+         * code on another core does not start the next transfer first
+         */
+        if ( irq_transfer.callback )
+        {
+            irq_transfer.callback();
+        }
+
+        dmb();
+
+        irq_transfer.busy = 0;
+    }
+
+    dmb();
+}
+
 /*------------------------------------------------
  * bcm2835_spi1_send_byte()
  *
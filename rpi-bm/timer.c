@@ -7,7 +7,8 @@
  *   Resources:
  *      https://www.raspberrypi.org/app/uploads/2012/02/BCM2835-ARM-Peripherals.pdf
  *
- *  TODO Add option for timer interrupts
+ *  Compare 1 and compare 3 interrupts are handled in rpibm.c, for the audio
+ *  sample timer and for the host tick, joystick sampler and keyboard reader.
  */
 
 #include    "rpi-bm/bcm2835.h"
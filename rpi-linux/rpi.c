@@ -9,13 +9,17 @@
  *******************************************************************/
 
 #include    <stdio.h>
+#include    <stdlib.h>
+#include    <signal.h>
 #include    <time.h>
+#include    <pthread.h>
 #include    <assert.h>
 #include    <fcntl.h>
 #include    <linux/fb.h>
 #include    <linux/kd.h>
 #include    <sys/mman.h>
 #include    <sys/ioctl.h>
+#include    <sys/syscall.h>
 
 #include    <unistd.h>
 #include    <string.h>
@@ -32,6 +36,14 @@
 #define     TEST_POINT          RPI_V2_GPIO_P1_07
 #define     MOTOR_LED           RPI_V2_GPIO_P1_12
 
+/* After a reset the AVR is polled until it answers with an empty
+ * key code FIFO for a few reads in a row, instead of a fixed wait
+ */
+#define     AVR_BOOT_DELAY      100000          // Micro-seconds before the first poll
+#define     AVR_POLL_INTERVAL   10000           // Micro-seconds between polls
+#define     AVR_READY_READS     3               // Consecutive empty reads that signal ready
+#define     AVR_READY_TIMEOUT   3000000         // Micro-seconds, then continue anyway
+
 // Miscellaneous IO
 #define     EMULATOR_RESET      RPI_V2_GPIO_P1_29
 
@@ -53,17 +65,64 @@
 #define     DAC_BIT_MASK        ((1 << DAC_BIT0) | (1 << DAC_BIT1) | (1 << DAC_BIT2) | \
                                  (1 << DAC_BIT3) | (1 << DAC_BIT4) | (1 << DAC_BIT5))
 
+// Frame buffer
+#define     FB_PAGES            2               // Display pages for page flipping
+#define     FB_SNAPSHOT_NAME    "frame%06d.ppm" // PPM snapshot file name by frame number
+#define     FB_PALETTE_COLORS   16
+
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
 static uint8_t  *fb_set_resolution(int fbh, int x_pix, int y_pix);
 static int       fb_set_tty(const int mode);
+static void      fb_frame_output(const uint8_t *buffer);
+static int       fb_write_ppm(const char *file_name, const uint8_t *buffer);
+static void      fb_snapshot_signal(int sig);
+static void     *audio_thread(void *arg);
+static void     *joystk_thread(void *arg);
+static void     *keyboard_thread(void *arg);
+static int       avr_wait_ready(void);
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
 static int      fbfd = 0;                       // frame buffer file descriptor
+static uint8_t *fb_base = 0L;                   // Mapped frame buffer pages
+static int      fb_pitch = 0;                   // Bytes per display line
+static int      fb_pages = 1;                   // Display pages, 2 for page flipping
+static struct fb_var_screeninfo var_info;
+static int      fb_headless = 0;                // Render to a memory buffer instead of /dev/fb0
+static int      fb_frame_hash = 0;              // Print a hash of every frame
+static int      fb_snapshot_interval = 0;       // Frames between PPM snapshots, 0=none
+static int      fb_frame_count = 0;
+static volatile sig_atomic_t fb_snapshot_request = 0;
+
+/* RGB values of the Linux console 16 color palette,
+ * that the frame buffer color indexes select
+ */
+static const uint8_t fb_palette[FB_PALETTE_COLORS][3] = {
+    { 0x00, 0x00, 0x00 },   // Black
+    { 0x00, 0x00, 0xaa },   // Blue
+    { 0x00, 0xaa, 0x00 },   // Green
+    { 0x00, 0xaa, 0xaa },   // Cyan
+    { 0xaa, 0x00, 0x00 },   // Red
+    { 0xaa, 0x00, 0xaa },   // Magenta
+    { 0xaa, 0x55, 0x00 },   // Brown
+    { 0xaa, 0xaa, 0xaa },   // Gray
+    { 0x55, 0x55, 0x55 },   // Dark gray
+    { 0x55, 0x55, 0xff },   // Light blue
+    { 0x55, 0xff, 0x55 },   // Light green
+    { 0x55, 0xff, 0xff },   // Light cyan
+    { 0xff, 0x55, 0x55 },   // Light red
+    { 0xff, 0x55, 0xff },   // Light magenta
+    { 0xff, 0xff, 0x55 },   // Yellow
+    { 0xff, 0xff, 0xff },   // White
+};
 static uint8_t  motor_led_ctrl = 0;             // Holds the source and state of LED
+static int    (*audio_source)(void) = 0;        // Audio sample source
+static long     audio_period_nsec = 0;          // Audio sample period
+static uint32_t (*joystk_step)(void) = 0;       // Joystick sampler step
+static uint32_t (*keyboard_step)(void) = 0;     // Keyboard reader step
 
 /*------------------------------------------------
  * rpi_gpio_init()
@@ -98,7 +157,7 @@ int rpi_gpio_init(void)
     bcm2835_gpio_write(AVR_RESET, HIGH);
 
     rpi_keyboard_reset();
-    sleep(3);
+    avr_wait_ready();
 
     /* Initialize GPIO for RPi test point and motor-LED
      */
@@ -142,10 +201,31 @@ int rpi_gpio_init(void)
     return 0;
 }
 
+/********************************************************************
+ * rpi_fb_output()
+ *
+ *  Select the frame buffer output options, before rpi_fb_init().
+ *  Headless output renders into a memory buffer, so video works without /dev/fb0.
+ *  Frame hashes and PPM snapshots work with either output.
+ *  A snapshot of the next frame can also be requested with a SIGUSR1 signal.
+ *
+ *  param:  Headless output, print frame hashes, frames between snapshots or 0
+ *  return: None
+ */
+void rpi_fb_output(int headless, int frame_hash, int snapshot_interval)
+{
+    fb_headless = headless;
+    fb_frame_hash = frame_hash;
+    fb_snapshot_interval = snapshot_interval;
+
+    signal(SIGUSR1, fb_snapshot_signal);
+}
+
 /********************************************************************
  * rpi_fb_init()
  *
- *  Initialize the RPi frame buffer device.
+ *  Initialize the RPi frame buffer device,
+ *  or a memory buffer for headless output.
  *
  *  param:  None
  *  return: Pointer to frame buffer, or 0 if error,
@@ -154,6 +234,26 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
 {
     uint8_t *fbp = 0;
 
+    if ( fb_headless )
+    {
+        if ( fb_base == 0L && (fb_base = malloc(x_pix * y_pix)) == 0L )
+        {
+            dbg_printf(0, "rpi_fb_init()[%d]: Cannot allocate headless frame buffer\n", __LINE__);
+            return 0;
+        }
+
+        memset(fb_base, 0, x_pix * y_pix);
+        memset(&var_info, 0, sizeof(var_info));
+        var_info.xres = x_pix;
+        var_info.yres = y_pix;
+        fb_pitch = x_pix;
+        fb_pages = 1;
+
+        dbg_printf(2, "Headless frame buffer %dx%d\n", x_pix, y_pix);
+
+        return fb_base;
+    }
+
     // Open the frame buffer device file for reading and writing
     if ( fbfd == 0 )
     {
@@ -172,6 +272,8 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
         return 0;
     }
 
+    fb_base = fbp;
+
     // Select graphics mode to hide cursor
     if ( fb_set_tty(1) )
     {
@@ -182,6 +284,51 @@ uint8_t *rpi_fb_init(int x_pix, int y_pix)
     return fbp;
 }
 
+/********************************************************************
+ * rpi_fb_flip()
+ *
+ *  Copy a complete frame from an off-screen buffer to the frame buffer
+ *  in one sequential pass. If the frame buffer has two pages, the frame is
+ *  copied to the hidden page and the display is then panned to it.
+ *
+ *  param:  Off-screen frame buffer
+ *  return: None
+ */
+void rpi_fb_flip(const uint8_t *buffer)
+{
+    int         line, back_page;
+    uint8_t    *dest;
+
+    if ( fb_base == 0L )
+        return;
+
+    fb_frame_output(buffer);
+
+    back_page = 0;
+    if ( fb_pages == FB_PAGES && var_info.yoffset == 0 )
+        back_page = var_info.yres;
+
+    dest = fb_base + back_page * fb_pitch;
+
+    for ( line = 0; line < var_info.yres; line++ )
+    {
+        memcpy(dest, buffer, var_info.xres);
+        dest += fb_pitch;
+        buffer += var_info.xres;
+    }
+
+    if ( fb_pages == FB_PAGES )
+    {
+        var_info.yoffset = back_page;
+        if ( ioctl(fbfd, FBIOPAN_DISPLAY, &var_info) )
+        {
+            dbg_printf(1, "rpi_fb_flip()[%d]: Display pan failed, using one page.\n", __LINE__);
+            fb_pages = 1;
+            var_info.yoffset = 0;
+        }
+    }
+}
+
 /********************************************************************
  * rpi_fb_resolution()
  *
@@ -244,6 +391,27 @@ void rpi_keyboard_reset(void)
     bcm2835_gpio_write(AVR_RESET, HIGH);
 }
 
+/*------------------------------------------------
+ * rpi_keyboard_start()
+ *
+ *  Start the keyboard reader thread. The thread calls the reader
+ *  step function, and sleeps for the micro-seconds it returns.
+ *
+ *  param:  Reader step function
+ *  return: None
+ */
+void rpi_keyboard_start(uint32_t (*poll_step)(void))
+{
+    static pthread_t    keyboard_thread_id;
+
+    keyboard_step = poll_step;
+
+    if ( pthread_create(&keyboard_thread_id, NULL, keyboard_thread, NULL) != 0 )
+    {
+        dbg_printf(0, "rpi_keyboard_start(): Keyboard reader thread failed to start.\n");
+    }
+}
+
 /*------------------------------------------------
  * rpi_joystk_comp()
  *
@@ -271,6 +439,21 @@ int rpi_joystk_comp(void)
     return (int) bcm2835_gpio_lev(JOYSTK_COMP);
 }
 
+/*------------------------------------------------
+ * rpi_joystk_comp_settled()
+ *
+ *  Read joystick comparator GPIO input pin and return its value,
+ *  without waiting for the DAC and comparator to settle.
+ *  For callers that allowed the settling time between the DAC write and this read.
+ *
+ *  param:  None
+ *  return: GPIO joystick comparator input level
+ */
+int rpi_joystk_comp_settled(void)
+{
+    return (int) bcm2835_gpio_lev(JOYSTK_COMP);
+}
+
 /*------------------------------------------------
  * rpi_rjoystk_button()
  *
@@ -301,6 +484,8 @@ int rpi_reset_button(void)
  * rpi_audio_mux_set()
  *
  *  Set GPIO to select analog multiplexer output.
+ *  The comparator read and the joystick sampler allow the multiplexer
+ *  to settle together with the DAC.
  *
  *  param:  Multiplexer select bit field: b.1=PIA1-CB2, b.0=PIA0-CA2
  *  return: None
@@ -312,7 +497,6 @@ void rpi_audio_mux_set(int select)
     if ( select != previous_select )
     {
         bcm2835_gpio_write_mask((uint32_t)select << AUDIO_MUX0, (uint32_t) AUDIO_MUX_MASK);
-        bcm2835_delayMicroseconds(20);  // TODO check if this is needed to reduce value noise
         previous_select = select;
     }
 }
@@ -340,6 +524,50 @@ void rpi_write_dac(int dac_value)
     bcm2835_gpio_write_mask(dac_bit_values, (uint32_t) DAC_BIT_MASK);
 }
 
+/*------------------------------------------------
+ * rpi_audio_start()
+ *
+ *  Start the audio sample thread. The thread takes a sample from the
+ *  sample source at a fixed rate and writes it to the DAC.
+ *  A negative sample leaves the DAC as it is.
+ *
+ *  param:  Sample rate in Hz, sample source function
+ *  return: None
+ */
+void rpi_audio_start(int sample_rate, int (*sample_source)(void))
+{
+    static pthread_t    audio_thread_id;
+
+    audio_source = sample_source;
+    audio_period_nsec = 1000000000L / sample_rate;
+
+    if ( pthread_create(&audio_thread_id, NULL, audio_thread, NULL) != 0 )
+    {
+        dbg_printf(0, "rpi_audio_start(): Audio thread failed to start.\n");
+    }
+}
+
+/*------------------------------------------------
+ * rpi_joystk_start()
+ *
+ *  Start the joystick sampler thread. The thread calls the sampler step
+ *  function, and sleeps for the micro-seconds it returns.
+ *
+ *  param:  Sampler step function
+ *  return: None
+ */
+void rpi_joystk_start(uint32_t (*sample_step)(void))
+{
+    static pthread_t    joystk_thread_id;
+
+    joystk_step = sample_step;
+
+    if ( pthread_create(&joystk_thread_id, NULL, joystk_thread, NULL) != 0 )
+    {
+        dbg_printf(0, "rpi_joystk_start(): Joystick sampler thread failed to start.\n");
+    }
+}
+
 /*------------------------------------------------
  * rpi_disable()
  *
@@ -421,6 +649,33 @@ void rpi_testpoint_off(void)
     bcm2835_gpio_write(TEST_POINT, LOW);
 }
 
+/*------------------------------------------------
+ * rpi_cpu_pin()
+ *
+ *  Pin the calling thread to a CPU core, so that the emulation
+ *  and render threads do not share a core or move between cores.
+ *  The thread is not pinned if the host does not have the core.
+ *  The affinity system call is used directly, because the emulator's
+ *  sched.h hides the C library's CPU set macros.
+ *
+ *  param:  Core number, -1 to leave the thread on any core
+ *  return: None
+ */
+void rpi_cpu_pin(int core)
+{
+    unsigned long   cpu_set;
+
+    if ( core < 0 || core >= sysconf(_SC_NPROCESSORS_ONLN) || core >= (int)(8 * sizeof(cpu_set)) )
+        return;
+
+    cpu_set = 1UL << core;
+
+    if ( syscall(SYS_sched_setaffinity, 0, sizeof(cpu_set), &cpu_set) != 0 )
+        dbg_printf(1, "rpi_cpu_pin()[%d]: Cannot pin thread to core %d\n", __LINE__, core);
+    else
+        dbg_printf(2, "rpi_cpu_pin()[%d]: Thread pinned to core %d\n", __LINE__, core);
+}
+
 /********************************************************************
  * rpi_halt()
  *
@@ -464,7 +719,6 @@ static uint8_t *fb_set_resolution(int fbh, int x_pix, int y_pix)
     int         page_size = 0;
     long int    screen_size = 0;
 
-    struct  fb_var_screeninfo var_info;
     struct  fb_fix_screeninfo fix_info;
 
     // Get variable screen information
@@ -478,12 +732,21 @@ static uint8_t *fb_set_resolution(int fbh, int x_pix, int y_pix)
     var_info.xres = x_pix;
     var_info.yres = y_pix;
     var_info.xres_virtual = x_pix;
-    var_info.yres_virtual = y_pix;
+    var_info.yres_virtual = FB_PAGES * y_pix;
+    var_info.xoffset = 0;
+    var_info.yoffset = 0;
     if ( ioctl(fbfd, FBIOPUT_VSCREENINFO, &var_info) )
     {
-        dbg_printf(0, "fb_set_resolution()[%d]: Error setting variable information.\n", __LINE__);
+        // Retry without a second page for page flipping
+        var_info.yres_virtual = y_pix;
+        if ( ioctl(fbfd, FBIOPUT_VSCREENINFO, &var_info) )
+        {
+            dbg_printf(0, "fb_set_resolution()[%d]: Error setting variable information.\n", __LINE__);
+        }
     }
 
+    fb_pages = (var_info.yres_virtual >= FB_PAGES * var_info.yres) ? FB_PAGES : 1;
+
     dbg_printf(2, "Display info: %dx%d, %d bpp\n",
            var_info.xres, var_info.yres,
            var_info.bits_per_pixel);
@@ -497,11 +760,19 @@ static uint8_t *fb_set_resolution(int fbh, int x_pix, int y_pix)
 
     dbg_printf(2, "Device ID: %s\n", fix_info.id);
 
+    fb_pitch = fix_info.line_length;
+
     // map frame buffer to user memory
-    screen_size = var_info.xres * var_info.yres_virtual * var_info.bits_per_pixel / 8;
+    screen_size = fb_pitch * var_info.yres * fb_pages;
     page_size = var_info.xres * var_info.yres;
 
-    dbg_printf(2, "Screen_size=%ld, page_size=%d\n", screen_size, page_size);
+    if ( screen_size > fix_info.smem_len && fb_pages > 1 )
+    {
+        fb_pages = 1;
+        screen_size = fb_pitch * var_info.yres;
+    }
+
+    dbg_printf(2, "Screen_size=%ld, page_size=%d, pages=%d\n", screen_size, page_size, fb_pages);
 
     if ( screen_size > fix_info.smem_len )
     {
@@ -567,3 +838,219 @@ static int fb_set_tty(const int mode)
 
     return result;
 }
+
+/*------------------------------------------------
+ * fb_frame_output()
+ *
+ *  Print the frame hash and write a PPM snapshot of a frame
+ *  when they are enabled or requested.
+ *  The hash is a 32-bit FNV-1a of the frame's color indexes.
+ *
+ *  param:  Frame buffer
+ *  return: None
+ */
+static void fb_frame_output(const uint8_t *buffer)
+{
+    int         i, frame_size;
+    uint32_t    hash;
+    char        file_name[32];
+
+    fb_frame_count++;
+
+    if ( fb_frame_hash )
+    {
+        frame_size = var_info.xres * var_info.yres;
+        hash = 2166136261U;
+
+        for ( i = 0; i < frame_size; i++ )
+        {
+            hash ^= buffer[i];
+            hash *= 16777619U;
+        }
+
+        dbg_printf(0, "frame %d hash %08x\n", fb_frame_count, hash);
+    }
+
+    if ( fb_snapshot_request ||
+         (fb_snapshot_interval && (fb_frame_count % fb_snapshot_interval) == 0) )
+    {
+        fb_snapshot_request = 0;
+
+        snprintf(file_name, sizeof(file_name), FB_SNAPSHOT_NAME, fb_frame_count);
+        if ( fb_write_ppm(file_name, buffer) == 0 )
+            dbg_printf(2, "Snapshot %s\n", file_name);
+    }
+}
+
+/*------------------------------------------------
+ * fb_write_ppm()
+ *
+ *  Write a frame to a binary PPM image file,
+ *  converting color indexes with the console palette.
+ *
+ *  param:  File name, frame buffer
+ *  return: 0 ok, -1 fail
+ */
+static int fb_write_ppm(const char *file_name, const uint8_t *buffer)
+{
+    FILE   *ppm;
+    int     i, frame_size;
+
+    ppm = fopen(file_name, "wb");
+    if ( ppm == NULL )
+    {
+        dbg_printf(1, "fb_write_ppm()[%d]: Cannot open %s\n", __LINE__, file_name);
+        return -1;
+    }
+
+    fprintf(ppm, "P6\n%d %d\n255\n", var_info.xres, var_info.yres);
+
+    frame_size = var_info.xres * var_info.yres;
+    for ( i = 0; i < frame_size; i++ )
+    {
+        fwrite(fb_palette[buffer[i] % FB_PALETTE_COLORS], 3, 1, ppm);
+    }
+
+    fclose(ppm);
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * fb_snapshot_signal()
+ *
+ *  SIGUSR1 handler that requests a PPM snapshot of the next frame.
+ *
+ *  param:  Signal number
+ *  return: None
+ */
+static void fb_snapshot_signal(int sig)
+{
+    fb_snapshot_request = 1;
+}
+
+/*------------------------------------------------
+ * audio_thread()
+ *
+ *  Audio sample thread. Wakes up at absolute times one sample period
+ *  apart, so the sample rate does not drift with the thread's run time,
+ *  and writes the sample source's output to the DAC.
+ *
+ *  param:  Not used
+ *  return: None, does not exit
+ */
+static void *audio_thread(void *arg)
+{
+    struct timespec next_sample;
+    int             sample;
+
+    clock_gettime(CLOCK_MONOTONIC, &next_sample);
+
+    for (;;)
+    {
+        next_sample.tv_nsec += audio_period_nsec;
+        if ( next_sample.tv_nsec >= 1000000000L )
+        {
+            next_sample.tv_nsec -= 1000000000L;
+            next_sample.tv_sec++;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_sample, NULL);
+
+        sample = audio_source();
+        if ( sample >= 0 )
+            rpi_write_dac(sample);
+    }
+
+    return NULL;
+}
+
+/*------------------------------------------------
+ * joystk_thread()
+ *
+ *  Joystick sampler thread.
+ *
+ *  param:  Not used
+ *  return: None, does not exit
+ */
+static void *joystk_thread(void *arg)
+{
+    struct timespec delay;
+    uint32_t        usec;
+
+    for (;;)
+    {
+        usec = joystk_step();
+
+        delay.tv_sec = usec / 1000000;
+        delay.tv_nsec = (usec % 1000000) * 1000;
+        nanosleep(&delay, NULL);
+    }
+
+    return NULL;
+}
+
+/*------------------------------------------------
+ * keyboard_thread()
+ *
+ *  Keyboard reader thread.
+ *
+ *  param:  Not used
+ *  return: None, does not exit
+ */
+static void *keyboard_thread(void *arg)
+{
+    struct timespec delay;
+    uint32_t        usec;
+
+    for (;;)
+    {
+        usec = keyboard_step();
+
+        delay.tv_sec = usec / 1000000;
+        delay.tv_nsec = (usec % 1000000) * 1000;
+        nanosleep(&delay, NULL);
+    }
+
+    return NULL;
+}
+
+/*------------------------------------------------
+ * avr_wait_ready()
+ *
+ *  Wait for the AVR (PS2 keyboard controller) to start after a reset.
+ *  The AVR answers a read with a '0' when its key code FIFO is empty,
+ *  so it is ready when a few reads in a row return '0'.
+ *  Key codes read while waiting are dropped.
+ *
+ *  param:  None
+ *  return: 1 AVR ready, 0 timed out
+ */
+static int avr_wait_ready(void)
+{
+    int     elapsed, empty_reads;
+
+    usleep(AVR_BOOT_DELAY);
+
+    empty_reads = 0;
+
+    for ( elapsed = AVR_BOOT_DELAY; elapsed < AVR_READY_TIMEOUT; elapsed += AVR_POLL_INTERVAL )
+    {
+        if ( rpi_keyboard_read() == 0 )
+            empty_reads++;
+        else
+            empty_reads = 0;
+
+        if ( empty_reads == AVR_READY_READS )
+        {
+            dbg_printf(2, "avr_wait_ready()[%d]: AVR ready after %d mSec\n", __LINE__, elapsed / 1000);
+            return 1;
+        }
+
+        usleep(AVR_POLL_INTERVAL);
+    }
+
+    dbg_printf(1, "avr_wait_ready()[%d]: AVR did not answer, continuing\n", __LINE__);
+
+    return 0;
+}
@@ -132,6 +132,26 @@ void spi_aux_transfer_buffer(uint8_t* buffer, uint16_t len)
     }
 }
 
+/*------------------------------------------------
+ * spi_aux_write_buffer()
+ *
+ *  Transmit any number of bytes (up to 65536) from
+ *  a buffer to SPI0, and drop the received bytes.
+ *
+ *  param:  Buffer pointer, length (1 to 65536)
+ *  return: None
+ */
+void spi_aux_write_buffer(const uint8_t* buffer, uint16_t len)
+{
+    if ( !spi_aux_initialized )
+        return;
+
+    if ( len > 0 )
+    {
+        bcm2835_aux_spi_writenb((const char*) buffer, (uint32_t) len);
+    }
+}
+
 /*------------------------------------------------
  * spi_aux_set_cs_high()
  *
@@ -2,7 +2,9 @@
  * sam.c
  *
  *  Module that implements the Synchronous Address Multiplexer
- *  MC6883 / SN74LS785, as used in the Dragon 32 computer
+ *  MC6883 / SN74LS785, as used in the Dragon 32 and 64 computers.
+ *  The Dragon 64 uses map type 1 for 64K RAM. The page bit and the MPU rate
+ *  are kept in the registers but not emulated.
  *
  *  February 6, 2021
  *
@@ -10,9 +12,11 @@
 
 #include    <stdint.h>
 
+#include    "config.h"
 #include    "mem.h"
 #include    "sam.h"
 #include    "vdg.h"
+#include    "state.h"
 
 /* -----------------------------------------
    Local definitions
@@ -21,7 +25,6 @@
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
-static uint8_t io_handler_vector_redirect(uint16_t address, uint8_t data, mem_operation_t op);
 static uint8_t io_handler_sam_write(uint16_t address, uint8_t data, mem_operation_t op);
 
 /* -----------------------------------------
@@ -47,7 +50,10 @@ static struct sam_reg_t
  */
 void sam_init(void)
 {
-    mem_define_io(0xfff2, 0xffff, io_handler_vector_redirect);
+    /* Redirect CPU memory access from the vector area
+     * 0xfff2 through 0xffff to 0xbff2 through 0xbfff
+     */
+    mem_define_alias(0xfff2, 0xffff, 0xbff2);
     mem_define_io(0xffc0, 0xffdf, io_handler_sam_write);
 
     sam_registers.vdg_mode = 0;             // Alphanumeric mode
@@ -55,28 +61,42 @@ void sam_init(void)
     sam_registers.page = 1;                 // For compatibility, not used
     sam_registers.mpu_rate = 0;             // For compatibility, not used
     sam_registers.memory_size = 2;          // For compatibility, not used
-    sam_registers.memory_map_type = 0;      // For compatibility maybe future Dragon 64 emulation, not used
+    sam_registers.memory_map_type = 0;      // 32K RAM and ROM
+
+    mem_set_map_type(0);
 }
 
 /*------------------------------------------------
- * io_handler_vector_redirect()
+ * sam_save_state()
  *
- *  IO call-back handler that will redirect CPU memory access from
- *  the normal vector area 0xfff2 through 0xffff to 0xbff2 through 0xbffff
+ *  Write the SAM registers to the machine state.
  *
- *  param:  Call address, data byte for write operation, and operation type
- *  return: Status or data byte
+ *  param:  Nothing
+ *  return: Nothing
  */
-static uint8_t io_handler_vector_redirect(uint16_t address, uint8_t data, mem_operation_t op)
+void sam_save_state(void)
 {
-    uint8_t response = 0;
+    state_write(&sam_registers, sizeof(sam_registers));
+}
 
-    if ( op == MEM_READ )
-    {
-        response = (uint8_t) mem_read((int)(address & 0xbfff));
-    }
+/*------------------------------------------------
+ * sam_restore_state()
+ *
+ *  Restore the SAM registers from the machine state,
+ *  and send the VDG mode and display offset to the VDG emulation module.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void sam_restore_state(void)
+{
+    state_read(&sam_registers, sizeof(sam_registers));
 
-    return response;
+    vdg_set_mode_sam((int) sam_registers.vdg_mode);
+    vdg_set_video_offset(sam_registers.vdg_display_offset);
+#if (DRAGON_MODEL==64)
+    mem_set_map_type((int) sam_registers.memory_map_type);
+#endif
 }
 
 /*------------------------------------------------
@@ -179,14 +199,72 @@ static uint8_t io_handler_sam_write(uint16_t address, uint8_t data, mem_operatio
             case 0x13:
                 sam_registers.vdg_display_offset |= 0x40;
                 break;
+
+            /* Page, MPU rate and memory size
+             */
+            case 0x14:
+                sam_registers.page = 0;
+                break;
+
+            case 0x15:
+                sam_registers.page = 1;
+                break;
+
+            case 0x16:
+                sam_registers.mpu_rate &= 0xfe;
+                break;
+
+            case 0x17:
+                sam_registers.mpu_rate |= 0x01;
+                break;
+
+            case 0x18:
+                sam_registers.mpu_rate &= 0xfd;
+                break;
+
+            case 0x19:
+                sam_registers.mpu_rate |= 0x02;
+                break;
+
+            case 0x1a:
+                sam_registers.memory_size &= 0xfe;
+                break;
+
+            case 0x1b:
+                sam_registers.memory_size |= 0x01;
+                break;
+
+            case 0x1c:
+                sam_registers.memory_size &= 0xfd;
+                break;
+
+            case 0x1d:
+                sam_registers.memory_size |= 0x02;
+                break;
+
+            /* Memory map type
+             */
+            case 0x1e:
+                sam_registers.memory_map_type = 0;
+                break;
+
+            case 0x1f:
+                sam_registers.memory_map_type = 1;
+                break;
         }
-    }
 
-    /* Send VDG mode to VDG emulation module
-     * and display offset address to VDG emulation module
-     */
-    vdg_set_mode_sam((int) sam_registers.vdg_mode);
-    vdg_set_video_offset(sam_registers.vdg_display_offset);
+        /* Send VDG mode or display offset address
+         * to VDG emulation module
+         */
+        if ( register_addr <= 0x05 )
+            vdg_set_mode_sam((int) sam_registers.vdg_mode);
+        else if ( register_addr <= 0x13 )
+            vdg_set_video_offset(sam_registers.vdg_display_offset);
+#if (DRAGON_MODEL==64)
+        else if ( register_addr >= 0x1e )
+            mem_set_map_type((int) sam_registers.memory_map_type);
+#endif
+    }
 
     return 0;
 }
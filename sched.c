@@ -0,0 +1,207 @@
+/********************************************************************
+ * sched.c
+ *
+ *  Emulated-time event scheduler.
+ *  Events are timed in CPU clock cycles accumulated from the
+ *  executed instructions, and not from host (wall clock) time.
+ *  A small priority queue, kept sorted by due time, holds the
+ *  pending events.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+
+#include    "sched.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     SCHED_MAX_EVENTS        8
+#define     SCHED_IDLE_CYCLES       0x7fffffff  // Cycles to next event when queue is empty
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static struct sched_event_t
+{
+    uint32_t            due_cycle;
+    sched_callback_t    callback;
+} sched_queue[SCHED_MAX_EVENTS];
+
+static int      sched_event_count = 0;
+static uint32_t sched_cycles = 0;
+
+/*------------------------------------------------
+ * sched_init()
+ *
+ *  Initialize the scheduler, clear the event queue
+ *  and the emulated cycle counter.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void sched_init(void)
+{
+    sched_event_count = 0;
+    sched_cycles = 0;
+}
+
+/*------------------------------------------------
+ * sched_add()
+ *
+ *  Schedule a call-back to run 'delay_cycles' CPU cycles from now.
+ *  The event queue is kept sorted by due time, and events
+ *  with the same due time run in the order they were added.
+ *
+ *  param:  Delay in CPU cycles, call-back function
+ *  return: 0- event added, -1- event queue is full
+ */
+int sched_add(uint32_t delay_cycles, sched_callback_t callback)
+{
+    int         i;
+    uint32_t    due_cycle;
+
+    if ( sched_event_count == SCHED_MAX_EVENTS )
+    {
+        dbg_printf(0, "sched_add()[%d]: Event queue is full.\n", __LINE__);
+        return -1;
+    }
+
+    due_cycle = sched_cycles + delay_cycles;
+
+    /* Insertion sort, cycle counter comparison is wrap-around safe
+     */
+    for ( i = sched_event_count; i > 0; i-- )
+    {
+        if ( (int32_t)(sched_queue[i-1].due_cycle - due_cycle) <= 0 )
+            break;
+
+        sched_queue[i] = sched_queue[i-1];
+    }
+
+    sched_queue[i].due_cycle = due_cycle;
+    sched_queue[i].callback = callback;
+    sched_event_count++;
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * sched_cancel()
+ *
+ *  Remove all pending events of a call-back function.
+ *
+ *  param:  Call-back function
+ *  return: Nothing
+ */
+void sched_cancel(sched_callback_t callback)
+{
+    int     i, j;
+
+    for ( i = 0, j = 0; i < sched_event_count; i++ )
+    {
+        if ( sched_queue[i].callback != callback )
+        {
+            sched_queue[j] = sched_queue[i];
+            j++;
+        }
+    }
+
+    sched_event_count = j;
+}
+
+/*------------------------------------------------
+ * sched_is_pending()
+ *
+ *  Check if a call-back function has a pending event.
+ *
+ *  param:  Call-back function
+ *  return: 1- event is pending, 0- no event pending
+ */
+int sched_is_pending(sched_callback_t callback)
+{
+    int     i;
+
+    for ( i = 0; i < sched_event_count; i++ )
+    {
+        if ( sched_queue[i].callback == callback )
+            return 1;
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------
+ * sched_advance()
+ *
+ *  Advance emulated time by the CPU cycles executed and
+ *  run the call-backs of all events that are due.
+ *  A call-back may schedule new events, including itself.
+ *
+ *  param:  CPU cycles executed
+ *  return: Nothing
+ */
+void sched_advance(int cycles)
+{
+    int                 i;
+    sched_callback_t    callback;
+
+    sched_cycles += cycles;
+
+    while ( sched_event_count &&
+            (int32_t)(sched_queue[0].due_cycle - sched_cycles) <= 0 )
+    {
+        callback = sched_queue[0].callback;
+
+        sched_event_count--;
+        for ( i = 0; i < sched_event_count; i++ )
+        {
+            sched_queue[i] = sched_queue[i+1];
+        }
+
+        callback();
+    }
+}
+
+/*------------------------------------------------
+ * sched_get_cycles()
+ *
+ *  Return the emulated time in CPU cycles.
+ *
+ *  param:  Nothing
+ *  return: CPU cycle count
+ */
+uint32_t sched_get_cycles(void)
+{
+    return sched_cycles;
+}
+
+/*------------------------------------------------
+ * sched_cycles_to_next()
+ *
+ *  Return the CPU cycles left until the next event is due.
+ *  Use as a CPU execution budget so that events run on time.
+ *
+ *  param:  Nothing
+ *  return: CPU cycles to next event, '0' if an event is already due
+ */
+uint32_t sched_cycles_to_next(void)
+{
+    int32_t     cycles;
+
+    if ( sched_event_count == 0 )
+        return SCHED_IDLE_CYCLES;
+
+    cycles = (int32_t)(sched_queue[0].due_cycle - sched_cycles);
+
+    return (cycles < 0) ? 0 : (uint32_t) cycles;
+}
@@ -20,6 +20,7 @@
 #endif
 #include    "sd.h"
 #include    "config.h"
+#include    "dbgmsg.h"
 
 /* -----------------------------------------
    Local definitions
@@ -83,15 +84,29 @@
 #define     SD_BLOCK_SIZE           512         // Bytes
 #define     SD_TIME_OUT             500000      // 500mSec
 #define     SD_NCR                  10          // Command response time: 0 to 8 bytes for SDC, 1 to 8 bytes for MMC
+#define     SD_RATE_TEST_BLOCKS     4           // Blocks read back to verify a bit rate
+#define     SD_ASYNC_XFER_LEN       (SD_BLOCK_SIZE + 4) // Token, data block, CRC16, data response
+
+/* Data block CRC16 is sent with writes and checked on reads when enabled.
+ * The card does not check CRCs in SPI mode unless enabled with CMD59,
+ * so written blocks carry a dummy CRC when data CRC is disabled.
+ */
+#if (SD_DATA_CRC==1)
+    #define     SD_WRITE_CRC16(b)   sd_get_crc16(b, SD_BLOCK_SIZE)
+#else
+    #define     SD_WRITE_CRC16(b)   0xffff
+#endif
 
 /* Aliases for compatibility between
  * bare-metal and OS libraries.
  */
 #if (RPI_BARE_METAL==1)
     #define     clock()                         bcm2835_st_read()
+    #define     spi_aux_set_rate(a)             bcm2835_spi1_set_rate(a)
     #define     spi_aux_close()                 bcm2835_spi1_close()
     #define     spi_aux_transfer_byte(a)        bcm2835_spi1_transfer_byte(a)
     #define     spi_aux_transfer_buffer(a,b)    bcm2835_spi1_transfer_Ex(a,a,b)
+    #define     spi_aux_write_buffer(a,b)       bcm2835_spi1_transfer_Ex((uint8_t*)a,0,b)
 #endif
 
 /* -----------------------------------------
@@ -100,14 +115,38 @@
 static uint8_t   sd_send_cmd(uint8_t cmd, uint32_t arg);
 static int       sd_wait_token(uint8_t token);
 static int       sd_wait_ready(void);
+static uint32_t  sd_negotiate_rate(void);
+#if (RPI_BARE_METAL==1)
+static void      sd_write_async_done(void);
+#endif
 static uint8_t   sd_get_crc7(uint8_t *message, uint16_t length);
+#if (SD_DATA_CRC==1)
 static uint16_t  sd_get_crc16(const uint8_t *buf, uint16_t length );
+#endif
 
 /* -----------------------------------------
    Module globals
 ----------------------------------------- */
 static int      sd_initialized = 0;
 
+/* SPI bit rates to step through after card initialization
+ */
+static const uint32_t sd_bit_rates[] =
+    {
+        2000000, 4000000, 8000000, 12500000, 16000000, 20000000, 25000000, 31250000, 41666666
+    };
+
+static uint8_t  rate_ref_buffer[SD_RATE_TEST_BLOCKS * SD_BLOCK_SIZE];
+static uint8_t  rate_test_buffer[SD_RATE_TEST_BLOCKS * SD_BLOCK_SIZE];
+
+#if (RPI_BARE_METAL==1)
+/* Interrupt driven block write
+ */
+static uint8_t  async_tx_buffer[SD_ASYNC_XFER_LEN];
+static uint8_t  async_rx_buffer[SD_ASYNC_XFER_LEN];
+static void   (*async_callback)(error_t);
+#endif
+
 /* -------------------------------------------------------------
  * sd_init()
  *
@@ -131,7 +170,7 @@ error_t sd_init(void)
         return result;
     }
 
-    spi_aux_set_rate(SD_CARD_BIT_RATE);
+    spi_aux_set_rate(SD_CARD_INIT_RATE);
 
     spi_aux_set_cs_high();                          // CS to 'High'
 
@@ -139,12 +178,12 @@ error_t sd_init(void)
     spi_aux_transfer_buffer(mosi_buffer, 10);       // Dummy clocks, CS=DI=High
     spi_aux_set_cs_spi_func();                      // Back to normal CS
 #else
-    if ( !bcm2835_spi1_init(SPI1_DEFAULT) )
+    if ( !bcm2835_spi1_init(SPI1_DEFAULT | SPI1_ENA_TX_IRQ) )
     {
       return SPI_INIT;
     }
 
-    bcm2835_spi1_set_rate(SD_CARD_BIT_RATE);
+    bcm2835_spi1_set_rate(SD_CARD_INIT_RATE);
 
     bcm2835_spi1_set_cs_high();
 
@@ -195,6 +234,8 @@ error_t sd_init(void)
 
     sd_initialized = 1;
 
+    dbg_printf(2, "sd_init()[%d]: SD card SPI bit rate %u Hz\n", __LINE__, sd_negotiate_rate());
+
     return NO_ERROR;
 }
 
@@ -265,10 +306,15 @@ error_t sd_read_block(uint32_t lba, uint8_t *buffer, uint16_t length)
 
     /* Check CRC
      */
+#if (SD_DATA_CRC==1)
     if ( sd_get_crc16(buffer, SD_BLOCK_SIZE) != ((crc_high << 8) + crc_low) )
     {
         return SD_BAD_CRC;
     }
+#else
+    (void) crc_high;
+    (void) crc_low;
+#endif
 
     return NO_ERROR;
 }
@@ -311,10 +357,10 @@ error_t sd_write_block(uint32_t lba, uint8_t *buffer, uint16_t length)
 
     /* Write a data block (one SD sector)
      */
-    crc = sd_get_crc16(buffer, SD_BLOCK_SIZE);
+    crc = SD_WRITE_CRC16(buffer);
 
     spi_aux_transfer_byte(SD_TOKEN_START_BLOCK);
-    spi_aux_transfer_buffer(buffer, SD_BLOCK_SIZE);
+    spi_aux_write_buffer(buffer, SD_BLOCK_SIZE);
     spi_aux_transfer_byte((crc >> 8) & 0xff);
     spi_aux_transfer_byte(crc & 0xff);
 
@@ -330,6 +376,305 @@ error_t sd_write_block(uint32_t lba, uint8_t *buffer, uint16_t length)
     return NO_ERROR;
 }
 
+/* -------------------------------------------------------------
+ * sd_read_blocks()
+ *
+ *  Read consecutive blocks (sectors) from the SD card
+ *  with one multiple block read command.
+ *
+ *  Param:  First LBA number, buffer address, and block count
+ *  Return: Driver error
+ */
+error_t sd_read_blocks(uint32_t lba, uint8_t *buffer, uint16_t count)
+{
+    uint8_t     sd_response;
+    uint8_t     crc_high, crc_low;
+    uint16_t    block;
+    error_t     result;
+
+    if ( count == 0 || !sd_initialized )
+    {
+        return SD_READ_FAIL;
+    }
+
+    if ( count == 1 )
+    {
+        return sd_read_block(lba, buffer, SD_BLOCK_SIZE);
+    }
+
+    /* check if DO is high
+     */
+    if ( sd_wait_ready() == 0 )
+    {
+        return SD_FAIL_READY;
+    }
+
+    /* Send read command to SD card
+     */
+    memset(buffer, SPI_FILL_BYTE, (uint32_t) count * SD_BLOCK_SIZE);
+
+    sd_response = sd_send_cmd(SD_READ_MULTIPLE_BLOCK, lba * SD_BLOCK_SIZE);   // *** SDC uses BYTE addressing ***
+    if ( sd_response != SD_R1_READY )
+    {
+        return SD_READ_FAIL;
+    }
+
+    /* Read the data blocks as they stream from the card,
+     * each one is preceded by a start of data token (0xFE)
+     */
+    result = NO_ERROR;
+
+    for ( block = 0; block < count; block++ )
+    {
+        if ( sd_wait_token(SD_TOKEN_START_BLOCK) == 0 )
+        {
+            result = SD_TIMEOUT;
+            break;
+        }
+
+        spi_aux_transfer_buffer(buffer, SD_BLOCK_SIZE);
+        crc_high = spi_aux_transfer_byte(SPI_FILL_BYTE);
+        crc_low = spi_aux_transfer_byte(SPI_FILL_BYTE);
+
+#if (SD_DATA_CRC==1)
+        if ( sd_get_crc16(buffer, SD_BLOCK_SIZE) != ((crc_high << 8) + crc_low) )
+        {
+            result = SD_BAD_CRC;
+            break;
+        }
+#else
+        (void) crc_high;
+        (void) crc_low;
+#endif
+
+        buffer += SD_BLOCK_SIZE;
+    }
+
+    /* Stop the data stream
+     */
+    sd_response = sd_send_cmd(SD_STOP_TRANSMISSION, 0);
+    if ( result == NO_ERROR && sd_response != SD_R1_READY )
+    {
+        result = SD_READ_FAIL;
+    }
+
+    return result;
+}
+
+/* -------------------------------------------------------------
+ * sd_write_blocks()
+ *
+ *  Write consecutive blocks (sectors) to the SD card
+ *  with one multiple block write command.
+ *
+ *  Param:  First LBA number, buffer address, and block count
+ *  Return: Driver error
+ */
+error_t sd_write_blocks(uint32_t lba, uint8_t *buffer, uint16_t count)
+{
+    uint8_t     sd_response;
+    uint16_t    crc;
+    uint16_t    block;
+    error_t     result;
+
+    if ( count == 0 || !sd_initialized )
+    {
+        return SD_WRITE_FAIL;
+    }
+
+    if ( count == 1 )
+    {
+        return sd_write_block(lba, buffer, SD_BLOCK_SIZE);
+    }
+
+    /* check if DO is high
+     */
+    if ( sd_wait_ready() == 0 )
+    {
+        return SD_FAIL_READY;
+    }
+
+    /* Send write command to SD card
+     */
+    sd_response = sd_send_cmd(SD_WRITE_MULTIPLE_BLOCK, lba * SD_BLOCK_SIZE);   // *** SDC uses BYTE addressing ***
+    if ( sd_response != SD_R1_READY )
+    {
+        return SD_WRITE_FAIL;
+    }
+
+    spi_aux_transfer_byte(SPI_FILL_BYTE);
+    spi_aux_transfer_byte(SPI_FILL_BYTE);
+
+    /* Write the data blocks, each one preceded by a multiple
+     * block write token (0xFC), and wait for the card to program it
+     */
+    result = NO_ERROR;
+
+    for ( block = 0; block < count; block++ )
+    {
+        crc = SD_WRITE_CRC16(buffer);
+
+        spi_aux_transfer_byte(SD_TOKEN_CMD25);
+        spi_aux_write_buffer(buffer, SD_BLOCK_SIZE);
+        spi_aux_transfer_byte((crc >> 8) & 0xff);
+        spi_aux_transfer_byte(crc & 0xff);
+
+        sd_response = spi_aux_transfer_byte(SPI_FILL_BYTE) & 0x0f;
+        if ( sd_response == SD_DATA_RESP_CRC_ERR ||
+             sd_response == SD_DATA_RESP_REJECT )
+        {
+            result = SD_WRITE_FAIL;
+            break;
+        }
+
+        if ( sd_wait_ready() == 0 )
+        {
+            result = SD_FAIL_READY;
+            break;
+        }
+
+        buffer += SD_BLOCK_SIZE;
+    }
+
+    /* Stop the data stream and wait for the card to finish programming
+     */
+    spi_aux_transfer_byte(SD_TOKEN_STOP_TX);
+    spi_aux_transfer_byte(SPI_FILL_BYTE);
+
+    if ( sd_wait_ready() == 0 && result == NO_ERROR )
+    {
+        result = SD_FAIL_READY;
+    }
+
+    return result;
+}
+
+/* -------------------------------------------------------------
+ * sd_write_block_async()
+ *
+ *  Write a block (sector) to SD card without waiting for the data transfer.
+ *  The command is sent, and on bare metal the data block is then moved by the
+ *  SPI1 transfer interrupt. 'callback' is called in interrupt context with the
+ *  write status when the card accepted or rejected the block.
+ *  The block is copied, so the buffer can be reused when the function returns.
+ *  On Linux the block is written before the function returns.
+ *
+ *  Param:  LBA number, buffer address, and completion callback (or NULL)
+ *  Return: Driver error of the command phase
+ */
+error_t sd_write_block_async(uint32_t lba, uint8_t *buffer, void (*callback)(error_t))
+{
+#if (RPI_BARE_METAL==0)
+    error_t     result;
+
+    result = sd_write_block(lba, buffer, SD_BLOCK_SIZE);
+    if ( callback )
+    {
+        callback(result);
+    }
+
+    return result;
+#else
+    uint8_t     sd_response;
+    uint16_t    crc;
+
+    if ( !sd_initialized )
+    {
+        return SD_WRITE_FAIL;
+    }
+
+    /* check if DO is high, this also waits for
+     * a previous interrupt driven write to complete
+     */
+    if ( sd_wait_ready() == 0 )
+    {
+        return SD_FAIL_READY;
+    }
+
+    /* Send write command to SD card
+     */
+    sd_response = sd_send_cmd(SD_WRITE_BLOCK, lba * SD_BLOCK_SIZE);   // *** SDC uses BYTE addressing ***
+    if ( sd_response != SD_R1_READY )
+    {
+        return SD_WRITE_FAIL;
+    }
+
+    spi_aux_transfer_byte(SPI_FILL_BYTE);
+    spi_aux_transfer_byte(SPI_FILL_BYTE);
+
+    /* Queue the data block with its token and CRC, and
+     * a fill byte to clock in the card's data response
+     */
+    crc = SD_WRITE_CRC16(buffer);
+
+    async_tx_buffer[0] = SD_TOKEN_START_BLOCK;
+    memcpy(&async_tx_buffer[1], buffer, SD_BLOCK_SIZE);
+    async_tx_buffer[SD_BLOCK_SIZE + 1] = (crc >> 8) & 0xff;
+    async_tx_buffer[SD_BLOCK_SIZE + 2] = crc & 0xff;
+    async_tx_buffer[SD_BLOCK_SIZE + 3] = SPI_FILL_BYTE;
+
+    async_callback = callback;
+
+    if ( !bcm2835_spi1_transfer_irq(async_tx_buffer, async_rx_buffer, SD_ASYNC_XFER_LEN, sd_write_async_done) )
+    {
+        bcm2835_spi1_transfer_Ex(async_tx_buffer, async_rx_buffer, SD_ASYNC_XFER_LEN);
+        sd_write_async_done();
+    }
+
+    return NO_ERROR;
+#endif
+}
+
+/* -------------------------------------------------------------
+ * sd_is_busy()
+ *
+ *  Check for an interrupt driven block write in progress.
+ *
+ *  Param:  None
+ *  Return: busy=1, idle=0
+ */
+int sd_is_busy(void)
+{
+#if (RPI_BARE_METAL==0)
+    return 0;
+#else
+    return bcm2835_spi1_is_busy();
+#endif
+}
+
+#if (RPI_BARE_METAL==1)
+/* -------------------------------------------------------------
+ * sd_write_async_done()
+ *
+ *  SPI1 transfer completion callback of sd_write_block_async().
+ *  Checks the data response and reports the write status.
+ *
+ *  Param:  None
+ *  Return: None
+ */
+static void sd_write_async_done(void)
+{
+    uint8_t     sd_response;
+    error_t     result;
+
+    sd_response = async_rx_buffer[SD_BLOCK_SIZE + 3] & 0x0f;
+    if ( sd_response == SD_DATA_RESP_CRC_ERR ||
+         sd_response == SD_DATA_RESP_REJECT )
+    {
+        result = SD_WRITE_FAIL;
+    }
+    else
+    {
+        result = NO_ERROR;
+    }
+
+    if ( async_callback )
+    {
+        async_callback(result);
+    }
+}
+#endif
+
 /* -------------------------------------------------------------
  * sd_send_cmd()
  *
@@ -368,6 +713,13 @@ static uint8_t sd_send_cmd(uint8_t cmd, uint32_t arg)
      */
     spi_aux_transfer_buffer(mosi_buffer, sizeof(mosi_buffer));
 
+    /* Discard the stuff byte that follows a stop transmission command
+     */
+    if ( cmd == SD_STOP_TRANSMISSION )
+    {
+        spi_aux_transfer_byte(SPI_FILL_BYTE);
+    }
+
     /* Send out '1's on MOSI until a response is received from the SD
      */
     i = 0;
@@ -436,6 +788,52 @@ static int sd_wait_ready(void)
     return 0;
 }
 
+/* -------------------------------------------------------------
+ * sd_negotiate_rate()
+ *
+ *  Step the SPI bit rate up from the initialization rate, up to SD_CARD_BIT_RATE.
+ *  Each rate is verified by reading back the first blocks of the card and comparing
+ *  them to the blocks read at the initialization rate. The last rate that passed
+ *  is kept.
+ *
+ *  Param:  None
+ *  Return: Selected bit rate in Hz
+ */
+static uint32_t sd_negotiate_rate(void)
+{
+    int         i;
+    uint32_t    bit_rate;
+
+    bit_rate = SD_CARD_INIT_RATE;
+
+    if ( sd_read_blocks(0, rate_ref_buffer, SD_RATE_TEST_BLOCKS) != NO_ERROR )
+    {
+        dbg_printf(1, "sd_negotiate_rate()[%d]: Reference read failed\n", __LINE__);
+        return bit_rate;
+    }
+
+    for ( i = 0; i < (int)(sizeof(sd_bit_rates) / sizeof(uint32_t)); i++ )
+    {
+        if ( sd_bit_rates[i] > SD_CARD_BIT_RATE )
+            break;
+
+        spi_aux_set_rate(sd_bit_rates[i]);
+
+        if ( sd_read_blocks(0, rate_test_buffer, SD_RATE_TEST_BLOCKS) != NO_ERROR ||
+             memcmp(rate_ref_buffer, rate_test_buffer, sizeof(rate_test_buffer)) != 0 )
+        {
+            dbg_printf(1, "sd_negotiate_rate()[%d]: Read back failed at %u Hz\n", __LINE__, sd_bit_rates[i]);
+            break;
+        }
+
+        bit_rate = sd_bit_rates[i];
+    }
+
+    spi_aux_set_rate(bit_rate);
+
+    return bit_rate;
+}
+
 /* -------------------------------------------------------------
  * sd_get_crc7()
  *
@@ -475,29 +873,59 @@ static uint8_t sd_get_crc7(uint8_t *message, uint16_t length)
     return crc;
 }
 
+#if (SD_DATA_CRC==1)
 /* -------------------------------------------------------------
  * sd_get_crc16()
  *
- *  Calculate CRC16 on a message.
+ *  Calculate CRC16 (CCITT, polynomial 0x1021) on a message.
  *
  *  Param:  Pointer to message buffer, length of message
  *  Return: CRC16 word
  */
 static uint16_t sd_get_crc16(const uint8_t *buf, uint16_t length )
 {
+    static const uint16_t crc_lookup_table[256] =
+        {
+            0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+            0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+            0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+            0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+            0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+            0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+            0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+            0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+            0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+            0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+            0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+            0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+            0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+            0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+            0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+            0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+            0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+            0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+            0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+            0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+            0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+            0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+            0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+            0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+            0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+            0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+            0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+            0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+            0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+            0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+            0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+            0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+        };
+
     uint16_t crc = 0;
-    int i;
 
     while( length-- )
     {
-        crc ^= *(uint8_t *)buf++ << 8;
-        for( i = 0; i < 8; i++ )
-        {
-            if( crc & 0x8000 )
-                crc = (crc << 1) ^ 0x1021;
-            else
-                crc = crc << 1;
-        }
+        crc = (crc << 8) ^ crc_lookup_table[((crc >> 8) ^ *buf++) & 0xff];
     }
     return crc;
 }
+#endif
@@ -0,0 +1,838 @@
+/********************************************************************
+ * state.c
+ *
+ *  Machine state save and restore.
+ *  The CPU registers, the RAM and cartridge ROM, the SAM, PIA and
+ *  WD2797 registers, and the tape input position of the mounted CAS file
+ *  are saved to a file on the SD card, and restored from it to resume
+ *  the session without a cold start and a tape load.
+ *
+ *  The machine state is built in a RAM buffer and written to the file
+ *  in one sequential stream. The file is a header followed by
+ *  a record for each part of the machine, ending with an end record:
+ *
+ *    Header  'D32S', format version (2), flags (2), payload length (4), checksum (4)
+ *    Record  record type (1), record length (2), record data
+ *
+ *  Header and record fields are little endian. Module records hold
+ *  the module's register structures as they are in memory, so a file restores
+ *  only into a build with the same format version and record lengths,
+ *  which is checked before any of the machine state is changed.
+ *  Memory is run-length encoded with STATE_RLE, which reduces mostly empty
+ *  RAM to a few KB. The Dragon 64 upper 32K RAM has a record of its own, and
+ *  its ACIA registers are not saved. The tape bit stream position within a byte, the
+ *  keyboard matrix and the emulated-time events of the VDG are not saved.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+#include    <string.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+
+#include    "cpu.h"
+#include    "mem.h"
+#include    "sam.h"
+#include    "pia.h"
+#include    "intr.h"
+#include    "disk.h"
+#include    "loader.h"
+
+#include    "state.h"
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     STATE_MAGIC             "D32S"
+#define     STATE_VERSION           1
+#define     STATE_FLAG_RLE          0x0001  // Memory record is run-length encoded
+
+#define     STATE_HEADER_SIZE       16
+#define     STATE_RECORD_HEADER     3       // Record type and length
+#define     STATE_RECORD_MAX        0xffff
+#if (DRAGON_MODEL==64)
+#define     STATE_BUFFER_SIZE       (96 * 1024)
+#else
+#define     STATE_BUFFER_SIZE       (64 * 1024)
+#endif
+
+#define     STATE_REC_END           0
+#define     STATE_REC_MEMORY        1
+#define     STATE_REC_CPU           2
+#define     STATE_REC_SAM           3
+#define     STATE_REC_PIA           4
+#define     STATE_REC_DISK          5
+#define     STATE_REC_FILES         6
+#define     STATE_REC_MEMORY_HIGH   7       // Dragon 64 RAM from 0x8000
+
+/* Run-length encoding, a control byte followed by 1 to 128 literal bytes
+ * for control values 0 to 127, or by one byte repeated 3 to 130 times
+ * for control values 128 to 255
+ */
+#define     STATE_RLE_REPEAT        0x80
+#define     STATE_RLE_LITERAL_MAX   128
+#define     STATE_RLE_RUN_MIN       3
+#define     STATE_RLE_RUN_MAX       (0x7f + STATE_RLE_RUN_MIN)
+
+/* -----------------------------------------
+   Module types
+----------------------------------------- */
+typedef struct
+{
+    uint8_t     type;
+    void        (*save)(void);
+    void        (*restore)(void);
+    int         (*verify)(int length);      // Check a variable length record, NULL for a fixed record length
+} state_record_t;
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static void     state_build(int measure);
+static int      state_verify(int payload_length);
+static void     state_apply(void);
+static int      state_record_begin(int type);
+
+static void     memory_save_state(void);
+static void     memory_restore_state(void);
+static int      memory_verify_state(int length);
+#if (DRAGON_MODEL==64)
+static void     memory_high_save_state(void);
+static void     memory_high_restore_state(void);
+static int      memory_high_verify_state(int length);
+#endif
+static void     memory_ranges_save(int record);
+static void     memory_ranges_restore(int record);
+static int      memory_ranges_verify(int record, int length);
+static void     files_save_state(void);
+static void     files_restore_state(void);
+
+static void     state_write_rle(const uint8_t *data, int length);
+static int      state_read_rle(uint8_t *data, int length);
+static void     state_put16(uint8_t *buffer, uint16_t value);
+static void     state_put32(uint8_t *buffer, uint32_t value);
+static uint16_t state_get16(const uint8_t *buffer);
+static uint32_t state_get32(const uint8_t *buffer);
+static uint32_t state_checksum(const uint8_t *data, int length);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+
+/* Machine state records in file order
+ */
+static const state_record_t state_records[] =
+{
+    { STATE_REC_MEMORY, memory_save_state, memory_restore_state, memory_verify_state },
+#if (DRAGON_MODEL==64)
+    { STATE_REC_MEMORY_HIGH, memory_high_save_state, memory_high_restore_state, memory_high_verify_state },
+#endif
+    { STATE_REC_CPU,    cpu_save_state,    cpu_restore_state,    0L },
+    { STATE_REC_SAM,    sam_save_state,    sam_restore_state,    0L },
+    { STATE_REC_PIA,    pia_save_state,    pia_restore_state,    0L },
+    { STATE_REC_DISK,   disk_save_state,   disk_restore_state,   0L },
+    { STATE_REC_FILES,  files_save_state,  files_restore_state,  0L },
+};
+
+#define     STATE_RECORDS           (int)(sizeof(state_records) / sizeof(state_record_t))
+
+/* Memory ranges of the memory records, RAM and the cartridge ROM.
+ * The ranges are taken from the RAM and ROM storage and not from the CPU
+ * memory map, so they restore before the SAM record sets the map type.
+ */
+static const struct
+{
+    int         record;
+    mem_block_t block;
+    int         offset;
+    int         length;
+} state_memory[] =
+{
+    { STATE_REC_MEMORY,      MEM_BLOCK_RAM,       0x0000, 0x8000 },
+    { STATE_REC_MEMORY,      MEM_BLOCK_CARTRIDGE, 0x0000, 0x3f00 },
+#if (DRAGON_MODEL==64)
+    { STATE_REC_MEMORY_HIGH, MEM_BLOCK_RAM,       0x8000, 0x7f00 },
+#endif
+};
+
+static uint8_t  state_buffer[STATE_BUFFER_SIZE];
+static int      state_length;               // Bytes written to the buffer, or counted when measuring
+static int      state_index;                // Next byte to read
+static int      state_limit;                // End of the record being read
+static int      state_error;                // Buffer overflow, or read past the end of a record
+static int      state_measure;              // Count record lengths without writing to the buffer
+static int      state_rle;                  // Memory record is run-length encoded
+
+static int      record_length[STATE_RECORDS];
+
+/*------------------------------------------------
+ * state_save()
+ *
+ *  Save the machine state to a machine state file,
+ *  in the directory last displayed by the loader.
+ *
+ *  param:  File name, STATE_FILE_NAME for the F8 and F9 keys
+ *  return: 1- state saved, 0- save failed
+ */
+int state_save(char *file_name)
+{
+    int     payload_length;
+
+    state_rle = STATE_RLE;
+    state_build(0);
+
+    if ( state_error )
+    {
+        dbg_printf(0, "state_save()[%d]: Machine state does not fit the buffer.\n", __LINE__);
+        return 0;
+    }
+
+    payload_length = state_length - STATE_HEADER_SIZE;
+
+    memcpy(state_buffer, STATE_MAGIC, 4);
+    state_put16(&state_buffer[4], STATE_VERSION);
+    state_put16(&state_buffer[6], (state_rle ? STATE_FLAG_RLE : 0));
+    state_put32(&state_buffer[8], (uint32_t) payload_length);
+    state_put32(&state_buffer[12], state_checksum(&state_buffer[STATE_HEADER_SIZE], payload_length));
+
+    if ( !loader_state_fwrite(file_name, state_buffer, (uint32_t) state_length) )
+    {
+        dbg_printf(0, "state_save()[%d]: Machine state file write failed.\n", __LINE__);
+        return 0;
+    }
+
+    dbg_printf(1, "Machine state saved to %s (%d bytes).\n", file_name, state_length);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * state_restore()
+ *
+ *  Restore the machine state from a machine state file.
+ *  The whole file is read and checked before the machine state is changed,
+ *  so a missing, damaged or incompatible file leaves the session running.
+ *
+ *  param:  File name
+ *  return: 1- state restored, 0- restore failed
+ */
+int state_restore(char *file_name)
+{
+    int         file_length, payload_length;
+    uint16_t    version;
+
+    if ( (file_length = loader_state_fread(file_name, state_buffer, STATE_BUFFER_SIZE)) < 0 )
+    {
+        dbg_printf(0, "state_restore()[%d]: Machine state file %s not found.\n", __LINE__, file_name);
+        return 0;
+    }
+
+    if ( file_length < STATE_HEADER_SIZE || memcmp(state_buffer, STATE_MAGIC, 4) != 0 )
+    {
+        dbg_printf(0, "state_restore()[%d]: Not a machine state file.\n", __LINE__);
+        return 0;
+    }
+
+    if ( (version = state_get16(&state_buffer[4])) != STATE_VERSION )
+    {
+        dbg_printf(0, "state_restore()[%d]: Machine state format version %d, expected %d.\n", __LINE__, version, STATE_VERSION);
+        return 0;
+    }
+
+    payload_length = (int) state_get32(&state_buffer[8]);
+    if ( payload_length < 0 || payload_length > (file_length - STATE_HEADER_SIZE) ||
+         state_get32(&state_buffer[12]) != state_checksum(&state_buffer[STATE_HEADER_SIZE], payload_length) )
+    {
+        dbg_printf(0, "state_restore()[%d]: Machine state file is damaged.\n", __LINE__);
+        return 0;
+    }
+
+    state_rle = ( (state_get16(&state_buffer[6]) & STATE_FLAG_RLE) != 0 );
+
+    /* Measure the records of the running build, which must
+     * match the records of the file
+     */
+    state_build(1);
+
+    if ( !state_verify(payload_length) )
+    {
+        dbg_printf(0, "state_restore()[%d]: Machine state file does not match this build.\n", __LINE__);
+        return 0;
+    }
+
+    state_apply();
+
+    dbg_printf(1, "Machine state restored from %s (%d bytes).\n", file_name, file_length);
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * state_write()
+ *
+ *  Write data to the record being saved.
+ *  While measuring, the data is only counted.
+ *
+ *  param:  Pointer to data, and its length in bytes
+ *  return: Nothing
+ */
+void state_write(const void *data, int length)
+{
+    if ( !state_measure )
+    {
+        if ( (state_length + length) > STATE_BUFFER_SIZE )
+        {
+            state_error = 1;
+            return;
+        }
+
+        memcpy(&state_buffer[state_length], data, length);
+    }
+
+    state_length += length;
+}
+
+/*------------------------------------------------
+ * state_read()
+ *
+ *  Read data from the record being restored.
+ *  A read past the end of the record is not done, and is flagged
+ *  as an error. With a NULL data pointer the data is skipped.
+ *
+ *  param:  Pointer to data buffer or NULL, and its length in bytes
+ *  return: Nothing
+ */
+void state_read(void *data, int length)
+{
+    if ( (state_index + length) > state_limit )
+    {
+        state_error = 1;
+        return;
+    }
+
+    if ( data )
+        memcpy(data, &state_buffer[state_index], length);
+
+    state_index += length;
+}
+
+/*------------------------------------------------
+ * state_build()
+ *
+ *  Build the machine state records in the buffer, after room
+ *  for the header, or measure the length of each record.
+ *
+ *  param:  1- measure record lengths, 0- write the records to the buffer
+ *  return: Nothing
+ */
+static void state_build(int measure)
+{
+    int     i, record_start;
+
+    state_length = STATE_HEADER_SIZE;
+    state_error = 0;
+    state_measure = measure;
+
+    for ( i = 0; i < STATE_RECORDS; i++ )
+    {
+        record_start = state_length;
+        state_length += STATE_RECORD_HEADER;
+
+        state_records[i].save();
+
+        record_length[i] = state_length - record_start - STATE_RECORD_HEADER;
+        if ( record_length[i] > STATE_RECORD_MAX )
+            state_error = 1;
+
+        if ( !measure && !state_error )
+        {
+            state_buffer[record_start] = state_records[i].type;
+            state_put16(&state_buffer[record_start + 1], (uint16_t) record_length[i]);
+        }
+    }
+
+    if ( (state_length + STATE_RECORD_HEADER) > STATE_BUFFER_SIZE )
+        state_error = 1;
+
+    if ( !measure && !state_error )
+    {
+        state_buffer[state_length] = STATE_REC_END;
+        state_put16(&state_buffer[state_length + 1], 0);
+    }
+
+    state_length += STATE_RECORD_HEADER;
+    state_measure = 0;
+}
+
+/*------------------------------------------------
+ * state_verify()
+ *
+ *  Check that the records of the file are the records of the running
+ *  build in order and length, and that the memory record decodes
+ *  to the memory ranges it holds.
+ *
+ *  param:  Payload length in bytes
+ *  return: 1- records match, 0- records do not match
+ */
+static int state_verify(int payload_length)
+{
+    int     i, length;
+
+    state_index = STATE_HEADER_SIZE;
+    state_error = 0;
+
+    for ( i = 0; i < STATE_RECORDS; i++ )
+    {
+        state_limit = STATE_HEADER_SIZE + payload_length;
+
+        if ( (length = state_record_begin(state_records[i].type)) < 0 )
+            return 0;
+
+        if ( state_records[i].verify )
+        {
+            if ( !state_records[i].verify(length) )
+                return 0;
+        }
+        else if ( length != record_length[i] )
+        {
+            dbg_printf(1, "state_verify()[%d]: Record %d length %d, expected %d.\n", __LINE__,
+                       state_records[i].type, length, record_length[i]);
+            return 0;
+        }
+
+        state_index = state_limit;
+    }
+
+    state_limit = STATE_HEADER_SIZE + payload_length;
+
+    return ( state_record_begin(STATE_REC_END) == 0 );
+}
+
+/*------------------------------------------------
+ * state_apply()
+ *
+ *  Restore the machine from the records of a verified file.
+ *  The interrupt controller is cleared first, and the PIA
+ *  record asserts the interrupt sources that were active.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void state_apply(void)
+{
+    int     i, length;
+
+    intr_init();
+
+    state_index = STATE_HEADER_SIZE;
+    state_error = 0;
+
+    for ( i = 0; i < STATE_RECORDS; i++ )
+    {
+        state_limit = STATE_BUFFER_SIZE;
+        length = state_record_begin(state_records[i].type);
+        state_limit = state_index + length;
+
+        state_records[i].restore();
+
+        state_index = state_limit;
+    }
+}
+
+/*------------------------------------------------
+ * state_record_begin()
+ *
+ *  Read a record header, and limit reads to the record.
+ *
+ *  param:  Expected record type
+ *  return: Record length, or -1 if the record is of another type or
+ *          does not fit the payload
+ */
+static int state_record_begin(int type)
+{
+    int     length;
+
+    if ( (state_index + STATE_RECORD_HEADER) > state_limit ||
+         state_buffer[state_index] != type )
+        return -1;
+
+    length = state_get16(&state_buffer[state_index + 1]);
+    state_index += STATE_RECORD_HEADER;
+
+    if ( (state_index + length) > state_limit )
+        return -1;
+
+    state_limit = state_index + length;
+
+    return length;
+}
+
+/*------------------------------------------------
+ * memory_save_state()
+ *
+ *  Write the memory ranges to the memory record.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void memory_save_state(void)
+{
+    memory_ranges_save(STATE_REC_MEMORY);
+}
+
+/*------------------------------------------------
+ * memory_restore_state()
+ *
+ *  Load the memory ranges from the memory record.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void memory_restore_state(void)
+{
+    memory_ranges_restore(STATE_REC_MEMORY);
+}
+
+/*------------------------------------------------
+ * memory_verify_state()
+ *
+ *  Check that the memory record holds exactly its memory ranges.
+ *
+ *  param:  Record length
+ *  return: 1- record is good, 0- bad record
+ */
+static int memory_verify_state(int length)
+{
+    return memory_ranges_verify(STATE_REC_MEMORY, length);
+}
+
+#if (DRAGON_MODEL==64)
+/*------------------------------------------------
+ * memory_high_save_state()
+ *
+ *  Write the Dragon 64 upper 32K RAM to its record, which is
+ *  kept apart from the memory record to fit the record length field.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void memory_high_save_state(void)
+{
+    memory_ranges_save(STATE_REC_MEMORY_HIGH);
+}
+
+/*------------------------------------------------
+ * memory_high_restore_state()
+ *
+ *  Load the Dragon 64 upper 32K RAM from its record.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void memory_high_restore_state(void)
+{
+    memory_ranges_restore(STATE_REC_MEMORY_HIGH);
+}
+
+/*------------------------------------------------
+ * memory_high_verify_state()
+ *
+ *  Check that the upper RAM record holds exactly its memory range.
+ *
+ *  param:  Record length
+ *  return: 1- record is good, 0- bad record
+ */
+static int memory_high_verify_state(int length)
+{
+    return memory_ranges_verify(STATE_REC_MEMORY_HIGH, length);
+}
+#endif
+
+/*------------------------------------------------
+ * memory_ranges_save()
+ *
+ *  Write the memory ranges of a record,
+ *  run-length encoded or as is.
+ *
+ *  param:  Record type
+ *  return: Nothing
+ */
+static void memory_ranges_save(int record)
+{
+    const uint8_t  *memory;
+    int             i;
+
+    for ( i = 0; i < (int)(sizeof(state_memory) / sizeof(state_memory[0])); i++ )
+    {
+        if ( state_memory[i].record != record )
+            continue;
+
+        memory = &mem_block(state_memory[i].block)[state_memory[i].offset];
+
+        if ( state_rle )
+            state_write_rle(memory, state_memory[i].length);
+        else
+            state_write(memory, state_memory[i].length);
+    }
+}
+
+/*------------------------------------------------
+ * memory_ranges_restore()
+ *
+ *  Load the memory ranges of a record.
+ *  The ranges are marked as loaded, so the display is redrawn and
+ *  decoded ROM instructions are discarded.
+ *
+ *  param:  Record type
+ *  return: Nothing
+ */
+static void memory_ranges_restore(int record)
+{
+    uint8_t    *memory;
+    int         i;
+
+    for ( i = 0; i < (int)(sizeof(state_memory) / sizeof(state_memory[0])); i++ )
+    {
+        if ( state_memory[i].record != record )
+            continue;
+
+        memory = mem_block_load_buffer(state_memory[i].block, state_memory[i].offset, state_memory[i].length);
+
+        if ( state_rle )
+            state_read_rle(memory, state_memory[i].length);
+        else
+            state_read(memory, state_memory[i].length);
+    }
+}
+
+/*------------------------------------------------
+ * memory_ranges_verify()
+ *
+ *  Check that a memory record holds exactly its memory ranges,
+ *  without loading them.
+ *
+ *  param:  Record type, record length
+ *  return: 1- record is good, 0- bad record
+ */
+static int memory_ranges_verify(int record, int length)
+{
+    int     i, record_end;
+
+    record_end = state_index + length;
+
+    for ( i = 0; i < (int)(sizeof(state_memory) / sizeof(state_memory[0])); i++ )
+    {
+        if ( state_memory[i].record != record )
+            continue;
+
+        if ( state_rle )
+        {
+            if ( !state_read_rle(0L, state_memory[i].length) )
+                return 0;
+        }
+        else
+        {
+            state_read(0L, state_memory[i].length);
+        }
+    }
+
+    return ( !state_error && state_index == record_end );
+}
+
+/*------------------------------------------------
+ * files_save_state()
+ *
+ *  Write the mounted files record: the first cluster and tape input position
+ *  of the CAS file, and the first cluster of each drive's disk image.
+ *  Disk images are read and written at the sector that the
+ *  disk controller addresses, so only their identity is saved.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void files_save_state(void)
+{
+    uint32_t    files[2 + LOADER_DISK_DRIVES];
+    int         drive;
+
+    files[1] = loader_cas_ftell(&files[0]);
+
+    for ( drive = 0; drive < LOADER_DISK_DRIVES; drive++ )
+        files[2 + drive] = loader_disk_img_cluster(drive);
+
+    state_write(files, sizeof(files));
+}
+
+/*------------------------------------------------
+ * files_restore_state()
+ *
+ *  Move the tape input of the mounted CAS file to its saved position,
+ *  and warn when the files mounted are not those of the saved state.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+static void files_restore_state(void)
+{
+    uint32_t    files[2 + LOADER_DISK_DRIVES];
+    int         drive;
+
+    state_read(files, sizeof(files));
+
+    if ( files[0] && !loader_cas_fseek(files[0], files[1]) )
+        dbg_printf(1, "files_restore_state()[%d]: CAS file of the machine state is not mounted.\n", __LINE__);
+
+    for ( drive = 0; drive < LOADER_DISK_DRIVES; drive++ )
+    {
+        if ( files[2 + drive] != loader_disk_img_cluster(drive) )
+            dbg_printf(1, "files_restore_state()[%d]: Drive %d does not hold the disk image of the machine state.\n", __LINE__, drive + 1);
+    }
+}
+
+/*------------------------------------------------
+ * state_write_rle()
+ *
+ *  Write data run-length encoded. Runs of three or more bytes are
+ *  encoded as a repeat, and the bytes between runs as literals.
+ *
+ *  param:  Pointer to data, and its length in bytes
+ *  return: Nothing
+ */
+static void state_write_rle(const uint8_t *data, int length)
+{
+    uint8_t control;
+    int     i, run, literal;
+
+    for ( i = 0; i < length; )
+    {
+        for ( run = 1; (i + run) < length && run < STATE_RLE_RUN_MAX && data[i + run] == data[i]; run++ );
+
+        if ( run >= STATE_RLE_RUN_MIN )
+        {
+            control = (uint8_t)(STATE_RLE_REPEAT | (run - STATE_RLE_RUN_MIN));
+            state_write(&control, 1);
+            state_write(&data[i], 1);
+            i += run;
+            continue;
+        }
+
+        /* Literal bytes up to the start of the next run
+         */
+        for ( literal = run; (i + literal) < length && literal < STATE_RLE_LITERAL_MAX; literal++ )
+        {
+            if ( (i + literal + 2) < length &&
+                 data[i + literal] == data[i + literal + 1] &&
+                 data[i + literal] == data[i + literal + 2] )
+                break;
+        }
+
+        control = (uint8_t)(literal - 1);
+        state_write(&control, 1);
+        state_write(&data[i], literal);
+        i += literal;
+    }
+}
+
+/*------------------------------------------------
+ * state_read_rle()
+ *
+ *  Read and decode run-length encoded data.
+ *  With a NULL data pointer the data is decoded and checked but not stored.
+ *
+ *  param:  Pointer to data buffer or NULL, and the decoded length in bytes
+ *  return: 1- data decoded, 0- encoding does not fit the length or the record
+ */
+static int state_read_rle(uint8_t *data, int length)
+{
+    uint8_t control, value;
+    int     i, count;
+
+    for ( i = 0; i < length; i += count )
+    {
+        control = 0;
+        state_read(&control, 1);
+
+        if ( control & STATE_RLE_REPEAT )
+            count = (control & ~STATE_RLE_REPEAT) + STATE_RLE_RUN_MIN;
+        else
+            count = control + 1;
+
+        if ( state_error || count > (length - i) )
+            return 0;
+
+        if ( control & STATE_RLE_REPEAT )
+        {
+            value = 0;
+            state_read(&value, 1);
+            if ( data )
+                memset(&data[i], value, count);
+        }
+        else
+        {
+            state_read((data ? &data[i] : 0L), count);
+        }
+
+        if ( state_error )
+            return 0;
+    }
+
+    return 1;
+}
+
+/*------------------------------------------------
+ * state_put16()
+ * state_put32()
+ * state_get16()
+ * state_get32()
+ *
+ *  Store and fetch little endian header fields.
+ *
+ *  param:  Pointer to the field, and value to store
+ *  return: Value fetched
+ */
+static void state_put16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t) value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void state_put32(uint8_t *buffer, uint32_t value)
+{
+    state_put16(buffer, (uint16_t) value);
+    state_put16(&buffer[2], (uint16_t)(value >> 16));
+}
+
+static uint16_t state_get16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint32_t state_get32(const uint8_t *buffer)
+{
+    return (uint32_t) state_get16(buffer) | ((uint32_t) state_get16(&buffer[2]) << 16);
+}
+
+/*------------------------------------------------
+ * state_checksum()
+ *
+ *  Calculate the checksum of the payload, a rotate and add
+ *  over its bytes.
+ *
+ *  param:  Pointer to data, and its length in bytes
+ *  return: Checksum
+ */
+static uint32_t state_checksum(const uint8_t *data, int length)
+{
+    uint32_t    checksum;
+    int         i;
+
+    checksum = 0;
+
+    for ( i = 0; i < length; i++ )
+        checksum = ((checksum << 1) | (checksum >> 31)) + data[i];
+
+    return checksum;
+}
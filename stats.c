@@ -0,0 +1,272 @@
+/********************************************************************
+ * stats.c
+ *
+ *  Emulator performance counters.
+ *  Over a period of one second of emulated frames, count the emulated
+ *  CPU cycles and instructions, the host time per frame, the frames
+ *  that were not rendered, and the host time spent rendering video,
+ *  running disk image jobs, transferring SD card blocks and in
+ *  memory mapped IO call-backs.
+ *  The counters of a period are shown in an overlay on the top text rows
+ *  of the display, and sent to the debug output.
+ *  Counting is off, and costs one test per timed section,
+ *  until the overlay or the debug output is turned on.
+ *  Timed sections nest, so SD card time is also counted in disk IO time
+ *  when a disk image job reads the SD card.
+ *
+ *  October 2026
+ *
+ *******************************************************************/
+
+#include    <stdint.h>
+
+#include    "config.h"
+#include    "dbgmsg.h"
+#include    "printf.h"
+
+#include    "cpu.h"
+#include    "rpi.h"
+#include    "sched.h"
+#include    "vdg.h"
+
+#include    "stats.h"
+
+#if (EMU_STATS==1)
+
+/* -----------------------------------------
+   Local definitions
+----------------------------------------- */
+#define     STATS_PERIOD_FRAMES     50      // Frames per counting period, one second
+#define     STATS_LINES             3       // Overlay text rows
+#define     STATS_LINE_LENGTH       33      // Overlay text row, 32 characters and terminator
+
+/* -----------------------------------------
+   Module static functions
+----------------------------------------- */
+static void stats_report(uint32_t host_usec);
+static uint32_t stats_percent(uint32_t usec, uint32_t host_usec);
+
+/* -----------------------------------------
+   Module globals
+----------------------------------------- */
+static int          stats_overlay = 0;      // Show counters in a display overlay
+static int          stats_dump = 0;         // Send counters to the debug output
+static volatile int stats_active = 0;       // Overlay or debug output is on
+
+static uint32_t     period_start_time;
+static uint32_t     period_start_cycles;
+static uint32_t     period_start_instructions;
+static int          period_frames;
+static int          period_skipped;
+
+static uint32_t     timer_start[STATS_TIMERS];
+static uint32_t     timer_usec[STATS_TIMERS];
+
+/*------------------------------------------------
+ * stats_init()
+ *
+ *  Initialize the performance counters, with the overlay
+ *  and the debug output off.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void stats_init(void)
+{
+    stats_overlay = 0;
+    stats_dump = 0;
+    stats_active = 0;
+
+    stats_reset();
+}
+
+/*------------------------------------------------
+ * stats_reset()
+ *
+ *  Start a new counting period. Called when counting is turned on,
+ *  and after time spent outside the emulation, such as in the loader.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void stats_reset(void)
+{
+    int     i;
+
+    period_start_time = rpi_system_timer();
+    period_start_cycles = sched_get_cycles();
+    period_start_instructions = cpu_instructions();
+    period_frames = 0;
+    period_skipped = 0;
+
+    for ( i = 0; i < STATS_TIMERS; i++ )
+    {
+        timer_start[i] = 0;
+        timer_usec[i] = 0;
+    }
+}
+
+/*------------------------------------------------
+ * stats_frame()
+ *
+ *  Count a VDG field, called at every VSYNC. At the end of a period
+ *  show the period's counters and start a new period.
+ *
+ *  param:  1- the frame is rendered, 0- the frame is skipped
+ *  return: Nothing
+ */
+void stats_frame(int rendered)
+{
+    if ( !stats_active )
+        return;
+
+    period_frames++;
+    if ( !rendered )
+        period_skipped++;
+
+    if ( period_frames < STATS_PERIOD_FRAMES )
+        return;
+
+    stats_report(rpi_system_timer() - period_start_time);
+    stats_reset();
+}
+
+/*------------------------------------------------
+ * stats_overlay_toggle()
+ *
+ *  Turn the display overlay of the counters on or off.
+ *  The overlay shows from the end of the first counting period.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void stats_overlay_toggle(void)
+{
+    int     i;
+
+    stats_overlay = !stats_overlay;
+
+    if ( !stats_overlay )
+    {
+        for ( i = 0; i < STATS_LINES; i++ )
+            vdg_overlay(i, 0);
+    }
+
+    if ( !stats_active )
+        stats_reset();
+
+    stats_active = stats_overlay || stats_dump;
+}
+
+/*------------------------------------------------
+ * stats_dump_toggle()
+ *
+ *  Turn the debug output of the counters, once per period, on or off.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void stats_dump_toggle(void)
+{
+    stats_dump = !stats_dump;
+
+    dbg_printf(0, "Performance counters output: %s\n", stats_dump ? "on" : "off");
+
+    if ( !stats_active )
+        stats_reset();
+
+    stats_active = stats_overlay || stats_dump;
+}
+
+/*------------------------------------------------
+ * stats_timer_start()
+ *
+ *  Start timing a section of host time.
+ *
+ *  param:  Host time accumulator
+ *  return: Nothing
+ */
+void stats_timer_start(stats_timer_t timer)
+{
+    if ( stats_active )
+        timer_start[timer] = rpi_system_timer();
+}
+
+/*------------------------------------------------
+ * stats_timer_stop()
+ *
+ *  Stop timing a section of host time, and add the section's
+ *  time to its accumulator. A section that started before counting
+ *  was turned on, or before the period started, is not counted.
+ *
+ *  param:  Host time accumulator
+ *  return: Nothing
+ */
+void stats_timer_stop(stats_timer_t timer)
+{
+    if ( stats_active && timer_start[timer] )
+    {
+        timer_usec[timer] += rpi_system_timer() - timer_start[timer];
+        timer_start[timer] = 0;
+    }
+}
+
+/*------------------------------------------------
+ * stats_report()
+ *
+ *  Format the counters of the period that ended, and show them
+ *  in the display overlay and send them to the debug output.
+ *
+ *  param:  Host time of the period in micro-seconds
+ *  return: Nothing
+ */
+static void stats_report(uint32_t host_usec)
+{
+    char        line[STATS_LINES][STATS_LINE_LENGTH];
+    uint32_t    cycles, instructions;
+    int         i;
+
+    if ( host_usec == 0 )
+        host_usec = 1;
+
+    cycles = sched_get_cycles() - period_start_cycles;
+    instructions = cpu_instructions() - period_start_instructions;
+
+    snprintf(line[0], STATS_LINE_LENGTH, "FRAMES %d SKIP %d CYC/FR %u",
+             period_frames, period_skipped, cycles / period_frames);
+    snprintf(line[1], STATS_LINE_LENGTH, "US/FR %u KHZ %u KIPS %u",
+             host_usec / period_frames,
+             (uint32_t)(((uint64_t) cycles * 1000) / host_usec),
+             (uint32_t)(((uint64_t) instructions * 1000) / host_usec));
+    snprintf(line[2], STATS_LINE_LENGTH, "VDG %u%% DSK %u%% SD %u%% IO %u%%",
+             stats_percent(timer_usec[STATS_RENDER], host_usec),
+             stats_percent(timer_usec[STATS_DISK_IO], host_usec),
+             stats_percent(timer_usec[STATS_SD], host_usec),
+             stats_percent(timer_usec[STATS_IO_CALLBACK], host_usec));
+
+    if ( stats_overlay )
+    {
+        for ( i = 0; i < STATS_LINES; i++ )
+            vdg_overlay(i, line[i]);
+    }
+
+    if ( stats_dump )
+    {
+        dbg_printf(0, "stats: %s, %s, %s\n", line[0], line[1], line[2]);
+    }
+}
+
+/*------------------------------------------------
+ * stats_percent()
+ *
+ *  Return a host time accumulator as a percentage of the period.
+ *
+ *  param:  Accumulated micro-seconds, host time of the period in micro-seconds
+ *  return: Percent of the period
+ */
+static uint32_t stats_percent(uint32_t usec, uint32_t host_usec)
+{
+    return (uint32_t)(((uint64_t) usec * 100) / host_usec);
+}
+
+#endif  /* EMU_STATS */
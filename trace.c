@@ -12,6 +12,7 @@
 #include    <ctype.h>
 #include    <string.h>
 
+#include    "config.h"
 #include    "mem.h"
 #include    "trace.h"
 
@@ -20,11 +21,17 @@
 ----------------------------------------- */
 #define     MAX_TOKENS      3       // Max number of command line tokens
 #define     CMD_DELIM       " \t"   // Command line white-space delimiters
+#define     PROFILE_LINES   20      // Hot spots and op-codes listed in the profile report
+#define     PROFILE_OPS     512     // Op-code counts, more than the machine_code[] entries
 
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
+static void print_registers(cpu_state_t* state);
 static void print_decorated_cc(uint8_t cc);
+#if (CPU_PROFILE==1)
+static int  take_max_count(uint32_t *counts, int length);
+#endif
 
 /* -----------------------------------------
    Module globals
@@ -36,14 +43,20 @@ static void print_decorated_cc(uint8_t cc);
  *  Pause after break-point to accept user commands:
  *
  *  m <start> <end>                  -  Display memory between <start> and <end>
- *  r [a|b|d|x|y|u|s|dp|cc|pc] <val> -  Change register value
- *  g <address>                      -  Run to next breakpoint
+ *  r                                -  Display registers
+ *  b <address>                      -  Set breakpoint
+ *  bc <address>|*                   -  Clear breakpoint, or all breakpoints
+ *  w <address> [r|w|rw]             -  Set watchpoint on reads, writes (default) or both
+ *  wc <address>|*                   -  Clear watchpoint, or all watchpoints
+ *  bl                               -  List breakpoints and watchpoints
+ *  h                                -  Display instruction history
+ *  g [<address>]                    -  Run to next breakpoint, optionally set at <address>
  *  <cr>                             -  Step program command on next PC
  * 
- *  param:  Pointer to breakpoint address
+ *  param:  None
  *  return: Breakpoint trigger 0=reset the trigger for another trap, 1=don't reset the trigger.
  */
-int trace_action(uint16_t* breakpoint_address)
+int trace_action(void)
 {
     char        input_string[20];
     char       *tokens[MAX_TOKENS] = {0, 0, 0};
@@ -51,16 +64,18 @@ int trace_action(uint16_t* breakpoint_address)
     char       *temp_cli;
     int         num_tokens;
     int         exit_trace = 0;
-    int         i;
+    int         i, mode;
     uint8_t     c;
     uint16_t    start, end;
+    cpu_state_t state;
 
     while ( !exit_trace )
     {
         printf(">");
 
-        fgets(input_string, sizeof(input_string), stdin);
-        input_string[strlen(input_string)-1] = 0;
+        if ( fgets(input_string, sizeof(input_string), stdin) == 0L )
+            return 0;
+        input_string[strcspn(input_string, "\n")] = 0;
 
         /* Separate command line into tokens
          */
@@ -83,7 +98,7 @@ int trace_action(uint16_t* breakpoint_address)
 
         /* Parse and execute commands
          */
-        else if ( strcmp(tokens[0], "m") == 0L )
+        else if ( strcmp(tokens[0], "m") == 0L && num_tokens == 3 )
         {
             start = ((uint16_t) strtol(tokens[1], 0L, 16)) & 0xfff0;
             end = (((uint16_t) strtol(tokens[2], 0L, 16)) & 0xfff0) + 0x000f;
@@ -108,11 +123,71 @@ int trace_action(uint16_t* breakpoint_address)
         }
         else if ( strcmp(tokens[0], "r") == 0L )
         {
-            printf("Not implemented.\n");
+            cpu_get_state(&state);
+            print_registers(&state);
+        }
+        else if ( strcmp(tokens[0], "b") == 0L && num_tokens == 2 )
+        {
+            cpu_breakpoint((uint16_t) strtol(tokens[1], 0L, 16), 1);
+        }
+        else if ( strcmp(tokens[0], "bc") == 0L && num_tokens == 2 )
+        {
+            if ( strcmp(tokens[1], "*") == 0L )
+            {
+                for ( i = 0; i < MEMORY; i++ )
+                    cpu_breakpoint((uint16_t) i, 0);
+            }
+            else
+            {
+                cpu_breakpoint((uint16_t) strtol(tokens[1], 0L, 16), 0);
+            }
+        }
+        else if ( strcmp(tokens[0], "w") == 0L && num_tokens >= 2 )
+        {
+            mode = MEM_WATCH_WRITE;
+            if ( num_tokens == 3 )
+            {
+                mode = 0;
+                if ( strchr(tokens[2], 'r') )
+                    mode |= MEM_WATCH_READ;
+                if ( strchr(tokens[2], 'w') )
+                    mode |= MEM_WATCH_WRITE;
+            }
+
+            if ( mode == 0 || mem_define_watch((uint16_t) strtol(tokens[1], 0L, 16), mode) != MEM_OK )
+                printf("Cannot set watchpoint.\n");
+        }
+        else if ( strcmp(tokens[0], "wc") == 0L && num_tokens == 2 )
+        {
+            if ( strcmp(tokens[1], "*") == 0L )
+            {
+                for ( i = 0; i < MEMORY; i++ )
+                    mem_define_watch(i, 0);
+            }
+            else
+            {
+                mem_define_watch((uint16_t) strtol(tokens[1], 0L, 16), 0);
+            }
+        }
+        else if ( strcmp(tokens[0], "bl") == 0L )
+        {
+            for ( i = 0; i < MEMORY; i++ )
+            {
+                if ( cpu_is_breakpoint((uint16_t) i) )
+                    printf("b %04x (%s)\n", i, cpu_get_menmonic((uint16_t) i));
+
+                if ( (mode = mem_get_watch(i)) != 0 )
+                    printf("w %04x %s%s\n", i, (mode & MEM_WATCH_READ) ? "r" : "", (mode & MEM_WATCH_WRITE) ? "w" : "");
+            }
+        }
+        else if ( strcmp(tokens[0], "h") == 0L )
+        {
+            trace_print_history();
         }
         else if ( strcmp(tokens[0], "g") == 0L )
         {
-            *breakpoint_address = ((uint16_t) strtol(tokens[1], 0L, 16));
+            if ( num_tokens == 2 )
+                cpu_breakpoint((uint16_t) strtol(tokens[1], 0L, 16), 1);
             exit_trace = 1;
             i = 0;
         }
@@ -152,10 +227,166 @@ void trace_print_registers(cpu_state_t* state)
 
     /* Print register content resulting from execution
      */
-    printf("\na=0x%02x b=0x%02x x=0x%04x y=0x%04x ", state->a, state->b, state->x, state->y);
+    printf("\n");
+    print_registers(state);
+}
+
+/*------------------------------------------------
+ * trace_print_history()
+ *
+ *  Print the CPU instruction history, oldest instruction first,
+ *  with the registers after each instruction.
+ *
+ *  param:  None
+ *  return: None
+ */
+void trace_print_history(void)
+{
+    cpu_history_t   entry;
+    int             n, i;
+
+    for ( n = 0; cpu_history(n, &entry); n++ );
+
+    printf("Instruction history (%d):\n", n);
+
+    while ( n-- > 0 )
+    {
+        cpu_history(n, &entry);
+
+        printf("%10u %04X: (%-5s) ", entry.cycles, entry.pc, cpu_get_code_menmonic(entry.code));
+        for ( i = 0; i < CPU_HISTORY_CODE; i++ )
+        {
+            if ( i < entry.bytes )
+                printf("%02x ", entry.code[i]);
+            else
+                printf("   ");
+        }
+
+        printf("a=%02x b=%02x x=%04x y=%04x u=%04x s=%04x dp=%02x ",
+               entry.a, entry.b, entry.x, entry.y, entry.u, entry.s, entry.dp);
+        print_decorated_cc(entry.cc);
+        printf("\n");
+    }
+}
+
+/*------------------------------------------------
+ * trace_print_watch()
+ *
+ *  Print the watched address access that stopped the CPU, if any.
+ *
+ *  param:  None
+ *  return: None
+ */
+void trace_print_watch(void)
+{
+    int             address;
+    mem_operation_t op;
+
+    if ( mem_watch_triggered(&address, &op) )
+        printf("Watchpoint: %s 0x%04x\n", (op == MEM_READ) ? "read" : "write", address);
+}
+
+#if (CPU_PROFILE==1)
+/*------------------------------------------------
+ * trace_print_profile()
+ *
+ *  Print the CPU execution profile: the PC buckets with the most
+ *  executed instructions, with the mnemonic of the first instruction
+ *  counted in each bucket, and the most executed op-codes.
+ *
+ *  param:  None
+ *  return: None
+ */
+void trace_print_profile(void)
+{
+    uint32_t    bucket_counts[CPU_PROFILE_BUCKETS];
+    uint32_t    op_counts[PROFILE_OPS];
+    uint32_t    count, total;
+    uint16_t    first_pc, op_code;
+    const char *mnemonic;
+    int         i, n, ops;
+
+    total = 0;
+    for ( i = 0; i < CPU_PROFILE_BUCKETS; i++ )
+    {
+        bucket_counts[i] = cpu_profile_pc(i, &first_pc);
+        total += bucket_counts[i];
+    }
+
+    for ( ops = 0; ops < PROFILE_OPS && cpu_profile_op(ops, &op_counts[ops], &op_code, &mnemonic); ops++ );
+
+    printf("Profile: %u instructions\n", total);
+    if ( total == 0 )
+        return;
+
+    printf("PC hot spots:\n");
+    for ( n = 0; n < PROFILE_LINES; n++ )
+    {
+        i = take_max_count(bucket_counts, CPU_PROFILE_BUCKETS);
+        if ( i < 0 )
+            break;
+
+        count = cpu_profile_pc(i, &first_pc);
+        printf("  %04X-%04X %10u %5.1f%%  %04X: (%s)\n",
+               i * CPU_PROFILE_BUCKET_SIZE, (i + 1) * CPU_PROFILE_BUCKET_SIZE - 1,
+               count, (100.0 * count) / total, first_pc, cpu_get_menmonic(first_pc));
+    }
+
+    printf("Op-codes:\n");
+    for ( n = 0; n < PROFILE_LINES; n++ )
+    {
+        i = take_max_count(op_counts, ops);
+        if ( i < 0 )
+            break;
+
+        cpu_profile_op(i, &count, &op_code, &mnemonic);
+        printf("  %-5s %04X %10u %5.1f%%\n", mnemonic, op_code, count, (100.0 * count) / total);
+    }
+}
+
+/*------------------------------------------------
+ * take_max_count()
+ *
+ *  Find the largest count in an array of counts, and clear it
+ *  so that the next call finds the next largest.
+ *
+ *  param:  Array of counts and its length
+ *  return: Index of the largest count, -1 if all counts are zero
+ */
+static int take_max_count(uint32_t *counts, int length)
+{
+    int     i, max_index = -1;
+
+    for ( i = 0; i < length; i++ )
+    {
+        if ( counts[i] && (max_index < 0 || counts[i] > counts[max_index]) )
+            max_index = i;
+    }
+
+    if ( max_index >= 0 )
+        counts[max_index] = 0;
+
+    return max_index;
+}
+#endif
+
+/*------------------------------------------------
+ * print_registers()
+ *
+ *  Print CPU register content.
+ *
+ *  param:  Pointer to CPU state structure
+ *  return: None
+ */
+static void print_registers(cpu_state_t* state)
+{
+    printf("a=0x%02x b=0x%02x x=0x%04x y=0x%04x ", state->a, state->b, state->x, state->y);
     print_decorated_cc(state->cc);
     printf("\n");
     printf("dp=0x%02x u=0x%04x s=0x%04x pc=0x%04x\n", state->dp, state->u, state->s, state->pc);
+#if (CPU_6309==1)
+    printf("e=0x%02x f=0x%02x v=0x%04x md=0x%02x\n", state->e, state->f, state->v, state->md);
+#endif
 }
 
 /*------------------------------------------------
@@ -12,6 +12,15 @@
  *******************************************************************/
 
 #include    <stdint.h>
+#include    <string.h>
+
+#include    "config.h"
+
+#if (VDG_RENDER_THREAD==1) && (RPI_BARE_METAL==0)
+    #include    <pthread.h>
+    #include    <semaphore.h>
+    #include    <unistd.h>
+#endif
 
 #include    "cpu.h"
 #include    "mem.h"
@@ -22,6 +31,10 @@
 #include    "dragon/font.h"
 #include    "dragon/semigraph.h"
 
+#if (VDG_SIMD==1)
+  #include    <arm_neon.h>
+#endif
+
 /* -----------------------------------------
    Local definitions
 ----------------------------------------- */
@@ -31,6 +44,23 @@
 #define     SCREEN_WIDTH_CHAR       32
 #define     SCREEN_HEIGHT_CHAR      16
 
+/* Frame buffer geometry, the display scaled by VDG_SCALE
+ * and centered in an optional border
+ */
+#if (VDG_BORDER==1)
+#define     BORDER_WIDTH_PIX        (32 * VDG_SCALE)
+#define     BORDER_HEIGHT_PIX       (24 * VDG_SCALE)
+#else
+#define     BORDER_WIDTH_PIX        0
+#define     BORDER_HEIGHT_PIX       0
+#endif
+
+#define     SCALED_WIDTH_PIX        (SCREEN_WIDTH_PIX * VDG_SCALE)
+#define     FRAME_WIDTH_PIX         (SCALED_WIDTH_PIX + 2 * BORDER_WIDTH_PIX)
+#define     FRAME_HEIGHT_PIX        (SCREEN_HEIGHT_PIX * VDG_SCALE + 2 * BORDER_HEIGHT_PIX)
+#define     SCAN_LINE_BYTES         (FRAME_WIDTH_PIX * VDG_SCALE)   // Frame bytes of a scaled display scan line
+#define     GLYPH_RUN_PIX           (FONT_WIDTH * VDG_SCALE)        // Frame pixels of a character cell scan line
+
 #define     FB_BLACK                0
 #define     FB_BLUE                 1
 #define     FB_GREEN                2
@@ -69,6 +99,42 @@
 #define     RES_ROW_REP             1       // Row repeat count
 #define     RES_MEM                 2       // Memory bytes per page
 
+/* Graphics mode pixel formats, bits per pixel and horizontal pixel repeat
+ */
+#define     PIX_1BPP_X1             0       // GRAPHICS_6R
+#define     PIX_1BPP_X2             1       // GRAPHICS_1R, 2R, 3R
+#define     PIX_2BPP_X2             2       // GRAPHICS_2C, 3C, 6C
+#define     PIX_2BPP_X4             3       // GRAPHICS_1C
+
+#define     BENCH_PATTERNS          5       // Video memory fill patterns of vdg_benchmark()
+
+/* Rendered bands are queued to the render thread with a copy of their video memory,
+ * so the thread draws the band as it was at band time while the CPU keeps running.
+ * The largest band holds 1/16 of the 6144 byte graphics modes.
+ * On bare metal the render thread is a secondary core, that sleeps on WFE
+ * and is woken by SEV when a band is queued.
+ */
+#if (VDG_RENDER_THREAD==1)
+    #define     BAND_JOB_QUEUE      32      // Band jobs, two frames, must be a power of 2
+    #define     BAND_JOB_MASK       (BAND_JOB_QUEUE-1)
+    #define     BAND_MEM_MAX        (6144 / VDG_BANDS)
+    #define     BAND_LINES_MAX      (BAND_MEM_MAX / MEM_DIRTY_LINE)
+  #if (RPI_BARE_METAL==0)
+    #define     render_barrier()    __sync_synchronize()
+    #define     render_wait()       usleep(100)
+    #define     render_notify()     sem_post(&jobs_queued)
+  #else
+    #define     render_barrier()    __asm__ __volatile__ ("mcr p15, 0, %0, c7, c10, 5" : : "r" (0) : "memory")
+    #define     render_wait()       __asm__ __volatile__ ("" ::: "memory")
+    #define     render_notify()     __asm__ __volatile__ ("sev")
+  #endif
+#endif
+
+/* Renderers read video memory and its dirty lines through these,
+ * the emulated memory, or the render thread's copy of it
+ */
+#define     vdg_video_read(a)       (render_mem[((a) & (MEMORY-1))])
+
 typedef enum
 {                       // Colors   Res.     Bytes BASIC
     ALPHA_INTERNAL = 0, // 2 color  32x16    512   Default
@@ -90,16 +156,75 @@ typedef enum
     UNDEFINED,          // Undefined
 } video_mode_t;
 
+/* Render descriptor of a video mode and its settings,
+ * with the renderer function that draws a range of bands in the mode.
+ */
+typedef struct render_desc_t render_desc_t;
+
+typedef void (*vdg_renderer_t)(const render_desc_t *desc, int first_row, int rows);
+
+struct render_desc_t
+{
+    video_mode_t    mode;
+    vdg_renderer_t  renderer;
+    int             vdg_mem_base;   // Video memory start address
+    int             video_mem;      // Video memory bytes
+    int             band_mem;       // Video memory bytes per band
+    int             row_rep;        // Scan lines per pixel row
+    int             color_set;      // PIA color set select
+    uint32_t        settings;       // Video memory offset, SAM mode and PIA mode
+};
+
+#if (VDG_RENDER_THREAD==1)
+/* A band queued to the render thread
+ */
+typedef struct
+{
+    render_desc_t   desc;                   // Video settings the band is drawn with
+    int             band;
+    int             refresh;                // Redraw all lines of the band
+    int             draw;                   // Band was changed, its video memory is copied
+    int             overlay;                // Draw the band's overlay row
+    uint8_t         video[BAND_MEM_MAX];    // Band video memory
+    uint8_t         dirty[BAND_LINES_MAX];  // Dirty state of the band's memory lines
+    uint8_t         overlay_chars[SCREEN_WIDTH_CHAR];
+} band_job_t;
+#endif
+
 /* -----------------------------------------
    Module static functions
 ----------------------------------------- */
-static void vdg_render_alpha_semi4(int vdg_mem_base);
-static void vdg_render_semi6(int vdg_mem_base);
-static void vdg_render_semi_ext(video_mode_t mode, int vdg_mem_base);
-static void vdg_render_resl_graph(video_mode_t mode, int vdg_mem_base);
-static void vdg_render_color_graph(video_mode_t mode, int vdg_mem_base);
+static void vdg_render_alpha_semi4(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_semi6(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_semi_ext(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_resl_graph(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_color_graph(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_unsupported(const render_desc_t *desc, int first_row, int rows);
+static void vdg_render_graph_rows(int pixel_format, const render_desc_t *desc, int first_row, int rows);
+static void vdg_expand_row(int pixel_format, int color_set, const uint8_t *row_data,
+                           int row_bytes, uint8_t *screen_buffer);
+static void vdg_copy_row(uint8_t *dest_row, const uint8_t *src_row);
+static uint8_t *vdg_draw_text_line(uint8_t *screen_buffer, uint8_t (*glyphs)[FONT_HEIGHT][GLYPH_RUN_PIX],
+                                   const uint8_t *row_chars, int font_row);
+static void vdg_build_descriptor(render_desc_t *desc, video_mode_t mode);
+static void vdg_draw_overlay(int row, const uint8_t *text);
+static void vdg_build_glyph_tables(void);
+#if (VDG_SIMD==0)
+static void vdg_build_pixel_tables(void);
+#endif
 
 static video_mode_t vdg_get_mode(void);
+static int vdg_line_changed(int address);
+
+#if (VDG_RENDER_THREAD==1)
+static void  vdg_band_publish(int band, int refresh, int draw, int overlay);
+static void  vdg_band_job_render(const band_job_t *job);
+static int   vdg_render_start(void);
+static void  vdg_render_loop(void);
+#if (RPI_BARE_METAL==0)
+static void *vdg_render_thread(void *arg);
+#endif
+#endif
 
 /* -----------------------------------------
    Module globals
@@ -107,11 +232,82 @@ static video_mode_t vdg_get_mode(void);
 static uint8_t      video_ram_offset;
 static int          sam_video_mode;
 static uint8_t      pia_video_mode;
-static video_mode_t current_mode;
-static video_mode_t prev_mode;
+static int          settings_changed;       // Video settings changed since the render descriptor was built
+static render_desc_t render_desc;           // Render descriptor of the current video settings
+
+static int          refresh_all;            // Redraw all lines, not only changed ones
+static int          frame_changed;          // A band was redrawn since the last frame flip
+
+static const uint8_t *render_mem = mem_data;    // Video memory the renderers read
+static const uint8_t *render_dirty = mem_dirty; // and its dirty lines
+
+#if (VDG_RENDER_THREAD==1)
+/* Band job queue, written by the emulation and read by the render thread.
+ * The render thread keeps a copy of video memory built from the queued bands.
+ */
+static band_job_t           band_jobs[BAND_JOB_QUEUE];
+static volatile uint32_t    job_head = 0;       // Next job to write, emulation
+static volatile uint32_t    job_tail = 0;       // Next job to render, render thread
+#if (RPI_BARE_METAL==0)
+static sem_t                jobs_queued;
+static pthread_t            render_thread_id;
+#endif
+static int                  render_thread_running = 0;  // '1' running, '-1' failed to start
+
+static uint8_t              render_thread_mem[MEMORY];
+static uint8_t              render_thread_dirty[MEM_DIRTY_LINES];
+#endif
+
+/* Video memory offset, SAM and PIA modes that each band was last rendered with
+ */
+static uint32_t     band_settings[VDG_BANDS];
+
+/* Overlay text rows drawn over the top bands of the display
+ */
+static uint8_t      overlay_chars[VDG_OVERLAY_ROWS][SCREEN_WIDTH_CHAR];
+static int          overlay_shown[VDG_OVERLAY_ROWS];
+static int          overlay_changed[VDG_OVERLAY_ROWS];
+
+static uint8_t *fbp;                        // Top left pixel of the display in the off-screen frame
+
+/* Off-screen frame in cached memory that the renderers draw into.
+ * It is copied to the RPi frame buffer by rpi_fb_flip() once per rendered frame.
+ */
+static uint8_t  frame_buffer[FRAME_WIDTH_PIX * FRAME_HEIGHT_PIX];
+
+/* Pre-rendered pixel runs of a character cell scan line, indexed by
+ * PIA color set select, character byte, and font scan line.
+ * Built once by vdg_init() for alphanumeric and semigraphics 4 cells,
+ * and for semigraphics 6 cells, with pixels already scaled by VDG_SCALE.
+ */
+static uint8_t  glyph_alpha_semi4[2][256][FONT_HEIGHT][GLYPH_RUN_PIX];
+static uint8_t  glyph_semi6[2][256][FONT_HEIGHT][GLYPH_RUN_PIX];
+
+#if (VDG_SIMD==0)
+/* Pre-rendered pixel runs of a graphics mode video memory byte, indexed by
+ * PIA color set select and video byte, for each horizontal pixel repeat count.
+ * Pixels are already scaled by VDG_SCALE.
+ */
+static uint8_t  pixels_resl_x1[2][256][8 * VDG_SCALE];      // GRAPHICS_6R
+static uint8_t  pixels_resl_x2[2][256][16 * VDG_SCALE];     // GRAPHICS_1R, 2R, 3R
+static uint8_t  pixels_color_x2[2][256][8 * VDG_SCALE];     // GRAPHICS_2C, 3C, 6C
+static uint8_t  pixels_color_x4[2][256][16 * VDG_SCALE];    // GRAPHICS_1C
+#else
+/* NEON lane constants for expanding one graphics mode video memory byte:
+ * bit masks of a 1-bit pixel per lane, and right shifts that bring a 2-bit
+ * pixel to the low bits of its lanes.
+ */
+static const uint8_t neon_bit_mask_x1[8]  = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+static const uint8_t neon_bit_mask_x2[16] = { 0x80, 0x80, 0x40, 0x40, 0x20, 0x20, 0x10, 0x10,
+                                              0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x01 };
+static const int8_t  neon_shift_x2[8]     = { -6, -6, -4, -4, -2, -2, 0, 0 };
+static const int8_t  neon_shift_x4[16]    = { -6, -6, -6, -6, -4, -4, -4, -4,
+                                              -2, -2, -2, -2,  0,  0,  0,  0 };
+#endif
 
-static uint8_t *fbp;
-static uint8_t  pixel_row[SCREEN_WIDTH_PIX];
+/* Frame buffer pixels per video memory byte, by graphics pixel format
+ */
+static const int pixel_run[] = { 8 * VDG_SCALE, 16 * VDG_SCALE, 8 * VDG_SCALE, 16 * VDG_SCALE };
 
 /* The following table lists the pixel ratio of columns and rows
  * relative to a 768x384 frame buffer resolution.
@@ -135,6 +331,25 @@ static const int resolution[][3] = {
     { 1, 1, 6144 },  // DMA, 2 color 256x192 6144B
 };
 
+static const vdg_renderer_t renderer[] = {
+    vdg_render_alpha_semi4,     // ALPHA_INTERNAL
+    vdg_render_semi6,           // ALPHA_EXTERNAL
+    vdg_render_alpha_semi4,     // SEMI_GRAPHICS_4
+    vdg_render_semi6,           // SEMI_GRAPHICS_6
+    vdg_render_semi_ext,        // SEMI_GRAPHICS_8
+    vdg_render_semi_ext,        // SEMI_GRAPHICS_12
+    vdg_render_semi_ext,        // SEMI_GRAPHICS_24
+    vdg_render_color_graph,     // GRAPHICS_1C
+    vdg_render_resl_graph,      // GRAPHICS_1R
+    vdg_render_color_graph,     // GRAPHICS_2C
+    vdg_render_resl_graph,      // GRAPHICS_2R
+    vdg_render_color_graph,     // GRAPHICS_3C
+    vdg_render_resl_graph,      // GRAPHICS_3R
+    vdg_render_color_graph,     // GRAPHICS_6C
+    vdg_render_resl_graph,      // GRAPHICS_6R
+    vdg_render_unsupported,     // DMA
+};
+
 static const char* mode_name[] = {
     "ALPHA_INT",
     "ALPHA_EXT",
@@ -186,90 +401,220 @@ void vdg_init(void)
     video_ram_offset = 0x02;    // For offset 0x400 text screen
     sam_video_mode = 0;         // Alphanumeric
 
-    fbp = rpi_fb_init(SCREEN_WIDTH_PIX, SCREEN_HEIGHT_PIX);
-    if ( fbp == 0L )
+    if ( rpi_fb_init(FRAME_WIDTH_PIX, FRAME_HEIGHT_PIX) == 0L )
     {
         dbg_printf(0, "vdg_init()[%d]: Frame buffer error.\n", __LINE__);
         rpi_halt();
     }
 
-    /* Default startup mode of Dragon 32
+    fbp = frame_buffer + BORDER_HEIGHT_PIX * FRAME_WIDTH_PIX + BORDER_WIDTH_PIX;
+
+    vdg_build_glyph_tables();
+#if (VDG_SIMD==0)
+    vdg_build_pixel_tables();
+#endif
+
+    /* Default startup mode of Dragon 32, the render descriptor
+     * is built on first render
      */
-    current_mode = ALPHA_INTERNAL;
-    prev_mode = UNDEFINED;
+    render_desc.mode = UNDEFINED;
+    settings_changed = 1;
+
+    /* Force a full screen redraw on first render
+     */
+    memset(band_settings, 0xff, sizeof(band_settings));
+    frame_changed = 0;
+
+    memset(overlay_shown, 0, sizeof(overlay_shown));
+    memset(overlay_changed, 0, sizeof(overlay_changed));
 }
 
 /*------------------------------------------------
  * vdg_render()
  *
- *  Render video display.
- *  A full screen rendering is performed at every invocation on the function.
- *  The function should be called periodically and will execute a screen refresh only
- *  if 20 milliseconds of more have elapsed since the last refresh (50Hz).
+ *  Render the complete video display, all bands in one pass.
+ *  The function is used when the display is not rendered band by band
+ *  with vdg_render_band(), such as by the loader.
  *
  *  param:  Nothing
  *  return: Nothing
  */
 void vdg_render(void)
 {
-    int     vdg_mem_base;
+    int     band;
+
+    for ( band = 0; band < VDG_BANDS; band++ )
+    {
+        vdg_render_band(band);
+    }
+}
+
+/*------------------------------------------------
+ * vdg_render_band()
+ *
+ *  Render one band of VDG_BAND_LINES scan lines, a text row, of the video display.
+ *  Bands are rendered in order while the CPU runs, so video mode changes
+ *  or video memory writes made mid-frame show from the next band onwards.
+ *  A band is fully redrawn when the video mode, color set or video memory offset
+ *  differ from the ones it was last rendered with. Otherwise only video memory lines
+ *  that were written since the band was last rendered are redrawn, and the band
+ *  is skipped if none of its video memory changed.
+ *  An overlay text row set by vdg_overlay() is drawn over its band.
+ *  Rendering is done off-screen, and after the last band a changed frame
+ *  is flipped to the RPi frame buffer.
+ *  With the render thread, the band is queued with a copy of its video memory
+ *  and drawn by the thread or render core, see VDG_RENDER_THREAD in config.h.
+ *
+ *  param:  Band number, 0 to VDG_BANDS-1 from the top of the display
+ *  return: Nothing
+ */
+void vdg_render_band(int band)
+{
+    video_mode_t    mode;
+    int             band_address;
+    int             refresh, draw, overlay;
 
-    /* VDG/SAM mode settings
+    /* Rebuild the render descriptor only after a VDG/SAM mode
+     * or video memory offset change
      */
-    current_mode = vdg_get_mode();
-    if ( current_mode != prev_mode )
+    if ( settings_changed )
     {
-        prev_mode = current_mode;
-        dbg_printf(2, "VDG mode: %s\n", mode_name[current_mode]);
+        mode = vdg_get_mode();
+        if ( mode != render_desc.mode )
+            dbg_printf(2, "VDG mode: %s\n", mode_name[mode]);
+
+        vdg_build_descriptor(&render_desc, mode);
+        settings_changed = 0;
     }
 
-    /* Render screen content to RPi frame buffer
+    refresh = ( render_desc.settings != band_settings[band] );
+    band_address = render_desc.vdg_mem_base + band * render_desc.band_mem;
+    draw = ( refresh || mem_is_dirty(band_address, render_desc.band_mem) );
+    overlay = ( band < VDG_OVERLAY_ROWS && overlay_shown[band] && (draw || overlay_changed[band]) );
+
+#if (VDG_RENDER_THREAD==1)
+    /* Queue the band to the render thread, only changed bands and the last band
+     * that flips the frame are queued. The thread is started with the first band, so vdg_benchmark()
+     * renders in the calling thread.
      */
-    vdg_mem_base = video_ram_offset << 9;
+    if ( render_thread_running == 0 )
+    {
+        if ( vdg_render_start() == 0 )
+        {
+            render_mem = render_thread_mem;
+            render_dirty = render_thread_dirty;
+            render_thread_running = 1;
+        }
+        else
+        {
+            dbg_printf(1, "vdg_render_band()[%d]: Render thread failed, rendering in the emulation.\n", __LINE__);
+            render_thread_running = -1;
+        }
+    }
 
-    switch ( current_mode )
+    if ( render_thread_running == 1 )
     {
-        case ALPHA_INTERNAL:
-        case SEMI_GRAPHICS_4:
-            vdg_render_alpha_semi4(vdg_mem_base);
-            break;
+        if ( draw || overlay || band == (VDG_BANDS - 1) )
+            vdg_band_publish(band, refresh, draw, overlay);
 
-        case SEMI_GRAPHICS_6:
-        case ALPHA_EXTERNAL:
-            vdg_render_semi6(vdg_mem_base);
-            break;
+        band_settings[band] = render_desc.settings;
+        if ( draw )
+            mem_clear_dirty(band_address, render_desc.band_mem);
+        if ( band < VDG_OVERLAY_ROWS )
+            overlay_changed[band] = 0;
 
-        case GRAPHICS_1C:
-        case GRAPHICS_2C:
-        case GRAPHICS_3C:
-        case GRAPHICS_6C:
-            vdg_render_color_graph(current_mode, vdg_mem_base);
-            break;
+        return;
+    }
+#endif
 
-        case GRAPHICS_1R:
-        case GRAPHICS_2R:
-        case GRAPHICS_3R:
-        case GRAPHICS_6R:
-            vdg_render_resl_graph(current_mode, vdg_mem_base);
-            break;
+    /* Render band content to the off-screen frame
+     */
+    band_settings[band] = render_desc.settings;
 
-        case SEMI_GRAPHICS_8:
-        case SEMI_GRAPHICS_12:
-        case SEMI_GRAPHICS_24:
-            vdg_render_semi_ext(current_mode, vdg_mem_base);
-            break;
+    if ( draw )
+    {
+        refresh_all = refresh;
+        render_desc.renderer(&render_desc, band, 1);
+        mem_clear_dirty(band_address, render_desc.band_mem);
+        frame_changed = 1;
+    }
 
-        case DMA:
-            dbg_printf(0, "vdg_render()[%d]: Mode not supported %d\n", __LINE__, current_mode);
-            rpi_halt();
-            break;
+    if ( band < VDG_OVERLAY_ROWS )
+    {
+        if ( overlay )
+        {
+            vdg_draw_overlay(band, overlay_chars[band]);
+            frame_changed = 1;
+        }
+        overlay_changed[band] = 0;
+    }
 
-        default:
-            {
-                dbg_printf(0, "vdg_render()[%d]: Illegal mode.\n", __LINE__);
-                rpi_halt();
-            }
+    if ( band == (VDG_BANDS - 1) && frame_changed )
+    {
+        rpi_fb_flip(frame_buffer);
+        frame_changed = 0;
+    }
+}
+
+/*------------------------------------------------
+ * vdg_render_sync()
+ *
+ *  Wait for the render thread to draw the bands queued so far,
+ *  so the frame buffer holds the last rendered frame.
+ *  Returns at once when bands are drawn by the emulation thread.
+ *
+ *  param:  Nothing
+ *  return: Nothing
+ */
+void vdg_render_sync(void)
+{
+#if (VDG_RENDER_THREAD==1)
+    while ( render_thread_running == 1 && job_tail != job_head )
+        render_wait();
+#endif
+}
+
+/*------------------------------------------------
+ * vdg_overlay()
+ *
+ *  Set or remove an overlay text row, drawn over a top band of the display
+ *  from the next time the band is rendered. Text is shown in upper case,
+ *  in inverse video of the orange color set, and is padded or cut to the
+ *  display width.
+ *
+ *  param:  Overlay row 0 to VDG_OVERLAY_ROWS-1, text or NULL to remove the row
+ *  return: Nothing
+ */
+void vdg_overlay(int row, const char *text)
+{
+    int     col;
+    char    c;
+
+    if ( row < 0 || row >= VDG_OVERLAY_ROWS )
+        return;
+
+    if ( text == 0L )
+    {
+        /* Redraw the band's display content over the overlay
+         */
+        if ( overlay_shown[row] )
+            band_settings[row] = 0xffffffff;
+
+        overlay_shown[row] = 0;
+        return;
+    }
+
+    for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
+    {
+        c = *text ? *text++ : ' ';
+        if ( c >= 'a' && c <= 'z' )
+            c -= ('a' - 'A');
+
+        overlay_chars[row][col] = (uint8_t)(c & 0x3f);
     }
+
+    overlay_shown[row] = 1;
+    overlay_changed[row] = 1;
 }
 
 /*------------------------------------------------
@@ -284,7 +629,11 @@ void vdg_render(void)
  */
 void vdg_set_video_offset(uint8_t offset)
 {
-    video_ram_offset = offset;
+    if ( offset != video_ram_offset )
+    {
+        video_ram_offset = offset;
+        settings_changed = 1;
+    }
 }
 
 /*------------------------------------------------
@@ -306,7 +655,11 @@ void vdg_set_video_offset(uint8_t offset)
  */
 void vdg_set_mode_sam(int sam_mode)
 {
-    sam_video_mode = sam_mode;
+    if ( sam_mode != sam_video_mode )
+    {
+        sam_video_mode = sam_mode;
+        settings_changed = 1;
+    }
 }
 
 /*------------------------------------------------
@@ -325,162 +678,174 @@ void vdg_set_mode_sam(int sam_mode)
  */
 void vdg_set_mode_pia(uint8_t pia_mode)
 {
-    pia_video_mode = pia_mode;
+    if ( pia_mode != pia_video_mode )
+    {
+        pia_video_mode = pia_mode;
+        settings_changed = 1;
+    }
 }
 
 /*------------------------------------------------
- * vdg_render_alpha_semi4()
- *
- *  Render aplphanumeric internal and Semi-graphics 4.
+ * vdg_benchmark()
  *
- * param:  VDG memory base address
- * return: None
+ *  Time the full screen rendering of every video mode over fixed
+ *  video memory fill patterns, and print the average time per frame.
+ *  Video memory at the current offset is overwritten.
  *
+ *  param:  Frames to render per mode and pattern.
+ *  return: Nothing
  */
-void vdg_render_alpha_semi4(int vdg_mem_base)
+void vdg_benchmark(int frames)
 {
-    int         c, row, col, font_row, font_col;
-    int         char_index, row_address;
-    uint8_t     bit_pattern, pix_pos;
-    uint8_t     color_set, fg_color, bg_color, tmp;
+    static const char* pattern_name[BENCH_PATTERNS] = { "zeros", "ones ", "check", "ramp ", "noise" };
 
-    uint8_t    *screen_buffer;
+    int             mode, pattern, frame, i;
+    uint32_t        start_time, elapsed_time, seed;
+    uint8_t         data;
+    render_desc_t   desc;
 
-    screen_buffer = fbp;
+    if ( frames <= 0 )
+        frames = VDG_BENCH_FRAMES;
 
-    if ( pia_video_mode & PIA_COLOR_SET )
-        color_set = colors[DEF_COLOR_CSS_1];
-    else
-        color_set = colors[DEF_COLOR_CSS_0];
+    dbg_printf(0, "VDG render benchmark, %s, %d frames per pattern.\n",
+               (VDG_SIMD == 1) ? "NEON" : "scalar", frames);
 
-    for ( row = 0; row < SCREEN_HEIGHT_CHAR; row++ )
+    for ( mode = ALPHA_INTERNAL; mode < DMA; mode++ )
     {
-        row_address = row * SCREEN_WIDTH_CHAR + vdg_mem_base;
-        
-        for ( font_row = 0; font_row < FONT_HEIGHT; font_row++ )
+        vdg_build_descriptor(&desc, (video_mode_t) mode);
+
+        for ( pattern = 0; pattern < BENCH_PATTERNS; pattern++ )
         {
-            for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
+            seed = 1;
+
+            for ( i = 0; i < desc.video_mem; i++ )
             {
-                c = mem_read(col + row_address);
+                switch ( pattern )
+                {
+                    case 0:
+                        data = 0x00;
+                        break;
 
-                bg_color = FB_BLACK;
+                    case 1:
+                        data = 0xff;
+                        break;
 
-                /* Mode dependent initializations
-                 * for text or semigraphics 4:
-                 * - Determine foreground and background colors
-                 * - Character pattern array
-                 * - Character code index to bit pattern array
-                 *
-                 */
-                if ( (uint8_t)c & CHAR_SEMI_GRAPHICS )
-                {
-                    fg_color = colors[(((uint8_t)c & 0b01110000) >> 4)];
-                    char_index = (int)(((uint8_t) c) & SEMI_GRAPH4_MASK);
-                    bit_pattern = semi_graph_4[char_index][font_row];
-                }
-                else
-                {
-                    fg_color = color_set;
+                    case 2:
+                        data = ((i / SCREEN_WIDTH_CHAR) & 1) ? 0x55 : 0xaa;
+                        break;
 
-                    if ( (uint8_t)c & CHAR_INVERSE )
-                    {
-                        tmp = fg_color;
-                        fg_color = bg_color;
-                        bg_color = tmp;
-                    }
-                    char_index = (int)(((uint8_t) c) & ~(CHAR_SEMI_GRAPHICS | CHAR_INVERSE));
-                    bit_pattern = font_img5x7[char_index][font_row];
+                    case 3:
+                        data = (uint8_t) i;
+                        break;
+
+                    default:
+                        seed = seed * 1103515245 + 12345;
+                        data = (uint8_t)(seed >> 16);
                 }
 
-                /* Render a row of pixels in a temporary buffer
-                 */
-                pix_pos = 0x80;
+                mem_write(desc.vdg_mem_base + i, data);
+            }
 
-                for ( font_col = 0; font_col < FONT_WIDTH; font_col++ )
-                {
-                    /* Bit is set in Font, print pixel(s) in text color
-                    */
-                    if ( (bit_pattern & pix_pos) )
-                    {
-                        *screen_buffer++ = fg_color;
-                    }
-                    /* Bit is cleared in Font
-                    */
-                    else
-                    {
-                        *screen_buffer++ = bg_color;
-                    }
+            start_time = rpi_system_timer();
 
-                    /* Move to the next pixel position
-                    */
-                    pix_pos = pix_pos >> 1;
-                }
+            for ( frame = 0; frame < frames; frame++ )
+            {
+                refresh_all = 1;
+                desc.renderer(&desc, 0, VDG_BANDS);
             }
+
+            elapsed_time = rpi_system_timer() - start_time;
+
+            dbg_printf(0, "  %s %s %6d uSec/frame\n", mode_name[mode], pattern_name[pattern],
+                       (int)(elapsed_time / frames));
         }
     }
+
+    /* Force a full screen redraw on next render
+     */
+    memset(band_settings, 0xff, sizeof(band_settings));
 }
 
 /*------------------------------------------------
- * vdg_render_semi6()
+ * vdg_render_alpha_semi4()
  *
- *  Render Semi-graphics 6.
+ *  Render aplphanumeric internal and Semi-graphics 4.
  *
- * param:  VDG memory base address
+ * param:  Render descriptor, first text row and count of rows to render
  * return: None
  *
  */
-static void vdg_render_semi6(int vdg_mem_base)
+void vdg_render_alpha_semi4(const render_desc_t *desc, int first_row, int rows)
 {
-    int         c, row, col, font_row, font_col, color_set;
-    int         char_index, row_address;
-    uint8_t     bit_pattern, pix_pos;
-    uint8_t     fg_color, bg_color;
+    int         row, col, font_row, color_set;
+    int         row_address;
+    uint8_t     row_chars[SCREEN_WIDTH_CHAR];
 
     uint8_t    *screen_buffer;
 
-    screen_buffer = fbp;
-    color_set = (int)(4 * (pia_video_mode & PIA_COLOR_SET));
+    screen_buffer = fbp + first_row * FONT_HEIGHT * SCAN_LINE_BYTES;
+    color_set = desc->color_set;
 
-    for ( row = 0; row < SCREEN_HEIGHT_CHAR; row++ )
+    for ( row = first_row; row < (first_row + rows); row++ )
     {
-        row_address = row * SCREEN_WIDTH_CHAR + vdg_mem_base;
+        row_address = row * SCREEN_WIDTH_CHAR + desc->vdg_mem_base;
+
+        if ( !vdg_line_changed(row_address) )
+        {
+            screen_buffer += FONT_HEIGHT * SCAN_LINE_BYTES;
+            continue;
+        }
+
+        for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
+        {
+            row_chars[col] = vdg_video_read(col + row_address);
+        }
 
         for ( font_row = 0; font_row < FONT_HEIGHT; font_row++ )
         {
-            for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
-            {
-                c = mem_read(col + row_address);
+            screen_buffer = vdg_draw_text_line(screen_buffer, glyph_alpha_semi4[color_set], row_chars, font_row);
+        }
+    }
+}
 
-                bg_color = FB_BLACK;
-                fg_color = colors[(int)(((c & 0b11000000) >> 6) + color_set)];
+/*------------------------------------------------
+ * vdg_render_semi6()
+ *
+ *  Render Semi-graphics 6.
+ *
+ * param:  Render descriptor, first text row and count of rows to render
+ * return: None
+ *
+ */
+static void vdg_render_semi6(const render_desc_t *desc, int first_row, int rows)
+{
+    int         row, col, font_row, color_set;
+    int         row_address;
+    uint8_t     row_chars[SCREEN_WIDTH_CHAR];
 
-                char_index = (int)(((uint8_t) c) & SEMI_GRAPH6_MASK);
-                bit_pattern = semi_graph_6[char_index][font_row];
+    uint8_t    *screen_buffer;
 
-                /* Render a row of pixels in a temporary buffer
-                 */
-                pix_pos = 0x80;
+    screen_buffer = fbp + first_row * FONT_HEIGHT * SCAN_LINE_BYTES;
+    color_set = desc->color_set;
 
-                for ( font_col = 0; font_col < FONT_WIDTH; font_col++ )
-                {
-                    /* Bit is set in Font, print pixel(s) in text color
-                    */
-                    if ( (bit_pattern & pix_pos) )
-                    {
-                        *screen_buffer++ = fg_color;
-                    }
-                    /* Bit is cleared in Font
-                    */
-                    else
-                    {
-                        *screen_buffer++ = bg_color;
-                    }
+    for ( row = first_row; row < (first_row + rows); row++ )
+    {
+        row_address = row * SCREEN_WIDTH_CHAR + desc->vdg_mem_base;
 
-                    /* Move to the next pixel position
-                    */
-                    pix_pos = pix_pos >> 1;
-                }
-            }
+        if ( !vdg_line_changed(row_address) )
+        {
+            screen_buffer += FONT_HEIGHT * SCAN_LINE_BYTES;
+            continue;
+        }
+
+        for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
+        {
+            row_chars[col] = vdg_video_read(col + row_address);
+        }
+
+        for ( font_row = 0; font_row < FONT_HEIGHT; font_row++ )
+        {
+            screen_buffer = vdg_draw_text_line(screen_buffer, glyph_semi6[color_set], row_chars, font_row);
         }
     }
 }
@@ -492,39 +857,34 @@ static void vdg_render_semi6(int vdg_mem_base)
  * Mode can only be SEMI_GRAPHICS_8, SEMI_GRAPHICS_12, and SEMI_GRAPHICS_24 as
  * this is not checked for validity.
  *
- * param:  Mode, base address of video memory buffer.
+ * param:  Render descriptor, first text row and count of rows to render.
  * return: none
  *
  */
-static void vdg_render_semi_ext(video_mode_t mode, int vdg_mem_base)
+static void vdg_render_semi_ext(const render_desc_t *desc, int first_row, int rows)
 {
-    int         row, seg_row, scan_line, col, font_col, font_row;
+    int         row, seg_row, scan_line, col, font_row;
     int         segments, seg_scan_lines;
-    int         c, char_index, row_address;
-    uint8_t     bit_pattern, pix_pos;
-    uint8_t     color_set, fg_color, bg_color, tmp;
+    int         row_address, color_set;
+    uint8_t     row_chars[SCREEN_WIDTH_CHAR];
 
     uint8_t    *screen_buffer;
 
-    screen_buffer = fbp;
+    screen_buffer = fbp + first_row * FONT_HEIGHT * SCAN_LINE_BYTES;
     font_row = 0;
+    color_set = desc->color_set;
 
-    if ( pia_video_mode & PIA_COLOR_SET )
-        color_set = colors[DEF_COLOR_CSS_1];
-    else
-        color_set = colors[DEF_COLOR_CSS_0];
-
-    if ( mode == SEMI_GRAPHICS_8 )
+    if ( desc->mode == SEMI_GRAPHICS_8 )
     {
         segments = SEMIG8_SEG_HEIGHT;
         seg_scan_lines = FONT_HEIGHT / SEMIG8_SEG_HEIGHT;
     }
-    else if ( mode == SEMI_GRAPHICS_12 )
+    else if ( desc->mode == SEMI_GRAPHICS_12 )
     {
         segments = SEMIG12_SEG_HEIGHT;
         seg_scan_lines = FONT_HEIGHT / SEMIG12_SEG_HEIGHT;
     }
-    else if ( mode == SEMI_GRAPHICS_24 )
+    else if ( desc->mode == SEMI_GRAPHICS_24 )
     {
         segments = SEMIG24_SEG_HEIGHT;
         seg_scan_lines = FONT_HEIGHT / SEMIG24_SEG_HEIGHT;
@@ -534,71 +894,27 @@ static void vdg_render_semi_ext(video_mode_t mode, int vdg_mem_base)
         return;
     }
 
-    for ( row = 0; row < SCREEN_HEIGHT_CHAR; row++ )
+    for ( row = first_row; row < (first_row + rows); row++ )
     {
         for ( seg_row = 0; seg_row < segments; seg_row++ )
         {
-            row_address = (row * segments + seg_row) * SCREEN_WIDTH_CHAR + vdg_mem_base;
+            row_address = (row * segments + seg_row) * SCREEN_WIDTH_CHAR + desc->vdg_mem_base;
 
-            for ( scan_line = 0; scan_line < seg_scan_lines; scan_line++ )
+            if ( !vdg_line_changed(row_address) )
             {
-                for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
-                {
-                    c = mem_read(col + row_address);
-
-                    /* Mode dependent initializations
-                    * for text or semigraphics 4:
-                    * - Determine foreground and background colors
-                    * - Character pattern array
-                    * - Character code index to bit pattern array
-                    *
-                    */
-                    bg_color = FB_BLACK;
-
-                    if ( (uint8_t)c & CHAR_SEMI_GRAPHICS )
-                    {
-                        fg_color = colors[(((uint8_t)c & 0b01110000) >> 4)];
-                        char_index = (int)(((uint8_t) c) & SEMI_GRAPH4_MASK);
-                        bit_pattern = semi_graph_4[char_index][font_row];
-                    }
-                    else
-                    {
-                        fg_color = color_set;
-
-                        if ( (uint8_t)c & CHAR_INVERSE )
-                        {
-                            tmp = fg_color;
-                            fg_color = bg_color;
-                            bg_color = tmp;
-                        }
-                        char_index = (int)(((uint8_t) c) & ~(CHAR_SEMI_GRAPHICS | CHAR_INVERSE));
-                        bit_pattern = font_img5x7[char_index][font_row];
-                    }
+                screen_buffer += seg_scan_lines * SCAN_LINE_BYTES;
+                font_row = (font_row + seg_scan_lines) % FONT_HEIGHT;
+                continue;
+            }
 
-                    /* Render a row of pixels in a temporary buffer
-                    */
-                    pix_pos = 0x80;
+            for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
+            {
+                row_chars[col] = vdg_video_read(col + row_address);
+            }
 
-                    for ( font_col = 0; font_col < FONT_WIDTH; font_col++ )
-                    {
-                        /* Bit is set in Font, print pixel(s) in text color
-                        */
-                        if ( (bit_pattern & pix_pos) )
-                        {
-                            *screen_buffer++ = fg_color;
-                        }
-                        /* Bit is cleared in Font
-                        */
-                        else
-                        {
-                            *screen_buffer++ = bg_color;
-                        }
-
-                        /* Move to the next pixel position
-                        */
-                        pix_pos = pix_pos >> 1;
-                    }
-                }
+            for ( scan_line = 0; scan_line < seg_scan_lines; scan_line++ )
+            {
+                screen_buffer = vdg_draw_text_line(screen_buffer, glyph_alpha_semi4[color_set], row_chars, font_row);
 
                 font_row++;
                 if ( font_row == FONT_HEIGHT )
@@ -609,130 +925,507 @@ static void vdg_render_semi_ext(video_mode_t mode, int vdg_mem_base)
 }
 
 /*------------------------------------------------
- * vdg_render_resl_graph()
+ * vdg_render_unsupported()
  *
- *  Render resolution graphics modes:
- *  GRAPHICS_1R, GRAPHICS_2R, GRAPHICS_3R, and GRAPHICS_6R.
+ *  Renderer of video modes that are not emulated.
  *
- * param:  Mode, base address of video memory buffer.
+ * param:  Render descriptor, first band and count of bands.
  * return: none
  *
  */
-static void vdg_render_resl_graph(video_mode_t mode, int vdg_mem_base)
+static void vdg_render_unsupported(const render_desc_t *desc, int first_row, int rows)
 {
-    int         i, j, vdg_mem_offset, element, buffer_index;
-    int         video_mem, row_rep;
-    uint8_t     pixels_byte, fg_color, pixel;
-    uint8_t    *screen_buffer;
-
-    screen_buffer = fbp;
-
-    video_mem = resolution[mode][RES_MEM];
-    row_rep = resolution[mode][RES_ROW_REP];
-    buffer_index = 0;
-
-    if ( pia_video_mode & PIA_COLOR_SET )
+    if ( desc->mode == DMA )
     {
-        fg_color = colors[DEF_COLOR_CSS_1];
+        dbg_printf(0, "vdg_render_unsupported()[%d]: Mode not supported %d\n", __LINE__, desc->mode);
     }
     else
     {
-        fg_color = colors[DEF_COLOR_CSS_0];
+        dbg_printf(0, "vdg_render_unsupported()[%d]: Illegal mode.\n", __LINE__);
     }
 
-    for ( vdg_mem_offset = 0; vdg_mem_offset < video_mem; vdg_mem_offset++)
-    {
-        pixels_byte = mem_read(vdg_mem_offset + vdg_mem_base);
+    rpi_halt();
+}
 
-        for ( element = 7; element >= 0; element--)
-        {
-            if ( (pixels_byte >> element) & 0x01 )
-            {
-                pixel = fg_color;
+/*------------------------------------------------
+ * vdg_build_descriptor()
+ *
+ *  Build the render descriptor of a video mode with the current
+ *  video memory offset and PIA color set.
+ *
+ * param:  Render descriptor to build, video mode.
+ * return: none
+ *
+ */
+static void vdg_build_descriptor(render_desc_t *desc, video_mode_t mode)
+{
+    desc->mode = mode;
+    desc->vdg_mem_base = video_ram_offset << 9;
+    desc->color_set = pia_video_mode & PIA_COLOR_SET;
+    desc->settings = ((uint32_t) video_ram_offset << 16) |
+                     ((uint32_t) sam_video_mode << 8) |
+                     (uint32_t) pia_video_mode;
+
+    if ( mode < UNDEFINED )
+    {
+        desc->renderer = renderer[mode];
+        desc->video_mem = resolution[mode][RES_MEM];
+        desc->row_rep = resolution[mode][RES_ROW_REP];
+    }
+    else
+    {
+        desc->renderer = vdg_render_unsupported;
+        desc->video_mem = 0;
+        desc->row_rep = 1;
+    }
+
+    desc->band_mem = desc->video_mem / VDG_BANDS;
+}
+
+/*------------------------------------------------
+ * vdg_render_resl_graph()
+ *
+ *  Render resolution graphics modes:
+ *  GRAPHICS_1R, GRAPHICS_2R, GRAPHICS_3R, and GRAPHICS_6R.
+ *
+ * param:  Render descriptor, first band and count of bands.
+ * return: none
+ *
+ */
+static void vdg_render_resl_graph(const render_desc_t *desc, int first_row, int rows)
+{
+    vdg_render_graph_rows((desc->mode == GRAPHICS_6R) ? PIX_1BPP_X1 : PIX_1BPP_X2,
+                          desc, first_row, rows);
+}
+
+/*------------------------------------------------
+ * vdg_render_color_graph()
+ *
+ *  Render color graphics modes:
+ *  GRAPHICS_1C, GRAPHICS_2C, GRAPHICS_3C, and GRAPHICS_6C.
+ *
+ * param:  Render descriptor, first band and count of bands.
+ * return: none
+ *
+ */
+static void vdg_render_color_graph(const render_desc_t *desc, int first_row, int rows)
+{
+    vdg_render_graph_rows((desc->mode == GRAPHICS_1C) ? PIX_2BPP_X4 : PIX_2BPP_X2,
+                          desc, first_row, rows);
+}
+
+/*------------------------------------------------
+ * vdg_render_graph_rows()
+ *
+ *  Render the pixel rows of a graphics mode.
+ *  The video memory bytes of a pixel row are expanded into the first scan line
+ *  of the row, which is then copied to the repeated and VDG_SCALE scaled scan lines of the row.
+ *
+ * param:  Pixel format, render descriptor, first band and count of bands.
+ * return: none
+ *
+ */
+static void vdg_render_graph_rows(int pixel_format, const render_desc_t *desc, int first_row, int rows)
+{
+    int         i, col, color_set, row_bytes, row_rep, vdg_mem_offset, vdg_mem_end, row_address;
+    uint8_t     row_data[SCREEN_WIDTH_CHAR];
+    uint8_t    *screen_buffer, *row_start;
+
+    color_set = desc->color_set;
+    row_rep = desc->row_rep;
+    row_bytes = SCALED_WIDTH_PIX / pixel_run[pixel_format];
+
+    /* Each band holds an equal share of the video memory
+     */
+    vdg_mem_offset = first_row * desc->band_mem;
+    vdg_mem_end = (first_row + rows) * desc->band_mem;
+
+    screen_buffer = fbp + first_row * VDG_BAND_LINES * SCAN_LINE_BYTES;
+
+    for ( ; vdg_mem_offset < vdg_mem_end; vdg_mem_offset += row_bytes )
+    {
+        row_address = vdg_mem_offset + desc->vdg_mem_base;
+
+        /* Skip a row of pixels if its video memory did not change
+         */
+        if ( !vdg_line_changed(row_address) )
+        {
+            screen_buffer += row_rep * SCAN_LINE_BYTES;
+            continue;
+        }
+
+        for ( col = 0; col < row_bytes; col++ )
+            row_data[col] = vdg_video_read(row_address + col);
+
+        row_start = screen_buffer;
+
+        vdg_expand_row(pixel_format, color_set, row_data, row_bytes, screen_buffer);
+        screen_buffer += FRAME_WIDTH_PIX;
+
+        for ( i = 1; i < (row_rep * VDG_SCALE); i++ )
+        {
+            vdg_copy_row(screen_buffer, row_start);
+            screen_buffer += FRAME_WIDTH_PIX;
+        }
+    }
+}
+
+#if (VDG_SIMD==0)
+
+/*------------------------------------------------
+ * vdg_expand_row()
+ *
+ *  Expand the video memory bytes of a graphics pixel row to one
+ *  frame buffer scan line, by copying the pre-rendered pixel run of each byte.
+ *
+ * param:  Pixel format, PIA color set, video bytes of the row, count of bytes,
+ *         and frame buffer scan line.
+ * return: none
+ *
+ */
+static void vdg_expand_row(int pixel_format, int color_set, const uint8_t *row_data,
+                           int row_bytes, uint8_t *screen_buffer)
+{
+    int             col;
+    const uint8_t  *pixel_table;
+
+    switch ( pixel_format )
+    {
+        case PIX_1BPP_X1:
+            pixel_table = &pixels_resl_x1[color_set][0][0];
+            break;
+
+        case PIX_1BPP_X2:
+            pixel_table = &pixels_resl_x2[color_set][0][0];
+            break;
+
+        case PIX_2BPP_X2:
+            pixel_table = &pixels_color_x2[color_set][0][0];
+            break;
+
+        default:
+            pixel_table = &pixels_color_x4[color_set][0][0];
+    }
+
+    if ( pixel_run[pixel_format] == (8 * VDG_SCALE) )
+    {
+        for ( col = 0; col < row_bytes; col++ )
+        {
+            memcpy(screen_buffer, &pixel_table[row_data[col] * 8 * VDG_SCALE], 8 * VDG_SCALE);
+            screen_buffer += 8 * VDG_SCALE;
+        }
+    }
+    else
+    {
+        for ( col = 0; col < row_bytes; col++ )
+        {
+            memcpy(screen_buffer, &pixel_table[row_data[col] * 16 * VDG_SCALE], 16 * VDG_SCALE);
+            screen_buffer += 16 * VDG_SCALE;
+        }
+    }
+}
+
+/*------------------------------------------------
+ * vdg_copy_row()
+ *
+ *  Copy a frame buffer scan line.
+ *
+ * param:  Destination and source scan lines.
+ * return: none
+ *
+ */
+static void vdg_copy_row(uint8_t *dest_row, const uint8_t *src_row)
+{
+    memcpy(dest_row, src_row, SCALED_WIDTH_PIX);
+}
+
+#else
+
+/*------------------------------------------------
+ * vdg_expand_row()
+ *
+ *  Expand the video memory bytes of a graphics pixel row to one
+ *  frame buffer scan line with NEON.
+ *  Resolution graphics test each pixel bit against a lane mask and select
+ *  the foreground or black color, color graphics shift each 2-bit pixel into
+ *  its lanes and look up the color set palette.
+ *
+ * param:  Pixel format, PIA color set, video bytes of the row, count of bytes,
+ *         and frame buffer scan line.
+ * return: none
+ *
+ */
+static void vdg_expand_row(int pixel_format, int color_set, const uint8_t *row_data,
+                           int row_bytes, uint8_t *screen_buffer)
+{
+    int         col;
+    uint8_t     palette_colors[8];
+    uint8x8_t   fg_color8, bg_color8, mask8, palette, index8;
+    uint8x16_t  fg_color16, bg_color16, mask16, index16;
+    int8x8_t    shift8;
+    int8x16_t   shift16;
+
+    switch ( pixel_format )
+    {
+        case PIX_1BPP_X1:
+            fg_color8 = vdup_n_u8(color_set ? colors[DEF_COLOR_CSS_1] : colors[DEF_COLOR_CSS_0]);
+            bg_color8 = vdup_n_u8(FB_BLACK);
+            mask8 = vld1_u8(neon_bit_mask_x1);
+
+            for ( col = 0; col < row_bytes; col++ )
+            {
+                vst1_u8(screen_buffer, vbsl_u8(vtst_u8(vdup_n_u8(row_data[col]), mask8), fg_color8, bg_color8));
+                screen_buffer += 8;
             }
-            else
+            break;
+
+        case PIX_1BPP_X2:
+            fg_color16 = vdupq_n_u8(color_set ? colors[DEF_COLOR_CSS_1] : colors[DEF_COLOR_CSS_0]);
+            bg_color16 = vdupq_n_u8(FB_BLACK);
+            mask16 = vld1q_u8(neon_bit_mask_x2);
+
+            for ( col = 0; col < row_bytes; col++ )
             {
-                pixel = FB_BLACK;
+                vst1q_u8(screen_buffer, vbslq_u8(vtstq_u8(vdupq_n_u8(row_data[col]), mask16), fg_color16, bg_color16));
+                screen_buffer += 16;
             }
+            break;
 
-            pixel_row[buffer_index++] = pixel;
-            if ( mode != GRAPHICS_6R )
-                pixel_row[buffer_index++] = pixel;
-        }
+        case PIX_2BPP_X2:
+        default:
+            memset(palette_colors, 0, sizeof(palette_colors));
+            memcpy(palette_colors, &colors[4 * color_set], 4);
+            palette = vld1_u8(palette_colors);
 
-        if ( buffer_index >= SCREEN_WIDTH_PIX )
-        {
-            for ( i = 0; i < row_rep; i++ )
+            if ( pixel_format == PIX_2BPP_X2 )
             {
-                for ( j = 0; j < SCREEN_WIDTH_PIX; j++ )
+                shift8 = vld1_s8(neon_shift_x2);
+
+                for ( col = 0; col < row_bytes; col++ )
                 {
-                    *screen_buffer++ = pixel_row[j];
+                    index8 = vand_u8(vshl_u8(vdup_n_u8(row_data[col]), shift8), vdup_n_u8(0x03));
+                    vst1_u8(screen_buffer, vtbl1_u8(palette, index8));
+                    screen_buffer += 8;
                 }
             }
+            else
+            {
+                shift16 = vld1q_s8(neon_shift_x4);
 
-            buffer_index = 0;
-        }
+                for ( col = 0; col < row_bytes; col++ )
+                {
+                    index16 = vandq_u8(vshlq_u8(vdupq_n_u8(row_data[col]), shift16), vdupq_n_u8(0x03));
+                    vst1q_u8(screen_buffer, vcombine_u8(vtbl1_u8(palette, vget_low_u8(index16)),
+                                                        vtbl1_u8(palette, vget_high_u8(index16))));
+                    screen_buffer += 16;
+                }
+            }
     }
 }
 
 /*------------------------------------------------
- * vdg_render_color_graph()
+ * vdg_copy_row()
  *
- *  Render color graphics modes:
- *  GRAPHICS_1C, GRAPHICS_2C, GRAPHICS_3C, and GRAPHICS_6C.
+ *  Copy a frame buffer scan line with NEON loads and stores.
  *
- * param:  Mode, base address of video memory buffer.
+ * param:  Destination and source scan lines.
  * return: none
  *
  */
-static void vdg_render_color_graph(video_mode_t mode, int vdg_mem_base)
+static void vdg_copy_row(uint8_t *dest_row, const uint8_t *src_row)
 {
-    int         i, j, vdg_mem_offset, element, buffer_index;
-    int         video_mem, row_rep, color_set, color;
-    uint8_t     pixels_byte, pixel;
-    uint8_t    *screen_buffer;
+    int     i;
+
+    for ( i = 0; i < SCALED_WIDTH_PIX; i += 16 )
+        vst1q_u8(&dest_row[i], vld1q_u8(&src_row[i]));
+}
 
-    screen_buffer = fbp;
+#endif  /* VDG_SIMD */
 
-    video_mem = resolution[mode][RES_MEM];
-    row_rep = resolution[mode][RES_ROW_REP];
-    color_set = 4 * (pia_video_mode & PIA_COLOR_SET);
-    buffer_index = 0;
+/*------------------------------------------------
+ * vdg_draw_text_line()
+ *
+ * Draw one display scan line of a text row from the pre-rendered
+ * character cell pixel runs, into its VDG_SCALE frame buffer scan lines.
+ *
+ * param:  Frame buffer scan line, glyph table of the color set,
+ *         characters of the text row, and font scan line.
+ * return: Frame buffer scan line following the drawn display scan line
+ *
+ */
+static uint8_t *vdg_draw_text_line(uint8_t *screen_buffer, uint8_t (*glyphs)[FONT_HEIGHT][GLYPH_RUN_PIX],
+                                   const uint8_t *row_chars, int font_row)
+{
+    int         col, i;
+    uint8_t    *line;
 
-    for ( vdg_mem_offset = 0; vdg_mem_offset < video_mem; vdg_mem_offset++)
+    for ( i = 0; i < VDG_SCALE; i++ )
     {
-        pixels_byte = mem_read(vdg_mem_offset + vdg_mem_base);
+        line = screen_buffer;
 
-        for ( element = 6; element >= 0; element -= 2)
+        for ( col = 0; col < SCREEN_WIDTH_CHAR; col++ )
         {
-            color = (int)((pixels_byte >> element) & 0x03) + color_set;
-            pixel = colors[color];
+            memcpy(line, glyphs[row_chars[col]][font_row], GLYPH_RUN_PIX);
+            line += GLYPH_RUN_PIX;
+        }
 
-            pixel_row[buffer_index++] = pixel;
-            pixel_row[buffer_index++] = pixel;
-            if ( mode == GRAPHICS_1C )
-            {
-                pixel_row[buffer_index++] = pixel;
-                pixel_row[buffer_index++] = pixel;
-            }
+        screen_buffer += FRAME_WIDTH_PIX;
+    }
 
-        }
+    return screen_buffer;
+}
+
+/*------------------------------------------------
+ * vdg_draw_overlay()
+ *
+ * Draw an overlay text row over its band in the off-screen frame.
+ *
+ * param:  Overlay row, text row characters
+ * return: None
+ *
+ */
+static void vdg_draw_overlay(int row, const uint8_t *text)
+{
+    int         font_row;
+    uint8_t    *screen_buffer;
+
+    screen_buffer = fbp + row * FONT_HEIGHT * SCAN_LINE_BYTES;
+
+    for ( font_row = 0; font_row < FONT_HEIGHT; font_row++ )
+    {
+        screen_buffer = vdg_draw_text_line(screen_buffer, glyph_alpha_semi4[1], text, font_row);
+    }
+}
+
+/*------------------------------------------------
+ * vdg_build_glyph_tables()
+ *
+ * Pre-render the pixel runs of every character cell scan line
+ * for both PIA color sets, so that text and semigraphics rendering
+ * copies a ready-made run of FONT_WIDTH pixels per cell and scan line,
+ * each pixel repeated VDG_SCALE times.
+ *
+ * param:  None
+ * return: none
+ *
+ */
+static void vdg_build_glyph_tables(void)
+{
+    int         css, c, font_row, font_col, i;
+    uint8_t     bit_pattern, pix_pos;
+    uint8_t     fg_color, bg_color, tmp;
 
-        if ( buffer_index >= SCREEN_WIDTH_PIX )
+    for ( css = 0; css < 2; css++ )
+    {
+        for ( c = 0; c < 256; c++ )
         {
-            for ( i = 0; i < row_rep; i++ )
+            for ( font_row = 0; font_row < FONT_HEIGHT; font_row++ )
             {
-                for ( j = 0; j < SCREEN_WIDTH_PIX; j++ )
+                /* Alphanumeric and semigraphics 4:
+                 * - Determine foreground and background colors
+                 * - Character code index to bit pattern array
+                 */
+                bg_color = FB_BLACK;
+
+                if ( (uint8_t)c & CHAR_SEMI_GRAPHICS )
                 {
-                    *screen_buffer++ = pixel_row[j];
+                    fg_color = colors[(((uint8_t)c & 0b01110000) >> 4)];
+                    bit_pattern = semi_graph_4[(c & SEMI_GRAPH4_MASK)][font_row];
                 }
+                else
+                {
+                    fg_color = css ? colors[DEF_COLOR_CSS_1] : colors[DEF_COLOR_CSS_0];
+
+                    if ( (uint8_t)c & CHAR_INVERSE )
+                    {
+                        tmp = fg_color;
+                        fg_color = bg_color;
+                        bg_color = tmp;
+                    }
+                    bit_pattern = font_img5x7[(c & ~(CHAR_SEMI_GRAPHICS | CHAR_INVERSE))][font_row];
+                }
+
+                pix_pos = 0x80;
+                for ( font_col = 0; font_col < FONT_WIDTH; font_col++ )
+                {
+                    for ( i = 0; i < VDG_SCALE; i++ )
+                        glyph_alpha_semi4[css][c][font_row][font_col * VDG_SCALE + i] = (bit_pattern & pix_pos) ? fg_color : bg_color;
+                    pix_pos = pix_pos >> 1;
+                }
+
+                /* Semigraphics 6
+                 */
+                fg_color = colors[(((c & 0b11000000) >> 6) + 4 * css)];
+                bit_pattern = semi_graph_6[(c & SEMI_GRAPH6_MASK)][font_row];
+
+                pix_pos = 0x80;
+                for ( font_col = 0; font_col < FONT_WIDTH; font_col++ )
+                {
+                    for ( i = 0; i < VDG_SCALE; i++ )
+                        glyph_semi6[css][c][font_row][font_col * VDG_SCALE + i] = (bit_pattern & pix_pos) ? fg_color : FB_BLACK;
+                    pix_pos = pix_pos >> 1;
+                }
+            }
+        }
+    }
+}
+
+#if (VDG_SIMD==0)
+
+/*------------------------------------------------
+ * vdg_build_pixel_tables()
+ *
+ * Pre-render the pixel runs of every graphics mode video byte value
+ * for both PIA color sets and each horizontal pixel repeat count,
+ * scaled by VDG_SCALE.
+ *
+ * param:  None
+ * return: none
+ *
+ */
+static void vdg_build_pixel_tables(void)
+{
+    int         css, byte, element, i;
+    uint8_t     pixel;
+
+    for ( css = 0; css < 2; css++ )
+    {
+        for ( byte = 0; byte < 256; byte++ )
+        {
+            /* Resolution graphics, 8 pixels of 1 bit
+             */
+            for ( element = 0; element < 8; element++ )
+            {
+                if ( (byte << element) & 0x80 )
+                    pixel = css ? colors[DEF_COLOR_CSS_1] : colors[DEF_COLOR_CSS_0];
+                else
+                    pixel = FB_BLACK;
+
+                for ( i = 0; i < VDG_SCALE; i++ )
+                    pixels_resl_x1[css][byte][VDG_SCALE * element + i] = pixel;
+
+                for ( i = 0; i < (2 * VDG_SCALE); i++ )
+                    pixels_resl_x2[css][byte][2 * VDG_SCALE * element + i] = pixel;
             }
 
-            buffer_index = 0;
+            /* Color graphics, 4 pixels of 2 bits
+             */
+            for ( element = 0; element < 4; element++ )
+            {
+                pixel = colors[(((byte << (2 * element)) & 0xc0) >> 6) + 4 * css];
+
+                for ( i = 0; i < (2 * VDG_SCALE); i++ )
+                    pixels_color_x2[css][byte][2 * VDG_SCALE * element + i] = pixel;
+
+                for ( i = 0; i < (4 * VDG_SCALE); i++ )
+                    pixels_color_x4[css][byte][4 * VDG_SCALE * element + i] = pixel;
+            }
         }
     }
 }
 
+#endif  /* VDG_SIMD */
+
 /*------------------------------------------------
  * vdg_get_mode()
  *
@@ -819,3 +1512,194 @@ static video_mode_t vdg_get_mode(void)
 
     return mode;
 }
+
+/*------------------------------------------------
+ * vdg_line_changed()
+ *
+ * Check if a line of video memory needs to be redrawn, either because
+ * it was written since the last rendering or a full refresh is needed.
+ * Video memory rows are always aligned to, and no longer than, a memory dirty line.
+ *
+ * param:  Video memory address
+ * return: '1' if line changed, '0' if not
+ *
+ */
+static int vdg_line_changed(int address)
+{
+    if ( refresh_all )
+        return 1;
+
+    return (int) render_dirty[((address & (MEMORY-1)) >> MEM_DIRTY_SHIFT)];
+}
+
+#if (VDG_RENDER_THREAD==1)
+/*------------------------------------------------
+ * vdg_band_publish()
+ *
+ * Queue a band to the render thread, with a copy of its video memory
+ * and memory line dirty state when the band changed.
+ * Waits for the thread when the queue is full, so no band is dropped.
+ *
+ * param:  Band number, redraw all lines, band changed, draw overlay row
+ * return: None
+ *
+ */
+static void vdg_band_publish(int band, int refresh, int draw, int overlay)
+{
+    band_job_t *job;
+    uint32_t    head;
+    int         band_address, i;
+
+    head = job_head;
+    while ( (head - job_tail) == BAND_JOB_QUEUE )
+        render_wait();
+
+    job = &band_jobs[(head & BAND_JOB_MASK)];
+
+    job->desc = render_desc;
+    job->band = band;
+    job->refresh = refresh;
+    job->draw = draw;
+    job->overlay = overlay;
+
+    if ( draw )
+    {
+        band_address = render_desc.vdg_mem_base + band * render_desc.band_mem;
+
+        for ( i = 0; i < render_desc.band_mem; i++ )
+            job->video[i] = mem_data[((band_address + i) & (MEMORY-1))];
+
+        for ( i = 0; i < (render_desc.band_mem >> MEM_DIRTY_SHIFT); i++ )
+            job->dirty[i] = mem_dirty[(((band_address >> MEM_DIRTY_SHIFT) + i) & (MEM_DIRTY_LINES-1))];
+    }
+
+    if ( overlay )
+        memcpy(job->overlay_chars, overlay_chars[band], SCREEN_WIDTH_CHAR);
+
+    render_barrier();
+
+    job_head = head + 1;
+    render_notify();
+}
+
+/*------------------------------------------------
+ * vdg_band_job_render()
+ *
+ * Draw a queued band from its copy of video memory, in the render thread.
+ * After the last band a changed frame is flipped to the RPi frame buffer.
+ *
+ * param:  Band job
+ * return: None
+ *
+ */
+static void vdg_band_job_render(const band_job_t *job)
+{
+    int     band_address, first_line, lines, i;
+
+    if ( job->draw )
+    {
+        band_address = job->desc.vdg_mem_base + job->band * job->desc.band_mem;
+        first_line = band_address >> MEM_DIRTY_SHIFT;
+        lines = job->desc.band_mem >> MEM_DIRTY_SHIFT;
+
+        for ( i = 0; i < job->desc.band_mem; i++ )
+            render_thread_mem[((band_address + i) & (MEMORY-1))] = job->video[i];
+
+        for ( i = 0; i < lines; i++ )
+            render_thread_dirty[((first_line + i) & (MEM_DIRTY_LINES-1))] = job->dirty[i];
+
+        refresh_all = job->refresh;
+        job->desc.renderer(&job->desc, job->band, 1);
+
+        for ( i = 0; i < lines; i++ )
+            render_thread_dirty[((first_line + i) & (MEM_DIRTY_LINES-1))] = 0;
+
+        frame_changed = 1;
+    }
+
+    if ( job->overlay )
+    {
+        vdg_draw_overlay(job->band, job->overlay_chars);
+        frame_changed = 1;
+    }
+
+    if ( job->band == (VDG_BANDS - 1) && frame_changed )
+    {
+        rpi_fb_flip(frame_buffer);
+        frame_changed = 0;
+    }
+}
+
+/*------------------------------------------------
+ * vdg_render_start()
+ *
+ * Start the render thread on Linux, or the render core on bare metal.
+ *
+ * param:  None
+ * return: '0' started, '-1' failed
+ *
+ */
+static int vdg_render_start(void)
+{
+#if (RPI_BARE_METAL==0)
+    if ( sem_init(&jobs_queued, 0, 0) != 0 ||
+         pthread_create(&render_thread_id, NULL, vdg_render_thread, NULL) != 0 )
+        return -1;
+
+    return 0;
+#else
+    return rpi_core_start(VDG_RENDER_CORE, vdg_render_loop);
+#endif
+}
+
+/*------------------------------------------------
+ * vdg_render_loop()
+ *
+ * Render thread or core loop, draws the queued bands in order.
+ * The renderers read the thread's copy of video memory, see vdg_render_band().
+ *
+ * param:  None
+ * return: Never returns
+ *
+ */
+static void vdg_render_loop(void)
+{
+    for (;;)
+    {
+#if (RPI_BARE_METAL==0)
+        if ( sem_wait(&jobs_queued) != 0 )
+            continue;
+#else
+        while ( job_tail == job_head )
+            __asm__ __volatile__ ("wfe");
+#endif
+
+        render_barrier();
+
+        vdg_band_job_render(&band_jobs[(job_tail & BAND_JOB_MASK)]);
+
+        render_barrier();
+
+        job_tail = job_tail + 1;
+    }
+}
+
+#if (RPI_BARE_METAL==0)
+/*------------------------------------------------
+ * vdg_render_thread()
+ *
+ * Linux render thread, pinned to its own core.
+ *
+ * param:  Not used
+ * return: Not used
+ *
+ */
+static void *vdg_render_thread(void *arg)
+{
+    rpi_cpu_pin(VDG_RENDER_CORE);
+    vdg_render_loop();
+
+    return 0L;
+}
+#endif
+#endif